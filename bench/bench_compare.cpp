@@ -0,0 +1,113 @@
+// Compara o resultado de "main --benchmark" (veja "benchmark.h") com um
+// resultado de referência, métrica por métrica. Termina com código 1 se o
+// percentil 95 de algum tempo (CPU, GPU ou quadro) piorou mais do que a
+// tolerância.
+//
+// Sem o arquivo de referência o resultado só é mostrado, exceto quando a
+// variável de ambiente CI está definida (como nos serviços de integração
+// contínua): aí a falta da referência também termina com código 1.
+//
+//     make bench
+//     ./bin/Linux/bench_compare <referência.json> <resultado.json> [tolerância em %]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Lê o arquivo inteiro; retorna false se ele não existe
+static bool read_file(const char* filename, std::string& contents)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+        return false;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.append(buffer, n);
+    fclose(file);
+    return true;
+}
+
+// Valor de "stat" dentro do objeto "section", no formato escrito por
+// Benchmark_WriteStats(). Retorna NAN se não encontrado.
+static double find_value(const std::string& json, const char* section, const char* stat)
+{
+    size_t begin = json.find(std::string("\"") + section + "\"");
+    if (begin == std::string::npos)
+        return NAN;
+    size_t end = json.find('}', begin);
+    size_t key = json.find(std::string("\"") + stat + "\":", begin);
+    if (key == std::string::npos || key > end)
+        return NAN;
+    return strtod(json.c_str() + key + strlen(stat) + 3, NULL);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Uso: %s <referência.json> <resultado.json> [tolerância em %%]\n", argv[0]);
+        return 2;
+    }
+    double tolerance = argc > 3 ? atof(argv[3]) : 10.0;
+
+    std::string baseline, result;
+    if (!read_file(argv[2], result))
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", argv[2]);
+        return 2;
+    }
+    if (!read_file(argv[1], baseline))
+    {
+        const char* ci = getenv("CI");
+        if (ci != NULL && ci[0] != '\0')
+        {
+            fprintf(stderr, "ERROR: Cannot open baseline \"%s\"; create it with \"make bench_baseline\".\n", argv[1]);
+            return 1;
+        }
+        printf("Sem referência em \"%s\"; para criá-la, use \"make bench_baseline\".\n", argv[1]);
+        return 0;
+    }
+
+    static const char* times[] = { "cpu_ms", "gpu_ms", "frame_ms" };
+    static const char* counts[] = { "draw_calls", "triangles" };
+    static const char* stats[] = { "mean", "p50", "p95", "p99", "max" };
+
+    printf("%-12s %-5s %12s %12s %9s\n", "", "", "referencia", "atual", "diferenca");
+    int regressions = 0;
+    for (int t = 0; t < 5; ++t)
+    {
+        bool is_time = t < 3;
+        const char* section = is_time ? times[t] : counts[t - 3];
+        for (int s = 0; s < 5; ++s)
+        {
+            if (!is_time && s != 0 && s != 4)
+                continue;
+            double before = find_value(baseline, section, stats[s]);
+            double after = find_value(result, section, stats[s]);
+            if (std::isnan(before) || std::isnan(after))
+                continue;
+
+            double change = before != 0.0 ? 100.0 * (after - before) / before : 0.0;
+            const char* note = "";
+            if (is_time && s == 2 && change > tolerance)
+            {
+                note = "  PIOROU";
+                ++regressions;
+            }
+            else if (!is_time && after != before)
+                note = "  mudou";
+            printf("%-12s %-5s %12.3f %12.3f %+8.1f%%%s\n", section, stats[s], before, after, change, note);
+        }
+    }
+
+    if (regressions > 0)
+    {
+        printf("%d tempo(s) com p95 mais de %.0f%% acima da referência.\n", regressions, tolerance);
+        return 1;
+    }
+    printf("Nenhum p95 mais de %.0f%% acima da referência.\n", tolerance);
+    return 0;
+}
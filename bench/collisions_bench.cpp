@@ -0,0 +1,221 @@
+// Compara os testes de colisão em lote ("collisions_simd.h") com as funções
+// escalares de "collisions.h", uma caixa por chamada. Tudo roda em uma única
+// thread, então os números são a vazão de um núcleo.
+//
+//     make bench_collisions
+//     ./bin/Linux/collisions_bench [número de caixas] [repetições]
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <tiny_obj_loader.h>
+
+#include "types.h"
+#include "collisions.h"
+#include "collisions_simd.h"
+
+static double now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float random_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static void report(const char* test, const char* version, size_t count, int repetitions, double seconds, size_t hits, double baseline)
+{
+    double rate = (double)count * repetitions / seconds / 1e6;
+    printf("%-8s %-10s %9.1f Mcaixas/s  %6.2fx  (%zu acertos)\n",
+           test, version, rate, baseline > 0.0 ? rate / baseline : 1.0, hits);
+}
+
+static size_t count_hits(const std::vector<uint64_t>& hits, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i)
+        total += Collisions_Hit(hits.data(), i);
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 4099;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 2000;
+
+    // Caixas aleatórias em uma sala parecida com a do jogo
+    srand(1);
+    std::vector<SceneObject> objects;
+    std::vector<float> min_x(count), min_y(count), min_z(count);
+    std::vector<float> max_x(count), max_y(count), max_z(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 lo(random_float(-10.0f, 10.0f), random_float(0.0f, 3.0f), random_float(-10.0f, 10.0f));
+        glm::vec3 hi = lo + glm::vec3(random_float(0.05f, 1.0f), random_float(0.05f, 1.0f), random_float(0.05f, 1.0f));
+        objects.push_back(SceneObject(0, 0, GL_TRIANGLES, 0, (int)i, lo, hi));
+        min_x[i] = lo.x; min_y[i] = lo.y; min_z[i] = lo.z;
+        max_x[i] = hi.x; max_y[i] = hi.y; max_z[i] = hi.z;
+    }
+    AABBArrays boxes = { min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data(), count };
+
+    // Jogador, esfera e raio da câmera
+    glm::vec3 player_min(-0.3f, 0.0f, -0.3f), player_max(2.3f, 1.8f, 2.3f);
+    SceneObject player(0, 0, GL_TRIANGLES, 0, -1, player_min, player_max);
+    glm::vec3 sphere_center(1.0f, 1.0f, 1.0f);
+    float radius = 1.5f;
+    glm::vec4 ray_origin(0.0f, 1.6f, 0.0f, 1.0f);
+    glm::vec4 ray = glm::normalize(glm::vec4(0.6f, -0.1f, 0.8f, 0.0f));
+
+    std::vector<uint64_t> hits(Collisions_HitWords(count));
+    std::vector<uint64_t> reference(Collisions_HitWords(count));
+    std::vector<float> distances(count);
+    CollisionsSimdLevel best = Collisions_SimdLevel();
+    volatile size_t sink = 0;
+    int errors = 0;
+
+    printf("%zu caixas, %d repetições, melhor versão suportada: %s\n\n",
+           count, repetitions, Collisions_SimdLevelName(best));
+
+    // Caixa contra caixa
+    {
+        double start = now_seconds();
+        size_t total = 0;
+        for (int r = 0; r < repetitions; ++r)
+            for (size_t i = 0; i < count; ++i)
+                total += isBoundingBoxIntersection(player, objects[i]);
+        double baseline = (double)count * repetitions / (now_seconds() - start) / 1e6;
+        sink += total;
+        report("AABB", "collisions", count, repetitions, (double)count * repetitions / baseline / 1e6, total / repetitions, 0.0);
+
+        std::fill(reference.begin(), reference.end(), 0);
+        for (size_t i = 0; i < count; ++i)
+            if (isBoundingBoxIntersection(player, objects[i]))
+                reference[i / 64] |= (uint64_t)1 << (i % 64);
+
+        for (int level = COLLISIONS_SCALAR; level <= best; ++level)
+        {
+            Collisions_SetSimdLevel((CollisionsSimdLevel)level);
+            start = now_seconds();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                Collisions_AABBBatch(boxes, player_min, player_max, hits.data());
+                sink += hits[0];
+            }
+            double seconds = now_seconds() - start;
+            report("AABB", Collisions_SimdLevelName((CollisionsSimdLevel)level), count, repetitions, seconds, count_hits(hits, count), baseline);
+            if (hits != reference)
+            {
+                printf("  ERRO: resultado diferente de isBoundingBoxIntersection()\n");
+                ++errors;
+            }
+        }
+        printf("\n");
+    }
+
+    // Esfera contra caixa
+    {
+        double start = now_seconds();
+        size_t total = 0;
+        for (int r = 0; r < repetitions; ++r)
+            for (size_t i = 0; i < count; ++i)
+                total += isCubeIntersectingSphere(glm::vec3(objects[i].get_bbox_min()), glm::vec3(objects[i].get_bbox_max()), sphere_center, radius);
+        double baseline = (double)count * repetitions / (now_seconds() - start) / 1e6;
+        sink += total;
+        report("Esfera", "collisions", count, repetitions, (double)count * repetitions / baseline / 1e6, total / repetitions, 0.0);
+
+        // Referência: a versão escalar do lote. isCubeIntersectingSphere()
+        // compara a distância e não o quadrado dela, o que pode mudar o
+        // resultado de caixas exatamente na borda da esfera.
+        Collisions_SetSimdLevel(COLLISIONS_SCALAR);
+        Collisions_SphereBatch(boxes, sphere_center, radius, reference.data());
+
+        for (int level = COLLISIONS_SCALAR; level <= best; ++level)
+        {
+            Collisions_SetSimdLevel((CollisionsSimdLevel)level);
+            start = now_seconds();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                Collisions_SphereBatch(boxes, sphere_center, radius, hits.data());
+                sink += hits[0];
+            }
+            double seconds = now_seconds() - start;
+            report("Esfera", Collisions_SimdLevelName((CollisionsSimdLevel)level), count, repetitions, seconds, count_hits(hits, count), baseline);
+            if (hits != reference)
+            {
+                printf("  ERRO: resultado diferente da versão escalar\n");
+                ++errors;
+            }
+        }
+        printf("\n");
+    }
+
+    // Raio contra caixa. isRayBoudingBox() também aceita caixas atrás da
+    // origem do raio, então só as distâncias das caixas à frente são comparadas.
+    {
+        double start = now_seconds();
+        size_t total = 0;
+        float distance;
+        for (int r = 0; r < repetitions; ++r)
+            for (size_t i = 0; i < count; ++i)
+                total += isRayBoudingBox(ray, ray_origin, objects[i], distance);
+        double baseline = (double)count * repetitions / (now_seconds() - start) / 1e6;
+        sink += total;
+        report("Raio", "collisions", count, repetitions, (double)count * repetitions / baseline / 1e6, total / repetitions, 0.0);
+
+        // As distâncias começam com FLT_MAX: as caixas não atingidas devem
+        // manter esse valor em todas as versões
+        std::vector<float> reference_distances(count, FLT_MAX);
+        Collisions_SetSimdLevel(COLLISIONS_SCALAR);
+        Collisions_RayBatch(boxes, glm::vec3(ray_origin), glm::vec3(ray), reference.data(), reference_distances.data());
+
+        for (int level = COLLISIONS_SCALAR; level <= best; ++level)
+        {
+            Collisions_SetSimdLevel((CollisionsSimdLevel)level);
+            std::fill(distances.begin(), distances.end(), FLT_MAX);
+            start = now_seconds();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                Collisions_RayBatch(boxes, glm::vec3(ray_origin), glm::vec3(ray), hits.data(), distances.data());
+                sink += hits[0];
+            }
+            double seconds = now_seconds() - start;
+            report("Raio", Collisions_SimdLevelName((CollisionsSimdLevel)level), count, repetitions, seconds, count_hits(hits, count), baseline);
+            if (hits != reference)
+            {
+                printf("  ERRO: resultado diferente da versão escalar\n");
+                ++errors;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (Collisions_Hit(hits.data(), i) && distances[i] >= 0.0f &&
+                    (!isRayBoudingBox(ray, ray_origin, objects[i], distance) || std::abs(distance - distances[i]) > 1e-4f))
+                {
+                    printf("  ERRO: distância da caixa %zu diferente de isRayBoudingBox()\n", i);
+                    ++errors;
+                    break;
+                }
+                if (!Collisions_Hit(hits.data(), i) && distances[i] != reference_distances[i])
+                {
+                    printf("  ERRO: distância da caixa %zu, não atingida, foi alterada\n", i);
+                    ++errors;
+                    break;
+                }
+            }
+        }
+    }
+
+    Collisions_SetSimdLevel(best);
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
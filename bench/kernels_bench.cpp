@@ -0,0 +1,296 @@
+// Microbenchmarks das funções de CPU mais usadas: matrizes ("matrices.h"),
+// colisões ("collisions.h"), carregamento dos modelos (ComputeNormals() e
+// MeshBuilder_Build(), veja "mesh_builder.h"), curvas ("spline.h") e texto
+// (TextRendering_PrintString()). Não precisa de GPU: as funções do OpenGL
+// nunca são chamadas e as duas da GLFW/"main.cpp" usadas pelo texto são
+// substituídas abaixo.
+//
+// Cada medição chama a função com as mesmas entradas fixas (os modelos são os
+// arquivos de "data/"), descarta KERNEL_WARMUP amostras e guarda o tempo
+// médio por chamada em cada uma das amostras seguintes. As estatísticas vão
+// para um arquivo JSON, em nanossegundos por chamada.
+//
+//     make bench_kernels
+//     ./bin/Linux/kernels_bench [diretório data] [resultado.json] [amostras]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <tiny_obj_loader.h>
+
+#include "types.h"
+#include "collisions.h"
+#include "mesh_builder.h"
+#include "spline.h"
+
+#define KERNEL_WARMUP 20
+
+// Funções de "textrendering.cpp"
+void TextRendering_BuildGlyphTable();
+void TextRendering_BeginFrame(GLFWwindow* window);
+void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f);
+
+// Substitutas das funções usadas por "textrendering.cpp": a janela tem
+// sempre 800x600 e nenhum programa é criado
+extern "C" void glfwGetWindowSize(GLFWwindow*, int* width, int* height)
+{
+    *width = 800;
+    *height = 600;
+}
+
+GLuint CreateGpuProgram(GLuint, GLuint)
+{
+    return 0;
+}
+
+// Resultados acumulados aqui, para que o compilador não elimine as chamadas
+volatile float g_Sink;
+
+struct KernelResult
+{
+    std::string         name;
+    int                 calls;  // Chamadas por amostra
+    std::vector<double> ns;     // Nanossegundos por chamada, uma por amostra
+};
+
+std::vector<KernelResult> g_Results;
+
+// Mede "calls" chamadas de "kernel(i)", i = 0 .. calls-1, por amostra
+template <typename Kernel>
+void Measure(const std::string& name, int calls, int samples, Kernel kernel)
+{
+    KernelResult result;
+    result.name = name;
+    result.calls = calls;
+    for (int s = -KERNEL_WARMUP; s < samples; ++s)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i)
+            kernel(i);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (s >= 0)
+            result.ns.push_back(std::chrono::duration<double, std::nano>(end - begin).count() / calls);
+    }
+    g_Results.push_back(result);
+
+    std::vector<double> sorted = result.ns;
+    std::sort(sorted.begin(), sorted.end());
+    printf("%-34s p50 %12.1f ns  min %12.1f ns\n", name.c_str(), sorted[sorted.size() / 2], sorted.front());
+}
+
+// Percentil pelo método do posto mais próximo, como em "benchmark.h"
+static double Percentile(const std::vector<double>& sorted, int percent)
+{
+    int n = (int)sorted.size();
+    return sorted[std::max(0, std::min(n - 1, (percent * n + 99) / 100 - 1))];
+}
+
+static bool WriteReport(const char* filename, int samples)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"unit\": \"ns\",\n");
+    fprintf(file, "  \"warmup\": %d,\n", KERNEL_WARMUP);
+    fprintf(file, "  \"samples\": %d,\n", samples);
+    for (size_t k = 0; k < g_Results.size(); ++k)
+    {
+        const KernelResult& result = g_Results[k];
+        std::vector<double> sorted = result.ns;
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+            sum += sorted[i];
+        double mean = sum / sorted.size();
+        double variance = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+            variance += (sorted[i] - mean) * (sorted[i] - mean);
+        double stddev = sorted.size() > 1 ? std::sqrt(variance / (sorted.size() - 1)) : 0.0;
+
+        fprintf(file, "  \"%s\": {\"calls\": %d, \"mean\": %.2f, \"stddev\": %.2f, \"min\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f, \"max\": %.2f}%s\n",
+                result.name.c_str(), result.calls, mean, stddev, sorted.front(),
+                Percentile(sorted, 50), Percentile(sorted, 95), Percentile(sorted, 99), sorted.back(),
+                k + 1 < g_Results.size() ? "," : "");
+    }
+    fprintf(file, "}\n");
+    fclose(file);
+    printf("Resultados em \"%s\".\n", filename);
+    return true;
+}
+
+static float random_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Avaliação por de Casteljau, como fazia o antigo calculateBezierPoint() de
+// "main.cpp", para comparação com Spline_Point()
+static glm::vec3 Casteljau(std::vector<glm::vec3> points, float t)
+{
+    for (size_t n = points.size() - 1; n > 0; --n)
+        for (size_t i = 0; i < n; ++i)
+            points[i] = points[i] + (points[i + 1] - points[i]) * t;
+    return points[0];
+}
+
+int main(int argc, char* argv[])
+{
+    std::string data = argc > 1 ? argv[1] : "../../data";
+    const char* output = argc > 2 ? argv[2] : "kernels.json";
+    int samples = argc > 3 ? atoi(argv[3]) : 200;
+    if (samples < 1)
+        samples = 1;
+
+    // Entradas fixas
+    srand(1);
+    const int count = 256;
+    std::vector<glm::vec4> positions(count), views(count), axes(count);
+    std::vector<float> angles(count), aspects(count);
+    std::vector<glm::vec3> box_min(count), box_max(count), centers(count), motions(count);
+    std::vector<SceneObject> objects;
+    for (int i = 0; i < count; ++i)
+    {
+        positions[i] = glm::vec4(random_float(-10.0f, 10.0f), random_float(0.5f, 3.0f), random_float(-10.0f, 10.0f), 1.0f);
+        views[i] = glm::vec4(random_float(-1.0f, 1.0f), random_float(-0.5f, 0.5f), random_float(-1.0f, 1.0f), 0.0f);
+        axes[i] = glm::vec4(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), 0.0f);
+        angles[i] = random_float(-3.14f, 3.14f);
+        aspects[i] = random_float(1.0f, 2.5f);
+
+        box_min[i] = glm::vec3(random_float(-10.0f, 10.0f), random_float(0.0f, 3.0f), random_float(-10.0f, 10.0f));
+        box_max[i] = box_min[i] + glm::vec3(random_float(0.05f, 1.0f), random_float(0.05f, 1.0f), random_float(0.05f, 1.0f));
+        centers[i] = glm::vec3(random_float(-10.0f, 10.0f), random_float(0.0f, 3.0f), random_float(-10.0f, 10.0f));
+        motions[i] = glm::vec3(random_float(-0.2f, 0.2f), 0.0f, random_float(-0.2f, 0.2f));
+        objects.push_back(SceneObject(0, 0, GL_TRIANGLES, 0, i, box_min[i], box_max[i]));
+    }
+    glm::vec3 player_min(-0.3f, 0.0f, -0.3f), player_max(0.3f, 1.8f, 0.3f);
+    glm::vec4 ray_origin(0.0f, 1.6f, 0.0f, 1.0f);
+
+    // Matrizes
+    Measure("matrix_camera_view", count, samples, [&](int i) {
+        g_Sink += Matrix_Camera_View(positions[i], views[i], glm::vec4(0.0f, 1.0f, 0.0f, 0.0f))[3][0];
+    });
+    Measure("matrix_rotate", count, samples, [&](int i) {
+        g_Sink += Matrix_Rotate(angles[i], axes[i])[0][0];
+    });
+    Measure("matrix_perspective", count, samples, [&](int i) {
+        g_Sink += Matrix_Perspective(3.141592f / 3.0f, aspects[i], -0.1f, -50.0f)[2][2];
+    });
+
+    // Colisões
+    Measure("collision_aabb", count, samples, [&](int i) {
+        g_Sink += isAABBIntersection(player_min + motions[i] * 40.0f, player_max + motions[i] * 40.0f, box_min[i], box_max[i]);
+    });
+    Measure("collision_ray_box", count, samples, [&](int i) {
+        float t;
+        g_Sink += isRayBoudingBox(positions[i] - ray_origin, ray_origin, objects[i], t);
+    });
+    Measure("collision_sphere_box", count, samples, [&](int i) {
+        g_Sink += isCubeIntersectingSphere(box_min[i], box_max[i], centers[i], 1.5f);
+    });
+    Measure("collision_swept_aabb", count, samples, [&](int i) {
+        float t;
+        glm::vec3 normal;
+        g_Sink += sweptAABB(player_min + centers[i], player_max + centers[i], motions[i] * 20.0f, box_min[i], box_max[i], t, normal);
+    });
+
+    // Modelos de "data/"
+    const char* model_files[] = {
+        "bunny.obj", "sphere.obj", "chess/ChessBoard.obj", "chess/Queen.obj",
+        "bed/Old_bed.obj", "sofa/sofa.obj", "bookshelf/bookshelf-031.obj" };
+    std::vector<ObjModel*> models;
+    for (size_t m = 0; m < sizeof(model_files) / sizeof(model_files[0]); ++m)
+        models.push_back(new ObjModel((data + "/" + model_files[m]).c_str()));
+
+    for (size_t m = 0; m < models.size(); ++m)
+    {
+        ObjModel* model = models[m];
+        int model_samples = std::max(samples / 10, 5);
+
+        // O arquivo pode ter normais; apagadas, ComputeNormals() as recalcula
+        Measure(std::string("compute_normals/") + model_files[m], 1, model_samples, [&](int) {
+            model->attrib.normals.clear();
+            ComputeNormals(model);
+        });
+
+        Measure(std::string("build_triangles/") + model_files[m], 1, model_samples, [&](int) {
+            std::map<std::string, MeshData> meshes;
+            MeshBuffers buffers;
+            std::vector<MeshShape> shapes;
+            MeshBuilder_Build(model, meshes, buffers, shapes);
+            g_Sink += (float)buffers.indices.size();
+        });
+    }
+
+    // Raios contra a BVH do coelho, como na seleção com o mouse
+    std::map<std::string, MeshData> bunny_meshes;
+    MeshBuffers bunny_buffers;
+    std::vector<MeshShape> bunny_shapes;
+    MeshBuilder_Build(models[0], bunny_meshes, bunny_buffers, bunny_shapes);
+    SceneObject bunny(0, 0, GL_TRIANGLES, 0, 0, bunny_shapes[0].bbox_min, bunny_shapes[0].bbox_max);
+    bunny.set_mesh_bvh(&bunny_shapes[0].mesh->bvh);
+    glm::vec4 bunny_center = glm::vec4((bunny_shapes[0].bbox_min + bunny_shapes[0].bbox_max) / 2.0f, 1.0f);
+    Measure("collision_ray_mesh/bunny.obj", count, samples, [&](int i) {
+        float t;
+        glm::vec4 origin = bunny_center + glm::vec4(glm::vec3(views[i]) * 5.0f, 0.0f);
+        g_Sink += isRayObject(bunny_center + glm::vec4(glm::vec3(axes[i]) * 0.3f, 0.0f) - origin, origin, bunny, t);
+    });
+
+    // Curvas: o caminho da animação de abertura, de "main.cpp"
+    const glm::vec3 intro_position_points[] = {
+        glm::vec3( 7.5f, 1.0f, -1.0f), glm::vec3( 5.5f, 1.0f,  2.0f), glm::vec3( 2.5f, 3.0f, -1.0f),
+        glm::vec3(-3.5f, 4.0f, -1.5f), glm::vec3(-3.5f, 2.0f,  3.0f), glm::vec3(-3.5f, 1.0f, -1.5f) };
+    const glm::vec3 intro_look_at_points[] = {
+        glm::vec3( 5.5f, 1.0f, -1.0f), glm::vec3( 5.5f, 0.0f,  2.0f), glm::vec3( 2.5f, 0.0f, -1.0f),
+        glm::vec3(-3.5f, 0.0f, -1.5f), glm::vec3(-3.5f, 0.0f,  3.0f), glm::vec3(-4.5f, 0.0f, -6.5f) };
+    std::vector<glm::vec3> control_points(intro_position_points, intro_position_points + 6);
+    CameraPath intro_path;
+    CameraPath_Build(intro_path, intro_position_points, 6, 8.0f, intro_look_at_points, 6, 6.0f);
+
+    Measure("bezier_casteljau", count, samples, [&](int i) {
+        g_Sink += Casteljau(control_points, i / (float)count).x;
+    });
+    Measure("spline_point", count, samples, [&](int i) {
+        g_Sink += Spline_Point(intro_path.position, i / (float)count).x;
+    });
+    Measure("camera_path_sample", count, samples, [&](int i) {
+        glm::vec3 position, look_at;
+        CameraPath_Sample(intro_path, 8.0f * i / count, position, look_at);
+        g_Sink += position.x + look_at.x;
+    });
+    Measure("camera_path_build", 1, samples, [&](int) {
+        CameraPath path;
+        CameraPath_Build(path, intro_position_points, 6, 8.0f, intro_look_at_points, 6, 6.0f);
+        g_Sink += path.position.length;
+    });
+
+    // Texto: um quadro com as linhas do HUD
+    TextRendering_BuildGlyphTable();
+    const char* lines[] = {
+        "60.00 fps", "Pressione E para inspecionar", "Pressione F para coletar",
+        "Pressione ESC para fechar o jogo", "cpu 4.21 ms  gpu 3.87 ms", "Voce perdeu!" };
+    Measure("text_print_frame", 1, samples, [&](int) {
+        TextRendering_BeginFrame(NULL);
+        for (int l = 0; l < 6; ++l)
+            TextRendering_PrintString(NULL, lines[l], -1.0f, 1.0f - 0.1f * l);
+    });
+
+    return WriteReport(output, samples) ? 0 : 1;
+}
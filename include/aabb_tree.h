@@ -0,0 +1,391 @@
+#ifndef _AABB_TREE_H
+#define _AABB_TREE_H
+
+// Árvore dinâmica de bounding boxes, usada para descobrir qual objeto está
+// na frente da câmera (veja GetInteractableObject() em "mouse_picking.h").
+//
+// Cada objeto é uma folha com uma caixa "gorda": a bounding box do objeto
+// aumentada de AABB_TREE_MARGIN em todas as direções. Enquanto o objeto se
+// move dentro dessa caixa a árvore não muda; quando ele sai, a folha é
+// removida e reinserida. Cada nó interno guarda a união das caixas dos
+// filhos, e a árvore é mantida balanceada com rotações (como a b2DynamicTree
+// da Box2D), então uma consulta visita O(log n) nós.
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "cpu_profiler.h"
+
+#define AABB_TREE_MARGIN 0.1f
+
+struct AABBTreeNode
+{
+    glm::vec3    bbox_min; // Caixa gorda, nas folhas; união dos filhos, nos nós internos
+    glm::vec3    bbox_max;
+    int          parent;   // Próximo nó livre, se o nó não está em uso
+    int          left;     // -1 nas folhas
+    int          right;
+    int          height;   // 0 nas folhas, -1 se o nó não está em uso
+    SceneObject* object;
+    unsigned int version;  // transform_version da última vez que a folha foi verificada
+};
+
+struct AABBTree
+{
+    std::vector<AABBTreeNode> nodes;
+    std::vector<int> leaves;     // Folha de cada objeto, na ordem de AABBTree_Build()
+    std::vector<int> stack;      // Pilha das consultas, reaproveitada entre chamadas
+    int root = -1;
+    int free_list = -1;
+    int reinserted = 0;          // Folhas reinseridas por terem saído da caixa gorda
+};
+
+AABBTree g_AABBTree;
+
+bool AABBTree_IsLeaf(int index)
+{
+    return g_AABBTree.nodes[index].left == -1;
+}
+
+// Área da superfície da caixa, usada como custo ao escolher onde inserir
+float AABBTree_Area(glm::vec3 bbox_min, glm::vec3 bbox_max)
+{
+    glm::vec3 d = bbox_max - bbox_min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void AABBTree_Fit(int index)
+{
+    AABBTreeNode& node = g_AABBTree.nodes[index];
+    const AABBTreeNode& left = g_AABBTree.nodes[node.left];
+    const AABBTreeNode& right = g_AABBTree.nodes[node.right];
+    node.bbox_min = glm::min(left.bbox_min, right.bbox_min);
+    node.bbox_max = glm::max(left.bbox_max, right.bbox_max);
+    node.height = 1 + std::max(left.height, right.height);
+}
+
+int AABBTree_AllocateNode()
+{
+    int index = g_AABBTree.free_list;
+    if (index == -1)
+    {
+        index = (int)g_AABBTree.nodes.size();
+        g_AABBTree.nodes.push_back(AABBTreeNode());
+    }
+    else
+        g_AABBTree.free_list = g_AABBTree.nodes[index].parent;
+
+    AABBTreeNode& node = g_AABBTree.nodes[index];
+    node.parent = -1;
+    node.left = -1;
+    node.right = -1;
+    node.height = 0;
+    node.object = NULL;
+    node.version = 0;
+    return index;
+}
+
+void AABBTree_FreeNode(int index)
+{
+    g_AABBTree.nodes[index].parent = g_AABBTree.free_list;
+    g_AABBTree.nodes[index].height = -1;
+    g_AABBTree.free_list = index;
+}
+
+// Se um dos filhos de "a" estiver dois níveis mais alto que o outro, sobe
+// esse filho para o lugar de "a". Retorna o nó que ficou nessa posição.
+int AABBTree_Balance(int a)
+{
+    std::vector<AABBTreeNode>& nodes = g_AABBTree.nodes;
+    if (AABBTree_IsLeaf(a) || nodes[a].height < 2)
+        return a;
+
+    int b = nodes[a].left;
+    int c = nodes[a].right;
+    int balance = nodes[c].height - nodes[b].height;
+    if (balance >= -1 && balance <= 1)
+        return a;
+
+    // "up" é o filho mais alto, que sobe para o lugar de "a"
+    int up = balance > 1 ? c : b;
+    int f = nodes[up].left;
+    int g = nodes[up].right;
+
+    nodes[up].left = a;
+    nodes[up].parent = nodes[a].parent;
+    nodes[a].parent = up;
+    if (nodes[up].parent != -1)
+    {
+        AABBTreeNode& parent = nodes[nodes[up].parent];
+        if (parent.left == a)
+            parent.left = up;
+        else
+            parent.right = up;
+    }
+    else
+        g_AABBTree.root = up;
+
+    // O neto mais alto fica com "up"; o outro passa para "a"
+    int keep = nodes[f].height > nodes[g].height ? f : g;
+    int move = keep == f ? g : f;
+    nodes[up].right = keep;
+    if (up == c)
+        nodes[a].right = move;
+    else
+        nodes[a].left = move;
+    nodes[move].parent = a;
+
+    AABBTree_Fit(a);
+    AABBTree_Fit(up);
+    return up;
+}
+
+// Corrige caixas e alturas de "index" até a raiz, balanceando no caminho
+void AABBTree_FitUpwards(int index)
+{
+    while (index != -1)
+    {
+        index = AABBTree_Balance(index);
+        AABBTree_Fit(index);
+        index = g_AABBTree.nodes[index].parent;
+    }
+}
+
+void AABBTree_InsertLeaf(int leaf)
+{
+    std::vector<AABBTreeNode>& nodes = g_AABBTree.nodes;
+    if (g_AABBTree.root == -1)
+    {
+        g_AABBTree.root = leaf;
+        nodes[leaf].parent = -1;
+        return;
+    }
+
+    // Desce pelo filho cuja caixa cresce menos ao incluir a folha, até que
+    // seja mais barato pendurar a folha ao lado do nó atual
+    glm::vec3 leaf_min = nodes[leaf].bbox_min;
+    glm::vec3 leaf_max = nodes[leaf].bbox_max;
+    int index = g_AABBTree.root;
+    while (!AABBTree_IsLeaf(index))
+    {
+        float area = AABBTree_Area(nodes[index].bbox_min, nodes[index].bbox_max);
+        float combined = AABBTree_Area(glm::min(nodes[index].bbox_min, leaf_min), glm::max(nodes[index].bbox_max, leaf_max));
+
+        // Custo de criar um novo pai para este nó e a folha
+        float cost = 2.0f * combined;
+        // Custo mínimo de descer mais: todos os ancestrais crescem
+        float inheritance = 2.0f * (combined - area);
+
+        float child_cost[2];
+        int children[2] = { nodes[index].left, nodes[index].right };
+        for (int i = 0; i < 2; ++i)
+        {
+            const AABBTreeNode& child = nodes[children[i]];
+            float grown = AABBTree_Area(glm::min(child.bbox_min, leaf_min), glm::max(child.bbox_max, leaf_max));
+            if (AABBTree_IsLeaf(children[i]))
+                child_cost[i] = grown + inheritance;
+            else
+                child_cost[i] = grown - AABBTree_Area(child.bbox_min, child.bbox_max) + inheritance;
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1])
+            break;
+        index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int old_parent = nodes[sibling].parent;
+    int new_parent = AABBTree_AllocateNode(); // Pode realocar "nodes"
+
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].left = sibling;
+    nodes[new_parent].right = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+    if (old_parent != -1)
+    {
+        if (nodes[old_parent].left == sibling)
+            nodes[old_parent].left = new_parent;
+        else
+            nodes[old_parent].right = new_parent;
+    }
+    else
+        g_AABBTree.root = new_parent;
+
+    AABBTree_FitUpwards(new_parent);
+}
+
+void AABBTree_RemoveLeaf(int leaf)
+{
+    std::vector<AABBTreeNode>& nodes = g_AABBTree.nodes;
+    if (leaf == g_AABBTree.root)
+    {
+        g_AABBTree.root = -1;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandparent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    // O irmão toma o lugar do pai
+    nodes[sibling].parent = grandparent;
+    if (grandparent != -1)
+    {
+        if (nodes[grandparent].left == parent)
+            nodes[grandparent].left = sibling;
+        else
+            nodes[grandparent].right = sibling;
+    }
+    else
+        g_AABBTree.root = sibling;
+    AABBTree_FreeNode(parent);
+
+    AABBTree_FitUpwards(grandparent);
+}
+
+// Caixa gorda de uma folha a partir da bounding box atual do objeto
+void AABBTree_SetFatBox(int leaf)
+{
+    AABBTreeNode& node = g_AABBTree.nodes[leaf];
+    node.bbox_min = glm::vec3(node.object->get_bbox_min()) - glm::vec3(AABB_TREE_MARGIN);
+    node.bbox_max = glm::vec3(node.object->get_bbox_max()) + glm::vec3(AABB_TREE_MARGIN);
+    node.version = node.object->get_transform_version();
+}
+
+int AABBTree_Insert(SceneObject* object)
+{
+    int leaf = AABBTree_AllocateNode();
+    g_AABBTree.nodes[leaf].object = object;
+    AABBTree_SetFatBox(leaf);
+    AABBTree_InsertLeaf(leaf);
+    return leaf;
+}
+
+void AABBTree_Remove(int leaf)
+{
+    AABBTree_RemoveLeaf(leaf);
+    AABBTree_FreeNode(leaf);
+}
+
+// Reinsere a folha se o objeto saiu da caixa gorda. Retorna true se reinseriu.
+bool AABBTree_Refit(int leaf)
+{
+    AABBTreeNode& node = g_AABBTree.nodes[leaf];
+    if (node.object->get_transform_version() == node.version)
+        return false;
+    node.version = node.object->get_transform_version();
+
+    glm::vec3 bbox_min = glm::vec3(node.object->get_bbox_min());
+    glm::vec3 bbox_max = glm::vec3(node.object->get_bbox_max());
+    if (glm::all(glm::greaterThanEqual(bbox_min, node.bbox_min)) &&
+        glm::all(glm::lessThanEqual(bbox_max, node.bbox_max)))
+        return false;
+
+    AABBTree_RemoveLeaf(leaf);
+    AABBTree_SetFatBox(leaf);
+    AABBTree_InsertLeaf(leaf);
+    ++g_AABBTree.reinserted;
+    return true;
+}
+
+void AABBTree_Build(const std::vector<SceneObject*>& objects)
+{
+    PROFILE_FUNCTION();
+    g_AABBTree.nodes.clear();
+    g_AABBTree.leaves.clear();
+    g_AABBTree.root = -1;
+    g_AABBTree.free_list = -1;
+
+    for (size_t i = 0; i < objects.size(); ++i)
+        g_AABBTree.leaves.push_back(AABBTree_Insert(objects[i]));
+}
+
+void AABBTree_Update()
+{
+    for (size_t i = 0; i < g_AABBTree.leaves.size(); ++i)
+        AABBTree_Refit(g_AABBTree.leaves[i]);
+}
+
+// Intervalo [t_enter, t_exit] do raio dentro da caixa ("slab test")
+bool AABBTree_RayBox(glm::vec3 origin, glm::vec3 inverse_ray, glm::vec3 bbox_min, glm::vec3 bbox_max, float& t_enter)
+{
+    glm::vec3 t1 = (bbox_min - origin) * inverse_ray;
+    glm::vec3 t2 = (bbox_max - origin) * inverse_ray;
+    glm::vec3 near = glm::min(t1, t2);
+    glm::vec3 far = glm::max(t1, t2);
+    t_enter = std::max(std::max(near.x, near.y), near.z);
+    float t_exit = std::min(std::min(far.x, far.y), far.z);
+    return t_enter <= t_exit && t_exit >= 0.0f;
+}
+
+// Objeto aceito por "accept" atingido mais perto da origem do raio
+// "ray_origin + t * ray", com 0 < t < max_distance. Retorna NULL se não há.
+// Nas folhas, o teste é exato contra os triângulos (isRayObject()).
+// Os nós cuja caixa começa depois do melhor t encontrado não são visitados.
+template <typename Accept>
+SceneObject* AABBTree_RayCast(glm::vec4 ray_origin, glm::vec4 ray, float max_distance, Accept accept, float& distance)
+{
+    SceneObject* nearest = NULL;
+    distance = max_distance;
+    if (g_AABBTree.root == -1)
+        return NULL;
+
+    glm::vec3 origin = glm::vec3(ray_origin);
+    glm::vec3 inverse_ray = glm::vec3(1.0f / ray.x, 1.0f / ray.y, 1.0f / ray.z);
+    const std::vector<AABBTreeNode>& nodes = g_AABBTree.nodes;
+    std::vector<int>& stack = g_AABBTree.stack;
+
+    stack.clear();
+    stack.push_back(g_AABBTree.root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+
+        const AABBTreeNode& node = nodes[index];
+        float t_enter;
+        if (!AABBTree_RayBox(origin, inverse_ray, node.bbox_min, node.bbox_max, t_enter) || t_enter >= distance)
+            continue;
+
+        if (node.left == -1)
+        {
+            float t;
+            if (accept(node.object) && isRayObject(ray, ray_origin, *node.object, t) && t > 0.0f && t < distance)
+            {
+                distance = t;
+                nearest = node.object;
+            }
+            continue;
+        }
+
+        // Visita primeiro o filho mais próximo, que deve diminuir "distance"
+        // e descartar o outro
+        float t_left, t_right;
+        bool hit_left = AABBTree_RayBox(origin, inverse_ray, nodes[node.left].bbox_min, nodes[node.left].bbox_max, t_left);
+        bool hit_right = AABBTree_RayBox(origin, inverse_ray, nodes[node.right].bbox_min, nodes[node.right].bbox_max, t_right);
+        if (hit_left && hit_right)
+        {
+            if (t_left <= t_right)
+            {
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            }
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+        else if (hit_left)
+            stack.push_back(node.left);
+        else if (hit_right)
+            stack.push_back(node.right);
+    }
+    return nearest;
+}
+
+#endif // _AABB_TREE_H
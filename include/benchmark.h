@@ -0,0 +1,232 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+// Modo de medição ("--benchmark"): percorre a sala por um caminho fixo e
+// escreve as estatísticas dos tempos de quadro em um arquivo JSON.
+//
+// A janela é criada escondida e sem vsync, de modo que roda também em
+// máquinas sem monitor (com um servidor X virtual, como xvfb-run, e o
+// renderizador por software do Mesa). A simulação ignora a entrada e executa
+// um tick por quadro: a câmera segue as paradas de BenchmarkStop, com
+// inspeções (o objeto gira na frente da câmera) e gavetas abertas no
+// caminho. O caminho se repete até completar os quadros pedidos; a resolução
+// dinâmica fica fixa em 1.0.
+//
+// São medidos, por quadro: o tempo de CPU da thread de renderização (do
+// início do quadro até a troca de buffers), o intervalo entre quadros, o
+// tempo de GPU (escopo "quadro" de "gpu_profiler.h") e o número de chamadas
+// de desenho e de triângulos de DrawVirtualObject(). Os primeiros
+// BENCHMARK_WARMUP_FRAMES quadros não entram nas estatísticas.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+
+#include "dynamic_resolution.h"
+#include "gpu_profiler.h"
+#include "simulation.h"
+
+#define BENCHMARK_WARMUP_FRAMES 60
+#define BENCHMARK_SPIN_SPEED    1.0f // Radianos por segundo durante a inspeção
+
+// Uma parada do caminho: a câmera vai da parada anterior até esta em
+// "travel" segundos e fica nela por "hold" segundos
+struct BenchmarkStop
+{
+    glm::vec4    position;
+    glm::vec4    look_at;
+    float        travel;
+    float        hold;
+    SceneObject* inspect; // Objeto inspecionado durante "hold", ou NULL
+    bool*        flag;    // Ligada ao chegar (uma gaveta, por exemplo), ou NULL
+};
+
+struct BenchmarkPose
+{
+    glm::vec4    position;
+    glm::vec4    look_at;
+    SceneObject* inspect;
+    float        spin;    // Ângulo do objeto inspecionado
+};
+
+struct Benchmark
+{
+    bool        running = false;
+    int         frames = 0;   // Quadros medidos, sem o aquecimento
+    const char* output = "benchmark.json";
+
+    // Simulação
+    std::vector<BenchmarkStop> stops;
+    float duration = 0.0f;
+    int   tick = 0;
+
+    // Renderização
+    int      frame = 0;
+    std::chrono::steady_clock::time_point frame_begin;
+    std::chrono::steady_clock::time_point previous_frame_end;
+    unsigned draw_calls = 0;  // Do quadro atual
+    unsigned triangles = 0;
+    std::vector<float> cpu_ms;
+    std::vector<float> frame_ms;
+    std::vector<float> gpu_ms;
+    std::vector<float> draw_call_counts;
+    std::vector<float> triangle_counts;
+};
+
+Benchmark g_Benchmark;
+
+// "frames" == 0 mede uma volta completa do caminho
+void Benchmark_Start(int frames, const char* output)
+{
+    g_Benchmark.running = true;
+    g_Benchmark.frames = frames;
+    if (output != NULL)
+        g_Benchmark.output = output;
+    DynamicResolution_SetFixedScale(1.0f);
+}
+
+void Benchmark_SetPath(const BenchmarkStop* stops, int count)
+{
+    g_Benchmark.stops.assign(stops, stops + count);
+    g_Benchmark.duration = 0.0f;
+    for (int i = 0; i < count; ++i)
+        g_Benchmark.duration += stops[i].travel + stops[i].hold;
+    if (g_Benchmark.frames <= 0)
+        g_Benchmark.frames = (int)(g_Benchmark.duration * SIMULATION_HZ);
+
+    printf("Benchmark: %d quadros (+%d de aquecimento), caminho de %.1f s.\n",
+           g_Benchmark.frames, BENCHMARK_WARMUP_FRAMES, g_Benchmark.duration);
+}
+
+// Simulação: um tick por quadro, desenhado sem interpolação
+int Benchmark_Advance()
+{
+    g_FixedTimestep.alpha = 1.0f;
+    return 1;
+}
+
+// Simulação, a cada tick: posição da câmera no caminho. As "flag" das
+// paradas já alcançadas são ligadas, e desligadas quando o caminho recomeça.
+void Benchmark_Update(BenchmarkPose& pose)
+{
+    float time = (g_Benchmark.tick++ % std::max((int)(g_Benchmark.duration * SIMULATION_HZ), 1)) * SIMULATION_DT;
+
+    pose.inspect = NULL;
+    pose.spin = 0.0f;
+    float start = 0.0f;
+    for (size_t i = 0; i < g_Benchmark.stops.size(); ++i)
+    {
+        const BenchmarkStop& stop = g_Benchmark.stops[i];
+        if (stop.flag != NULL)
+            *stop.flag = time >= start + stop.travel;
+
+        if (time < start)
+            continue;
+        if (time < start + stop.travel)
+        {
+            const BenchmarkStop& from = g_Benchmark.stops[i > 0 ? i - 1 : 0];
+            float f = (time - start) / stop.travel;
+            f = f * f * (3.0f - 2.0f * f);
+            pose.position = from.position + (stop.position - from.position) * f;
+            pose.look_at = from.look_at + (stop.look_at - from.look_at) * f;
+        }
+        else
+        {
+            pose.position = stop.position;
+            pose.look_at = stop.look_at;
+            if (stop.inspect != NULL && time < start + stop.travel + stop.hold)
+            {
+                pose.inspect = stop.inspect;
+                pose.spin = (time - start - stop.travel) * BENCHMARK_SPIN_SPEED;
+            }
+        }
+        start += stop.travel + stop.hold;
+    }
+}
+
+// Chamada por DrawVirtualObject()
+void Benchmark_CountDraw(GLenum mode, GLsizei count)
+{
+    ++g_Benchmark.draw_calls;
+    if (mode == GL_TRIANGLES)
+        g_Benchmark.triangles += count / 3;
+}
+
+// Renderização: início de um quadro, depois de GpuProfiler_BeginFrame()
+void Benchmark_BeginFrame()
+{
+    g_Benchmark.frame_begin = std::chrono::steady_clock::now();
+    g_Benchmark.draw_calls = 0;
+    g_Benchmark.triangles = 0;
+
+    float gpu;
+    if (g_Benchmark.frame > BENCHMARK_WARMUP_FRAMES + GPU_PROFILER_FRAMES &&
+        GpuProfiler_LastSample(GPU_SCOPE_FRAME, gpu))
+        g_Benchmark.gpu_ms.push_back(gpu);
+}
+
+// Renderização: fim de um quadro, antes da troca de buffers. Retorna true
+// quando todos os quadros foram medidos.
+bool Benchmark_EndFrame()
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    if (g_Benchmark.frame >= BENCHMARK_WARMUP_FRAMES)
+    {
+        g_Benchmark.cpu_ms.push_back(std::chrono::duration<float, std::milli>(end - g_Benchmark.frame_begin).count());
+        g_Benchmark.frame_ms.push_back(std::chrono::duration<float, std::milli>(end - g_Benchmark.previous_frame_end).count());
+        g_Benchmark.draw_call_counts.push_back((float)g_Benchmark.draw_calls);
+        g_Benchmark.triangle_counts.push_back((float)g_Benchmark.triangles);
+    }
+    g_Benchmark.previous_frame_end = end;
+    ++g_Benchmark.frame;
+    return g_Benchmark.frame >= BENCHMARK_WARMUP_FRAMES + g_Benchmark.frames;
+}
+
+// Escreve "name": {"mean": ..., "p50": ..., ...} com as amostras de "values"
+void Benchmark_WriteStats(FILE* file, const char* name, std::vector<float> values, bool last)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); ++i)
+        sum += values[i];
+    std::sort(values.begin(), values.end());
+
+    // Percentis pelo método do posto mais próximo
+    float p[3] = { 0.0f, 0.0f, 0.0f };
+    const int percent[3] = { 50, 95, 99 };
+    int n = (int)values.size();
+    for (int k = 0; k < 3 && n > 0; ++k)
+        p[k] = values[std::max(0, std::min(n - 1, (percent[k] * n + 99) / 100 - 1))];
+
+    fprintf(file, "  \"%s\": {\"samples\": %d, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+            name, n, n > 0 ? sum / n : 0.0, p[0], p[1], p[2], n > 0 ? values.back() : 0.0f, last ? "" : ",");
+    printf("%-10s media %9.3f  p50 %9.3f  p95 %9.3f  p99 %9.3f  max %9.3f\n",
+           name, n > 0 ? sum / n : 0.0, p[0], p[1], p[2], n > 0 ? values.back() : 0.0f);
+}
+
+bool Benchmark_WriteReport(const char* renderer)
+{
+    FILE* file = fopen(g_Benchmark.output, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", g_Benchmark.output);
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"renderer\": \"%s\",\n", renderer);
+    fprintf(file, "  \"frames\": %d,\n", (int)g_Benchmark.cpu_ms.size());
+    Benchmark_WriteStats(file, "cpu_ms", g_Benchmark.cpu_ms, false);
+    Benchmark_WriteStats(file, "gpu_ms", g_Benchmark.gpu_ms, false);
+    Benchmark_WriteStats(file, "frame_ms", g_Benchmark.frame_ms, false);
+    Benchmark_WriteStats(file, "draw_calls", g_Benchmark.draw_call_counts, false);
+    Benchmark_WriteStats(file, "triangles", g_Benchmark.triangle_counts, true);
+    fprintf(file, "}\n");
+    fclose(file);
+    printf("Resultados do benchmark em \"%s\".\n", g_Benchmark.output);
+    return true;
+}
+
+#endif // _BENCHMARK_H
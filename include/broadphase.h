@@ -0,0 +1,167 @@
+#ifndef _BROADPHASE_H
+#define _BROADPHASE_H
+
+// Fase ampla ("broadphase") das colisões do jogador.
+//
+// As bounding boxes dos objetos com colisão são inseridas em uma grade
+// uniforme de células cúbicas de lado BROADPHASE_CELL_SIZE, guardada em uma
+// tabela hash indexada pelas coordenadas inteiras da célula. Uma consulta
+// visita somente as células tocadas pela região pedida, então o custo de
+// move_with_collision() depende de quantos objetos estão perto do jogador e
+// não do tamanho da cena.
+//
+// Somente os objetos que se movem entram na grade: as paredes e os móveis
+// fazem parte do campo de distância de "collision_sdf.h".
+//
+// A grade é construída uma única vez, em Broadphase_Build(). Depois disso,
+// Broadphase_Update() reinsere somente os objetos que se moveram (gavetas e
+// peças de xadrez), detectados por SceneObject::get_transform_version(). A
+// forma de colisão de cada objeto (veja "collision_shapes.h") também é
+// recalculada somente nesse momento.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "cpu_profiler.h"
+
+#define BROADPHASE_CELL_SIZE 1.0f
+
+struct Collider
+{
+    SceneObject*   object;
+    CollisionShape shape;    // Forma em coordenadas globais. Veja Collision_ObjectShape().
+    glm::vec3      bbox_min; // Caixa que envolve a forma
+    glm::vec3      bbox_max;
+
+    unsigned int version;    // transform_version usada para calcular a bounding box
+    int          cell_min[3]; // Células ocupadas na grade
+    int          cell_max[3];
+    unsigned int query;      // Última consulta que retornou este collider
+};
+
+struct Broadphase
+{
+    std::vector<Collider> colliders;
+    std::unordered_map<uint64_t, std::vector<int> > cells; // Índices em "colliders"
+    unsigned int query = 0;
+    int          reinserted = 0; // Objetos reinseridos por terem se movido
+};
+
+Broadphase g_Broadphase;
+
+int Broadphase_Cell(float coordinate)
+{
+    return (int)std::floor(coordinate / BROADPHASE_CELL_SIZE);
+}
+
+// Chave de uma célula: 21 bits de cada coordenada
+uint64_t Broadphase_CellKey(int x, int y, int z)
+{
+    return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+}
+
+// Recalcula a bounding box e insere o collider nas células que ela toca
+void Broadphase_Insert(int index)
+{
+    Collider& collider = g_Broadphase.colliders[index];
+    SceneObject* obj = collider.object;
+
+    collider.shape = Collision_ObjectShape(*obj);
+    CollisionShape_Bounds(collider.shape, collider.bbox_min, collider.bbox_max);
+    collider.version = obj->get_transform_version();
+
+    for (int a = 0; a < 3; ++a)
+    {
+        collider.cell_min[a] = Broadphase_Cell(collider.bbox_min[a]);
+        collider.cell_max[a] = Broadphase_Cell(collider.bbox_max[a]);
+    }
+
+    for (int x = collider.cell_min[0]; x <= collider.cell_max[0]; ++x)
+    for (int y = collider.cell_min[1]; y <= collider.cell_max[1]; ++y)
+    for (int z = collider.cell_min[2]; z <= collider.cell_max[2]; ++z)
+        g_Broadphase.cells[Broadphase_CellKey(x, y, z)].push_back(index);
+}
+
+void Broadphase_Remove(int index)
+{
+    const Collider& collider = g_Broadphase.colliders[index];
+    for (int x = collider.cell_min[0]; x <= collider.cell_max[0]; ++x)
+    for (int y = collider.cell_min[1]; y <= collider.cell_max[1]; ++y)
+    for (int z = collider.cell_min[2]; z <= collider.cell_max[2]; ++z)
+    {
+        std::vector<int>& cell = g_Broadphase.cells[Broadphase_CellKey(x, y, z)];
+        cell.erase(std::remove(cell.begin(), cell.end(), index), cell.end());
+    }
+}
+
+// Constrói a grade com os objetos que têm colisão
+void Broadphase_Build(const std::vector<SceneObject*>& objects)
+{
+    PROFILE_FUNCTION();
+    g_Broadphase.colliders.clear();
+    g_Broadphase.cells.clear();
+
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (!objects[i]->has_collision())
+            continue;
+
+        Collider collider;
+        collider.object = objects[i];
+        collider.query = 0;
+        g_Broadphase.colliders.push_back(collider);
+        Broadphase_Insert((int)g_Broadphase.colliders.size() - 1);
+    }
+}
+
+// Reinsere os objetos que se moveram desde a última atualização
+void Broadphase_Update()
+{
+    for (size_t i = 0; i < g_Broadphase.colliders.size(); ++i)
+    {
+        const Collider& collider = g_Broadphase.colliders[i];
+        if (collider.object->get_transform_version() == collider.version)
+            continue;
+
+        Broadphase_Remove((int)i);
+        Broadphase_Insert((int)i);
+        ++g_Broadphase.reinserted;
+    }
+}
+
+// Coloca em "result" os colliders cujas células tocam a caixa [lo, hi]. Cada
+// collider aparece uma única vez, mesmo ocupando várias dessas células.
+void Broadphase_Query(glm::vec3 lo, glm::vec3 hi, std::vector<int>& result)
+{
+    result.clear();
+    unsigned int query = ++g_Broadphase.query;
+
+    int x0 = Broadphase_Cell(lo.x), x1 = Broadphase_Cell(hi.x);
+    int y0 = Broadphase_Cell(lo.y), y1 = Broadphase_Cell(hi.y);
+    int z0 = Broadphase_Cell(lo.z), z1 = Broadphase_Cell(hi.z);
+    for (int x = x0; x <= x1; ++x)
+    for (int y = y0; y <= y1; ++y)
+    for (int z = z0; z <= z1; ++z)
+    {
+        std::unordered_map<uint64_t, std::vector<int> >::const_iterator cell =
+            g_Broadphase.cells.find(Broadphase_CellKey(x, y, z));
+        if (cell == g_Broadphase.cells.end())
+            continue;
+
+        for (size_t i = 0; i < cell->second.size(); ++i)
+        {
+            Collider& collider = g_Broadphase.colliders[cell->second[i]];
+            if (collider.query == query)
+                continue;
+            collider.query = query;
+            result.push_back(cell->second[i]);
+        }
+    }
+}
+
+#endif // _BROADPHASE_H
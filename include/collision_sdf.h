@@ -0,0 +1,271 @@
+#ifndef _COLLISION_SDF_H
+#define _COLLISION_SDF_H
+
+// Campo de distância com sinal (SDF) pré-calculado das formas de colisão
+// estáticas da sala.
+//
+// As paredes e os móveis nunca se movem, então em vez de testar o jogador
+// contra cada uma dessas formas a cada passo (veja "collision_shapes.h"),
+// guardamos em uma grade 3D a distância com sinal até a forma estática mais
+// próxima: positiva fora dos objetos e negativa dentro. A distância de uma
+// esfera ou cápsula até o mundo estático vira então algumas consultas
+// trilineares na grade, e a normal do contato é o gradiente do campo.
+//
+// A grade é esparsa, dividida em "bricks" de COLLISION_SDF_BRICK^3 voxels.
+// Somente os bricks perto de alguma superfície (a menos de
+// COLLISION_SDF_BAND do lado de fora) guardam amostras, quantizadas em 16
+// bits; os demais guardam um único valor, um limite inferior da distância
+// dentro do brick, o bastante para avançar o jogador com segurança. Cada
+// brick guarda as amostras das suas bordas, repetidas nos vizinhos, para que
+// uma consulta leia um único brick.
+//
+// CollisionSDF_Bake() calcula as amostras usando todos os núcleos da CPU, e o
+// resultado é salvo em disco junto com um hash das formas usadas. Ao iniciar,
+// CollisionSDF_LoadOrBake() reaproveita o arquivo se as formas não mudaram.
+// Veja "src/collision_sdf.cpp".
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include "collision_shapes.h"
+
+#define COLLISION_SDF_DIR "../../data/collision"
+#define COLLISION_SDF_VOXEL_SIZE 0.05f // Distância entre amostras
+#define COLLISION_SDF_BRICK 8          // Voxels por brick em cada eixo
+#define COLLISION_SDF_BAND 1.2f        // Alcance das amostras fora dos objetos; maior que o raio do jogador
+#define COLLISION_SDF_SCALE 4096.0f    // Valores quantizados por unidade de distância
+
+// Amostras por brick em cada eixo: os voxels e mais a borda compartilhada
+#define COLLISION_SDF_BRICK_SAMPLES (COLLISION_SDF_BRICK + 1)
+
+struct CollisionSDF
+{
+    glm::vec3 origin;     // Canto mínimo da grade
+    float     voxel_size;
+    int       bricks[3];  // Número de bricks em cada eixo
+    uint32_t  hash;       // Hash das formas usadas no cálculo
+
+    std::vector<int32_t> brick_index;    // Por brick: primeiro índice em "samples", ou -1
+    std::vector<float>   brick_distance; // Por brick sem amostras: limite da distância
+    std::vector<int16_t> samples;        // COLLISION_SDF_BRICK_SAMPLES^3 por brick, x mais rápido
+
+    CollisionSDF() : origin(0.0f), voxel_size(COLLISION_SDF_VOXEL_SIZE), hash(0) { bricks[0] = bricks[1] = bricks[2] = 0; }
+
+    bool empty() const { return brick_index.empty(); }
+};
+
+// Campo das formas estáticas da sala, usado por move_with_collision()
+extern CollisionSDF g_CollisionSDF;
+
+// Calcula o campo das formas "shapes" (em coordenadas globais). Formas
+// COLLISION_MESH usam os triângulos da sua BVH.
+void CollisionSDF_Bake(CollisionSDF& sdf, const std::vector<CollisionShape>& shapes);
+
+// Caminho do arquivo de um campo
+std::string CollisionSDF_Path(const std::string& name);
+
+bool CollisionSDF_Save(const CollisionSDF& sdf, const std::string& name);
+
+// Carrega um campo salvo por CollisionSDF_Save(). Falha se o arquivo não
+// existir, for inválido ou tiver sido calculado com outras formas.
+bool CollisionSDF_Load(CollisionSDF& sdf, const std::string& name, const std::vector<CollisionShape>& shapes);
+
+// Carrega o campo salvo ou, se ele não existir, estiver desatualizado ou
+// "bake" for verdadeiro, calcula e salva um novo
+void CollisionSDF_LoadOrBake(CollisionSDF& sdf, const std::string& name, const std::vector<CollisionShape>& shapes, bool bake);
+
+//------------------------------------------------------------------------------
+// Consultas. Todas leem somente o brick que contém o ponto.
+
+// Distância com sinal no ponto p, interpolada trilinearmente. Fora dos bricks
+// com amostras o valor é um limite inferior da distância verdadeira.
+inline float CollisionSDF_Distance(const CollisionSDF& sdf, glm::vec3 p)
+{
+    glm::vec3 g = (p - sdf.origin) / sdf.voxel_size;
+    glm::vec3 size = glm::vec3(sdf.bricks[0], sdf.bricks[1], sdf.bricks[2]) * (float)COLLISION_SDF_BRICK;
+
+    // Fora da grade não há formas estáticas: a grade tem um brick de folga
+    // em volta de todas elas
+    glm::vec3 outside = glm::max(glm::max(-g, g - size), glm::vec3(0.0f));
+    if (outside.x > 0.0f || outside.y > 0.0f || outside.z > 0.0f)
+        return (glm::length(outside) + COLLISION_SDF_BRICK) * sdf.voxel_size;
+
+    int brick[3] = { 0, 0, 0 };
+    int cell[3];
+    float f[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        brick[a] = std::min((int)(g[a] / COLLISION_SDF_BRICK), sdf.bricks[a] - 1);
+        float local = g[a] - (float)(brick[a] * COLLISION_SDF_BRICK);
+        cell[a] = std::min((int)local, COLLISION_SDF_BRICK - 1);
+        f[a] = local - (float)cell[a];
+    }
+
+    int b = (brick[2] * sdf.bricks[1] + brick[1]) * sdf.bricks[0] + brick[0];
+    int first = sdf.brick_index[b];
+    if (first < 0)
+        return sdf.brick_distance[b];
+
+    const int sx = 1, sy = COLLISION_SDF_BRICK_SAMPLES, sz = COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES;
+    const int16_t* s = &sdf.samples[first + cell[2] * sz + cell[1] * sy + cell[0]];
+    float c00 = s[0]       + f[0] * (s[sx]           - s[0]);
+    float c10 = s[sy]      + f[0] * (s[sy + sx]      - s[sy]);
+    float c01 = s[sz]      + f[0] * (s[sz + sx]      - s[sz]);
+    float c11 = s[sz + sy] + f[0] * (s[sz + sy + sx] - s[sz + sy]);
+    float c0 = c00 + f[1] * (c10 - c00);
+    float c1 = c01 + f[1] * (c11 - c01);
+    return (c0 + f[2] * (c1 - c0)) * (1.0f / COLLISION_SDF_SCALE);
+}
+
+// Gradiente do campo por diferenças centrais, normalizado: aponta para fora
+// da forma estática mais próxima. O passo é bem menor que um voxel para não
+// misturar as normais das duas paredes de um canto.
+inline glm::vec3 CollisionSDF_Gradient(const CollisionSDF& sdf, glm::vec3 p)
+{
+    float h = 0.1f * sdf.voxel_size;
+    glm::vec3 gradient = glm::vec3(
+        CollisionSDF_Distance(sdf, p + glm::vec3(h, 0.0f, 0.0f)) - CollisionSDF_Distance(sdf, p - glm::vec3(h, 0.0f, 0.0f)),
+        CollisionSDF_Distance(sdf, p + glm::vec3(0.0f, h, 0.0f)) - CollisionSDF_Distance(sdf, p - glm::vec3(0.0f, h, 0.0f)),
+        CollisionSDF_Distance(sdf, p + glm::vec3(0.0f, 0.0f, h)) - CollisionSDF_Distance(sdf, p - glm::vec3(0.0f, 0.0f, h)));
+    float length = glm::length(gradient);
+    return length > 0.0f ? gradient / length : glm::vec3(0.0f);
+}
+
+// Distância de uma esfera ou cápsula até o mundo estático (negativa se há
+// penetração) e o ponto do eixo da forma mais próximo dele. O segmento da
+// cápsula é amostrado a cada meio raio. Outras formas são tratadas como a
+// esfera que as envolve.
+inline float CollisionSDF_ShapeDistance(const CollisionSDF& sdf, const CollisionShape& shape, glm::vec3& closest)
+{
+    glm::vec3 a = shape.center, b = shape.center;
+    float radius = shape.radius;
+    if (shape.type == COLLISION_CAPSULE)
+    {
+        a = shape.center - shape.segment;
+        b = shape.center + shape.segment;
+    }
+    else if (shape.type != COLLISION_SPHERE)
+    {
+        glm::vec3 bbox_min, bbox_max;
+        CollisionShape_Bounds(shape, bbox_min, bbox_max);
+        a = b = (bbox_min + bbox_max) * 0.5f;
+        radius = 0.5f * glm::length(bbox_max - bbox_min);
+    }
+
+    int steps = 1 + (int)(glm::length(b - a) / std::max(0.5f * radius, sdf.voxel_size));
+    float best = 1e30f;
+    for (int i = 0; i <= steps; ++i)
+    {
+        glm::vec3 p = a + (b - a) * ((float)i / (float)steps);
+        float d = CollisionSDF_Distance(sdf, p);
+        if (d < best)
+        {
+            best = d;
+            closest = p;
+        }
+    }
+    return best - radius;
+}
+
+// Distância de "moving" deslocada por motion * s até o mundo estático
+inline float CollisionSDF_MovedDistance(const CollisionSDF& sdf, const CollisionShape& moving, glm::vec3 motion,
+                                        float s, glm::vec3& closest)
+{
+    CollisionShape shape = moving;
+    CollisionShape_Translate(shape, motion * s);
+    return CollisionSDF_ShapeDistance(sdf, shape, closest);
+}
+
+// Verdadeiro se "moving" deslocada por motion * s está em contato com o
+// mundo e se aproximando dele, com a normal do contato em "normal"
+inline bool CollisionSDF_Blocked(const CollisionSDF& sdf, const CollisionShape& moving, glm::vec3 motion,
+                                 float s, float contact, glm::vec3& normal)
+{
+    glm::vec3 closest;
+    float d = CollisionSDF_MovedDistance(sdf, moving, motion, s, closest);
+    if (d > contact)
+        return false;
+    normal = CollisionSDF_Gradient(sdf, closest);
+    return d < 0.5f * contact || glm::dot(normal, motion) < -0.01f * glm::length(motion);
+}
+
+// Varredura de "moving" deslocada por "motion" contra o mundo estático, no
+// formato de g_CollisionSweeps: instante t em [0, 1] do primeiro contato e a
+// normal que empurra a forma para fora. A forma avança pela distância livre
+// dada pelo campo ("sphere tracing"), então não atravessa paredes finas, e o
+// contato acontece a menos de "contact" do mundo. Uma forma que já toca o
+// mundo só colide se estiver se aproximando dele.
+inline bool CollisionSDF_Sweep(const CollisionSDF& sdf, const CollisionShape& moving, glm::vec3 motion,
+                               float contact, float& t, glm::vec3& normal)
+{
+    float length = glm::length(motion);
+    if (sdf.empty() || length == 0.0f)
+        return false;
+
+    float s = 0.0f;
+    glm::vec3 closest;
+    for (int iteration = 0; iteration < 32; ++iteration)
+    {
+        float d = CollisionSDF_MovedDistance(sdf, moving, motion, s, closest);
+        if (d > contact)
+        {
+            s += (d - 0.5f * contact) / length;
+            if (s >= 1.0f)
+                return false;
+            continue;
+        }
+
+        glm::vec3 n = CollisionSDF_Gradient(sdf, closest);
+        if (glm::dot(n, motion) < -0.01f * length)
+        {
+            t = s;
+            normal = n;
+            return true;
+        }
+
+        // Encostada, mas deslizando ou se afastando: a distância não diz
+        // quanto falta até o contato com outra superfície (em um canto, por
+        // exemplo), então damos um passo curto e, se no fim dele a forma
+        // estiver bloqueada, procuramos por bisseção onde o contato começa
+        float next = std::min(s + 0.25f * sdf.voxel_size / length, 1.0f);
+        glm::vec3 next_normal;
+        if (CollisionSDF_Blocked(sdf, moving, motion, next, contact, next_normal))
+        {
+            float lo = s, hi = next;
+            for (int i = 0; i < 8; ++i)
+            {
+                float mid = 0.5f * (lo + hi);
+                glm::vec3 mid_normal;
+                if (CollisionSDF_Blocked(sdf, moving, motion, mid, contact, mid_normal))
+                {
+                    hi = mid;
+                    next_normal = mid_normal;
+                }
+                else
+                {
+                    lo = mid;
+                }
+            }
+            t = lo;
+            normal = next_normal;
+            return true;
+        }
+        if (next >= 1.0f)
+            return false;
+        s = next;
+    }
+
+    // Aproximação rasante que não convergiu: para onde chegou
+    t = s;
+    normal = CollisionSDF_Gradient(sdf, closest);
+    return true;
+}
+
+#endif // _COLLISION_SDF_H
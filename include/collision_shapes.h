@@ -0,0 +1,622 @@
+#ifndef _COLLISION_SHAPES_H
+#define _COLLISION_SHAPES_H
+
+// Formas de colisão e testes de sobreposição entre pares de formas.
+//
+// Cada SceneObject escolhe uma forma com set_collision_shape(); a forma em
+// coordenadas globais é montada por Collision_ObjectShape() ("collisions.h")
+// e guardada pela fase ampla ("broadphase.h") até o objeto se mover.
+//
+//   COLLISION_AABB    caixa alinhada aos eixos globais
+//   COLLISION_OBB     caixa orientada pelos eixos da matriz "model"
+//   COLLISION_SPHERE  esfera (objetos com set_radius())
+//   COLLISION_CAPSULE segmento vertical com raio, usado pelo jogador
+//   COLLISION_MESH    triângulos do modelo, através da BVH de "mesh_bvh.h"
+//
+// Collision_Overlap() escolhe o teste pelo tipo das duas formas em uma tabela
+// g_CollisionTests montada em tempo de compilação, com uma função
+// especializada para cada par. Os pares em ordem invertida reaproveitam a
+// mesma função com Collision_Swapped<>. As formas são sempre passadas por
+// referência constante.
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+
+#include "mesh_bvh.h"
+
+enum CollisionShapeType
+{
+    COLLISION_AABB,
+    COLLISION_OBB,
+    COLLISION_SPHERE,
+    COLLISION_CAPSULE,
+    COLLISION_MESH,
+    COLLISION_SHAPE_COUNT
+};
+
+struct CollisionShape
+{
+    CollisionShapeType type;
+    glm::vec3      center;        // Centro da caixa ou da esfera; meio do segmento da cápsula
+    glm::vec3      half_size;     // Caixas: meia-dimensão ao longo de cada eixo
+    glm::vec3      axes[3];       // Caixas: eixos unitários (os globais na AABB)
+    glm::vec3      segment;       // Cápsula: segmento de center - segment a center + segment
+    float          radius;        // Esfera e cápsula
+    const MeshBVH* mesh;          // Malha
+    glm::mat4      model;
+    glm::mat4      inverse_model;
+};
+
+inline CollisionShape CollisionShape_Empty(CollisionShapeType type)
+{
+    CollisionShape shape;
+    shape.type = type;
+    shape.center = glm::vec3(0.0f);
+    shape.half_size = glm::vec3(0.0f);
+    shape.axes[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+    shape.axes[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+    shape.axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+    shape.segment = glm::vec3(0.0f);
+    shape.radius = 0.0f;
+    shape.mesh = NULL;
+    shape.model = glm::mat4(1.0f);
+    shape.inverse_model = glm::mat4(1.0f);
+    return shape;
+}
+
+inline CollisionShape CollisionShape_AABB(glm::vec3 bbox_min, glm::vec3 bbox_max)
+{
+    CollisionShape shape = CollisionShape_Empty(COLLISION_AABB);
+    shape.center = (bbox_min + bbox_max) * 0.5f;
+    shape.half_size = (bbox_max - bbox_min) * 0.5f;
+    return shape;
+}
+
+inline CollisionShape CollisionShape_OBB(glm::vec3 center, glm::vec3 half_size, const glm::vec3 axes[3])
+{
+    CollisionShape shape = CollisionShape_Empty(COLLISION_OBB);
+    shape.center = center;
+    shape.half_size = half_size;
+    for (int i = 0; i < 3; ++i)
+        shape.axes[i] = axes[i];
+    return shape;
+}
+
+inline CollisionShape CollisionShape_Sphere(glm::vec3 center, float radius)
+{
+    CollisionShape shape = CollisionShape_Empty(COLLISION_SPHERE);
+    shape.center = center;
+    shape.radius = radius;
+    return shape;
+}
+
+// Cápsula entre os pontos "a" e "b"
+inline CollisionShape CollisionShape_Capsule(glm::vec3 a, glm::vec3 b, float radius)
+{
+    CollisionShape shape = CollisionShape_Empty(COLLISION_CAPSULE);
+    shape.center = (a + b) * 0.5f;
+    shape.segment = (b - a) * 0.5f;
+    shape.radius = radius;
+    return shape;
+}
+
+inline CollisionShape CollisionShape_Mesh(const MeshBVH* mesh, const glm::mat4& model)
+{
+    CollisionShape shape = CollisionShape_Empty(COLLISION_MESH);
+    shape.mesh = mesh;
+    shape.model = model;
+    shape.inverse_model = glm::inverse(model);
+    shape.center = glm::vec3(model[3]);
+    return shape;
+}
+
+inline void CollisionShape_Translate(CollisionShape& shape, glm::vec3 offset)
+{
+    shape.center += offset;
+    if (shape.type == COLLISION_MESH)
+    {
+        shape.model[3] += glm::vec4(offset, 0.0f);
+        shape.inverse_model = glm::inverse(shape.model);
+    }
+}
+
+// Caixa alinhada aos eixos globais que envolve a forma
+inline void CollisionShape_Bounds(const CollisionShape& shape, glm::vec3& bbox_min, glm::vec3& bbox_max)
+{
+    glm::vec3 extent;
+    switch (shape.type)
+    {
+        case COLLISION_AABB:
+        case COLLISION_OBB:
+            extent = glm::abs(shape.axes[0]) * shape.half_size.x
+                   + glm::abs(shape.axes[1]) * shape.half_size.y
+                   + glm::abs(shape.axes[2]) * shape.half_size.z;
+            break;
+        case COLLISION_SPHERE:
+            extent = glm::vec3(shape.radius);
+            break;
+        case COLLISION_CAPSULE:
+            extent = glm::abs(shape.segment) + glm::vec3(shape.radius);
+            break;
+        default:
+        {
+            if (shape.mesh == NULL || shape.mesh->empty())
+            {
+                bbox_min = bbox_max = shape.center;
+                return;
+            }
+            // Caixa da raiz da BVH levada para as coordenadas globais
+            const MeshBVHNode& root = shape.mesh->nodes[0];
+            glm::vec3 c = glm::vec3(shape.model * glm::vec4((root.bbox_min + root.bbox_max) * 0.5f, 1.0f));
+            glm::vec3 h = (root.bbox_max - root.bbox_min) * 0.5f;
+            for (int a = 0; a < 3; ++a)
+                extent[a] = std::fabs(shape.model[0][a]) * h.x + std::fabs(shape.model[1][a]) * h.y + std::fabs(shape.model[2][a]) * h.z;
+            bbox_min = c - extent;
+            bbox_max = c + extent;
+            return;
+        }
+    }
+    bbox_min = shape.center - extent;
+    bbox_max = shape.center + extent;
+}
+
+// Menor espessura da forma: uma forma que se move menos que isso entre duas
+// amostras não atravessa um obstáculo sem tocá-lo em alguma delas
+inline float CollisionShape_Thickness(const CollisionShape& shape)
+{
+    switch (shape.type)
+    {
+        case COLLISION_AABB:
+        case COLLISION_OBB:
+            return 2.0f * std::min(shape.half_size.x, std::min(shape.half_size.y, shape.half_size.z));
+        case COLLISION_SPHERE:
+        case COLLISION_CAPSULE:
+            return 2.0f * shape.radius;
+        default:
+            return 0.0f;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Funções geométricas auxiliares
+
+inline glm::vec3 Collision_ClosestPointOnSegment(glm::vec3 p, glm::vec3 a, glm::vec3 b)
+{
+    glm::vec3 ab = b - a;
+    float length2 = glm::dot(ab, ab);
+    if (length2 == 0.0f)
+        return a;
+    float s = glm::clamp(glm::dot(p - a, ab) / length2, 0.0f, 1.0f);
+    return a + ab * s;
+}
+
+// Pontos mais próximos entre os segmentos [p1, q1] e [p2, q2] (Ericson,
+// Real-Time Collision Detection)
+inline void Collision_ClosestPointsSegments(glm::vec3 p1, glm::vec3 q1, glm::vec3 p2, glm::vec3 q2, glm::vec3& c1, glm::vec3& c2)
+{
+    glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    float s, t;
+    if (a <= 1e-12f && e <= 1e-12f)
+    {
+        c1 = p1;
+        c2 = p2;
+        return;
+    }
+    if (a <= 1e-12f)
+    {
+        s = 0.0f;
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    }
+    else
+    {
+        float c = glm::dot(d1, r);
+        if (e <= 1e-12f)
+        {
+            t = 0.0f;
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else
+        {
+            float b = glm::dot(d1, d2);
+            float denom = a * e - b * b;
+            s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else if (t > 1.0f)
+            {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+}
+
+// Ponto da caixa (AABB ou OBB) mais próximo de "p"
+inline glm::vec3 Collision_ClosestPointOnBox(const CollisionShape& box, glm::vec3 p)
+{
+    glm::vec3 d = p - box.center;
+    glm::vec3 closest = box.center;
+    for (int i = 0; i < 3; ++i)
+        closest += glm::clamp(glm::dot(d, box.axes[i]), -box.half_size[i], box.half_size[i]) * box.axes[i];
+    return closest;
+}
+
+// Direção para fora da caixa a partir de um ponto dentro dela: a face mais
+// próxima do ponto
+inline glm::vec3 Collision_BoxExitNormal(const CollisionShape& box, glm::vec3 p)
+{
+    glm::vec3 d = p - box.center;
+    int best_axis = 0;
+    float best_depth = INFINITY;
+    float best_sign = 1.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        float x = glm::dot(d, box.axes[i]);
+        float depth = box.half_size[i] - std::fabs(x);
+        if (depth < best_depth)
+        {
+            best_depth = depth;
+            best_axis = i;
+            best_sign = x < 0.0f ? -1.0f : 1.0f;
+        }
+    }
+    return box.axes[best_axis] * best_sign;
+}
+
+// Normal para fora de "p" a partir do ponto mais próximo "closest" em outra forma
+inline glm::vec3 Collision_SeparationNormal(glm::vec3 p, glm::vec3 closest, glm::vec3 fallback)
+{
+    glm::vec3 d = p - closest;
+    float length = glm::length(d);
+    return length > 0.0f ? d / length : fallback;
+}
+
+//------------------------------------------------------------------------------
+// Testes de sobreposição. Todos têm a mesma assinatura: "direction" é a
+// direção em que "a" está se movendo (pode ser nula) e "normal", se não for
+// NULL, recebe a direção unitária para empurrar "a" para fora de "b".
+
+typedef bool (*CollisionTest)(const CollisionShape& a, const CollisionShape& b, glm::vec3 direction, glm::vec3* normal);
+
+inline bool Collision_None(const CollisionShape&, const CollisionShape&, glm::vec3, glm::vec3*)
+{
+    return false;
+}
+
+inline bool Collision_AABBAABB(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 d = a.center - b.center;
+    glm::vec3 overlap = a.half_size + b.half_size - glm::abs(d);
+    if (overlap.x < 0.0f || overlap.y < 0.0f || overlap.z < 0.0f)
+        return false;
+    if (normal != NULL)
+    {
+        int axis = overlap.x < overlap.y ? (overlap.x < overlap.z ? 0 : 2) : (overlap.y < overlap.z ? 1 : 2);
+        *normal = glm::vec3(0.0f);
+        (*normal)[axis] = d[axis] < 0.0f ? -1.0f : 1.0f;
+    }
+    return true;
+}
+
+// Teorema dos eixos separadores: 3 eixos de cada caixa e os 9 produtos
+// vetoriais entre eles. A normal é o eixo de menor sobreposição.
+inline bool Collision_BoxBox(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 d = a.center - b.center;
+    float best_overlap = INFINITY;
+    glm::vec3 best_axis = glm::vec3(0.0f);
+
+    glm::vec3 axes[15];
+    int num_axes = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        axes[num_axes++] = a.axes[i];
+        axes[num_axes++] = b.axes[i];
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            glm::vec3 axis = glm::cross(a.axes[i], b.axes[j]);
+            float length = glm::length(axis);
+            if (length > 1e-6f) // Arestas paralelas já são cobertas pelas faces
+                axes[num_axes++] = axis / length;
+        }
+    }
+
+    for (int k = 0; k < num_axes; ++k)
+    {
+        glm::vec3 axis = axes[k];
+        float ra = 0.0f, rb = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            ra += a.half_size[i] * std::fabs(glm::dot(a.axes[i], axis));
+            rb += b.half_size[i] * std::fabs(glm::dot(b.axes[i], axis));
+        }
+        float distance = glm::dot(d, axis);
+        float overlap = ra + rb - std::fabs(distance);
+        if (overlap < 0.0f)
+            return false;
+        if (overlap < best_overlap)
+        {
+            best_overlap = overlap;
+            best_axis = distance < 0.0f ? -axis : axis;
+        }
+    }
+
+    if (normal != NULL)
+        *normal = best_axis;
+    return true;
+}
+
+inline bool Collision_SphereBox(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 closest = Collision_ClosestPointOnBox(b, a.center);
+    glm::vec3 d = a.center - closest;
+    if (glm::dot(d, d) > a.radius * a.radius)
+        return false;
+    if (normal != NULL)
+        *normal = Collision_SeparationNormal(a.center, closest, Collision_BoxExitNormal(b, a.center));
+    return true;
+}
+
+inline bool Collision_SphereSphere(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 d = a.center - b.center;
+    float r = a.radius + b.radius;
+    if (glm::dot(d, d) > r * r)
+        return false;
+    if (normal != NULL)
+        *normal = Collision_SeparationNormal(a.center, b.center, glm::vec3(0.0f, 1.0f, 0.0f));
+    return true;
+}
+
+inline bool Collision_CapsuleSphere(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 p = Collision_ClosestPointOnSegment(b.center, a.center - a.segment, a.center + a.segment);
+    glm::vec3 d = p - b.center;
+    float r = a.radius + b.radius;
+    if (glm::dot(d, d) > r * r)
+        return false;
+    if (normal != NULL)
+        *normal = Collision_SeparationNormal(p, b.center, glm::vec3(0.0f, 1.0f, 0.0f));
+    return true;
+}
+
+inline bool Collision_CapsuleCapsule(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 ca, cb;
+    Collision_ClosestPointsSegments(a.center - a.segment, a.center + a.segment,
+                                    b.center - b.segment, b.center + b.segment, ca, cb);
+    glm::vec3 d = ca - cb;
+    float r = a.radius + b.radius;
+    if (glm::dot(d, d) > r * r)
+        return false;
+    if (normal != NULL)
+        *normal = Collision_SeparationNormal(ca, cb, glm::vec3(0.0f, 1.0f, 0.0f));
+    return true;
+}
+
+// A distância entre a caixa e um ponto do segmento é uma função convexa da
+// posição no segmento, então o ponto mais próximo é achado por busca ternária
+inline bool Collision_CapsuleBox(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    glm::vec3 p0 = a.center - a.segment;
+    glm::vec3 p1 = a.center + a.segment;
+    float lo = 0.0f, hi = 1.0f;
+    for (int i = 0; i < 24; ++i)
+    {
+        float m1 = lo + (hi - lo) / 3.0f;
+        float m2 = hi - (hi - lo) / 3.0f;
+        glm::vec3 q1 = p0 + (p1 - p0) * m1;
+        glm::vec3 q2 = p0 + (p1 - p0) * m2;
+        if (glm::length(Collision_ClosestPointOnBox(b, q1) - q1) < glm::length(Collision_ClosestPointOnBox(b, q2) - q2))
+            hi = m2;
+        else
+            lo = m1;
+    }
+    glm::vec3 p = p0 + (p1 - p0) * ((lo + hi) * 0.5f);
+    glm::vec3 closest = Collision_ClosestPointOnBox(b, p);
+    glm::vec3 d = p - closest;
+    if (glm::dot(d, d) > a.radius * a.radius)
+        return false;
+    if (normal != NULL)
+        *normal = Collision_SeparationNormal(p, closest, Collision_BoxExitNormal(b, p));
+    return true;
+}
+
+// Normal do triângulo escolhida para um contato: virada para o lado de "a" e,
+// entre os triângulos tocados, a mais oposta ao movimento
+inline void Collision_MeshContact(glm::vec3 n, glm::vec3 direction, float& best, glm::vec3* normal)
+{
+    float facing = glm::dot(n, direction);
+    if (normal != NULL && facing < best)
+    {
+        best = facing;
+        *normal = n;
+    }
+}
+
+inline glm::vec3 Collision_TriangleNormal(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 side)
+{
+    glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+    float length = glm::length(n);
+    if (length == 0.0f)
+        return glm::vec3(0.0f);
+    n /= length;
+    return glm::dot(n, side - v0) < 0.0f ? -n : n;
+}
+
+inline bool Collision_BoxMesh(const CollisionShape& a, const CollisionShape& b, glm::vec3 direction, glm::vec3* normal)
+{
+    if (b.mesh == NULL || b.mesh->empty())
+        return false;
+    glm::vec3 lo, hi, model_min, model_max;
+    CollisionShape_Bounds(a, lo, hi);
+    MeshBVH_ModelBox(b.inverse_model, (lo + hi) * 0.5f, (hi - lo) * 0.5f, model_min, model_max);
+
+    bool hit = false;
+    float best = INFINITY;
+    MeshBVH_ForEachTriangle(*b.mesh, b.model, model_min, model_max,
+        [&](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) -> bool {
+            // Triângulo nas coordenadas da caixa
+            glm::vec3 l0, l1, l2;
+            for (int i = 0; i < 3; ++i)
+            {
+                l0[i] = glm::dot(v0 - a.center, a.axes[i]);
+                l1[i] = glm::dot(v1 - a.center, a.axes[i]);
+                l2[i] = glm::dot(v2 - a.center, a.axes[i]);
+            }
+            if (!MeshBVH_TriangleBox(l0, l1, l2, a.half_size))
+                return false;
+            hit = true;
+            Collision_MeshContact(Collision_TriangleNormal(v0, v1, v2, a.center), direction, best, normal);
+            return normal == NULL;
+        });
+    return hit;
+}
+
+inline bool Collision_SphereMesh(const CollisionShape& a, const CollisionShape& b, glm::vec3, glm::vec3* normal)
+{
+    if (b.mesh == NULL || b.mesh->empty())
+        return false;
+    return MeshBVH_OverlapsSphere(*b.mesh, b.model, b.inverse_model, a.center, a.radius, normal);
+}
+
+// Ponto do triângulo mais próximo do segmento [p0, p1], e o ponto
+// correspondente no segmento
+inline void Collision_ClosestPointsSegmentTriangle(glm::vec3 p0, glm::vec3 p1, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2,
+                                                   glm::vec3& on_segment, glm::vec3& on_triangle)
+{
+    // O segmento atravessa o triângulo?
+    glm::vec3 d = p1 - p0, e1 = v1 - v0, e2 = v2 - v0;
+    glm::vec3 p = glm::cross(d, e2);
+    float det = glm::dot(e1, p);
+    if (std::fabs(det) > 1e-12f)
+    {
+        glm::vec3 s = p0 - v0;
+        float u = glm::dot(s, p) / det;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(d, q) / det;
+        float t = glm::dot(e2, q) / det;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t <= 1.0f)
+        {
+            on_segment = on_triangle = p0 + d * t;
+            return;
+        }
+    }
+
+    // Senão, o par mais próximo envolve uma ponta do segmento ou uma aresta
+    float best = INFINITY;
+    glm::vec3 ends[2] = { p0, p1 };
+    for (int i = 0; i < 2; ++i)
+    {
+        glm::vec3 c = MeshBVH_ClosestPoint(ends[i], v0, v1, v2);
+        float distance2 = glm::dot(c - ends[i], c - ends[i]);
+        if (distance2 < best)
+        {
+            best = distance2;
+            on_segment = ends[i];
+            on_triangle = c;
+        }
+    }
+    glm::vec3 edges[3][2] = { { v0, v1 }, { v1, v2 }, { v2, v0 } };
+    for (int i = 0; i < 3; ++i)
+    {
+        glm::vec3 cs, ct;
+        Collision_ClosestPointsSegments(p0, p1, edges[i][0], edges[i][1], cs, ct);
+        float distance2 = glm::dot(cs - ct, cs - ct);
+        if (distance2 < best)
+        {
+            best = distance2;
+            on_segment = cs;
+            on_triangle = ct;
+        }
+    }
+}
+
+inline bool Collision_CapsuleMesh(const CollisionShape& a, const CollisionShape& b, glm::vec3 direction, glm::vec3* normal)
+{
+    if (b.mesh == NULL || b.mesh->empty())
+        return false;
+    glm::vec3 lo, hi, model_min, model_max;
+    CollisionShape_Bounds(a, lo, hi);
+    MeshBVH_ModelBox(b.inverse_model, (lo + hi) * 0.5f, (hi - lo) * 0.5f, model_min, model_max);
+
+    glm::vec3 p0 = a.center - a.segment;
+    glm::vec3 p1 = a.center + a.segment;
+    float r2 = a.radius * a.radius;
+    bool hit = false;
+    float best = INFINITY;
+    MeshBVH_ForEachTriangle(*b.mesh, b.model, model_min, model_max,
+        [&](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) -> bool {
+            glm::vec3 on_segment, on_triangle;
+            Collision_ClosestPointsSegmentTriangle(p0, p1, v0, v1, v2, on_segment, on_triangle);
+            glm::vec3 d = on_segment - on_triangle;
+            if (glm::dot(d, d) > r2)
+                return false;
+            hit = true;
+            Collision_MeshContact(Collision_SeparationNormal(on_segment, on_triangle, Collision_TriangleNormal(v0, v1, v2, a.center)),
+                                  direction, best, normal);
+            return normal == NULL;
+        });
+    return hit;
+}
+
+// Mesmo teste com as formas trocadas; a normal passa a empurrar "a"
+template <CollisionTest test>
+bool Collision_Swapped(const CollisionShape& a, const CollisionShape& b, glm::vec3 direction, glm::vec3* normal)
+{
+    if (!test(b, a, -direction, normal))
+        return false;
+    if (normal != NULL)
+        *normal = -*normal;
+    return true;
+}
+
+// g_CollisionTests[tipo de a][tipo de b]. Colisão entre duas malhas não é
+// suportada.
+static const CollisionTest g_CollisionTests[COLLISION_SHAPE_COUNT][COLLISION_SHAPE_COUNT] =
+{
+    // a = AABB
+    { Collision_AABBAABB, Collision_BoxBox,
+      Collision_Swapped<Collision_SphereBox>, Collision_Swapped<Collision_CapsuleBox>, Collision_BoxMesh },
+    // a = OBB
+    { Collision_BoxBox, Collision_BoxBox,
+      Collision_Swapped<Collision_SphereBox>, Collision_Swapped<Collision_CapsuleBox>, Collision_BoxMesh },
+    // a = esfera
+    { Collision_SphereBox, Collision_SphereBox,
+      Collision_SphereSphere, Collision_Swapped<Collision_CapsuleSphere>, Collision_SphereMesh },
+    // a = cápsula
+    { Collision_CapsuleBox, Collision_CapsuleBox,
+      Collision_CapsuleSphere, Collision_CapsuleCapsule, Collision_CapsuleMesh },
+    // a = malha
+    { Collision_Swapped<Collision_BoxMesh>, Collision_Swapped<Collision_BoxMesh>,
+      Collision_Swapped<Collision_SphereMesh>, Collision_Swapped<Collision_CapsuleMesh>, Collision_None },
+};
+
+inline bool Collision_Overlap(const CollisionShape& a, const CollisionShape& b, glm::vec3 direction, glm::vec3* normal)
+{
+    return g_CollisionTests[a.type][b.type](a, b, direction, normal);
+}
+
+inline bool Collision_Overlap(const CollisionShape& a, const CollisionShape& b)
+{
+    return g_CollisionTests[a.type][b.type](a, b, glm::vec3(0.0f), NULL);
+}
+
+#endif // _COLLISION_SHAPES_H
@@ -1,5 +1,15 @@
 #include <cmath>
 
+#include "mesh_bvh.h"
+
+bool isAABBIntersection(glm::vec3 bbox_min1, glm::vec3 bbox_max1, glm::vec3 bbox_min2, glm::vec3 bbox_max2) {
+    bool xAxis = bbox_min1.x <= bbox_max2.x && bbox_max1.x >= bbox_min2.x;
+    bool yAxis = bbox_min1.y <= bbox_max2.y && bbox_max1.y >= bbox_min2.y;
+    bool zAxis = bbox_min1.z <= bbox_max2.z && bbox_max1.z >= bbox_min2.z;
+
+    return yAxis && xAxis && zAxis;
+}
+
 bool isBoundingBoxIntersection(SceneObject& ob1, SceneObject& ob2) {
 
     if(!ob2.has_collision()){
@@ -114,3 +124,589 @@ bool isCubeIntersectingSphere(glm::vec3 bbox_min, glm::vec3 bbox_max, glm::vec3
 
 
 
+
+// Instante t em [0, 1] em que a AABB [bbox_min, bbox_max], deslocada por
+// "motion", encosta na AABB parada [obstacle_min, obstacle_max], e a normal
+// da face tocada (apontando para fora do obstáculo). É o teste de um raio
+// saindo do centro da caixa móvel contra o obstáculo aumentado pelas
+// dimensões da caixa móvel ("slab test"). Caixas que já começam se
+// intersectando não contam, para que o jogador consiga sair delas.
+bool sweptAABB(glm::vec3 bbox_min, glm::vec3 bbox_max, glm::vec3 motion,
+               glm::vec3 obstacle_min, glm::vec3 obstacle_max,
+               float& t, glm::vec3& normal)
+{
+    glm::vec3 center = (bbox_min + bbox_max) / 2.0f;
+    glm::vec3 half_size = (bbox_max - bbox_min) / 2.0f;
+    glm::vec3 expanded_min = obstacle_min - half_size;
+    glm::vec3 expanded_max = obstacle_max + half_size;
+
+    float t_enter = -INFINITY;
+    float t_exit = INFINITY;
+    int axis = -1;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (motion[a] == 0.0f)
+        {
+            if (center[a] < expanded_min[a] || center[a] > expanded_max[a])
+                return false;
+            continue;
+        }
+
+        float t0 = (expanded_min[a] - center[a]) / motion[a];
+        float t1 = (expanded_max[a] - center[a]) / motion[a];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > t_enter)
+        {
+            t_enter = t0;
+            axis = a;
+        }
+        t_exit = std::min(t_exit, t1);
+    }
+
+    if (axis < 0 || t_enter > t_exit || t_enter < 0.0f || t_enter > 1.0f)
+        return false;
+
+    t = t_enter;
+    normal = glm::vec3(0.0f);
+    normal[axis] = motion[axis] > 0.0f ? -1.0f : 1.0f;
+    return true;
+}
+
+// Distância entre a AABB [bbox_min, bbox_max] e um ponto
+float distanceToBBox(glm::vec3 bbox_min, glm::vec3 bbox_max, glm::vec3 point)
+{
+    return glm::length(clamp_to_bbox(bbox_min, bbox_max, point) - point);
+}
+
+// Como sweptAABB(), mas contra uma esfera parada. A distância entre a caixa
+// e o centro da esfera é uma função convexa de t: primeiro encontramos o
+// instante de menor distância e depois, por bisseção, o primeiro instante em
+// que a distância chega ao raio.
+bool sweptAABBSphere(glm::vec3 bbox_min, glm::vec3 bbox_max, glm::vec3 motion,
+                     glm::vec3 sphere_center, float radius,
+                     float& t, glm::vec3& normal)
+{
+    // Teste conservador com o cubo que envolve a esfera
+    float t_cube;
+    glm::vec3 normal_cube;
+    glm::vec3 r = glm::vec3(radius);
+    if (distanceToBBox(bbox_min, bbox_max, sphere_center) <= radius ||
+        !sweptAABB(bbox_min, bbox_max, motion, sphere_center - r, sphere_center + r, t_cube, normal_cube))
+        return false;
+
+    float lo = t_cube;
+    float hi = 1.0f;
+    for (int i = 0; i < 24; ++i)
+    {
+        float m1 = lo + (hi - lo) / 3.0f;
+        float m2 = hi - (hi - lo) / 3.0f;
+        if (distanceToBBox(bbox_min + motion * m1, bbox_max + motion * m1, sphere_center) <
+            distanceToBBox(bbox_min + motion * m2, bbox_max + motion * m2, sphere_center))
+            hi = m2;
+        else
+            lo = m1;
+    }
+    float t_closest = (lo + hi) / 2.0f;
+    if (distanceToBBox(bbox_min + motion * t_closest, bbox_max + motion * t_closest, sphere_center) > radius)
+        return false;
+
+    lo = t_cube;
+    hi = t_closest;
+    for (int i = 0; i < 24; ++i)
+    {
+        float mid = (lo + hi) / 2.0f;
+        if (distanceToBBox(bbox_min + motion * mid, bbox_max + motion * mid, sphere_center) > radius)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    t = lo;
+    glm::vec3 contact = clamp_to_bbox(bbox_min + motion * t, bbox_max + motion * t, sphere_center);
+    normal = glm::normalize(contact - sphere_center);
+    return true;
+}
+
+// Como isRayBoudingBox(), mas, se o objeto tem uma BVH (veja "mesh_bvh.h"),
+// a interseção é com os triângulos do modelo: apontar para o espaço vazio
+// dentro da bounding box não conta. O raio é levado para as coordenadas do
+// modelo pela inversa de "model", o que não muda o valor de t.
+bool isRayObject(glm::vec4 ray, glm::vec4 ray_origin, SceneObject& obj, float& intersection_distance)
+{
+    if (!isRayBoudingBox(ray, ray_origin, obj, intersection_distance))
+        return false;
+
+    const MeshBVH* bvh = obj.get_mesh_bvh();
+    if (bvh == NULL || bvh->empty())
+        return true;
+
+    glm::mat4 inverse_model = glm::inverse(obj.get_model());
+    glm::vec3 origin = glm::vec3(inverse_model * glm::vec4(glm::vec3(ray_origin), 1.0f));
+    glm::vec3 direction = glm::vec3(inverse_model * glm::vec4(glm::vec3(ray), 0.0f));
+    return MeshBVH_RayCast(*bvh, origin, direction, INFINITY, intersection_distance);
+}
+
+// Forma de colisão do objeto em coordenadas globais (veja
+// "collision_shapes.h"). Objetos com raio são sempre esferas; uma malha sem
+// BVH vira OBB; e uma OBB cuja matriz "model" distorce os ângulos (escala não
+// uniforme depois de uma rotação) vira a AABB que a envolve.
+CollisionShape Collision_ObjectShape(SceneObject& obj)
+{
+    if (obj.is_sphere())
+        return CollisionShape_Sphere(glm::vec3(obj.get_center()), obj.get_radius());
+
+    CollisionShapeType type = obj.get_collision_shape();
+    if (type == COLLISION_MESH)
+    {
+        if (obj.get_mesh_bvh() != NULL && !obj.get_mesh_bvh()->empty())
+            return CollisionShape_Mesh(obj.get_mesh_bvh(), obj.get_model());
+        type = COLLISION_OBB;
+    }
+
+    glm::mat4 model = obj.get_model();
+    glm::vec3 local_min = glm::vec3(obj.get_object_bbox_min());
+    glm::vec3 local_max = glm::vec3(obj.get_object_bbox_max());
+    glm::vec3 center = glm::vec3(model * glm::vec4((local_min + local_max) * 0.5f, 1.0f));
+    glm::vec3 half = (local_max - local_min) * 0.5f;
+
+    glm::vec3 axes[3];
+    glm::vec3 scale;
+    for (int i = 0; i < 3; ++i)
+    {
+        axes[i] = glm::vec3(model[i]);
+        scale[i] = glm::length(axes[i]);
+        axes[i] = scale[i] > 0.0f ? axes[i] / scale[i] : glm::vec3(0.0f);
+    }
+    bool orthogonal = std::fabs(glm::dot(axes[0], axes[1])) < 1e-4f &&
+                      std::fabs(glm::dot(axes[1], axes[2])) < 1e-4f &&
+                      std::fabs(glm::dot(axes[2], axes[0])) < 1e-4f;
+    if (type == COLLISION_OBB && orthogonal)
+        return CollisionShape_OBB(center, half * scale, axes);
+
+    // AABB que envolve a caixa do modelo transformada
+    glm::vec3 extent;
+    for (int a = 0; a < 3; ++a)
+        extent[a] = std::fabs(model[0][a]) * half.x + std::fabs(model[1][a]) * half.y + std::fabs(model[2][a]) * half.z;
+    if (type != COLLISION_CAPSULE)
+        return CollisionShape_AABB(center - extent, center + extent);
+
+    // Cápsula vertical inscrita nessa AABB
+    float radius = std::min(extent.x, extent.z);
+    float height = std::max(extent.y - radius, 0.0f);
+    return CollisionShape_Capsule(center - glm::vec3(0.0f, height, 0.0f), center + glm::vec3(0.0f, height, 0.0f), radius);
+}
+
+// Varreduras: instante t em [0, 1] do primeiro contato de "moving",
+// deslocada por "motion", com "obstacle", e a normal que empurra "moving"
+// para fora. Como em sweptAABB(), as varreduras da tabela não tratam formas
+// que já começam se tocando; isso fica com Collision_Sweep().
+typedef bool (*CollisionSweep)(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                               float& t, glm::vec3& normal);
+
+// Varredura exata de caixas alinhadas aos eixos
+bool Collision_SweepAABB(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                         float& t, glm::vec3& normal)
+{
+    return sweptAABB(moving.center - moving.half_size, moving.center + moving.half_size, motion,
+                     obstacle.center - obstacle.half_size, obstacle.center + obstacle.half_size, t, normal);
+}
+
+bool Collision_SweepAABBSphere(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                               float& t, glm::vec3& normal)
+{
+    return sweptAABBSphere(moving.center - moving.half_size, moving.center + moving.half_size, motion,
+                           obstacle.center, obstacle.radius, t, normal);
+}
+
+// Varredura genérica com os testes de g_CollisionTests: amostras ao longo do
+// movimento, espaçadas por no máximo metade da espessura da forma (para não
+// atravessar obstáculos finos), e bisseção entre a última amostra livre e a
+// primeira com contato. A normal é a da face tocada mais oposta ao movimento.
+bool Collision_SweepSampled(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                            float& t, glm::vec3& normal)
+{
+    float length = glm::length(motion);
+    if (length == 0.0f)
+        return false;
+
+    float thickness = CollisionShape_Thickness(moving);
+    int samples = thickness > 0.0f ? (int)std::ceil(length / (0.5f * thickness)) : 1;
+    samples = std::max(1, std::min(samples, 64));
+
+    CollisionShape moved = moving;
+    glm::vec3 contact_normal = glm::vec3(0.0f);
+    float lo = 0.0f;
+    float hi = -1.0f;
+    for (int k = 1; k <= samples; ++k)
+    {
+        float s = (float)k / samples;
+        moved = moving;
+        CollisionShape_Translate(moved, motion * s);
+        if (Collision_Overlap(moved, obstacle, motion, &contact_normal))
+        {
+            hi = s;
+            break;
+        }
+        lo = s;
+    }
+    if (hi < 0.0f)
+        return false;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float mid = (lo + hi) * 0.5f;
+        glm::vec3 mid_normal = glm::vec3(0.0f);
+        moved = moving;
+        CollisionShape_Translate(moved, motion * mid);
+        if (Collision_Overlap(moved, obstacle, motion, &mid_normal))
+        {
+            hi = mid;
+            contact_normal = mid_normal;
+        }
+        else
+            lo = mid;
+    }
+
+    t = lo;
+    normal = glm::length(contact_normal) > 0.0f ? contact_normal : -motion / length;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Varreduras exatas da cápsula (o jogador) e da esfera, que é uma cápsula de
+// segmento nulo.
+//
+// O primeiro contato da cápsula [p0, p1] de raio r com um poliedro convexo é
+// sempre entre um par de características: uma ponta da cápsula com uma face,
+// aresta ou vértice do poliedro, ou o interior do segmento com uma aresta ou
+// um vértice (o interior só toca uma face ao mesmo tempo que uma ponta). Cada
+// par é um raio contra uma forma simples, resolvido analiticamente:
+//
+//   ponta contra face    raio da ponta contra a face engrossada por r
+//   ponta contra aresta  raio da ponta contra a cápsula da aresta
+//   vértice contra cápsula  raio do vértice, no sentido -motion, contra a cápsula
+//   segmento contra aresta  raio contra o paralelogramo (aresta - segmento) engrossado por r
+//
+// O menor instante entre todos os pares é o primeiro contato. Uma malha é a
+// união dos seus triângulos, então o mesmo vale triângulo a triângulo.
+
+// Raio o + d s, s em [0, s_max], contra a esfera (c, r), entrando por fora.
+// "normal" é a normal da esfera no ponto atingido.
+inline bool Collision_RaySphere(glm::vec3 o, glm::vec3 d, glm::vec3 c, float r, float s_max, float& s, glm::vec3& normal)
+{
+    glm::vec3 m = o - c;
+    float a = glm::dot(d, d);
+    float b = glm::dot(m, d);
+    float k = glm::dot(m, m) - r * r;
+    if (a == 0.0f || k < 0.0f || b >= 0.0f)
+        return false;
+    float discriminant = b * b - a * k;
+    if (discriminant < 0.0f)
+        return false;
+    float hit = (-b - std::sqrt(discriminant)) / a;
+    if (hit > s_max)
+        return false;
+    s = std::max(hit, 0.0f);
+    normal = glm::normalize(m + d * s);
+    return true;
+}
+
+// Raio contra a cápsula [p, q] de raio r: a lateral do cilindro e as duas
+// semiesferas das pontas
+inline bool Collision_RayCapsule(glm::vec3 o, glm::vec3 d, glm::vec3 p, glm::vec3 q, float r, float s_max, float& s, glm::vec3& normal)
+{
+    bool hit = false;
+    glm::vec3 w = q - p;
+    float ww = glm::dot(w, w);
+    if (ww > 1e-12f)
+    {
+        // Componentes perpendiculares ao eixo
+        glm::vec3 m = o - p;
+        glm::vec3 dp = d - w * (glm::dot(d, w) / ww);
+        glm::vec3 mp = m - w * (glm::dot(m, w) / ww);
+        float a = glm::dot(dp, dp);
+        float b = glm::dot(mp, dp);
+        float k = glm::dot(mp, mp) - r * r;
+        float discriminant = b * b - a * k;
+        if (a > 1e-12f && k >= 0.0f && b < 0.0f && discriminant >= 0.0f)
+        {
+            float cylinder = (-b - std::sqrt(discriminant)) / a;
+            float h = glm::dot(m + d * cylinder, w) / ww;
+            if (cylinder <= s_max && h >= 0.0f && h <= 1.0f)
+            {
+                s_max = s = cylinder;
+                normal = glm::normalize(mp + dp * cylinder);
+                hit = true;
+            }
+        }
+    }
+    float cap;
+    glm::vec3 cap_normal;
+    if (Collision_RaySphere(o, d, p, r, s_max, cap, cap_normal))
+    {
+        s_max = s = cap;
+        normal = cap_normal;
+        hit = true;
+    }
+    if (ww > 1e-12f && Collision_RaySphere(o, d, q, r, s_max, cap, cap_normal))
+    {
+        s = cap;
+        normal = cap_normal;
+        hit = true;
+    }
+    return hit;
+}
+
+// Raio contra o paralelogramo (ou triângulo) base + u e1 + v e2 engrossado
+// por r, atingido em uma das duas faces planas. As bordas da placa ficam
+// dentro das cápsulas das arestas, testadas à parte.
+inline bool Collision_RayThickPolygon(glm::vec3 o, glm::vec3 d, glm::vec3 base, glm::vec3 e1, glm::vec3 e2, bool triangle,
+                                      float r, float s_max, float& s, glm::vec3& normal)
+{
+    glm::vec3 n = glm::cross(e1, e2);
+    float area = glm::length(n);
+    if (area < 1e-12f)
+        return false;
+    n /= area;
+    float side = glm::dot(o - base, n);
+    if (side < 0.0f)
+    {
+        n = -n;
+        side = -side;
+    }
+    float approach = -glm::dot(d, n);
+    if (side < r || approach <= 0.0f)
+        return false;
+    float hit = (side - r) / approach;
+    if (hit > s_max)
+        return false;
+
+    // Coordenadas do ponto atingido, projetado no plano do polígono
+    glm::vec3 x = o + d * hit - base;
+    float u = glm::dot(glm::cross(x, e2), n) / glm::dot(glm::cross(e1, e2), n);
+    float v = glm::dot(glm::cross(e1, x), n) / glm::dot(glm::cross(e1, e2), n);
+    if (u < 0.0f || v < 0.0f || (triangle ? u + v > 1.0f : (u > 1.0f || v > 1.0f)))
+        return false;
+    s = hit;
+    normal = n;
+    return true;
+}
+
+// Primeiro contato encontrado até agora por uma varredura da cápsula
+struct CapsuleSweep
+{
+    glm::vec3 p0, p1;   // Pontas da cápsula no início do movimento
+    glm::vec3 motion;
+    float     radius;
+    float     t;        // Instante do contato mais cedo (1 se nenhum)
+    glm::vec3 normal;   // Normal que empurra a cápsula para fora
+    bool      hit;
+};
+
+inline CapsuleSweep CapsuleSweep_Begin(const CollisionShape& moving, glm::vec3 motion, float extra_radius)
+{
+    CapsuleSweep sweep;
+    sweep.p0 = moving.center - moving.segment;
+    sweep.p1 = moving.center + moving.segment;
+    sweep.motion = motion;
+    sweep.radius = moving.radius + extra_radius;
+    sweep.t = 1.0f;
+    sweep.normal = glm::vec3(0.0f);
+    sweep.hit = false;
+    return sweep;
+}
+
+inline void CapsuleSweep_Vertex(CapsuleSweep& sweep, glm::vec3 v)
+{
+    float t;
+    glm::vec3 n;
+    if (Collision_RayCapsule(v, -sweep.motion, sweep.p0, sweep.p1, sweep.radius, sweep.t, t, n))
+    {
+        sweep.t = t;
+        sweep.normal = -n;
+        sweep.hit = true;
+    }
+}
+
+inline void CapsuleSweep_Edge(CapsuleSweep& sweep, glm::vec3 a, glm::vec3 b)
+{
+    float t;
+    glm::vec3 n;
+    glm::vec3 ends[2] = { sweep.p0, sweep.p1 };
+    for (int i = 0; i < (sweep.p0 == sweep.p1 ? 1 : 2); ++i)
+    {
+        if (Collision_RayCapsule(ends[i], sweep.motion, a, b, sweep.radius, sweep.t, t, n))
+        {
+            sweep.t = t;
+            sweep.normal = n;
+            sweep.hit = true;
+        }
+    }
+    if (Collision_RayThickPolygon(glm::vec3(0.0f), sweep.motion, a - sweep.p0, b - a, sweep.p0 - sweep.p1, false,
+                                  sweep.radius, sweep.t, t, n))
+    {
+        sweep.t = t;
+        sweep.normal = n;
+        sweep.hit = true;
+    }
+}
+
+inline void CapsuleSweep_Face(CapsuleSweep& sweep, glm::vec3 base, glm::vec3 e1, glm::vec3 e2, bool triangle)
+{
+    float t;
+    glm::vec3 n;
+    glm::vec3 ends[2] = { sweep.p0, sweep.p1 };
+    for (int i = 0; i < (sweep.p0 == sweep.p1 ? 1 : 2); ++i)
+    {
+        if (Collision_RayThickPolygon(ends[i], sweep.motion, base, e1, e2, triangle, sweep.radius, sweep.t, t, n))
+        {
+            sweep.t = t;
+            sweep.normal = n;
+            sweep.hit = true;
+        }
+    }
+}
+
+inline bool CapsuleSweep_End(const CapsuleSweep& sweep, float& t, glm::vec3& normal)
+{
+    if (!sweep.hit)
+        return false;
+    t = sweep.t;
+    normal = sweep.normal;
+    return true;
+}
+
+bool Collision_SweepCapsuleSphere(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                                  float& t, glm::vec3& normal)
+{
+    CapsuleSweep sweep = CapsuleSweep_Begin(moving, motion, obstacle.radius);
+    CapsuleSweep_Vertex(sweep, obstacle.center);
+    return CapsuleSweep_End(sweep, t, normal);
+}
+
+bool Collision_SweepCapsuleCapsule(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                                   float& t, glm::vec3& normal)
+{
+    CapsuleSweep sweep = CapsuleSweep_Begin(moving, motion, obstacle.radius);
+    CapsuleSweep_Vertex(sweep, obstacle.center - obstacle.segment);
+    CapsuleSweep_Vertex(sweep, obstacle.center + obstacle.segment);
+    CapsuleSweep_Edge(sweep, obstacle.center - obstacle.segment, obstacle.center + obstacle.segment);
+    return CapsuleSweep_End(sweep, t, normal);
+}
+
+// Caixa (AABB ou OBB): 8 vértices, 12 arestas e 6 faces
+bool Collision_SweepCapsuleBox(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                               float& t, glm::vec3& normal)
+{
+    // Descarta a caixa se nem a região varrida pela cápsula chega nela
+    glm::vec3 moving_min, moving_max, box_min, box_max;
+    CollisionShape_Bounds(moving, moving_min, moving_max);
+    CollisionShape_Bounds(obstacle, box_min, box_max);
+    if (glm::any(glm::greaterThan(glm::min(moving_min, moving_min + motion), box_max)) ||
+        glm::any(glm::lessThan(glm::max(moving_max, moving_max + motion), box_min)))
+        return false;
+
+    glm::vec3 e[3];
+    for (int i = 0; i < 3; ++i)
+        e[i] = obstacle.axes[i] * (2.0f * obstacle.half_size[i]);
+    glm::vec3 corner = obstacle.center - (e[0] + e[1] + e[2]) * 0.5f;
+
+    CapsuleSweep sweep = CapsuleSweep_Begin(moving, motion, 0.0f);
+    for (int i = 0; i < 8; ++i)
+        CapsuleSweep_Vertex(sweep, corner + e[0] * (float)(i & 1) + e[1] * (float)((i >> 1) & 1) + e[2] * (float)((i >> 2) & 1));
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        glm::vec3 u = e[(axis + 1) % 3];
+        glm::vec3 v = e[(axis + 2) % 3];
+        for (int k = 0; k < 4; ++k)
+        {
+            glm::vec3 a = corner + u * (float)(k & 1) + v * (float)(k >> 1);
+            CapsuleSweep_Edge(sweep, a, a + e[axis]);
+        }
+        CapsuleSweep_Face(sweep, corner, u, v, false);
+        CapsuleSweep_Face(sweep, corner + e[axis], u, v, false);
+    }
+    return CapsuleSweep_End(sweep, t, normal);
+}
+
+// Malha: os triângulos cujas folhas da BVH tocam a região varrida
+bool Collision_SweepCapsuleMesh(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                                float& t, glm::vec3& normal)
+{
+    if (obstacle.mesh == NULL || obstacle.mesh->empty())
+        return false;
+    glm::vec3 lo, hi, model_min, model_max;
+    CollisionShape_Bounds(moving, lo, hi);
+    lo = glm::min(lo, lo + motion);
+    hi = glm::max(hi, hi + motion);
+    MeshBVH_ModelBox(obstacle.inverse_model, (lo + hi) * 0.5f, (hi - lo) * 0.5f, model_min, model_max);
+
+    CapsuleSweep sweep = CapsuleSweep_Begin(moving, motion, 0.0f);
+    MeshBVH_ForEachTriangle(*obstacle.mesh, obstacle.model, model_min, model_max,
+        [&](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) -> bool {
+            CapsuleSweep_Vertex(sweep, v0);
+            CapsuleSweep_Vertex(sweep, v1);
+            CapsuleSweep_Vertex(sweep, v2);
+            CapsuleSweep_Edge(sweep, v0, v1);
+            CapsuleSweep_Edge(sweep, v1, v2);
+            CapsuleSweep_Edge(sweep, v2, v0);
+            CapsuleSweep_Face(sweep, v0, v1 - v0, v2 - v0, true);
+            return false;
+        });
+    return CapsuleSweep_End(sweep, t, normal);
+}
+
+// Mesma varredura com as formas trocadas: o obstáculo se move com -motion e a
+// normal passa a empurrar "moving"
+template <CollisionSweep sweep>
+bool Collision_SweepSwapped(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                            float& t, glm::vec3& normal)
+{
+    if (!sweep(obstacle, -motion, moving, t, normal))
+        return false;
+    normal = -normal;
+    return true;
+}
+
+// g_CollisionSweeps[tipo da forma que se move][tipo do obstáculo]. Esferas
+// usam as varreduras da cápsula (segmento de comprimento zero), e os pares
+// com uma esfera ou cápsula parada as reaproveitam trocando as formas. Só os
+// pares entre caixas e malhas ficam com a amostragem.
+static const CollisionSweep g_CollisionSweeps[COLLISION_SHAPE_COUNT][COLLISION_SHAPE_COUNT] =
+{
+    // moving = AABB
+    { Collision_SweepAABB, Collision_SweepSampled,
+      Collision_SweepAABBSphere, Collision_SweepSwapped<Collision_SweepCapsuleBox>, Collision_SweepSampled },
+    // moving = OBB
+    { Collision_SweepSampled, Collision_SweepSampled,
+      Collision_SweepSwapped<Collision_SweepCapsuleBox>, Collision_SweepSwapped<Collision_SweepCapsuleBox>, Collision_SweepSampled },
+    // moving = esfera
+    { Collision_SweepCapsuleBox, Collision_SweepCapsuleBox,
+      Collision_SweepCapsuleSphere, Collision_SweepCapsuleCapsule, Collision_SweepCapsuleMesh },
+    // moving = cápsula
+    { Collision_SweepCapsuleBox, Collision_SweepCapsuleBox,
+      Collision_SweepCapsuleSphere, Collision_SweepCapsuleCapsule, Collision_SweepCapsuleMesh },
+    // moving = malha (sem espessura: as amostras seguem a caixa)
+    { Collision_SweepSwapped<Collision_SweepSampled>, Collision_SweepSwapped<Collision_SweepSampled>,
+      Collision_SweepSwapped<Collision_SweepCapsuleMesh>, Collision_SweepSwapped<Collision_SweepCapsuleMesh>, Collision_SweepSampled },
+};
+
+// Formas que já começam sobrepostas colidem em t = 0 com a normal de
+// separação do teste de sobreposição, a menos que o movimento já as esteja
+// afastando. Sem isso o jogador que entra um pouco em um objeto (por exemplo,
+// uma gaveta que se abriu contra ele) o atravessaria no passo seguinte.
+bool Collision_Sweep(const CollisionShape& moving, glm::vec3 motion, const CollisionShape& obstacle,
+                     float& t, glm::vec3& normal)
+{
+    glm::vec3 overlap_normal(0.0f);
+    if (Collision_Overlap(moving, obstacle, motion, &overlap_normal))
+    {
+        if (glm::dot(motion, overlap_normal) >= 0.0f)
+            return false;
+        t = 0.0f;
+        normal = overlap_normal;
+        return true;
+    }
+    return g_CollisionSweeps[moving.type][obstacle.type](moving, motion, obstacle, t, normal);
+}
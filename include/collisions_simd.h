@@ -0,0 +1,74 @@
+#ifndef _COLLISIONS_SIMD_H
+#define _COLLISIONS_SIMD_H
+
+// Versões em lote dos testes de "collisions.h".
+//
+// Cada função testa uma única caixa, esfera ou raio contra "count" AABBs
+// guardadas em estrutura de arrays (AABBArrays) e marca as AABBs atingidas
+// em um vetor de bits: a caixa i corresponde ao bit (i % 64) de hits[i / 64].
+// "hits" deve ter espaço para Collisions_HitWords(count) palavras.
+//
+// As funções avaliam 4, 8 ou 16 caixas por instrução com SSE, AVX2 ou
+// AVX-512, escolhidos em tempo de execução de acordo com a CPU (veja
+// Collisions_SimdLevel()). Em CPUs sem essas extensões, ou fora de x86, é
+// usada uma versão escalar com os mesmos resultados. Implementação em
+// "src/collisions_simd.cpp"; comparação de desempenho em
+// "bench/collisions_bench.cpp".
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+enum CollisionsSimdLevel
+{
+    COLLISIONS_SCALAR,
+    COLLISIONS_SSE,
+    COLLISIONS_AVX2,
+    COLLISIONS_AVX512
+};
+
+// Componentes das AABBs em arrays separados, um elemento por caixa
+struct AABBArrays
+{
+    const float* min_x;
+    const float* min_y;
+    const float* min_z;
+    const float* max_x;
+    const float* max_y;
+    const float* max_z;
+    size_t       count;
+};
+
+inline size_t Collisions_HitWords(size_t count)
+{
+    return (count + 63) / 64;
+}
+
+inline bool Collisions_Hit(const uint64_t* hits, size_t i)
+{
+    return (hits[i / 64] >> (i % 64)) & 1;
+}
+
+// Maior nível suportado pela CPU, ou o escolhido por Collisions_SetSimdLevel()
+CollisionsSimdLevel Collisions_SimdLevel();
+
+// Força um nível menor ou igual ao suportado (para comparar desempenho).
+// Retorna o nível efetivamente usado.
+CollisionsSimdLevel Collisions_SetSimdLevel(CollisionsSimdLevel level);
+
+const char* Collisions_SimdLevelName(CollisionsSimdLevel level);
+
+// Equivalente a isBoundingBoxIntersection() para cada caixa
+void Collisions_AABBBatch(const AABBArrays& boxes, glm::vec3 bbox_min, glm::vec3 bbox_max, uint64_t* hits);
+
+// Equivalente a isCubeIntersectingSphere() para cada caixa
+void Collisions_SphereBatch(const AABBArrays& boxes, glm::vec3 sphere_center, float radius, uint64_t* hits);
+
+// Raio "ray_origin + t * ray" contra cada caixa ("slab test", como em
+// isRayBoudingBox()). Uma caixa é atingida se o intervalo de t dentro dela
+// não é vazio e não está todo atrás da origem. Se "distances" não for NULL,
+// recebe o t de entrada de cada caixa atingida.
+void Collisions_RayBatch(const AABBArrays& boxes, glm::vec3 ray_origin, glm::vec3 ray, uint64_t* hits, float* distances);
+
+#endif // _COLLISIONS_SIMD_H
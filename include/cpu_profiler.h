@@ -0,0 +1,57 @@
+#ifndef _CPU_PROFILER_H
+#define _CPU_PROFILER_H
+
+// Medição do tempo de CPU por trechos ("zonas") do código.
+//
+// PROFILE_ZONE("nome") mede o tempo desde a linha onde aparece até o fim do
+// bloco; PROFILE_FUNCTION() faz o mesmo com o nome da função. Cada thread
+// guarda suas zonas em um anel próprio (thread_local), sem travas, com
+// instantes lidos de std::chrono::steady_clock. CpuProfiler_WriteTrace()
+// salva as zonas de todas as threads no formato JSON de "trace events", que
+// pode ser aberto em chrome://tracing ou https://ui.perfetto.dev.
+//
+// O profiler só é compilado com -DCPU_PROFILER (make PROFILE=1). Sem esse
+// define as macros não geram código e as funções abaixo não fazem nada.
+
+#ifdef CPU_PROFILER
+
+#include <cstdint>
+
+// Registra uma zona ao sair do escopo. "name" deve ser uma string com
+// duração estática (um literal ou __func__).
+class CpuProfilerZone
+{
+public:
+    explicit CpuProfilerZone(const char* name);
+    ~CpuProfilerZone();
+
+private:
+    const char* name;
+    uint64_t    start;
+};
+
+#define CPU_PROFILER_CONCAT_(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_(a, b)
+#define PROFILE_ZONE(name) CpuProfilerZone CPU_PROFILER_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+// Nome da thread atual no arquivo de trace
+void CpuProfiler_SetThreadName(const char* name);
+
+// Salva as zonas de todas as threads, inclusive as que continuam registrando
+// zonas durante a escrita (como a thread de simulação): são salvas as zonas
+// terminadas até o início da escrita, menos as que a thread sobrescreveu
+// enquanto eram copiadas. Retorna false se o arquivo não pôde ser criado.
+bool CpuProfiler_WriteTrace(const char* filename);
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+
+inline void CpuProfiler_SetThreadName(const char*) {}
+inline bool CpuProfiler_WriteTrace(const char*) { return false; }
+
+#endif // CPU_PROFILER
+
+#endif // _CPU_PROFILER_H
@@ -0,0 +1,158 @@
+#ifndef _DEPTH_PREPASS_H
+#define _DEPTH_PREPASS_H
+
+// Pré-passo de profundidade ("depth pre-pass").
+//
+// Quando ativado (tecla P), os objetos são desenhados primeiro somente no
+// Z-buffer, com um programa de GPU que lê apenas a posição dos vértices e
+// com a escrita de cor desligada. No passo seguinte, com os materiais
+// completos, o teste de profundidade GL_LEQUAL deixa passar somente os
+// fragmentos visíveis, de forma que cada pixel executa o fragment shader
+// caro uma única vez.
+//
+// O número de amostras que passam no teste de profundidade durante o passo
+// de cor é medido com consultas GL_SAMPLES_PASSED, com e sem o pré-passo.
+// Os resultados chegam alguns quadros depois, sem bloquear a CPU.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Funções definidas em main.cpp
+void DrawVirtualObject(const char* object_name);
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines);
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines);
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+
+#define DEPTH_PREPASS_QUERIES 4 // Consultas em uso ao mesmo tempo
+
+struct DepthPrepass
+{
+    bool enabled = false;
+
+    // Programa de GPU que escreve somente profundidade
+    GLuint program = 0;
+    GLint  model_uniform;
+    GLint  view_uniform;
+    GLint  projection_uniform;
+
+    // Consultas GL_SAMPLES_PASSED, usadas em rodízio
+    GLuint queries[DEPTH_PREPASS_QUERIES];
+    bool   query_pending[DEPTH_PREPASS_QUERIES];
+    bool   query_prepass[DEPTH_PREPASS_QUERIES]; // O pré-passo estava ativo no quadro da consulta
+    int    next_query = 0;
+    int    active_query = -1; // Consulta do passo de cor atual, ou -1
+
+    // Último resultado disponível de cada modo
+    GLuint samples_with_prepass = 0;
+    GLuint samples_without_prepass = 0;
+};
+
+DepthPrepass g_DepthPrepass;
+
+void DepthPrepass_Init()
+{
+    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_depth_vertex.glsl", "");
+    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_depth_fragment.glsl", "");
+    g_DepthPrepass.program = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    g_DepthPrepass.model_uniform      = glGetUniformLocation(g_DepthPrepass.program, "model");
+    g_DepthPrepass.view_uniform       = glGetUniformLocation(g_DepthPrepass.program, "view");
+    g_DepthPrepass.projection_uniform = glGetUniformLocation(g_DepthPrepass.program, "projection");
+
+    glGenQueries(DEPTH_PREPASS_QUERIES, g_DepthPrepass.queries);
+    for (int i = 0; i < DEPTH_PREPASS_QUERIES; ++i)
+        g_DepthPrepass.query_pending[i] = false;
+}
+
+void DepthPrepass_Toggle()
+{
+    g_DepthPrepass.enabled = !g_DepthPrepass.enabled;
+    printf("Pré-passo de profundidade: %s\n", g_DepthPrepass.enabled ? "ligado" : "desligado");
+}
+
+// Desenha a profundidade dos objetos, se o pré-passo estiver ativo. Altera o
+// programa de GPU ativo.
+void DepthPrepass_Draw(const std::vector<SceneObject*>& objects, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (!g_DepthPrepass.enabled)
+        return;
+
+    glUseProgram(g_DepthPrepass.program);
+    glUniformMatrix4fv(g_DepthPrepass.view_uniform, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(g_DepthPrepass.projection_uniform, 1, GL_FALSE, glm::value_ptr(projection));
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        glUniformMatrix4fv(g_DepthPrepass.model_uniform, 1, GL_FALSE, glm::value_ptr(objects[i]->get_render_model()));
+        DrawVirtualObject(objects[i]->get_model_name().c_str());
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Lê os resultados das consultas que já terminaram
+void DepthPrepass_CollectQueries()
+{
+    for (int i = 0; i < DEPTH_PREPASS_QUERIES; ++i)
+    {
+        if (!g_DepthPrepass.query_pending[i])
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(g_DepthPrepass.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint samples = 0;
+        glGetQueryObjectuiv(g_DepthPrepass.queries[i], GL_QUERY_RESULT, &samples);
+        if (g_DepthPrepass.query_prepass[i])
+            g_DepthPrepass.samples_with_prepass = samples;
+        else
+            g_DepthPrepass.samples_without_prepass = samples;
+        g_DepthPrepass.query_pending[i] = false;
+    }
+}
+
+// Deve envolver o passo de cor dos mesmos objetos passados para
+// DepthPrepass_Draw(). Com o pré-passo, o Z-buffer já está completo: só
+// passam no teste os fragmentos com a mesma profundidade já gravada, que não
+// precisa ser escrita novamente. Os dois vertex shaders declaram gl_Position
+// como "invariant", então a profundidade é exatamente a mesma nos dois passos.
+void DepthPrepass_BeginColorPass()
+{
+    DepthPrepass_CollectQueries();
+
+    // Se a próxima consulta ainda não terminou, este quadro não é medido
+    int query = g_DepthPrepass.next_query;
+    g_DepthPrepass.active_query = -1;
+    if (!g_DepthPrepass.query_pending[query])
+    {
+        glBeginQuery(GL_SAMPLES_PASSED, g_DepthPrepass.queries[query]);
+        g_DepthPrepass.query_pending[query] = true;
+        g_DepthPrepass.query_prepass[query] = g_DepthPrepass.enabled;
+        g_DepthPrepass.active_query = query;
+        g_DepthPrepass.next_query = (query + 1) % DEPTH_PREPASS_QUERIES;
+    }
+
+    if (g_DepthPrepass.enabled)
+    {
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+    }
+}
+
+void DepthPrepass_EndColorPass()
+{
+    if (g_DepthPrepass.active_query >= 0)
+        glEndQuery(GL_SAMPLES_PASSED);
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+#endif // _DEPTH_PREPASS_H
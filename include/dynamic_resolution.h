@@ -0,0 +1,266 @@
+#ifndef _DYNAMIC_RESOLUTION_H
+#define _DYNAMIC_RESOLUTION_H
+
+// Resolução dinâmica da cena 3D.
+//
+// A cena é renderizada em um framebuffer fora da tela, do tamanho da janela,
+// mas usando somente uma fração "scale" da sua largura e altura (o viewport).
+// Em seguida, um passo de "upscale" desenha um triângulo que cobre a tela
+// inteira e amplia essa região para o framebuffer da janela, com filtragem
+// bilinear e, opcionalmente (tecla U), um filtro de nitidez. O texto é
+// desenhado depois, diretamente na resolução da janela.
+//
+// O tempo gasto pela GPU na cena é medido com consultas GL_TIME_ELAPSED e
+// alimenta um controlador PID que ajusta "scale" para atingir o tempo
+// desejado por quadro. Como no pré-passo de profundidade ("depth_prepass.h"),
+// os resultados chegam alguns quadros depois, sem bloquear a CPU.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include <glad/glad.h>
+
+// Funções definidas em main.cpp
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines);
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines);
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+
+// "Texture unit" da imagem da cena lida pelo passo de upscale (veja
+// "shadows.h", "lights.h" e "lightmap.h" para as demais)
+#define DYNAMIC_RESOLUTION_TEXTURE_UNIT 28
+#define DYNAMIC_RESOLUTION_QUERIES 4 // Consultas em uso ao mesmo tempo
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+#define DYNAMIC_RESOLUTION_SHARPNESS 0.5f // Intensidade do filtro de nitidez em scale = MIN_SCALE
+
+struct DynamicResolution
+{
+    // Framebuffer da cena, com a resolução da janela
+    GLuint framebuffer = 0;
+    GLuint color_texture = 0;
+    GLuint depth_renderbuffer = 0;
+    int    texture_width = 0;
+    int    texture_height = 0;
+
+    // Região efetivamente renderizada neste quadro
+    float  scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    bool   fixed_scale = false; // O controlador não altera "scale"
+    int    render_width = 1;
+    int    render_height = 1;
+
+    // Controlador PID. O erro é a folga relativa em relação ao tempo
+    // desejado: positivo quando sobra tempo e a resolução pode aumentar.
+    float  target_ms = 14.0f; // Um pouco abaixo de 1000/60 ms
+    float  kp = 0.10f;
+    float  ki = 0.02f;
+    float  kd = 0.05f;
+    float  integral = 0.0f;
+    float  previous_error = 0.0f;
+    float  gpu_ms = 0.0f; // Último tempo medido
+
+    // Consultas GL_TIME_ELAPSED, usadas em rodízio
+    GLuint queries[DYNAMIC_RESOLUTION_QUERIES];
+    bool   query_pending[DYNAMIC_RESOLUTION_QUERIES];
+    int    next_query = 0;
+    int    active_query = -1; // Consulta do quadro atual, ou -1
+
+    // Programa de GPU do passo de upscale
+    bool   sharpen = true;
+    GLuint program = 0;
+    GLint  scene_uniform;
+    GLint  uv_scale_uniform;
+    GLint  uv_max_uniform;
+    GLint  texel_size_uniform;
+    GLint  sharpness_uniform;
+    GLuint vertex_array = 0; // Vazio: os vértices são gerados a partir de gl_VertexID
+};
+
+DynamicResolution g_DynamicResolution;
+
+// (Re)cria as imagens do framebuffer da cena com o tamanho da janela
+void DynamicResolution_Resize(int width, int height)
+{
+    g_DynamicResolution.texture_width = width;
+    g_DynamicResolution.texture_height = height;
+
+    glBindTexture(GL_TEXTURE_2D, g_DynamicResolution.color_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, g_DynamicResolution.depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, g_DynamicResolution.framebuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "ERROR: Dynamic resolution framebuffer is incomplete.\n");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution_Init()
+{
+    glGenTextures(1, &g_DynamicResolution.color_texture);
+    glBindTexture(GL_TEXTURE_2D, g_DynamicResolution.color_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &g_DynamicResolution.depth_renderbuffer);
+
+    glGenFramebuffers(1, &g_DynamicResolution.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_DynamicResolution.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_DynamicResolution.color_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_DynamicResolution.depth_renderbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_upscale_vertex.glsl", "");
+    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_upscale_fragment.glsl", "");
+    g_DynamicResolution.program = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    g_DynamicResolution.scene_uniform      = glGetUniformLocation(g_DynamicResolution.program, "scene");
+    g_DynamicResolution.uv_scale_uniform   = glGetUniformLocation(g_DynamicResolution.program, "uv_scale");
+    g_DynamicResolution.uv_max_uniform     = glGetUniformLocation(g_DynamicResolution.program, "uv_max");
+    g_DynamicResolution.texel_size_uniform = glGetUniformLocation(g_DynamicResolution.program, "texel_size");
+    g_DynamicResolution.sharpness_uniform  = glGetUniformLocation(g_DynamicResolution.program, "sharpness");
+
+    glUseProgram(g_DynamicResolution.program);
+    glUniform1i(g_DynamicResolution.scene_uniform, DYNAMIC_RESOLUTION_TEXTURE_UNIT);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &g_DynamicResolution.vertex_array);
+
+    glGenQueries(DYNAMIC_RESOLUTION_QUERIES, g_DynamicResolution.queries);
+    for (int i = 0; i < DYNAMIC_RESOLUTION_QUERIES; ++i)
+        g_DynamicResolution.query_pending[i] = false;
+}
+
+void DynamicResolution_ToggleSharpen()
+{
+    g_DynamicResolution.sharpen = !g_DynamicResolution.sharpen;
+    printf("Upscale: %s\n", g_DynamicResolution.sharpen ? "bilinear + nitidez" : "bilinear");
+}
+
+// Desliga o controlador e mantém a escala em "scale", para medições
+// comparáveis entre execuções
+void DynamicResolution_SetFixedScale(float scale)
+{
+    g_DynamicResolution.scale = std::max(DYNAMIC_RESOLUTION_MIN_SCALE, std::min(DYNAMIC_RESOLUTION_MAX_SCALE, scale));
+    g_DynamicResolution.fixed_scale = true;
+}
+
+// Um passo do controlador PID, com o tempo de GPU de um quadro
+void DynamicResolution_Control(float gpu_ms)
+{
+    DynamicResolution& dr = g_DynamicResolution;
+    dr.gpu_ms = gpu_ms;
+    if (dr.fixed_scale)
+        return;
+
+    float error = (dr.target_ms - gpu_ms) / dr.target_ms;
+    float derivative = error - dr.previous_error;
+    dr.previous_error = error;
+
+    // O termo integral é limitado para que o controlador não acumule erro
+    // enquanto "scale" está preso em um dos extremos
+    dr.integral = std::max(-5.0f, std::min(dr.integral + error, 5.0f));
+
+    float output = dr.kp * error + dr.ki * dr.integral + dr.kd * derivative;
+    dr.scale = std::max(DYNAMIC_RESOLUTION_MIN_SCALE, std::min(DYNAMIC_RESOLUTION_MAX_SCALE, dr.scale + output));
+}
+
+// Lê os resultados das consultas que já terminaram, na ordem em que foram
+// iniciadas
+void DynamicResolution_CollectQueries()
+{
+    for (int k = 0; k < DYNAMIC_RESOLUTION_QUERIES; ++k)
+    {
+        int i = (g_DynamicResolution.next_query + k) % DYNAMIC_RESOLUTION_QUERIES;
+        if (!g_DynamicResolution.query_pending[i])
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(g_DynamicResolution.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(g_DynamicResolution.queries[i], GL_QUERY_RESULT, &nanoseconds);
+        g_DynamicResolution.query_pending[i] = false;
+
+        DynamicResolution_Control(nanoseconds / 1e6f);
+    }
+}
+
+// Ativa o framebuffer da cena, com o viewport reduzido, e inicia a medição
+// do tempo de GPU. "width" e "height" são o tamanho do framebuffer da janela.
+void DynamicResolution_BeginScene(int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+    if (width != g_DynamicResolution.texture_width || height != g_DynamicResolution.texture_height)
+        DynamicResolution_Resize(width, height);
+
+    DynamicResolution_CollectQueries();
+
+    g_DynamicResolution.render_width  = std::max(1, (int)(width  * g_DynamicResolution.scale + 0.5f));
+    g_DynamicResolution.render_height = std::max(1, (int)(height * g_DynamicResolution.scale + 0.5f));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, g_DynamicResolution.framebuffer);
+    glViewport(0, 0, g_DynamicResolution.render_width, g_DynamicResolution.render_height);
+
+    // Se a próxima consulta ainda não terminou, este quadro não é medido
+    int query = g_DynamicResolution.next_query;
+    g_DynamicResolution.active_query = -1;
+    if (!g_DynamicResolution.query_pending[query])
+    {
+        glBeginQuery(GL_TIME_ELAPSED, g_DynamicResolution.queries[query]);
+        g_DynamicResolution.query_pending[query] = true;
+        g_DynamicResolution.active_query = query;
+        g_DynamicResolution.next_query = (query + 1) % DYNAMIC_RESOLUTION_QUERIES;
+    }
+}
+
+// Termina a medição e amplia a imagem da cena para o framebuffer da janela,
+// que fica ativo com o viewport completo. Altera o programa de GPU ativo.
+void DynamicResolution_EndScene()
+{
+    DynamicResolution& dr = g_DynamicResolution;
+
+    if (dr.active_query >= 0)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, dr.texture_width, dr.texture_height);
+
+    glActiveTexture(GL_TEXTURE0 + DYNAMIC_RESOLUTION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, dr.color_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Coordenadas de textura da região renderizada. As amostras vizinhas do
+    // filtro de nitidez não podem sair dela, onde há restos de quadros
+    // anteriores com outra resolução.
+    float texel_x = 1.0f / dr.texture_width;
+    float texel_y = 1.0f / dr.texture_height;
+    float sharpness = 0.0f;
+    if (dr.sharpen && DYNAMIC_RESOLUTION_MAX_SCALE > DYNAMIC_RESOLUTION_MIN_SCALE)
+        sharpness = DYNAMIC_RESOLUTION_SHARPNESS * (DYNAMIC_RESOLUTION_MAX_SCALE - dr.scale)
+                  / (DYNAMIC_RESOLUTION_MAX_SCALE - DYNAMIC_RESOLUTION_MIN_SCALE);
+
+    glUseProgram(dr.program);
+    glUniform2f(dr.uv_scale_uniform, dr.render_width * texel_x, dr.render_height * texel_y);
+    glUniform2f(dr.uv_max_uniform, (dr.render_width - 0.5f) * texel_x, (dr.render_height - 0.5f) * texel_y);
+    glUniform2f(dr.texel_size_uniform, texel_x, texel_y);
+    glUniform1f(dr.sharpness_uniform, sharpness);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(dr.vertex_array);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+
+    glUseProgram(0);
+}
+
+#endif // _DYNAMIC_RESOLUTION_H
@@ -0,0 +1,165 @@
+#ifndef _FRAME_PACKET_H
+#define _FRAME_PACKET_H
+
+// Comunicação entre a thread de simulação e a de renderização.
+//
+// A thread principal é dona do contexto OpenGL e da janela: ela recebe os
+// eventos da GLFW e desenha os quadros. Os callbacks de entrada não alteram o
+// estado do jogo; apenas colocam um InputEvent em g_InputQueue, que a thread
+// de simulação consome antes de executar os ticks (veja "simulation.h").
+//
+// Ao fim de cada iteração a simulação escreve tudo que a renderização precisa
+// em um FramePacket: a transformação de cada objeto, a câmera, os objetos da
+// inspeção e quais textos mostrar. Há dois pacotes: enquanto a renderização
+// lê um, a simulação escreve o outro, e assim as duas trabalham ao mesmo
+// tempo em núcleos diferentes. A simulação fica no máximo um pacote à frente
+// da renderização.
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "spsc_queue.h"
+
+#define INPUT_QUEUE_SIZE 4096
+
+enum InputEventType
+{
+    INPUT_KEY,
+    INPUT_MOUSE_BUTTON,
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    int    key;    // Tecla ou botão do mouse
+    int    action; // GLFW_PRESS, GLFW_RELEASE, ...
+    double x;      // Posição do cursor ou deslocamento da "rodinha"
+    double y;
+    double time;   // glfwGetTime() na entrega pela GLFW
+};
+
+SpscQueue<InputEvent, INPUT_QUEUE_SIZE> g_InputQueue;
+
+// Chamada pelos callbacks da GLFW, na thread principal. Se a simulação ficar
+// muito atrasada e a fila encher, o evento é descartado.
+void InputQueue_Push(InputEventType type, int key, int action, double x, double y)
+{
+    InputEvent event;
+    event.type = type;
+    event.key = key;
+    event.action = action;
+    event.x = x;
+    event.y = y;
+    event.time = glfwGetTime();
+    g_InputQueue.push(event);
+}
+
+// Objeto desenhado durante a inspeção. "object" é o índice em objects_to_draw.
+struct InspectionDraw
+{
+    int       object;
+    glm::mat4 model;
+    bool      lightmap;
+};
+
+struct FramePacket
+{
+    std::vector<ObjectTransform> transforms; // Um por objeto de objects_to_draw, na mesma ordem
+
+    glm::vec4 camera_position;
+    glm::vec4 camera_view_vector;
+
+    bool inspecting = false;
+    std::vector<InspectionDraw> inspection;
+
+    bool show_collect_prompt = false;
+    bool show_open_prompt = false;
+    bool show_inspect_prompt = false;
+    bool game_ended = false;
+    bool close_window = false;
+
+    // Teclas da renderização reproduzidas neste quadro (veja "input_replay.h")
+    std::vector<InputEvent> replayed_keys;
+};
+
+struct FramePipeline
+{
+    FramePacket packets[2];
+    int  write = 0;    // Pacote que a simulação escreve
+    int  ready = -1;   // Pacote publicado que a renderização ainda não pegou
+    int  reading = -1; // Pacote que a renderização está lendo
+    bool quit = false;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+FramePipeline g_FramePipeline;
+
+// Simulação: espera o pacote anterior ser pego pela renderização e retorna o
+// próximo pacote a ser escrito. Depois de FramePipeline_Quit(), retorna
+// imediatamente; verifique FramePipeline_ShouldQuit().
+FramePacket& FramePipeline_BeginWrite()
+{
+    std::unique_lock<std::mutex> lock(g_FramePipeline.mutex);
+    while (!g_FramePipeline.quit &&
+           (g_FramePipeline.ready != -1 || g_FramePipeline.reading == g_FramePipeline.write))
+        g_FramePipeline.cond.wait(lock);
+    return g_FramePipeline.packets[g_FramePipeline.write];
+}
+
+// Simulação: entrega o pacote escrito para a renderização
+void FramePipeline_Publish()
+{
+    std::lock_guard<std::mutex> lock(g_FramePipeline.mutex);
+    g_FramePipeline.ready = g_FramePipeline.write;
+    g_FramePipeline.write = 1 - g_FramePipeline.write;
+    g_FramePipeline.cond.notify_all();
+}
+
+// Renderização: espera e retorna o pacote publicado mais recente, que fica
+// reservado até FramePipeline_EndRead(). Retorna NULL depois de
+// FramePipeline_Quit().
+const FramePacket* FramePipeline_BeginRead()
+{
+    std::unique_lock<std::mutex> lock(g_FramePipeline.mutex);
+    while (!g_FramePipeline.quit && g_FramePipeline.ready == -1)
+        g_FramePipeline.cond.wait(lock);
+    if (g_FramePipeline.ready == -1)
+        return NULL;
+
+    g_FramePipeline.reading = g_FramePipeline.ready;
+    g_FramePipeline.ready = -1;
+    g_FramePipeline.cond.notify_all();
+    return &g_FramePipeline.packets[g_FramePipeline.reading];
+}
+
+void FramePipeline_EndRead()
+{
+    std::lock_guard<std::mutex> lock(g_FramePipeline.mutex);
+    g_FramePipeline.reading = -1;
+    g_FramePipeline.cond.notify_all();
+}
+
+// Acorda a simulação para que ela termine
+void FramePipeline_Quit()
+{
+    std::lock_guard<std::mutex> lock(g_FramePipeline.mutex);
+    g_FramePipeline.quit = true;
+    g_FramePipeline.cond.notify_all();
+}
+
+bool FramePipeline_ShouldQuit()
+{
+    std::lock_guard<std::mutex> lock(g_FramePipeline.mutex);
+    return g_FramePipeline.quit;
+}
+
+#endif // _FRAME_PACKET_H
@@ -0,0 +1,187 @@
+#ifndef _GPU_PROFILER_H
+#define _GPU_PROFILER_H
+
+// Medição do tempo de GPU de cada passo de renderização.
+//
+// Cada escopo ("cena", "skybox", ...) é delimitado por GpuProfiler_Begin() e
+// GpuProfiler_End(), que registram o instante em que a GPU chega naquele
+// ponto com consultas GL_TIMESTAMP (glQueryCounter). Ao contrário de
+// GL_TIME_ELAPSED, timestamps podem ser aninhados e usados ao mesmo tempo
+// que a consulta da resolução dinâmica ("dynamic_resolution.h").
+//
+// As consultas de GPU_PROFILER_FRAMES quadros seguidos ficam em um anel: os
+// resultados de um quadro só são lidos quando seu espaço do anel vai ser
+// reutilizado, quando a GPU normalmente já terminou. Se ainda não terminou,
+// a amostra é descartada em vez de bloquear a CPU. As últimas
+// GPU_PROFILER_HISTORY amostras de cada escopo dão o mínimo, a média e o
+// percentil 99 mostrados na tela.
+
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#define GPU_PROFILER_FRAMES  4   // Quadros em andamento no anel de consultas
+#define GPU_PROFILER_HISTORY 120 // Amostras guardadas por escopo
+
+enum GpuProfilerScopeId
+{
+    GPU_SCOPE_FRAME,      // O quadro inteiro, até o texto
+    GPU_SCOPE_SHADOWS,
+    GPU_SCOPE_SCENE,
+    GPU_SCOPE_INSPECTION,
+    GPU_SCOPE_SKYBOX,
+    GPU_SCOPE_UPSCALE,
+    GPU_SCOPE_HUD,
+    NUM_GPU_SCOPES
+};
+
+struct GpuProfilerScope
+{
+    const char* name;
+    GLuint begin_queries[GPU_PROFILER_FRAMES];
+    GLuint end_queries[GPU_PROFILER_FRAMES];
+    bool   recorded[GPU_PROFILER_FRAMES]; // O escopo foi executado no quadro daquele espaço do anel
+
+    float  history[GPU_PROFILER_HISTORY]; // Em milissegundos
+    int    history_count;
+    int    history_next;
+
+    bool   has_last;  // Uma amostra foi lida no último GpuProfiler_BeginFrame()
+    float  last_ms;
+};
+
+struct GpuProfilerStats
+{
+    int   samples; // 0 se o escopo não foi executado recentemente
+    float min_ms;
+    float avg_ms;
+    float p99_ms;
+};
+
+struct GpuProfiler
+{
+    GpuProfilerScope scopes[NUM_GPU_SCOPES];
+    int frame = 0;   // Espaço do anel do quadro atual
+    int dropped = 0; // Amostras descartadas por não estarem prontas
+};
+
+GpuProfiler g_GpuProfiler;
+
+void GpuProfiler_Init()
+{
+    static const char* names[NUM_GPU_SCOPES] = {
+        "quadro", "sombras", "cena", "inspecao", "skybox", "upscale", "texto"
+    };
+
+    for (int s = 0; s < NUM_GPU_SCOPES; ++s)
+    {
+        GpuProfilerScope& scope = g_GpuProfiler.scopes[s];
+        scope.name = names[s];
+        glGenQueries(GPU_PROFILER_FRAMES, scope.begin_queries);
+        glGenQueries(GPU_PROFILER_FRAMES, scope.end_queries);
+        for (int f = 0; f < GPU_PROFILER_FRAMES; ++f)
+            scope.recorded[f] = false;
+        scope.history_count = 0;
+        scope.history_next = 0;
+        scope.has_last = false;
+    }
+}
+
+// Lê os resultados do quadro que usou o espaço "frame" do anel
+void GpuProfiler_Collect(int frame)
+{
+    for (int s = 0; s < NUM_GPU_SCOPES; ++s)
+    {
+        GpuProfilerScope& scope = g_GpuProfiler.scopes[s];
+        scope.has_last = false;
+
+        // Um escopo que deixou de ser executado (por exemplo, a inspeção)
+        // não mostra mais estatísticas antigas
+        if (!scope.recorded[frame])
+        {
+            scope.history_count = 0;
+            scope.history_next = 0;
+            continue;
+        }
+        scope.recorded[frame] = false;
+
+        // Os timestamps terminam em ordem: se o final está pronto, o início
+        // também está
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(scope.end_queries[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            ++g_GpuProfiler.dropped;
+            continue;
+        }
+
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(scope.begin_queries[frame], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(scope.end_queries[frame], GL_QUERY_RESULT, &end);
+
+        scope.last_ms = (end - begin) / 1e6f;
+        scope.has_last = true;
+        scope.history[scope.history_next] = scope.last_ms;
+        scope.history_next = (scope.history_next + 1) % GPU_PROFILER_HISTORY;
+        scope.history_count = std::min(scope.history_count + 1, GPU_PROFILER_HISTORY);
+    }
+}
+
+// Deve ser chamada no início de cada quadro, antes de qualquer escopo
+void GpuProfiler_BeginFrame()
+{
+    g_GpuProfiler.frame = (g_GpuProfiler.frame + 1) % GPU_PROFILER_FRAMES;
+    GpuProfiler_Collect(g_GpuProfiler.frame);
+}
+
+void GpuProfiler_Begin(GpuProfilerScopeId id)
+{
+    GpuProfilerScope& scope = g_GpuProfiler.scopes[id];
+    glQueryCounter(scope.begin_queries[g_GpuProfiler.frame], GL_TIMESTAMP);
+}
+
+void GpuProfiler_End(GpuProfilerScopeId id)
+{
+    GpuProfilerScope& scope = g_GpuProfiler.scopes[id];
+    glQueryCounter(scope.end_queries[g_GpuProfiler.frame], GL_TIMESTAMP);
+    scope.recorded[g_GpuProfiler.frame] = true;
+}
+
+// Amostra lida no último GpuProfiler_BeginFrame(), de um quadro
+// GPU_PROFILER_FRAMES atrás. Retorna false se não havia amostra pronta.
+bool GpuProfiler_LastSample(GpuProfilerScopeId id, float& ms)
+{
+    const GpuProfilerScope& scope = g_GpuProfiler.scopes[id];
+    ms = scope.last_ms;
+    return scope.has_last;
+}
+
+GpuProfilerStats GpuProfiler_Stats(GpuProfilerScopeId id)
+{
+    const GpuProfilerScope& scope = g_GpuProfiler.scopes[id];
+
+    GpuProfilerStats stats;
+    stats.samples = scope.history_count;
+    stats.min_ms = stats.avg_ms = stats.p99_ms = 0.0f;
+    if (scope.history_count == 0)
+        return stats;
+
+    float sorted[GPU_PROFILER_HISTORY];
+    float sum = 0.0f;
+    for (int i = 0; i < scope.history_count; ++i)
+    {
+        sorted[i] = scope.history[i];
+        sum += sorted[i];
+    }
+
+    // Percentil 99 pelo método do posto mais próximo
+    int p99 = std::min(scope.history_count - 1, (99 * scope.history_count + 99) / 100 - 1);
+    std::nth_element(sorted, sorted + p99, sorted + scope.history_count);
+    stats.p99_ms = sorted[p99];
+    stats.min_ms = *std::min_element(sorted, sorted + scope.history_count);
+    stats.avg_ms = sum / scope.history_count;
+    return stats;
+}
+
+#endif // _GPU_PROFILER_H
@@ -0,0 +1,253 @@
+#ifndef _INPUT_REPLAY_H
+#define _INPUT_REPLAY_H
+
+// Gravação e reprodução da entrada, para medições repetíveis.
+//
+// Com "--record arquivo", cada evento de teclado, mouse e "rodinha" que a
+// thread de simulação tira de g_InputQueue é gravado em um log binário,
+// junto com o número do tick antes do qual foi tratado, o número do quadro e
+// o instante em que a GLFW o entregou. Com "--replay arquivo", a entrada ao
+// vivo é ignorada e os eventos do log são tratados antes dos mesmos ticks.
+//
+// Na reprodução cada quadro executa exatamente um tick de SIMULATION_DT
+// segundos, independentemente do relógio, e desenha o estado do tick sem
+// interpolação. Como o estado do jogo só muda nos ticks e nos eventos, o
+// percurso gravado (inclusive inspeções e animações de coleta) se repete
+// exatamente, quadro após quadro, e termina no tick em que a gravação
+// terminou.
+//
+// Formato: um InputLogHeader seguido de InputLogRecord, o último com
+// type == INPUT_LOG_END e o total de ticks gravados.
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#include "frame_packet.h"
+#include "simulation.h"
+
+#define INPUT_LOG_MAGIC   "INPT"
+#define INPUT_LOG_VERSION 1
+#define INPUT_LOG_END     255
+
+struct InputLogHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t simulation_hz; // A reprodução exige o mesmo SIMULATION_HZ
+    uint32_t reserved;
+};
+
+struct InputLogRecord
+{
+    uint32_t tick;   // Ticks executados antes do evento
+    uint32_t frame;  // Quadros da simulação antes do evento
+    float    time;   // Segundos desde o início da gravação, na entrega pela GLFW
+    uint8_t  type;   // InputEventType ou INPUT_LOG_END
+    int8_t   action;
+    int16_t  key;
+    double   x;
+    double   y;
+};
+
+static_assert(sizeof(InputLogRecord) == 32, "InputLogRecord deve ter 32 bytes");
+
+enum InputReplayMode
+{
+    INPUT_LIVE,
+    INPUT_RECORD,
+    INPUT_REPLAY
+};
+
+struct InputReplay
+{
+    InputReplayMode mode = INPUT_LIVE;
+    FILE*    file = NULL;        // Log sendo gravado
+    const char* filename = NULL;
+    double   start_time = 0.0;
+
+    std::vector<InputLogRecord> records; // Log sendo reproduzido
+    size_t   next = 0;
+    uint32_t end_tick = 0;
+
+    uint32_t tick = 0;
+    uint32_t frame = 0;
+};
+
+InputReplay g_InputReplay;
+
+bool InputReplay_IsReplaying()
+{
+    return g_InputReplay.mode == INPUT_REPLAY;
+}
+
+// Erro de escrita (disco cheio, por exemplo): a gravação é interrompida,
+// em vez de deixar um log truncado que só falharia na reprodução
+void InputReplay_WriteFailed()
+{
+    fprintf(stderr, "ERROR: Cannot write to file \"%s\"; input recording stopped.\n", g_InputReplay.filename);
+    fclose(g_InputReplay.file);
+    g_InputReplay.file = NULL;
+    g_InputReplay.mode = INPUT_LIVE;
+}
+
+bool InputReplay_StartRecording(const char* filename, double now)
+{
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        return false;
+    }
+    InputLogHeader header;
+    memcpy(header.magic, INPUT_LOG_MAGIC, 4);
+    header.version = INPUT_LOG_VERSION;
+    header.simulation_hz = SIMULATION_HZ;
+    header.reserved = 0;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0)
+    {
+        fprintf(stderr, "ERROR: Cannot write to file \"%s\".\n", filename);
+        fclose(file);
+        return false;
+    }
+
+    g_InputReplay.mode = INPUT_RECORD;
+    g_InputReplay.file = file;
+    g_InputReplay.filename = filename;
+    g_InputReplay.start_time = now;
+    printf("Gravando a entrada em \"%s\".\n", filename);
+    return true;
+}
+
+bool InputReplay_StartReplay(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        return false;
+    }
+    InputLogHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, INPUT_LOG_MAGIC, 4) != 0 ||
+        header.version != INPUT_LOG_VERSION)
+    {
+        fprintf(stderr, "ERROR: \"%s\" is not an input log.\n", filename);
+        fclose(file);
+        return false;
+    }
+    if (header.simulation_hz != SIMULATION_HZ)
+    {
+        fprintf(stderr, "ERROR: \"%s\" was recorded at %u Hz, the simulation runs at %d Hz.\n",
+                filename, header.simulation_hz, SIMULATION_HZ);
+        fclose(file);
+        return false;
+    }
+
+    InputLogRecord record;
+    g_InputReplay.records.clear();
+    g_InputReplay.end_tick = 0;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        g_InputReplay.end_tick = record.tick;
+        if (record.type == INPUT_LOG_END)
+            break;
+        g_InputReplay.records.push_back(record);
+    }
+    fclose(file);
+
+    g_InputReplay.mode = INPUT_REPLAY;
+    g_InputReplay.next = 0;
+    printf("Reproduzindo \"%s\": %d eventos, %u ticks (%.1f s).\n", filename,
+           (int)g_InputReplay.records.size(), g_InputReplay.end_tick,
+           g_InputReplay.end_tick * SIMULATION_DT);
+    return true;
+}
+
+// Simulação: grava um evento tirado de g_InputQueue, antes de tratá-lo
+void InputReplay_Record(const InputEvent& event)
+{
+    if (g_InputReplay.mode != INPUT_RECORD)
+        return;
+    InputLogRecord record;
+    record.tick = g_InputReplay.tick;
+    record.frame = g_InputReplay.frame;
+    record.time = (float)(event.time - g_InputReplay.start_time);
+    record.type = (uint8_t)event.type;
+    record.action = (int8_t)event.action;
+    record.key = (int16_t)event.key;
+    record.x = event.x;
+    record.y = event.y;
+    if (fwrite(&record, sizeof(record), 1, g_InputReplay.file) != 1)
+        InputReplay_WriteFailed();
+}
+
+// Simulação, na reprodução: o próximo evento a ser tratado antes do tick
+// atual. Retorna false quando não há mais eventos para este tick.
+bool InputReplay_Next(InputEvent& event)
+{
+    if (g_InputReplay.next >= g_InputReplay.records.size())
+        return false;
+    const InputLogRecord& record = g_InputReplay.records[g_InputReplay.next];
+    if (record.tick > g_InputReplay.tick)
+        return false;
+    ++g_InputReplay.next;
+
+    event.type = (InputEventType)record.type;
+    event.key = record.key;
+    event.action = record.action;
+    event.x = record.x;
+    event.y = record.y;
+    event.time = g_InputReplay.start_time + record.time;
+    return true;
+}
+
+// Ticks a executar neste quadro: um por quadro na reprodução, até o fim do
+// log; senão, os do relógio (veja FixedTimestep_Advance())
+int InputReplay_Advance(double now)
+{
+    if (g_InputReplay.mode != INPUT_REPLAY)
+        return FixedTimestep_Advance(now);
+    g_FixedTimestep.alpha = 1.0f;
+    return g_InputReplay.tick < g_InputReplay.end_tick ? 1 : 0;
+}
+
+// Simulação: fim de um quadro com "steps" ticks
+void InputReplay_EndFrame(int steps)
+{
+    g_InputReplay.tick += steps;
+    ++g_InputReplay.frame;
+}
+
+bool InputReplay_Finished()
+{
+    return g_InputReplay.mode == INPUT_REPLAY && g_InputReplay.tick >= g_InputReplay.end_tick;
+}
+
+// Termina a gravação, depois que a simulação parou
+void InputReplay_Stop()
+{
+    if (g_InputReplay.mode != INPUT_RECORD)
+        return;
+    InputLogRecord end;
+    memset(&end, 0, sizeof(end));
+    end.tick = g_InputReplay.tick;
+    end.frame = g_InputReplay.frame;
+    end.type = INPUT_LOG_END;
+    if (fwrite(&end, sizeof(end), 1, g_InputReplay.file) != 1)
+    {
+        InputReplay_WriteFailed();
+        return;
+    }
+    bool closed = fclose(g_InputReplay.file) == 0; // Escreve o que estava no buffer
+    g_InputReplay.file = NULL;
+    g_InputReplay.mode = INPUT_LIVE;
+    if (!closed)
+    {
+        fprintf(stderr, "ERROR: Cannot write to file \"%s\"; the input log is incomplete.\n", g_InputReplay.filename);
+        return;
+    }
+    printf("Entrada gravada: %u ticks, %u quadros.\n", end.tick, end.frame);
+}
+
+#endif // _INPUT_REPLAY_H
@@ -0,0 +1,88 @@
+#ifndef _LIGHTMAP_H
+#define _LIGHTMAP_H
+
+// Lightmaps pré-calculados ("baked") para os objetos estáticos da sala.
+//
+// Cada triângulo de um modelo recebe uma região própria de um atlas
+// quadrado: os triângulos são agrupados dois a dois em células de uma grade,
+// um de cada lado da diagonal da célula. As coordenadas resultantes são
+// enviadas como um quarto atributo de vértice por
+// BuildTrianglesAndAddToVirtualScene() (veja Lightmap_VertexUV()).
+//
+// Lightmap_Bake() constrói uma BVH com os triângulos dos objetos estáticos
+// e, para cada texel dos objetos marcados, traça raios em pacotes de 4 (SSE)
+// usando todos os núcleos da CPU: um raio de sombra para a luz principal e
+// raios no hemisfério para a oclusão ambiente e um rebatimento de luz
+// indireta. Os resultados são salvos em disco e carregados em tempo de
+// execução por Lightmap_LoadTexture(). Veja "src/lightmap.cpp" e o define
+// BAKED_LIGHTING em "src/shader_fragment.glsl".
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "mesh_data.h"
+
+// "Texture unit" do lightmap do objeto sendo desenhado (veja "lights.h" e
+// "shadows.h" para as demais)
+#define LIGHTMAP_TEXTURE_UNIT 27
+
+#define LIGHTMAP_DIR "../../data/lightmaps"
+#define LIGHTMAP_MIN_SIZE 256
+#define LIGHTMAP_MAX_SIZE 512
+#define LIGHTMAP_TEXELS_PER_CELL 8 // Resolução desejada de cada célula da grade
+
+// Disposição dos triângulos de um modelo no atlas. Depende somente do
+// número de triângulos, então todas as instâncias de um modelo
+// compartilham as mesmas coordenadas de textura.
+struct LightmapLayout
+{
+    int   num_triangles;
+    int   size;   // Largura e altura do atlas, em texels
+    int   grid;   // Células por linha/coluna
+    float margin; // Espaço livre nas bordas de cada triângulo, em unidades da célula
+};
+
+LightmapLayout Lightmap_Layout(int num_triangles);
+
+// Coordenadas no atlas do vértice "vertex" (0, 1 ou 2) do triângulo "triangle"
+glm::vec2 Lightmap_VertexUV(const LightmapLayout& layout, int triangle, int vertex);
+
+// Objeto da cena visto pelo baker
+struct LightmapObject
+{
+    std::string     name;        // Nome do arquivo gerado (sem diretório e extensão)
+    const MeshData* mesh = NULL;
+    glm::mat4       model;
+    bool            bake = false;       // Gera um lightmap para o objeto
+    bool            cast_shadow = true; // Bloqueia a luz principal (veja SceneObject::casts_shadow())
+};
+
+struct LightmapSettings
+{
+    glm::vec3 light_direction = glm::vec3(1.0f,1.0f,0.5f); // Sentido que aponta para a luz principal
+    glm::vec3 light_color     = glm::vec3(1.0f,1.0f,1.0f);
+    glm::vec3 albedo          = glm::vec3(0.5f,0.5f,0.5f); // Refletância difusa usada no rebatimento
+    int       samples         = 32;   // Raios no hemisfério por texel (múltiplo de 4)
+    float     ao_distance     = 1.0f; // Alcance da oclusão ambiente
+};
+
+// Gera e salva em LIGHTMAP_DIR o lightmap de cada objeto com "bake" ativo.
+// Todos os objetos participam como oclusores e refletores. Cada texel guarda
+// RGB = luz principal direta (com sombras) + luz indireta e A = oclusão
+// ambiente (1 = desobstruído).
+void Lightmap_Bake(const std::vector<LightmapObject>& objects, const LightmapSettings& settings);
+
+// Caminho do lightmap de um objeto
+std::string Lightmap_Path(const std::string& name);
+
+// Carrega um lightmap salvo por Lightmap_Bake() em uma textura. Retorna 0
+// se o arquivo não existir ou for inválido.
+GLuint Lightmap_LoadTexture(const std::string& name);
+
+#endif // _LIGHTMAP_H
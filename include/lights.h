@@ -0,0 +1,77 @@
+#ifndef _LIGHTS_H
+#define _LIGHTS_H
+
+// Luzes pontuais com "clustered forward shading".
+//
+// O frustum de visualização é dividido em uma grade 3D de clusters
+// (CLUSTER_X x CLUSTER_Y ladrilhos na tela e CLUSTER_Z fatias em
+// profundidade, espaçadas exponencialmente). A cada quadro, Lights_Update()
+// calcula na CPU quais luzes intersectam cada cluster e envia as listas para a
+// GPU através de "texture buffers". O fragment shader então percorre somente
+// as luzes do cluster onde o fragmento está. Veja "src/lights.cpp" e
+// "src/shader_fragment.glsl".
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define NUM_CLUSTERS (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 64 // Limita o custo por fragmento
+#define MAX_POINT_LIGHTS 4096
+
+// "Texture units" dos texture buffers. As unidades 0-21 são usadas pelas
+// imagens de LoadTextureImage() e a 31 pelo texto.
+#define LIGHT_DATA_TEXTURE_UNIT  24
+#define LIGHT_GRID_TEXTURE_UNIT  25
+#define LIGHT_INDEX_TEXTURE_UNIT 26
+
+struct PointLight
+{
+    glm::vec3 position;  // Coordenadas globais
+    float     radius;    // Alcance da luz; 0 desativa a luz
+    glm::vec3 color;
+    float     intensity;
+};
+
+// Parâmetros que o fragment shader usa para encontrar seu cluster.
+struct ClusterUniforms
+{
+    float tile_scale_x; // CLUSTER_X / largura do framebuffer
+    float tile_scale_y; // CLUSTER_Y / altura do framebuffer
+    float z_scale;      // fatia = log(profundidade) * z_scale + z_bias
+    float z_bias;
+};
+
+// Cria os texture buffers. Deve ser chamada com o contexto OpenGL ativo.
+void Lights_Init();
+
+// Adiciona uma luz e retorna seu identificador, que permanece válido até
+// Lights_Clear().
+int Lights_Add(const glm::vec3& position, const glm::vec3& color, float radius, float intensity = 1.0f);
+
+// Acesso a uma luz para alterar seus parâmetros (por exemplo, para animá-la).
+PointLight& Lights_Get(int light);
+
+// Desativa uma luz sem alterar os identificadores das demais.
+void Lights_Remove(int light);
+
+void Lights_Clear();
+
+int Lights_Count();
+
+// Atribui as luzes aos clusters do frustum definido pelos parâmetros abaixo
+// (os mesmos passados para Matrix_Perspective(); "nearplane" e "farplane"
+// são negativos) e envia os resultados para a GPU.
+void Lights_Update(const glm::mat4& view, float field_of_view, float screen_ratio,
+                   float nearplane, float farplane, int framebuffer_width, int framebuffer_height);
+
+// Ativa os texture buffers nas suas texture units.
+void Lights_BindTextures();
+
+ClusterUniforms Lights_GetClusterUniforms();
+
+#endif // _LIGHTS_H
@@ -0,0 +1,147 @@
+#ifndef _MATERIALS_H
+#define _MATERIALS_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+// Modo de mapeamento das coordenadas de textura de uma classe de material.
+enum TextureMapping
+{
+    MAPPING_NONE,       // Sem textura: Kd é constante
+    MAPPING_TEXCOORDS,  // Coordenadas de textura do arquivo OBJ
+    MAPPING_PLANAR_XZ,  // Projeção planar no plano XZ do modelo (chão, teto, tabuleiro)
+    MAPPING_PLANAR_XY,  // Projeção planar no plano XY do modelo (paredes, livros)
+    MAPPING_SPHERICAL   // Projeção esférica em torno do centro da bounding box
+};
+
+// Modelo de iluminação de uma classe de material.
+enum LightingModel
+{
+    LIGHTING_UNLIT,
+    LIGHTING_LAMBERT,
+    LIGHTING_BLINN_PHONG,
+    LIGHTING_PHONG
+};
+
+// Chave de uma permutação dos shaders. Cada combinação distinta destes
+// campos gera um programa de GPU especializado, compilado com os #defines
+// retornados por defines(), de forma que o fragment shader não precise
+// testar qual objeto está sendo desenhado.
+struct ShaderPermutation
+{
+    TextureMapping mapping  = MAPPING_TEXCOORDS;
+    LightingModel  lighting = LIGHTING_BLINN_PHONG;
+    bool gouraud     = false; // Iluminação calculada por vértice
+    bool kd2_texture = false; // Kd é multiplicado por uma segunda textura
+    bool ks_texture  = false; // Ks é lido de uma textura
+    bool lightmap    = false; // Iluminação estática lida do lightmap do objeto (veja "lightmap.h")
+    bool lod         = false; // Versão simplificada para objetos distantes (veja "shading_lod.h")
+
+    bool operator==(const ShaderPermutation& other) const
+    {
+        return mapping == other.mapping && lighting == other.lighting &&
+               gouraud == other.gouraud && kd2_texture == other.kd2_texture &&
+               ks_texture == other.ks_texture && lightmap == other.lightmap &&
+               lod == other.lod;
+    }
+
+    // Permutação usada quando o objeto é pequeno na tela: toda a iluminação
+    // é calculada por vértice (GOURAUD + SHADING_LOD) e somente a textura Kd
+    // é amostrada. Materiais sem iluminação não têm versão simplificada.
+    ShaderPermutation Lod() const
+    {
+        ShaderPermutation simplified = *this;
+        if (lighting == LIGHTING_UNLIT)
+            return simplified;
+        simplified.gouraud = true;
+        simplified.kd2_texture = false;
+        simplified.ks_texture = false;
+        simplified.lod = true;
+        return simplified;
+    }
+
+    std::string defines() const
+    {
+        static const char* mapping_names[] = {
+            "MAPPING_NONE", "MAPPING_TEXCOORDS", "MAPPING_PLANAR_XZ",
+            "MAPPING_PLANAR_XY", "MAPPING_SPHERICAL"
+        };
+        static const char* lighting_names[] = {
+            "LIGHTING_UNLIT", "LIGHTING_LAMBERT", "LIGHTING_BLINN_PHONG", "LIGHTING_PHONG"
+        };
+
+        std::string str;
+        str += "#define "; str += mapping_names[mapping];   str += "\n";
+        str += "#define "; str += lighting_names[lighting]; str += "\n";
+        if (gouraud)     str += "#define GOURAUD\n";
+        if (kd2_texture) str += "#define KD2_TEXTURE\n";
+        if (ks_texture)  str += "#define KS_TEXTURE\n";
+        if (lightmap)    str += "#define BAKED_LIGHTING\n";
+        if (lod)         str += "#define SHADING_LOD\n";
+        return str;
+    }
+};
+
+// Parâmetros de uma classe de material. Os índices de textura são as
+// "texture units" atribuídas por LoadTextureImage().
+struct Material
+{
+    ShaderPermutation permutation;
+    int       kd_texture  = 0;
+    int       kd2_texture = 0;
+    int       ks_texture  = 0;
+    glm::vec3 kd = glm::vec3(0.0f,0.0f,0.0f); // Usado quando mapping == MAPPING_NONE
+    glm::vec3 ks = glm::vec3(0.0f,0.0f,0.0f); // Usado quando ks_texture == false
+    float     ka_factor = 0.0f;               // Ka = Kd * ka_factor
+    float     q = 1.0f;                       // Expoente especular
+    glm::vec2 uv_scale  = glm::vec2(1.0f,1.0f);
+    glm::vec2 uv_offset = glm::vec2(0.0f,0.0f);
+    glm::vec2 uv_wrap   = glm::vec2(1.0f,1.0f); // 1 = repete a textura (fract) naquele eixo
+    int       program = 0;     // Índice em g_GpuPrograms, preenchido por LoadShadersFromFiles()
+    int       lod_program = 0; // Programa de permutation.Lod(), também em g_GpuPrograms
+};
+
+// Programa de GPU de uma permutação, com a localização de suas variáveis uniform.
+// Enquanto uma nova versão do programa é compilada em segundo plano,
+// "pending_id" guarda o programa em compilação e "id" continua sendo usado.
+struct GpuProgram
+{
+    ShaderPermutation permutation;
+    GLuint id = 0; // 0 até a primeira compilação terminar
+    GLuint pending_id = 0;
+    GLuint pending_vertex_shader = 0;
+    GLuint pending_fragment_shader = 0;
+    unsigned long long cache_key = 0; // Veja ProgramCache_Key() em "program_cache.h"
+    GLint  model_uniform;
+    GLint  view_uniform;
+    GLint  projection_uniform;
+    GLint  bbox_min_uniform;
+    GLint  bbox_max_uniform;
+    GLint  kd_texture_uniform;
+    GLint  kd2_texture_uniform;
+    GLint  ks_texture_uniform;
+    GLint  kd_uniform;
+    GLint  ks_uniform;
+    GLint  ka_factor_uniform;
+    GLint  q_uniform;
+    GLint  uv_scale_uniform;
+    GLint  uv_offset_uniform;
+    GLint  uv_wrap_uniform;
+    GLint  light_data_uniform;
+    GLint  light_grid_uniform;
+    GLint  light_index_uniform;
+    GLint  cluster_params_uniform;
+    GLint  cluster_count_uniform;
+    GLint  shadow_static_uniform;
+    GLint  shadow_dynamic_uniform;
+    GLint  shadow_matrix_uniform;
+    GLint  shadow_enabled_uniform;
+    GLint  lightmap_uniform;
+};
+
+#endif // _MATERIALS_H
@@ -0,0 +1,214 @@
+#ifndef _MESH_BUILDER_H
+#define _MESH_BUILDER_H
+
+// Parte de CPU do carregamento dos modelos: ComputeNormals() e a montagem
+// dos vetores de atributos dos vértices, de g_MeshData e das caixas
+// envolventes. BuildTrianglesAndAddToVirtualScene() (em "main.cpp") chama
+// MeshBuilder_Build() e só então envia os vetores para a GPU; separadas
+// assim, as duas podem ser medidas sem um contexto OpenGL (veja
+// "bench/kernels_bench.cpp").
+//
+// Deve ser incluído depois de "types.h" (ObjModel).
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <tiny_obj_loader.h>
+
+#include "cpu_profiler.h"
+#include "lightmap.h"
+#include "matrices.h"
+#include "mesh_bvh.h"
+#include "mesh_data.h"
+
+// Atributos de todos os vértices de um ObjModel, na ordem dos buffers da GPU
+struct MeshBuffers
+{
+    std::vector<GLuint> indices;
+    std::vector<float>  model_coefficients;    // vec4 por vértice
+    std::vector<float>  normal_coefficients;   // vec4 por vértice; vazio se o modelo não tem normais
+    std::vector<float>  texture_coefficients;  // vec2 por vértice; vazio se o modelo não tem coordenadas de textura
+    std::vector<float>  lightmap_coefficients; // vec2 por vértice
+};
+
+// Faixa de "indices" de um objeto do modelo
+struct MeshShape
+{
+    std::string name;
+    size_t      first_index;
+    size_t      num_indices;
+    glm::vec3   bbox_min;
+    glm::vec3   bbox_max;
+    MeshData*   mesh;
+};
+
+// Função que computa as normais de um ObjModel, caso elas não tenham sido
+// especificadas dentro do arquivo ".obj"
+void ComputeNormals(ObjModel* model)
+{
+    PROFILE_FUNCTION();
+    if ( !model->attrib.normals.empty() )
+        return;
+
+    // Primeiro computamos as normais para todos os TRIÂNGULOS.
+    // Segundo, computamos as normais dos VÉRTICES através do método proposto
+    // por Gouraud, onde a normal de cada vértice vai ser a média das normais de
+    // todas as faces que compartilham este vértice.
+
+    size_t num_vertices = model->attrib.vertices.size() / 3;
+
+    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
+    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            glm::vec4  vertices[3];
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
+                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
+                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
+                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
+            }
+
+            const glm::vec4  a = vertices[0];
+            const glm::vec4  b = vertices[1];
+            const glm::vec4  c = vertices[2];
+
+            // PREENCHA AQUI o cálculo da normal de um triângulo cujos vértices
+            // estão nos pontos "a", "b", e "c", definidos no sentido anti-horário.
+            const glm::vec4  n = crossproduct(b-a,c-a);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+                num_triangles_per_vertex[idx.vertex_index] += 1;
+                vertex_normals[idx.vertex_index] += n;
+                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
+            }
+        }
+    }
+
+    model->attrib.normals.resize( 3*num_vertices );
+
+    for (size_t i = 0; i < vertex_normals.size(); ++i)
+    {
+        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
+        n /= norm(n);
+        model->attrib.normals[3*i + 0] = n.x;
+        model->attrib.normals[3*i + 1] = n.y;
+        model->attrib.normals[3*i + 2] = n.z;
+    }
+}
+
+
+// Preenche "buffers" com os vértices de todos os objetos de "model" e, para
+// cada objeto, a sua cópia em "meshes" (com a BVH) e a sua faixa em "shapes"
+void MeshBuilder_Build(const ObjModel* model, std::map<std::string, MeshData>& meshes,
+                       MeshBuffers& buffers, std::vector<MeshShape>& shapes)
+{
+    PROFILE_FUNCTION();
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        size_t first_index = buffers.indices.size();
+        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+
+        // Cópia dos triângulos na CPU e coordenadas no atlas do lightmap
+        MeshData& mesh = meshes[model->shapes[shape].name];
+        mesh.positions.clear();
+        mesh.normals.clear();
+        LightmapLayout lightmap_layout = Lightmap_Layout((int)num_triangles);
+
+        const float minval = std::numeric_limits<float>::min();
+        const float maxval = std::numeric_limits<float>::max();
+
+        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
+        glm::vec3 bbox_max = glm::vec3(minval,minval,minval);
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+
+                buffers.indices.push_back(first_index + 3*triangle + vertex);
+
+                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
+                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
+                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
+                //printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
+                buffers.model_coefficients.push_back( vx ); // X
+                buffers.model_coefficients.push_back( vy ); // Y
+                buffers.model_coefficients.push_back( vz ); // Z
+                buffers.model_coefficients.push_back( 1.0f ); // W
+                mesh.positions.push_back(glm::vec4(vx,vy,vz,1.0f));
+
+                glm::vec2 lightmap_uv = Lightmap_VertexUV(lightmap_layout, (int)triangle, (int)vertex);
+                buffers.lightmap_coefficients.push_back( lightmap_uv.x );
+                buffers.lightmap_coefficients.push_back( lightmap_uv.y );
+
+                bbox_min.x = std::min(bbox_min.x, vx);
+                bbox_min.y = std::min(bbox_min.y, vy);
+                bbox_min.z = std::min(bbox_min.z, vz);
+                bbox_max.x = std::max(bbox_max.x, vx);
+                bbox_max.y = std::max(bbox_max.y, vy);
+                bbox_max.z = std::max(bbox_max.z, vz);
+
+                // Inspecionando o código da tinyobjloader, o aluno Bernardo
+                // Sulzbach (2017/1) apontou que a maneira correta de testar se
+                // existem normais e coordenadas de textura no ObjModel é
+                // comparando se o índice retornado é -1. Fazemos isso abaixo.
+
+                if ( idx.normal_index != -1 )
+                {
+                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
+                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
+                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
+                    buffers.normal_coefficients.push_back( nx ); // X
+                    buffers.normal_coefficients.push_back( ny ); // Y
+                    buffers.normal_coefficients.push_back( nz ); // Z
+                    buffers.normal_coefficients.push_back( 0.0f ); // W
+                    mesh.normals.push_back(glm::vec4(nx,ny,nz,0.0f));
+                }
+
+                if ( idx.texcoord_index != -1 )
+                {
+                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
+                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
+                    buffers.texture_coefficients.push_back( u );
+                    buffers.texture_coefficients.push_back( v );
+                }
+            }
+        }
+
+        // Triângulos organizados para os testes exatos de colisão e seleção
+        MeshBVH_Build(mesh.bvh, mesh.positions);
+
+        MeshShape range;
+        range.name = model->shapes[shape].name;
+        range.first_index = first_index;
+        range.num_indices = buffers.indices.size() - first_index;
+        range.bbox_min = bbox_min;
+        range.bbox_max = bbox_max;
+        range.mesh = &mesh;
+        shapes.push_back(range);
+    }
+}
+
+#endif // _MESH_BUILDER_H
@@ -0,0 +1,446 @@
+#ifndef _MESH_BVH_H
+#define _MESH_BVH_H
+
+// Hierarquia de volumes envolventes (BVH) sobre os triângulos de uma malha,
+// usada nos testes exatos de colisão e de seleção com o mouse (veja
+// isRayObject() em "collisions.h" e as formas COLLISION_MESH em
+// "collision_shapes.h").
+//
+// A árvore é construída uma vez, ao carregar o modelo, dividindo os
+// triângulos pela heurística de área de superfície (SAH) com "bins". Os nós
+// ficam em um único array, em pré-ordem: o filho esquerdo de um nó interno é
+// o nó seguinte, e "skip" aponta para o primeiro nó depois da sub-árvore.
+// Assim o percurso não precisa de pilha: se a caixa de um nó é atingida,
+// segue-se para i + 1; senão, pula-se para "skip". Os triângulos de cada
+// folha ficam contíguos, já com as arestas pré-calculadas para o teste de
+// Möller-Trumbore.
+//
+// As consultas trabalham nas coordenadas do modelo. Quem chama transforma o
+// raio pela inversa da matriz "model"; nos testes de sobreposição, a caixa
+// ou esfera é levada para as coordenadas do modelo somente para descartar
+// nós, e os triângulos atingidos são testados em coordenadas globais.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+
+#define MESH_BVH_BINS 12
+#define MESH_BVH_LEAF_SIZE 4
+
+struct MeshBVHNode
+{
+    glm::vec3 bbox_min;
+    int       skip;           // Próximo nó quando esta sub-árvore não é visitada
+    glm::vec3 bbox_max;
+    int       first_triangle; // Folhas: índice em MeshBVH::triangles
+    int       num_triangles;  // 0 nos nós internos
+};
+
+struct MeshBVHTriangle
+{
+    glm::vec3 v0;
+    glm::vec3 e1; // v1 - v0
+    glm::vec3 e2; // v2 - v0
+};
+
+struct MeshBVH
+{
+    std::vector<MeshBVHNode>     nodes;
+    std::vector<MeshBVHTriangle> triangles; // Na ordem das folhas
+
+    bool empty() const { return nodes.empty(); }
+};
+
+// Dados de cada triângulo durante a construção
+struct MeshBVHBuildTriangle
+{
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+    glm::vec3 centroid;
+    int       index;
+};
+
+inline float MeshBVH_Area(glm::vec3 bbox_min, glm::vec3 bbox_max)
+{
+    glm::vec3 d = glm::max(bbox_max - bbox_min, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+inline int MeshBVH_BuildNode(MeshBVH& bvh, std::vector<MeshBVHBuildTriangle>& build, int begin, int end)
+{
+    int index = (int)bvh.nodes.size();
+    bvh.nodes.push_back(MeshBVHNode());
+
+    glm::vec3 bbox_min = build[begin].bbox_min, bbox_max = build[begin].bbox_max;
+    glm::vec3 centroid_min = build[begin].centroid, centroid_max = build[begin].centroid;
+    for (int i = begin + 1; i < end; ++i)
+    {
+        bbox_min = glm::min(bbox_min, build[i].bbox_min);
+        bbox_max = glm::max(bbox_max, build[i].bbox_max);
+        centroid_min = glm::min(centroid_min, build[i].centroid);
+        centroid_max = glm::max(centroid_max, build[i].centroid);
+    }
+    bvh.nodes[index].bbox_min = bbox_min;
+    bvh.nodes[index].bbox_max = bbox_max;
+
+    // Melhor divisão entre as fronteiras dos bins, nos três eixos. O custo de
+    // um filho é sua área vezes o número de triângulos, relativo ao pai.
+    int count = end - begin;
+    int best_axis = -1, best_bin = 0;
+    float best_cost = (float)count;
+    float parent_area = MeshBVH_Area(bbox_min, bbox_max);
+    if (count > MESH_BVH_LEAF_SIZE && parent_area > 0.0f)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centroid_max[axis] - centroid_min[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            int bin_count[MESH_BVH_BINS] = {};
+            glm::vec3 bin_min[MESH_BVH_BINS], bin_max[MESH_BVH_BINS];
+            for (int b = 0; b < MESH_BVH_BINS; ++b)
+            {
+                bin_min[b] = glm::vec3(INFINITY);
+                bin_max[b] = glm::vec3(-INFINITY);
+            }
+            float scale = MESH_BVH_BINS / extent;
+            for (int i = begin; i < end; ++i)
+            {
+                int b = std::min(MESH_BVH_BINS - 1, (int)((build[i].centroid[axis] - centroid_min[axis]) * scale));
+                ++bin_count[b];
+                bin_min[b] = glm::min(bin_min[b], build[i].bbox_min);
+                bin_max[b] = glm::max(bin_max[b], build[i].bbox_max);
+            }
+
+            // Áreas acumuladas da direita para a esquerda
+            float right_area[MESH_BVH_BINS];
+            int right_count[MESH_BVH_BINS];
+            glm::vec3 lo = glm::vec3(INFINITY), hi = glm::vec3(-INFINITY);
+            int n = 0;
+            for (int b = MESH_BVH_BINS - 1; b > 0; --b)
+            {
+                lo = glm::min(lo, bin_min[b]);
+                hi = glm::max(hi, bin_max[b]);
+                n += bin_count[b];
+                right_area[b] = n > 0 ? MeshBVH_Area(lo, hi) : 0.0f;
+                right_count[b] = n;
+            }
+
+            lo = glm::vec3(INFINITY);
+            hi = glm::vec3(-INFINITY);
+            n = 0;
+            for (int b = 0; b < MESH_BVH_BINS - 1; ++b)
+            {
+                lo = glm::min(lo, bin_min[b]);
+                hi = glm::max(hi, bin_max[b]);
+                n += bin_count[b];
+                if (n == 0 || right_count[b + 1] == 0)
+                    continue;
+                float cost = 1.0f + (MeshBVH_Area(lo, hi) * n + right_area[b + 1] * right_count[b + 1]) / parent_area;
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+    }
+
+    if (best_axis == -1)
+    {
+        // Folha
+        bvh.nodes[index].first_triangle = begin;
+        bvh.nodes[index].num_triangles = count;
+        bvh.nodes[index].skip = index + 1;
+        return index;
+    }
+
+    float scale = MESH_BVH_BINS / (centroid_max[best_axis] - centroid_min[best_axis]);
+    float split_min = centroid_min[best_axis];
+    MeshBVHBuildTriangle* middle = std::partition(&build[begin], &build[0] + end,
+        [=](const MeshBVHBuildTriangle& t) {
+            return std::min(MESH_BVH_BINS - 1, (int)((t.centroid[best_axis] - split_min) * scale)) <= best_bin;
+        });
+    int split = (int)(middle - &build[0]);
+
+    bvh.nodes[index].first_triangle = 0;
+    bvh.nodes[index].num_triangles = 0;
+    MeshBVH_BuildNode(bvh, build, begin, split); // Filho esquerdo: index + 1
+    MeshBVH_BuildNode(bvh, build, split, end);
+    bvh.nodes[index].skip = (int)bvh.nodes.size();
+    return index;
+}
+
+// Constrói a BVH a partir de MeshData::positions (3 vértices por triângulo).
+// Se "order" não é nulo, recebe o índice original (em "positions" / 3) de
+// cada triângulo de MeshBVH::triangles, para quem guarda dados por triângulo.
+inline void MeshBVH_Build(MeshBVH& bvh, const std::vector<glm::vec4>& positions, std::vector<int>* order = NULL)
+{
+    bvh.nodes.clear();
+    bvh.triangles.clear();
+    if (order != NULL)
+        order->clear();
+    int num_triangles = (int)positions.size() / 3;
+    if (num_triangles == 0)
+        return;
+
+    std::vector<MeshBVHBuildTriangle> build(num_triangles);
+    for (int i = 0; i < num_triangles; ++i)
+    {
+        glm::vec3 a = glm::vec3(positions[3*i + 0]);
+        glm::vec3 b = glm::vec3(positions[3*i + 1]);
+        glm::vec3 c = glm::vec3(positions[3*i + 2]);
+        build[i].bbox_min = glm::min(a, glm::min(b, c));
+        build[i].bbox_max = glm::max(a, glm::max(b, c));
+        build[i].centroid = (a + b + c) / 3.0f;
+        build[i].index = i;
+    }
+
+    bvh.nodes.reserve(2 * num_triangles / MESH_BVH_LEAF_SIZE + 1);
+    MeshBVH_BuildNode(bvh, build, 0, num_triangles);
+
+    // Triângulos na ordem das folhas: cada folha aponta para o seu intervalo
+    // de "build", já particionado
+    bvh.triangles.resize(num_triangles);
+    if (order != NULL)
+        order->resize(num_triangles);
+    for (int k = 0; k < num_triangles; ++k)
+    {
+        int i = build[k].index;
+        if (order != NULL)
+            (*order)[k] = i;
+        MeshBVHTriangle& t = bvh.triangles[k];
+        t.v0 = glm::vec3(positions[3*i + 0]);
+        t.e1 = glm::vec3(positions[3*i + 1]) - t.v0;
+        t.e2 = glm::vec3(positions[3*i + 2]) - t.v0;
+    }
+}
+
+inline bool MeshBVH_RayNode(const MeshBVHNode& node, glm::vec3 origin, glm::vec3 inverse_ray, float t_max)
+{
+    glm::vec3 t1 = (node.bbox_min - origin) * inverse_ray;
+    glm::vec3 t2 = (node.bbox_max - origin) * inverse_ray;
+    glm::vec3 near = glm::min(t1, t2);
+    glm::vec3 far = glm::max(t1, t2);
+    float t_enter = std::max(std::max(near.x, near.y), near.z);
+    float t_exit = std::min(std::min(far.x, far.y), far.z);
+    return t_enter <= t_exit && t_exit > 0.0f && t_enter < t_max;
+}
+
+// Primeiro triângulo atingido pelo raio "origin + t * ray", com
+// 0 < t < t_max. Retorna true e o t em "distance" se há interseção.
+inline bool MeshBVH_RayCast(const MeshBVH& bvh, glm::vec3 origin, glm::vec3 ray, float t_max, float& distance)
+{
+    glm::vec3 inverse_ray = 1.0f / ray;
+    float best = t_max;
+    int num_nodes = (int)bvh.nodes.size();
+    int i = 0;
+    while (i < num_nodes)
+    {
+        const MeshBVHNode& node = bvh.nodes[i];
+        if (!MeshBVH_RayNode(node, origin, inverse_ray, best))
+        {
+            i = node.skip;
+            continue;
+        }
+        if (node.num_triangles == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        // Möller-Trumbore, sem descartar faces de trás
+        for (int k = node.first_triangle; k < node.first_triangle + node.num_triangles; ++k)
+        {
+            const MeshBVHTriangle& tri = bvh.triangles[k];
+            glm::vec3 p = glm::cross(ray, tri.e2);
+            float det = glm::dot(tri.e1, p);
+            if (std::fabs(det) < 1e-12f)
+                continue;
+            float inverse_det = 1.0f / det;
+            glm::vec3 s = origin - tri.v0;
+            float u = glm::dot(s, p) * inverse_det;
+            if (u < 0.0f || u > 1.0f)
+                continue;
+            glm::vec3 q = glm::cross(s, tri.e1);
+            float v = glm::dot(ray, q) * inverse_det;
+            if (v < 0.0f || u + v > 1.0f)
+                continue;
+            float t = glm::dot(tri.e2, q) * inverse_det;
+            if (t > 0.0f && t < best)
+                best = t;
+        }
+        i = node.skip;
+    }
+
+    if (best >= t_max)
+        return false;
+    distance = best;
+    return true;
+}
+
+// Teste de eixos separadores entre um triângulo e uma caixa centrada na
+// origem com meia-dimensão "h" (Akenine-Möller)
+inline bool MeshBVH_TriangleBox(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 h)
+{
+    // Eixos da caixa
+    for (int a = 0; a < 3; ++a)
+    {
+        if (std::max(v0[a], std::max(v1[a], v2[a])) < -h[a] ||
+            std::min(v0[a], std::min(v1[a], v2[a])) > h[a])
+            return false;
+    }
+
+    // Plano do triângulo
+    glm::vec3 e0 = v1 - v0, e1 = v2 - v1, e2 = v0 - v2;
+    glm::vec3 n = glm::cross(e0, e1);
+    float r = h.x * std::fabs(n.x) + h.y * std::fabs(n.y) + h.z * std::fabs(n.z);
+    if (std::fabs(glm::dot(n, v0)) > r)
+        return false;
+
+    // Produtos vetoriais entre as arestas e os eixos da caixa
+    const glm::vec3 edges[3] = { e0, e1, e2 };
+    for (int e = 0; e < 3; ++e)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            glm::vec3 axis = glm::vec3(0.0f);
+            axis[(a + 1) % 3] = -edges[e][(a + 2) % 3];
+            axis[(a + 2) % 3] = edges[e][(a + 1) % 3];
+            float p0 = glm::dot(v0, axis), p1 = glm::dot(v1, axis), p2 = glm::dot(v2, axis);
+            float radius = h.x * std::fabs(axis.x) + h.y * std::fabs(axis.y) + h.z * std::fabs(axis.z);
+            if (std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Ponto do triângulo mais próximo de "p" (Ericson, Real-Time Collision Detection)
+inline glm::vec3 MeshBVH_ClosestPoint(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Caixa alinhada aos eixos do modelo que envolve a caixa global
+// [center - half, center + half]
+inline void MeshBVH_ModelBox(const glm::mat4& inverse_model, glm::vec3 center, glm::vec3 half, glm::vec3& bbox_min, glm::vec3& bbox_max)
+{
+    glm::vec3 c = glm::vec3(inverse_model * glm::vec4(center, 1.0f));
+    glm::vec3 h;
+    for (int a = 0; a < 3; ++a)
+        h[a] = std::fabs(inverse_model[0][a]) * half.x + std::fabs(inverse_model[1][a]) * half.y + std::fabs(inverse_model[2][a]) * half.z;
+    bbox_min = c - h;
+    bbox_max = c + h;
+}
+
+inline bool MeshBVH_BoxNode(const MeshBVHNode& node, glm::vec3 bbox_min, glm::vec3 bbox_max)
+{
+    return node.bbox_min.x <= bbox_max.x && node.bbox_max.x >= bbox_min.x &&
+           node.bbox_min.y <= bbox_max.y && node.bbox_max.y >= bbox_min.y &&
+           node.bbox_min.z <= bbox_max.z && node.bbox_max.z >= bbox_min.z;
+}
+
+// Percorre os triângulos cujas folhas tocam a caixa [bbox_min, bbox_max]
+// (coordenadas do modelo) e chama visit(v0, v1, v2) com os vértices em
+// coordenadas globais. O percurso termina quando visit() retorna true.
+template <typename Visit>
+inline void MeshBVH_ForEachTriangle(const MeshBVH& bvh, const glm::mat4& model, glm::vec3 bbox_min, glm::vec3 bbox_max, Visit visit)
+{
+    int num_nodes = (int)bvh.nodes.size();
+    int i = 0;
+    while (i < num_nodes)
+    {
+        const MeshBVHNode& node = bvh.nodes[i];
+        if (!MeshBVH_BoxNode(node, bbox_min, bbox_max))
+        {
+            i = node.skip;
+            continue;
+        }
+        if (node.num_triangles == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        for (int k = node.first_triangle; k < node.first_triangle + node.num_triangles; ++k)
+        {
+            const MeshBVHTriangle& tri = bvh.triangles[k];
+            glm::vec3 v0 = glm::vec3(model * glm::vec4(tri.v0, 1.0f));
+            glm::vec3 v1 = glm::vec3(model * glm::vec4(tri.v0 + tri.e1, 1.0f));
+            glm::vec3 v2 = glm::vec3(model * glm::vec4(tri.v0 + tri.e2, 1.0f));
+            if (visit(v0, v1, v2))
+                return;
+        }
+        i = node.skip;
+    }
+}
+
+// Normal do triângulo virada contra "direction"
+inline glm::vec3 MeshBVH_FacingNormal(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 direction)
+{
+    glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+    float length = glm::length(n);
+    if (length == 0.0f)
+        return glm::vec3(0.0f);
+    n /= length;
+    return glm::dot(n, direction) > 0.0f ? -n : n;
+}
+
+// A esfera global toca algum triângulo da malha? Se "normal" não for NULL,
+// recebe a direção do ponto mais próximo da malha até o centro.
+inline bool MeshBVH_OverlapsSphere(const MeshBVH& bvh, const glm::mat4& model, const glm::mat4& inverse_model,
+                                   glm::vec3 center, float radius, glm::vec3* normal)
+{
+    glm::vec3 model_min, model_max;
+    MeshBVH_ModelBox(inverse_model, center, glm::vec3(radius), model_min, model_max);
+
+    bool hit = false;
+    float best = radius * radius;
+    MeshBVH_ForEachTriangle(bvh, model, model_min, model_max,
+        [&](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) -> bool {
+            glm::vec3 d = center - MeshBVH_ClosestPoint(center, v0, v1, v2);
+            float distance2 = glm::dot(d, d);
+            if (distance2 > best)
+                return false;
+            hit = true;
+            best = distance2;
+            if (normal == NULL)
+                return true;
+            *normal = distance2 > 0.0f ? d / std::sqrt(distance2) : MeshBVH_FacingNormal(v0, v1, v2, glm::vec3(0.0f));
+            return false;
+        });
+    return hit;
+}
+
+#endif // _MESH_BVH_H
@@ -0,0 +1,26 @@
+#ifndef _MESH_DATA_H
+#define _MESH_DATA_H
+
+// Cópia na CPU dos triângulos de um objeto de g_VirtualScene. Os buffers da
+// GPU não podem ser lidos de volta de forma eficiente, então
+// BuildTrianglesAndAddToVirtualScene() guarda aqui os vértices de cada
+// objeto para os algoritmos que precisam da geometria exata (por exemplo, o
+// "baker" de lightmaps em "lightmap.h" e os testes exatos de colisão, que
+// usam a BVH de "mesh_bvh.h").
+
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+#include "mesh_bvh.h"
+
+struct MeshData
+{
+    std::vector<glm::vec4> positions; // 3 vértices por triângulo, em coordenadas do modelo
+    std::vector<glm::vec4> normals;   // Normais dos vértices; vazio se o modelo não tem normais
+    MeshBVH                bvh;       // Construída a partir de "positions" ao carregar o modelo
+
+    int num_triangles() const { return (int)positions.size() / 3; }
+};
+
+#endif // _MESH_DATA_H
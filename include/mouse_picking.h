@@ -4,27 +4,23 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <map>
 
+#include "aabb_tree.h"
+#include "cpu_profiler.h"
 
-SceneObject *GetInteractableObject(std::vector<SceneObject*> &virtual_scene ,glm::vec4& camera_position_c, glm::vec4& camera_view_vector ){
-    SceneObject *interactableObject = NULL;
+#define INTERACTION_DISTANCE 1.0f
 
-    float minDistance = 10000;
-
-    int scene_size = virtual_scene.size();
-    for(int i = 0; i < scene_size; i++){
-        SceneObject *obj = virtual_scene[i];
+bool IsInspectable(SceneObject* obj){
+    return obj->is_inspectable();
+}
 
-        float distance;
+// Objeto inspecionável mais próximo na direção da câmera, a menos de
+// INTERACTION_DISTANCE. Usa a árvore de "aabb_tree.h", construída com
+// AABBTree_Build(); os objetos que se moveram são atualizados aqui.
+SceneObject *GetInteractableObject(glm::vec4& camera_position_c, glm::vec4& camera_view_vector){
+    PROFILE_FUNCTION();
+    AABBTree_Update();
 
-        if(obj->is_inspectable() && isRayBoudingBox(camera_view_vector,camera_position_c,*obj,distance)){
-           if(distance < minDistance){
-                minDistance = distance;
-                if(minDistance < 1 && minDistance > 0){
-                    interactableObject = obj;
-                }
-            }
-        }
-    }
-    return interactableObject;
+    float distance;
+    return AABBTree_RayCast(camera_position_c, camera_view_vector, INTERACTION_DISTANCE, IsInspectable, distance);
 }
 #endif
@@ -0,0 +1,129 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+// Pool de threads simples para dividir laços entre os núcleos da CPU.
+//
+// ParallelFor(n, f) chama f(0), f(1), ..., f(n-1), distribuindo as chamadas
+// entre as threads do pool e a thread que chamou ParallelFor(), e só retorna
+// quando todas terminaram. As chamadas podem executar em qualquer ordem, então
+// cada índice deve escrever somente em dados próprios. f() não deve chamar
+// ParallelFor() recursivamente.
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ParallelPool
+{
+public:
+    static ParallelPool& instance()
+    {
+        static ParallelPool pool;
+        return pool;
+    }
+
+    // Número de threads que executam trabalho, incluindo a que chama run()
+    int num_threads() const { return (int)workers.size() + 1; }
+
+    void run(int count, const std::function<void(int)>& body)
+    {
+        if (count <= 0)
+            return;
+
+        if (workers.empty() || count == 1)
+        {
+            for (int i = 0; i < count; ++i)
+                body(i);
+            return;
+        }
+
+        // Somente um laço paralelo por vez
+        std::lock_guard<std::mutex> run_lock(run_mutex);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        job = &body;
+        job_count = count;
+        next = 0;
+        pending = (int)workers.size();
+        ++generation;
+        lock.unlock();
+        wake.notify_all();
+
+        work();
+
+        lock.lock();
+        done.wait(lock, [this]{ return pending == 0; });
+        job = NULL;
+    }
+
+    ~ParallelPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+    }
+
+private:
+    ParallelPool()
+    {
+        unsigned int hardware_threads = std::thread::hardware_concurrency();
+        for (unsigned int i = 1; i < hardware_threads; ++i)
+            workers.push_back(std::thread(&ParallelPool::worker_loop, this));
+    }
+
+    ParallelPool(const ParallelPool&);
+    ParallelPool& operator=(const ParallelPool&);
+
+    void work()
+    {
+        int i;
+        while ((i = next.fetch_add(1)) < job_count)
+            (*job)(i);
+    }
+
+    void worker_loop()
+    {
+        unsigned int seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [&]{ return stop || generation != seen_generation; });
+            if (stop)
+                return;
+            seen_generation = generation;
+
+            lock.unlock();
+            work();
+            lock.lock();
+
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = NULL;
+    int job_count = 0;
+    std::atomic<int> next;
+    int pending = 0;
+    unsigned int generation = 0;
+    bool stop = false;
+};
+
+inline void ParallelFor(int count, const std::function<void(int)>& body)
+{
+    ParallelPool::instance().run(count, body);
+}
+
+#endif // _PARALLEL_H
@@ -0,0 +1,222 @@
+#ifndef _PROGRAM_CACHE_H
+#define _PROGRAM_CACHE_H
+
+// Cache em disco de programas de GPU já linkados, usando
+// glGetProgramBinary()/glProgramBinary() (OpenGL 4.1 ou
+// GL_ARB_get_program_binary), e compilação paralela de shaders com
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile.
+//
+// Como o GLAD deste projeto foi gerado somente para OpenGL 3.3, as funções e
+// constantes abaixo são carregadas manualmente por ProgramCache_Init().
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define PROGRAM_CACHE_DIR "shader_cache"
+#define PROGRAM_CACHE_MAGIC 0x42504346u // "FCPB"
+
+#define PROGRAM_CACHE_RETRIEVABLE_HINT 0x8257 // GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define PROGRAM_CACHE_BINARY_LENGTH    0x8741 // GL_PROGRAM_BINARY_LENGTH
+#define PROGRAM_CACHE_NUM_FORMATS      0x87FE // GL_NUM_PROGRAM_BINARY_FORMATS
+#define PROGRAM_CACHE_COMPLETION_STATUS 0x91B1 // GL_COMPLETION_STATUS_KHR (== _ARB)
+
+struct ProgramCacheApi
+{
+    bool binary_supported   = false;
+    bool parallel_supported = false;
+
+    void (APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufsize, GLsizei* length, GLenum* format, void* binary) = NULL;
+    void (APIENTRYP ProgramBinary)(GLuint program, GLenum format, const void* binary, GLsizei length) = NULL;
+    void (APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value) = NULL;
+    void (APIENTRYP MaxShaderCompilerThreads)(GLuint count) = NULL;
+
+    std::string renderer; // GL_RENDERER e GL_VERSION entram na chave do cache
+    std::string version;
+};
+
+ProgramCacheApi g_ProgramCache;
+
+// Deve ser chamada após gladLoadGLLoader(), com o contexto OpenGL ativo.
+void ProgramCache_Init()
+{
+    g_ProgramCache.renderer = (const char*)glGetString(GL_RENDERER);
+    g_ProgramCache.version  = (const char*)glGetString(GL_VERSION);
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool gl41 = major > 4 || (major == 4 && minor >= 1);
+
+    if ( gl41 || glfwExtensionSupported("GL_ARB_get_program_binary") )
+    {
+        g_ProgramCache.GetProgramBinary  = (void (APIENTRYP)(GLuint, GLsizei, GLsizei*, GLenum*, void*)) glfwGetProcAddress("glGetProgramBinary");
+        g_ProgramCache.ProgramBinary     = (void (APIENTRYP)(GLuint, GLenum, const void*, GLsizei)) glfwGetProcAddress("glProgramBinary");
+        g_ProgramCache.ProgramParameteri = (void (APIENTRYP)(GLuint, GLenum, GLint)) glfwGetProcAddress("glProgramParameteri");
+
+        // Alguns drivers expõem a extensão mas não suportam nenhum formato
+        GLint num_formats = 0;
+        glGetIntegerv(PROGRAM_CACHE_NUM_FORMATS, &num_formats);
+
+        g_ProgramCache.binary_supported = num_formats > 0 &&
+                                          g_ProgramCache.GetProgramBinary &&
+                                          g_ProgramCache.ProgramBinary &&
+                                          g_ProgramCache.ProgramParameteri;
+    }
+
+    if ( glfwExtensionSupported("GL_KHR_parallel_shader_compile") )
+        g_ProgramCache.MaxShaderCompilerThreads = (void (APIENTRYP)(GLuint)) glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if ( glfwExtensionSupported("GL_ARB_parallel_shader_compile") )
+        g_ProgramCache.MaxShaderCompilerThreads = (void (APIENTRYP)(GLuint)) glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+
+    if ( g_ProgramCache.MaxShaderCompilerThreads )
+    {
+        // 0xFFFFFFFF: o driver escolhe o número de threads
+        g_ProgramCache.MaxShaderCompilerThreads(0xFFFFFFFFu);
+        g_ProgramCache.parallel_supported = true;
+    }
+
+    if ( g_ProgramCache.binary_supported )
+    {
+#ifdef _WIN32
+        _mkdir(PROGRAM_CACHE_DIR);
+#else
+        mkdir(PROGRAM_CACHE_DIR, 0755);
+#endif
+    }
+
+    printf("Cache de programas: %s, compilação paralela: %s\n",
+           g_ProgramCache.binary_supported ? "sim" : "não",
+           g_ProgramCache.parallel_supported ? "sim" : "não");
+}
+
+// Hash FNV-1a de 64 bits
+unsigned long long ProgramCache_HashBytes(unsigned long long hash, const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Chave do cache: fontes dos shaders (que já contêm os #defines da
+// permutação), GL_RENDERER e GL_VERSION.
+unsigned long long ProgramCache_Key(const std::string& vertex_source, const std::string& fragment_source)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    const char separator = '\0';
+    hash = ProgramCache_HashBytes(hash, g_ProgramCache.renderer.data(), g_ProgramCache.renderer.size());
+    hash = ProgramCache_HashBytes(hash, &separator, 1);
+    hash = ProgramCache_HashBytes(hash, g_ProgramCache.version.data(), g_ProgramCache.version.size());
+    hash = ProgramCache_HashBytes(hash, &separator, 1);
+    hash = ProgramCache_HashBytes(hash, vertex_source.data(), vertex_source.size());
+    hash = ProgramCache_HashBytes(hash, &separator, 1);
+    hash = ProgramCache_HashBytes(hash, fragment_source.data(), fragment_source.size());
+    return hash;
+}
+
+std::string ProgramCache_Path(unsigned long long key)
+{
+    char path[64];
+    snprintf(path, sizeof(path), PROGRAM_CACHE_DIR "/%016llx.bin", key);
+    return path;
+}
+
+// Tenta restaurar o programa "program_id" a partir do cache. Retorna false
+// se não houver entrada para a chave ou se o driver rejeitar o binário (por
+// exemplo, após uma atualização de driver).
+bool ProgramCache_Load(unsigned long long key, GLuint program_id)
+{
+    if ( !g_ProgramCache.binary_supported )
+        return false;
+
+    FILE* file = fopen(ProgramCache_Path(key).c_str(), "rb");
+    if ( !file )
+        return false;
+
+    unsigned int header[3]; // magic, formato, tamanho
+    std::vector<char> binary;
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == PROGRAM_CACHE_MAGIC;
+    if ( ok )
+    {
+        binary.resize(header[2]);
+        ok = !binary.empty() && fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+
+    if ( !ok )
+        return false;
+
+    g_ProgramCache.ProgramBinary(program_id, (GLenum)header[1], binary.data(), (GLsizei)binary.size());
+
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+    return linked_ok == GL_TRUE;
+}
+
+// Deve ser chamada antes de glLinkProgram() para que o driver mantenha o binário
+void ProgramCache_MarkRetrievable(GLuint program_id)
+{
+    if ( g_ProgramCache.binary_supported )
+        g_ProgramCache.ProgramParameteri(program_id, PROGRAM_CACHE_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Salva um programa já linkado com sucesso no cache
+void ProgramCache_Store(unsigned long long key, GLuint program_id)
+{
+    if ( !g_ProgramCache.binary_supported )
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program_id, PROGRAM_CACHE_BINARY_LENGTH, &length);
+    if ( length <= 0 )
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    g_ProgramCache.GetProgramBinary(program_id, length, &length, &format, binary.data());
+
+    std::string path = ProgramCache_Path(key);
+    FILE* file = fopen(path.c_str(), "wb");
+    if ( !file )
+        return;
+
+    // Um arquivo incompleto seria rejeitado pelo carregamento e o programa
+    // seria recompilado a cada execução; melhor removê-lo
+    unsigned int header[3] = { PROGRAM_CACHE_MAGIC, (unsigned int)format, (unsigned int)length };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(binary.data(), 1, length, file) == (size_t)length;
+    ok = fclose(file) == 0 && ok;
+    if ( !ok )
+    {
+        fprintf(stderr, "ERROR: Cannot write to file \"%s\".\n", path.c_str());
+        remove(path.c_str());
+    }
+}
+
+// Retorna true se a compilação/linkagem do programa já terminou. Sem
+// compilação paralela, consultar o estado do programa bloqueia até o fim da
+// linkagem, então consideramos o programa sempre pronto.
+bool ProgramCache_IsLinkComplete(GLuint program_id)
+{
+    if ( !g_ProgramCache.parallel_supported )
+        return true;
+
+    GLint done = GL_FALSE;
+    glGetProgramiv(program_id, PROGRAM_CACHE_COMPLETION_STATUS, &done);
+    return done == GL_TRUE;
+}
+
+#endif // _PROGRAM_CACHE_H
@@ -0,0 +1,72 @@
+#ifndef _SHADING_LOD_H
+#define _SHADING_LOD_H
+
+// Nível de detalhe do sombreamento ("shading LOD").
+//
+// Objetos pequenos na tela não precisam de iluminação por fragmento: cada
+// classe de material tem, além do seu programa de GPU completo, um programa
+// simplificado (veja ShaderPermutation::Lod() em "materials.h") que calcula a
+// luz principal, sua sombra e as luzes pontuais por vértice, como no modelo
+// de Gouraud, e amostra uma única textura por fragmento.
+//
+// A escolha é feita a cada quadro por draw_objects() em "main.cpp", a partir
+// do tamanho projetado da bounding box do objeto. O objeto inspecionado é
+// sempre desenhado com o programa completo. A tecla L liga e desliga o LOD.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "matrices.h"
+
+struct ShadingLod
+{
+    bool  enabled = true;
+
+    // Objetos cuja esfera envolvente ocupa menos que esta fração da altura
+    // da tela usam o programa simplificado
+    float threshold = 0.08f;
+
+    // Objetos desenhados com cada programa no último quadro
+    int   num_full = 0;
+    int   num_lod = 0;
+};
+
+ShadingLod g_ShadingLod;
+
+void ShadingLod_Toggle()
+{
+    g_ShadingLod.enabled = !g_ShadingLod.enabled;
+    printf("LOD de sombreamento: %s\n", g_ShadingLod.enabled ? "ligado" : "desligado");
+}
+
+// Fração da altura da tela ocupada pela esfera que envolve a AABB
+// [bbox_min, bbox_max] (em coordenadas globais). Retorna 1 se a câmera está
+// dentro da esfera.
+float ShadingLod_ScreenSize(glm::vec4 bbox_min, glm::vec4 bbox_max, const glm::mat4& view, const glm::mat4& projection)
+{
+    glm::vec4 center = (bbox_min + bbox_max) / 2.0f;
+    center.w = 1.0f;
+    glm::vec4 diagonal = bbox_max - bbox_min;
+    diagonal.w = 0.0f;
+    float radius = norm(diagonal) / 2.0f;
+
+    // A câmera olha no sentido -z; projection[1][1] = ±1/tan(fov/2)
+    float depth = -(view * center).z;
+    if (depth <= radius)
+        return 1.0f;
+    return std::min(1.0f, radius * std::fabs(projection[1][1]) / depth);
+}
+
+// Decide se um objeto pode ser desenhado com o programa simplificado
+bool ShadingLod_Select(glm::vec4 bbox_min, glm::vec4 bbox_max, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (!g_ShadingLod.enabled)
+        return false;
+    return ShadingLod_ScreenSize(bbox_min, bbox_max, view, projection) < g_ShadingLod.threshold;
+}
+
+#endif // _SHADING_LOD_H
@@ -0,0 +1,235 @@
+#ifndef _SHADOWS_H
+#define _SHADOWS_H
+
+// Mapas de sombra da luz principal (direcional) com cache.
+//
+// Os objetos que projetam sombra são divididos em duas camadas, cada uma
+// com seu próprio mapa de profundidade:
+//
+//   - estática: móveis, paredes internas, etc. Renderizada uma única vez;
+//   - dinâmica: gavetas e peças de xadrez, que se movem durante o jogo.
+//
+// Cada camada só é renderizada novamente quando algum de seus objetos muda de
+// transformação (veja SceneObject::get_transform_version() em "types.h"). O
+// fragment shader amostra as duas camadas e combina os resultados: o ponto só
+// é iluminado se não estiver na sombra de nenhuma delas.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "matrices.h"
+
+// Funções definidas em main.cpp
+void DrawVirtualObject(const char* object_name);
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines);
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines);
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
+
+// "Texture units" dos mapas de sombra (veja também "lights.h")
+#define SHADOW_STATIC_TEXTURE_UNIT  22
+#define SHADOW_DYNAMIC_TEXTURE_UNIT 23
+#define SHADOW_STATIC_SIZE  2048
+#define SHADOW_DYNAMIC_SIZE 1024
+
+struct ShadowLayer
+{
+    GLuint framebuffer = 0;
+    GLuint texture = 0;
+    int    size = 0;
+    std::vector<SceneObject*>  casters;
+    std::vector<unsigned int>  versions; // transform_version de cada caster na última renderização
+    bool   dirty = true;
+    int    renders = 0; // Número de vezes que a camada foi renderizada
+};
+
+struct ShadowMaps
+{
+    ShadowLayer static_layer;
+    ShadowLayer dynamic_layer;
+    glm::mat4 light_view;
+    glm::mat4 light_projection;
+
+    // Programa de GPU que escreve somente profundidade
+    GLuint program = 0;
+    GLint  model_uniform;
+    GLint  view_uniform;
+    GLint  projection_uniform;
+};
+
+ShadowMaps g_Shadows;
+
+void Shadows_CreateLayer(ShadowLayer& layer, int size)
+{
+    layer.size = size;
+
+    glGenTextures(1, &layer.texture);
+    glBindTexture(GL_TEXTURE_2D, layer.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+    // Comparação de profundidade feita pelo hardware (sampler2DShadow), com
+    // filtragem bilinear dos resultados
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // Fora do mapa, nada projeta sombra
+    float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+
+    glGenFramebuffers(1, &layer.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, layer.texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "ERROR: Shadow map framebuffer is incomplete.\n");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Cria os mapas de sombra para a luz direcional que vem do sentido
+// "light_direction" (apontando para a luz), cobrindo a caixa
+// [scene_min, scene_max] em coordenadas globais.
+void Shadows_Init(glm::vec4 light_direction, glm::vec4 scene_min, glm::vec4 scene_max)
+{
+    Shadows_CreateLayer(g_Shadows.static_layer, SHADOW_STATIC_SIZE);
+    Shadows_CreateLayer(g_Shadows.dynamic_layer, SHADOW_DYNAMIC_SIZE);
+
+    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_depth_vertex.glsl", "");
+    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_depth_fragment.glsl", "");
+    g_Shadows.program = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    g_Shadows.model_uniform      = glGetUniformLocation(g_Shadows.program, "model");
+    g_Shadows.view_uniform       = glGetUniformLocation(g_Shadows.program, "view");
+    g_Shadows.projection_uniform = glGetUniformLocation(g_Shadows.program, "projection");
+
+    // "Câmera" da luz: posicionada fora da cena, olhando no sentido da luz
+    light_direction.w = 0.0f;
+    light_direction = light_direction / norm(light_direction);
+    glm::vec4 center = (scene_min + scene_max) / 2.0f;
+    center.w = 1.0f;
+    g_Shadows.light_view = Matrix_Camera_View(center + light_direction * 50.0f, -light_direction, glm::vec4(0.0f,1.0f,0.0f,0.0f));
+
+    // A projeção ortográfica envolve os 8 cantos da cena vistos pela luz
+    glm::vec4 lmin = glm::vec4( 1e30f,  1e30f,  1e30f, 1.0f);
+    glm::vec4 lmax = glm::vec4(-1e30f, -1e30f, -1e30f, 1.0f);
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec4 corner = glm::vec4(i & 1 ? scene_max.x : scene_min.x,
+                                     i & 2 ? scene_max.y : scene_min.y,
+                                     i & 4 ? scene_max.z : scene_min.z, 1.0f);
+        glm::vec4 p = g_Shadows.light_view * corner;
+        lmin = glm::min(lmin, p);
+        lmax = glm::max(lmax, p);
+    }
+    g_Shadows.light_projection = Matrix_Orthographic(lmin.x, lmax.x, lmin.y, lmax.y, lmax.z, lmin.z);
+}
+
+// Define quais objetos projetam sombra em cada camada. Ambas são marcadas
+// para serem renderizadas novamente.
+void Shadows_SetCasters(const std::vector<SceneObject*>& static_casters,
+                        const std::vector<SceneObject*>& dynamic_casters)
+{
+    g_Shadows.static_layer.casters = static_casters;
+    g_Shadows.static_layer.versions.assign(static_casters.size(), 0);
+    g_Shadows.static_layer.dirty = true;
+
+    g_Shadows.dynamic_layer.casters = dynamic_casters;
+    g_Shadows.dynamic_layer.versions.assign(dynamic_casters.size(), 0);
+    g_Shadows.dynamic_layer.dirty = true;
+}
+
+// Verifica se algum caster da camada mudou desde a última renderização
+bool Shadows_CheckDirty(ShadowLayer& layer)
+{
+    for (size_t i = 0; i < layer.casters.size(); ++i)
+    {
+        unsigned int version = layer.casters[i]->get_transform_version();
+        if (version != layer.versions[i])
+        {
+            layer.versions[i] = version;
+            layer.dirty = true;
+        }
+    }
+    return layer.dirty;
+}
+
+void Shadows_RenderLayer(ShadowLayer& layer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffer);
+    glViewport(0, 0, layer.size, layer.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    for (size_t i = 0; i < layer.casters.size(); ++i)
+    {
+        SceneObject* caster = layer.casters[i];
+        glUniformMatrix4fv(g_Shadows.model_uniform, 1, GL_FALSE, glm::value_ptr(caster->get_model()));
+        DrawVirtualObject(caster->get_model_name().c_str());
+    }
+
+    layer.dirty = false;
+    ++layer.renders;
+}
+
+// Renderiza novamente as camadas cujos casters mudaram. Altera o programa de
+// GPU ativo; o framebuffer e o viewport anteriores são restaurados.
+void Shadows_Update()
+{
+    bool static_dirty = Shadows_CheckDirty(g_Shadows.static_layer);
+    bool dynamic_dirty = Shadows_CheckDirty(g_Shadows.dynamic_layer);
+    if (!static_dirty && !dynamic_dirty)
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glUseProgram(g_Shadows.program);
+    glUniformMatrix4fv(g_Shadows.view_uniform, 1, GL_FALSE, glm::value_ptr(g_Shadows.light_view));
+    glUniformMatrix4fv(g_Shadows.projection_uniform, 1, GL_FALSE, glm::value_ptr(g_Shadows.light_projection));
+
+    // Os modelos não são necessariamente fechados, então desenhamos as duas
+    // faces dos triângulos. O "polygon offset" evita "shadow acne".
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    if (static_dirty)
+        Shadows_RenderLayer(g_Shadows.static_layer);
+    if (dynamic_dirty)
+        Shadows_RenderLayer(g_Shadows.dynamic_layer);
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_CULL_FACE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void Shadows_BindTextures()
+{
+    glActiveTexture(GL_TEXTURE0 + SHADOW_STATIC_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, g_Shadows.static_layer.texture);
+    glActiveTexture(GL_TEXTURE0 + SHADOW_DYNAMIC_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, g_Shadows.dynamic_layer.texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Matriz que leva coordenadas globais para as coordenadas dos mapas de sombra
+glm::mat4 Shadows_Matrix()
+{
+    return g_Shadows.light_projection * g_Shadows.light_view;
+}
+
+#endif // _SHADOWS_H
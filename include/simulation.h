@@ -0,0 +1,84 @@
+#ifndef _SIMULATION_H
+#define _SIMULATION_H
+
+// Simulação em passo de tempo fixo, independente da taxa de quadros.
+//
+// O movimento do jogador, as gavetas, as animações de Bézier e a animação
+// final são integrados sempre com SIMULATION_DT segundos ("ticks"). A cada
+// quadro, o tempo real decorrido é somado a um acumulador e são executados
+// tantos ticks quanto couberem nele; a fração que sobra (alpha) interpola a
+// câmera e as matrizes "model" entre o penúltimo e o último tick, de modo que
+// a imagem não treme quando a taxa de quadros não é múltipla de SIMULATION_HZ.
+//
+// Um quadro muito longo (janela arrastada, depurador, carregamento) é
+// limitado a SIMULATION_MAX_FRAME_TIME: o tempo excedente é descartado em vez
+// de gerar cada vez mais ticks por quadro ("espiral da morte").
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#define SIMULATION_HZ             120
+#define SIMULATION_DT             (1.0f / SIMULATION_HZ)
+#define SIMULATION_MAX_FRAME_TIME 0.1f // Segundos de simulação por quadro, no máximo
+
+struct FixedTimestep
+{
+    double previous_time = 0.0;
+    float  accumulator = 0.0f;
+    float  alpha = 0.0f;   // Fração de tick entre o estado anterior e o atual
+    float  dropped = 0.0f; // Tempo descartado por quadros longos, em segundos
+};
+
+FixedTimestep g_FixedTimestep;
+
+// O primeiro quadro depois de FixedTimestep_Reset() sempre executa um tick,
+// que define o estado inicial da câmera
+void FixedTimestep_Reset(double now)
+{
+    g_FixedTimestep.previous_time = now;
+    g_FixedTimestep.accumulator = SIMULATION_DT;
+    g_FixedTimestep.alpha = 0.0f;
+}
+
+// Avança o relógio até "now" (em segundos, glfwGetTime()) e retorna quantos
+// ticks devem ser executados neste quadro
+int FixedTimestep_Advance(double now)
+{
+    float frame_time = (float)(now - g_FixedTimestep.previous_time);
+    g_FixedTimestep.previous_time = now;
+    if (frame_time > SIMULATION_MAX_FRAME_TIME)
+    {
+        g_FixedTimestep.dropped += frame_time - SIMULATION_MAX_FRAME_TIME;
+        frame_time = SIMULATION_MAX_FRAME_TIME;
+    }
+    g_FixedTimestep.accumulator += std::max(frame_time, 0.0f);
+
+    int steps = (int)(g_FixedTimestep.accumulator / SIMULATION_DT);
+    g_FixedTimestep.accumulator -= steps * SIMULATION_DT;
+    g_FixedTimestep.alpha = std::min(g_FixedTimestep.accumulator / SIMULATION_DT, 1.0f);
+    return steps;
+}
+
+// Guarda o estado atual dos objetos como o "anterior", antes de um tick
+void Simulation_BeginTick(const std::vector<SceneObject*>& objects)
+{
+    for (size_t i = 0; i < objects.size(); ++i)
+        objects[i]->begin_tick();
+}
+
+// Calcula as matrizes usadas na renderização deste quadro
+void Simulation_Interpolate(const std::vector<SceneObject*>& objects, float alpha)
+{
+    for (size_t i = 0; i < objects.size(); ++i)
+        objects[i]->interpolate(alpha);
+}
+
+glm::vec4 Simulation_Lerp(const glm::vec4& previous, const glm::vec4& current, float alpha)
+{
+    return previous + (current - previous) * alpha;
+}
+
+#endif // _SIMULATION_H
@@ -0,0 +1,230 @@
+#ifndef _SPLINE_H
+#define _SPLINE_H
+
+// Curvas de Bézier para os caminhos de câmera das animações.
+//
+// Spline_Build() converte os pontos de controle uma única vez para a base de
+// potências, p(t) = c0 + c1 t + c2 t^2 + ..., de modo que cada avaliação é um
+// esquema de Horner sem cópias nem alocações (de Casteljau refaz O(n^2)
+// interpolações a cada ponto). Também é montada uma tabela com o comprimento
+// do arco acumulado em SPLINE_ARC_SAMPLES valores de t, usada para percorrer
+// a curva com velocidade constante: Spline_ParameterAt() converte uma
+// distância ao longo da curva no t correspondente.
+//
+// Spline_EvaluateBatch() avalia várias curvas de uma vez, quatro por
+// registrador SSE, cada uma no seu próprio t. Um CameraPath tem curvas
+// separadas para a posição da câmera e para o ponto para onde ela olha, cada
+// uma com a sua duração.
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SPLINE_MAX_POINTS 8     // Grau máximo + 1
+#define SPLINE_ARC_SAMPLES 64   // Intervalos da tabela de comprimento do arco
+
+struct Spline
+{
+    int       degree;
+    glm::vec3 coefficients[SPLINE_MAX_POINTS]; // Base de potências; zero acima do grau
+    float     arc_length[SPLINE_ARC_SAMPLES + 1]; // Comprimento de t = 0 até t = i / SPLINE_ARC_SAMPLES
+    float     length;
+};
+
+// Ponto da curva em t (Horner)
+inline glm::vec3 Spline_Point(const Spline& spline, float t)
+{
+    glm::vec3 p = spline.coefficients[spline.degree];
+    for (int k = spline.degree - 1; k >= 0; --k)
+        p = p * t + spline.coefficients[k];
+    return p;
+}
+
+// Derivada dp/dt em t
+inline glm::vec3 Spline_Derivative(const Spline& spline, float t)
+{
+    if (spline.degree == 0)
+        return glm::vec3(0.0f);
+    glm::vec3 d = spline.coefficients[spline.degree] * (float)spline.degree;
+    for (int k = spline.degree - 1; k >= 1; --k)
+        d = d * t + spline.coefficients[k] * (float)k;
+    return d;
+}
+
+// Comprimento da curva entre t0 e t1 (Gauss-Legendre com 4 pontos)
+inline float Spline_ArcLength(const Spline& spline, float t0, float t1)
+{
+    static const float nodes[4]   = { -0.861136312f, -0.339981044f, 0.339981044f, 0.861136312f };
+    static const float weights[4] = {  0.347854845f,  0.652145155f, 0.652145155f, 0.347854845f };
+    float half = 0.5f * (t1 - t0);
+    float middle = 0.5f * (t1 + t0);
+    float length = 0.0f;
+    for (int i = 0; i < 4; ++i)
+        length += weights[i] * glm::length(Spline_Derivative(spline, middle + half * nodes[i]));
+    return length * half;
+}
+
+// Curva de Bézier com os "count" pontos de controle (até SPLINE_MAX_POINTS)
+inline void Spline_Build(Spline& spline, const glm::vec3* points, int count)
+{
+    count = std::max(1, std::min(count, SPLINE_MAX_POINTS));
+    int n = count - 1;
+    spline.degree = n;
+
+    // c_k = C(n,k) * soma_{i<=k} (-1)^(k-i) C(k,i) P_i
+    float binomial_n = 1.0f; // C(n,k)
+    for (int k = 0; k < SPLINE_MAX_POINTS; ++k)
+    {
+        glm::vec3 c = glm::vec3(0.0f);
+        if (k <= n)
+        {
+            float binomial_k = 1.0f; // C(k,i)
+            for (int i = 0; i <= k; ++i)
+            {
+                float sign = ((k - i) % 2 == 0) ? 1.0f : -1.0f;
+                c += sign * binomial_k * points[i];
+                binomial_k = binomial_k * (float)(k - i) / (float)(i + 1);
+            }
+            c *= binomial_n;
+            binomial_n = binomial_n * (float)(n - k) / (float)(k + 1);
+        }
+        spline.coefficients[k] = c;
+    }
+
+    spline.arc_length[0] = 0.0f;
+    for (int i = 0; i < SPLINE_ARC_SAMPLES; ++i)
+    {
+        float t0 = (float)i / SPLINE_ARC_SAMPLES;
+        float t1 = (float)(i + 1) / SPLINE_ARC_SAMPLES;
+        spline.arc_length[i + 1] = spline.arc_length[i] + Spline_ArcLength(spline, t0, t1);
+    }
+    spline.length = spline.arc_length[SPLINE_ARC_SAMPLES];
+}
+
+// Parâmetro t do ponto a uma distância "distance" do início, medida ao longo
+// da curva. A tabela é percorrida por busca binária e interpolada
+// linearmente dentro do intervalo; um passo do método de Newton corrige o
+// erro da interpolação.
+inline float Spline_ParameterAt(const Spline& spline, float distance)
+{
+    if (distance <= 0.0f || spline.length <= 0.0f)
+        return 0.0f;
+    if (distance >= spline.length)
+        return 1.0f;
+
+    const float* begin = spline.arc_length;
+    const float* end = spline.arc_length + SPLINE_ARC_SAMPLES + 1;
+    int i = (int)(std::upper_bound(begin, end, distance) - begin) - 1;
+    i = std::min(i, SPLINE_ARC_SAMPLES - 1);
+    float segment = spline.arc_length[i + 1] - spline.arc_length[i];
+    float f = segment > 0.0f ? (distance - spline.arc_length[i]) / segment : 0.0f;
+
+    float t0 = (float)i / SPLINE_ARC_SAMPLES;
+    float t1 = (float)(i + 1) / SPLINE_ARC_SAMPLES;
+    float t = t0 + f * (t1 - t0);
+    float speed = glm::length(Spline_Derivative(spline, t));
+    if (speed > 0.0f)
+    {
+        float error = spline.arc_length[i] + Spline_ArcLength(spline, t0, t) - distance;
+        t = std::max(t0, std::min(t1, t - error / speed));
+    }
+    return t;
+}
+
+inline glm::vec3 Spline_PointAt(const Spline& spline, float distance)
+{
+    return Spline_Point(spline, Spline_ParameterAt(spline, distance));
+}
+
+// Avalia splines[i] em t[i] para i em [0, count), colocando o ponto em
+// points[i]. Quatro curvas por vez, uma em cada elemento de um registrador
+// SSE; as curvas de grau menor têm coeficientes nulos acima do grau, e um
+// último grupo incompleto repete a última curva nos elementos que sobram.
+inline void Spline_EvaluateBatch(const Spline* const* splines, const float* t, glm::vec3* points, int count)
+{
+#if defined(__SSE2__)
+    for (int i = 0; i < count; i += 4)
+    {
+        int lanes = std::min(count - i, 4);
+        const Spline* s[4];
+        float ts[4];
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            s[lane] = splines[i + std::min(lane, lanes - 1)];
+            ts[lane] = t[i + std::min(lane, lanes - 1)];
+        }
+        int degree = std::max(std::max(s[0]->degree, s[1]->degree), std::max(s[2]->degree, s[3]->degree));
+
+        __m128 tt = _mm_loadu_ps(ts);
+        __m128 x = _mm_set_ps(s[3]->coefficients[degree].x, s[2]->coefficients[degree].x, s[1]->coefficients[degree].x, s[0]->coefficients[degree].x);
+        __m128 y = _mm_set_ps(s[3]->coefficients[degree].y, s[2]->coefficients[degree].y, s[1]->coefficients[degree].y, s[0]->coefficients[degree].y);
+        __m128 z = _mm_set_ps(s[3]->coefficients[degree].z, s[2]->coefficients[degree].z, s[1]->coefficients[degree].z, s[0]->coefficients[degree].z);
+        for (int k = degree - 1; k >= 0; --k)
+        {
+            x = _mm_add_ps(_mm_mul_ps(x, tt), _mm_set_ps(s[3]->coefficients[k].x, s[2]->coefficients[k].x, s[1]->coefficients[k].x, s[0]->coefficients[k].x));
+            y = _mm_add_ps(_mm_mul_ps(y, tt), _mm_set_ps(s[3]->coefficients[k].y, s[2]->coefficients[k].y, s[1]->coefficients[k].y, s[0]->coefficients[k].y));
+            z = _mm_add_ps(_mm_mul_ps(z, tt), _mm_set_ps(s[3]->coefficients[k].z, s[2]->coefficients[k].z, s[1]->coefficients[k].z, s[0]->coefficients[k].z));
+        }
+
+        float px[4], py[4], pz[4];
+        _mm_storeu_ps(px, x);
+        _mm_storeu_ps(py, y);
+        _mm_storeu_ps(pz, z);
+        for (int lane = 0; lane < lanes; ++lane)
+            points[i + lane] = glm::vec3(px[lane], py[lane], pz[lane]);
+    }
+#else
+    for (int i = 0; i < count; ++i)
+        points[i] = Spline_Point(*splines[i], t[i]);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Caminhos de câmera
+
+struct CameraPath
+{
+    Spline position;
+    Spline look_at;
+    float  position_duration; // Segundos para percorrer cada curva
+    float  look_at_duration;
+};
+
+inline void CameraPath_Build(CameraPath& path,
+                             const glm::vec3* position_points, int position_count, float position_duration,
+                             const glm::vec3* look_at_points, int look_at_count, float look_at_duration)
+{
+    Spline_Build(path.position, position_points, position_count);
+    Spline_Build(path.look_at, look_at_points, look_at_count);
+    path.position_duration = position_duration;
+    path.look_at_duration = look_at_duration;
+}
+
+inline float CameraPath_Duration(const CameraPath& path)
+{
+    return std::max(path.position_duration, path.look_at_duration);
+}
+
+// Posição da câmera e ponto observado "time" segundos após o início. As duas
+// curvas são percorridas com velocidade constante e param no ponto final.
+inline void CameraPath_Sample(const CameraPath& path, float time, glm::vec3& position, glm::vec3& look_at)
+{
+    float position_progress = path.position_duration > 0.0f ? std::min(time / path.position_duration, 1.0f) : 1.0f;
+    float look_at_progress = path.look_at_duration > 0.0f ? std::min(time / path.look_at_duration, 1.0f) : 1.0f;
+
+    const Spline* splines[2] = { &path.position, &path.look_at };
+    float t[2] = { Spline_ParameterAt(path.position, position_progress * path.position.length),
+                   Spline_ParameterAt(path.look_at, look_at_progress * path.look_at.length) };
+    glm::vec3 points[2];
+    Spline_EvaluateBatch(splines, t, points, 2);
+    position = points[0];
+    look_at = points[1];
+}
+
+#endif // _SPLINE_H
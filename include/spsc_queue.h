@@ -0,0 +1,52 @@
+#ifndef _SPSC_QUEUE_H
+#define _SPSC_QUEUE_H
+
+// Fila circular sem travas para exatamente uma thread produtora e uma
+// consumidora. O produtor só escreve "tail" e o consumidor só escreve "head";
+// cada um lê o índice do outro com memory_order_acquire, o que garante que o
+// elemento já foi escrito (ou lido) antes de o índice mudar.
+//
+// Usada para levar os eventos de entrada da GLFW, recebidos na thread
+// principal, até a thread de simulação. Veja "frame_packet.h".
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscQueue
+{
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Chamada somente pelo produtor. Retorna false se a fila está cheia.
+    bool push(const T& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        items[t % N] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Chamada somente pelo consumidor. Retorna false se a fila está vazia.
+    bool pop(T& value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = items[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+
+    // Em linhas de cache separadas, para que produtor e consumidor não
+    // disputem a mesma linha a cada operação
+    alignas(64) std::atomic<size_t> head; // Próximo elemento a ser lido
+    alignas(64) std::atomic<size_t> tail; // Próximo espaço a ser escrito
+};
+
+#endif // _SPSC_QUEUE_H
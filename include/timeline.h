@@ -0,0 +1,414 @@
+#ifndef _TIMELINE_H
+#define _TIMELINE_H
+
+// Linha do tempo de animações por quadros-chave.
+//
+// Uma Timeline é lida de um arquivo de texto (Timeline_Load) e tem trilhas
+// de quadros-chave de translação (posição) e de rotação (quatérnios,
+// relativos à orientação do objeto na carga), além de eventos que chamam
+// funções registradas pelo jogo. Os nomes dos objetos e das funções são
+// resolvidos uma única vez, na carga, para índices em "targets" e
+// "callbacks"; nada é procurado por nome durante a animação.
+//
+// Os quadros-chave de todas as trilhas ficam contíguos em "key_times" e
+// "key_values", e Timeline_Evaluate() interpola todas as trilhas ativas num
+// único laço (primeiro as de translação, depois as de rotação, já ordenadas
+// na carga), guardando o resultado em "values"; só então os objetos são
+// atualizados. Cada trilha mantém o índice do segmento atual, que só avança
+// enquanto o tempo avança.
+//
+// Formato do arquivo (linhas vazias e o que vem depois de '#' são ignorados):
+//
+//   translation <objeto> [linear|smooth]
+//   rotation <objeto> [linear|smooth]
+//   key <tempo> <x y z>        (translação)
+//   key <tempo> <w x y z>      (rotação)
+//   key <tempo> @              posição/orientação do objeto quando a trilha começa
+//   key <tempo> @<objeto>      posição de outro objeto quando a trilha começa
+//   event <tempo> <função> [objeto]
+//
+// As linhas "key" pertencem à última trilha declarada, em ordem crescente de
+// tempo. Uma trilha começa no tempo da sua primeira chave e, depois da
+// última, deixa o objeto no valor final.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+typedef void (*TimelineCallback)(SceneObject* target); // target pode ser NULL
+
+enum TimelineTrackType
+{
+    TIMELINE_TRANSLATION,
+    TIMELINE_ROTATION
+};
+
+enum TimelineKeySource
+{
+    TIMELINE_KEY_VALUE,   // Valor do arquivo
+    TIMELINE_KEY_SELF,    // "@": valor do próprio objeto
+    TIMELINE_KEY_OBJECT   // "@objeto": posição de outro objeto
+};
+
+enum TimelineTrackState
+{
+    TIMELINE_WAITING,
+    TIMELINE_ACTIVE,
+    TIMELINE_DONE
+};
+
+struct TimelineTrack
+{
+    TimelineTrackType type;
+    int  target;      // Índice em Timeline::targets
+    bool smooth;      // Suaviza a entrada e a saída de cada segmento
+    int  first_key;   // Chaves em [first_key, first_key + num_keys)
+    int  num_keys;
+    int  segment;     // Chave no início do segmento atual
+    TimelineTrackState state;
+};
+
+struct TimelineEvent
+{
+    float time;
+    int   callback;   // Índice em Timeline::callbacks
+    int   target;     // Índice em Timeline::targets, ou -1
+};
+
+struct Timeline
+{
+    std::vector<SceneObject*>     targets;
+    std::vector<glm::mat4>        bind_models;      // "model" de cada alvo na carga
+    std::vector<TimelineCallback> callbacks;
+
+    std::vector<TimelineTrack>     tracks;          // Translação antes de rotação
+    std::vector<float>             key_times;
+    std::vector<glm::vec4>         key_values;      // (x,y,z,1) ou quatérnio (x,y,z,w)
+    std::vector<TimelineKeySource> key_sources;
+    std::vector<int>               key_objects;     // Alvo de TIMELINE_KEY_OBJECT
+    std::vector<TimelineEvent>     events;          // Em ordem de tempo
+
+    std::vector<int>       active;                  // Trilhas ativas neste passo
+    std::vector<glm::vec4> values;                  // Resultado de cada trilha ativa
+    int   num_active_translations;
+    int   next_event;
+    float time;
+    float duration;
+};
+
+// Índice do objeto "name" em timeline.targets, adicionando-o na primeira vez
+inline int Timeline_BindTarget(Timeline& timeline, const std::string& name, const std::vector<SceneObject*>& objects)
+{
+    for (size_t i = 0; i < timeline.targets.size(); ++i)
+        if (timeline.targets[i]->get_name() == name)
+            return (int)i;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (objects[i]->get_name() == name)
+        {
+            timeline.targets.push_back(objects[i]);
+            timeline.bind_models.push_back(objects[i]->get_model());
+            return (int)timeline.targets.size() - 1;
+        }
+    }
+    throw std::runtime_error("Objeto \"" + name + "\" da animação não encontrado.");
+}
+
+// Volta ao início, sem alterar os objetos
+inline void Timeline_Reset(Timeline& timeline)
+{
+    for (size_t i = 0; i < timeline.tracks.size(); ++i)
+    {
+        timeline.tracks[i].segment = timeline.tracks[i].first_key;
+        timeline.tracks[i].state = TIMELINE_WAITING;
+    }
+    timeline.next_event = 0;
+    timeline.time = 0.0f;
+}
+
+// Lê a animação do arquivo "filename". Os objetos citados são procurados em
+// "objects" e as funções dos eventos em "callbacks".
+inline void Timeline_Load(Timeline& timeline, const char* filename,
+                          const std::vector<SceneObject*>& objects,
+                          const std::map<std::string, TimelineCallback>& callbacks)
+{
+    printf("Carregando animação \"%s\"... ", filename);
+
+    std::ifstream file(filename);
+    if (!file)
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Trilhas e chaves na ordem do arquivo; reordenadas por tipo no final
+    struct TrackKeys
+    {
+        TimelineTrack track;
+        std::vector<float> times;
+        std::vector<glm::vec4> values;
+        std::vector<TimelineKeySource> sources;
+        std::vector<int> objects;
+    };
+    std::vector<TrackKeys> parsed;
+    std::vector<std::string> callback_names;
+
+    timeline = Timeline();
+    timeline.duration = 0.0f;
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command))
+            continue;
+
+        std::ostringstream where;
+        where << filename << ":" << line_number << ": ";
+
+        if (command == "translation" || command == "rotation")
+        {
+            std::string name, interpolation;
+            if (!(words >> name))
+                throw std::runtime_error(where.str() + "falta o nome do objeto.");
+            words >> interpolation;
+
+            TrackKeys keys;
+            keys.track.type = command == "translation" ? TIMELINE_TRANSLATION : TIMELINE_ROTATION;
+            keys.track.target = Timeline_BindTarget(timeline, name, objects);
+            keys.track.smooth = interpolation == "smooth";
+            parsed.push_back(keys);
+        }
+        else if (command == "key")
+        {
+            if (parsed.empty())
+                throw std::runtime_error(where.str() + "\"key\" antes de uma trilha.");
+            TrackKeys& keys = parsed.back();
+
+            float time;
+            std::string first;
+            if (!(words >> time >> first))
+                throw std::runtime_error(where.str() + "chave incompleta.");
+            if (!keys.times.empty() && time <= keys.times.back())
+                throw std::runtime_error(where.str() + "chaves fora de ordem.");
+
+            glm::vec4 value = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            TimelineKeySource source = TIMELINE_KEY_VALUE;
+            int object = -1;
+            if (first == "@")
+                source = TIMELINE_KEY_SELF;
+            else if (first[0] == '@')
+            {
+                if (keys.track.type != TIMELINE_TRANSLATION)
+                    throw std::runtime_error(where.str() + "\"@objeto\" só vale para translação.");
+                source = TIMELINE_KEY_OBJECT;
+                object = Timeline_BindTarget(timeline, first.substr(1), objects);
+            }
+            else
+            {
+                float v[4] = { (float)atof(first.c_str()), 0.0f, 0.0f, 0.0f };
+                int count = keys.track.type == TIMELINE_TRANSLATION ? 3 : 4;
+                for (int i = 1; i < count; ++i)
+                    if (!(words >> v[i]))
+                        throw std::runtime_error(where.str() + "valor incompleto.");
+                if (keys.track.type == TIMELINE_TRANSLATION)
+                    value = glm::vec4(v[0], v[1], v[2], 1.0f);
+                else
+                {
+                    // Arquivo em (w, x, y, z)
+                    glm::quat q = glm::normalize(glm::quat(v[0], v[1], v[2], v[3]));
+                    value = glm::vec4(q.x, q.y, q.z, q.w);
+                }
+            }
+            keys.times.push_back(time);
+            keys.values.push_back(value);
+            keys.sources.push_back(source);
+            keys.objects.push_back(object);
+            timeline.duration = std::max(timeline.duration, time);
+        }
+        else if (command == "event")
+        {
+            TimelineEvent event;
+            std::string function, name;
+            if (!(words >> event.time >> function))
+                throw std::runtime_error(where.str() + "evento incompleto.");
+            std::map<std::string, TimelineCallback>::const_iterator it = callbacks.find(function);
+            if (it == callbacks.end())
+                throw std::runtime_error(where.str() + "função \"" + function + "\" desconhecida.");
+
+            event.callback = -1;
+            for (size_t i = 0; i < callback_names.size(); ++i)
+                if (callback_names[i] == function)
+                    event.callback = (int)i;
+            if (event.callback < 0)
+            {
+                event.callback = (int)timeline.callbacks.size();
+                callback_names.push_back(function);
+                timeline.callbacks.push_back(it->second);
+            }
+            event.target = (words >> name) ? Timeline_BindTarget(timeline, name, objects) : -1;
+
+            // Eventos no mesmo tempo disparam na ordem do arquivo
+            size_t position = timeline.events.size();
+            while (position > 0 && timeline.events[position - 1].time > event.time)
+                --position;
+            timeline.events.insert(timeline.events.begin() + position, event);
+            timeline.duration = std::max(timeline.duration, event.time);
+        }
+        else
+            throw std::runtime_error(where.str() + "comando \"" + command + "\" desconhecido.");
+    }
+
+    for (int type = TIMELINE_TRANSLATION; type <= TIMELINE_ROTATION; ++type)
+    {
+        for (size_t i = 0; i < parsed.size(); ++i)
+        {
+            TrackKeys& keys = parsed[i];
+            if (keys.track.type != type || keys.times.empty())
+                continue;
+            keys.track.first_key = (int)timeline.key_times.size();
+            keys.track.num_keys = (int)keys.times.size();
+            timeline.tracks.push_back(keys.track);
+            timeline.key_times.insert(timeline.key_times.end(), keys.times.begin(), keys.times.end());
+            timeline.key_values.insert(timeline.key_values.end(), keys.values.begin(), keys.values.end());
+            timeline.key_sources.insert(timeline.key_sources.end(), keys.sources.begin(), keys.sources.end());
+            timeline.key_objects.insert(timeline.key_objects.end(), keys.objects.begin(), keys.objects.end());
+        }
+    }
+    timeline.active.reserve(timeline.tracks.size());
+    timeline.values.resize(timeline.tracks.size());
+    Timeline_Reset(timeline);
+
+    printf("OK (%d trilhas, %d chaves, %d eventos, %.1f s).\n",
+           (int)timeline.tracks.size(), (int)timeline.key_times.size(),
+           (int)timeline.events.size(), timeline.duration);
+}
+
+// Resolve as chaves "@" de uma trilha que está começando
+inline void Timeline_StartTrack(Timeline& timeline, TimelineTrack& track)
+{
+    SceneObject* target = timeline.targets[track.target];
+    for (int k = track.first_key; k < track.first_key + track.num_keys; ++k)
+    {
+        if (timeline.key_sources[k] == TIMELINE_KEY_OBJECT)
+            timeline.key_values[k] = timeline.targets[timeline.key_objects[k]]->get_position();
+        else if (timeline.key_sources[k] == TIMELINE_KEY_SELF && track.type == TIMELINE_TRANSLATION)
+            timeline.key_values[k] = target->get_position();
+        else if (timeline.key_sources[k] == TIMELINE_KEY_SELF)
+        {
+            // Orientação atual relativa à da carga: R = M * B^-1 (parte 3x3)
+            glm::mat3 current = glm::mat3(target->get_model());
+            glm::mat3 bind = glm::mat3(timeline.bind_models[track.target]);
+            glm::quat q = glm::normalize(glm::quat_cast(current * glm::inverse(bind)));
+            timeline.key_values[k] = glm::vec4(q.x, q.y, q.z, q.w);
+        }
+    }
+    track.segment = track.first_key;
+    track.state = TIMELINE_ACTIVE;
+}
+
+// Avança a animação até "time" segundos após o início
+inline void Timeline_Evaluate(Timeline& timeline, float time)
+{
+    if (time < timeline.time)
+        Timeline_Reset(timeline);
+    timeline.time = time;
+
+    // Trilhas que começam, continuam ou terminam neste passo; a ordem de
+    // "tracks" (translação antes de rotação) é mantida
+    timeline.active.clear();
+    timeline.num_active_translations = 0;
+    for (size_t i = 0; i < timeline.tracks.size(); ++i)
+    {
+        TimelineTrack& track = timeline.tracks[i];
+        if (track.state == TIMELINE_DONE || time < timeline.key_times[track.first_key])
+            continue;
+        if (track.state == TIMELINE_WAITING)
+            Timeline_StartTrack(timeline, track);
+        int last_key = track.first_key + track.num_keys - 1;
+        if (time >= timeline.key_times[last_key])
+            track.state = TIMELINE_DONE; // Último passo: valor final
+        timeline.active.push_back((int)i);
+        if (track.type == TIMELINE_TRANSLATION)
+            ++timeline.num_active_translations;
+    }
+
+    // Interpolação de todas as trilhas ativas
+    const float* times = timeline.key_times.data();
+    const glm::vec4* key_values = timeline.key_values.data();
+    int num_active = (int)timeline.active.size();
+    for (int a = 0; a < num_active; ++a)
+    {
+        TimelineTrack& track = timeline.tracks[timeline.active[a]];
+        int last_key = track.first_key + track.num_keys - 1;
+        int k = track.segment;
+        while (k < last_key && time >= times[k + 1])
+            ++k;
+        track.segment = k;
+
+        float f = 1.0f;
+        int next = k;
+        if (k < last_key)
+        {
+            next = k + 1;
+            f = (time - times[k]) / (times[next] - times[k]);
+            if (track.smooth)
+                f = f * f * (3.0f - 2.0f * f);
+        }
+
+        if (a < timeline.num_active_translations)
+            timeline.values[a] = key_values[k] + (key_values[next] - key_values[k]) * f;
+        else
+        {
+            glm::quat q0(key_values[k].w, key_values[k].x, key_values[k].y, key_values[k].z);
+            glm::quat q1(key_values[next].w, key_values[next].x, key_values[next].y, key_values[next].z);
+            glm::quat q = glm::slerp(q0, q1, f);
+            timeline.values[a] = glm::vec4(q.x, q.y, q.z, q.w);
+        }
+    }
+
+    // Resultados para os objetos
+    for (int a = 0; a < num_active; ++a)
+    {
+        const TimelineTrack& track = timeline.tracks[timeline.active[a]];
+        SceneObject* target = timeline.targets[track.target];
+        if (a < timeline.num_active_translations)
+            target->set_position(timeline.values[a]);
+        else
+        {
+            const glm::vec4& v = timeline.values[a];
+            glm::mat4 rotation = glm::mat4_cast(glm::quat(v.w, v.x, v.y, v.z));
+            glm::mat4 model = rotation * timeline.bind_models[track.target];
+            model[3] = target->get_position();
+            target->set_model(model);
+        }
+    }
+
+    while (timeline.next_event < (int)timeline.events.size() &&
+           timeline.events[timeline.next_event].time <= time)
+    {
+        const TimelineEvent& event = timeline.events[timeline.next_event++];
+        timeline.callbacks[event.callback](event.target >= 0 ? timeline.targets[event.target] : NULL);
+    }
+}
+
+inline bool Timeline_Finished(const Timeline& timeline)
+{
+    return timeline.time >= timeline.duration;
+}
+
+#endif // _TIMELINE_H
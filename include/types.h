@@ -1,5 +1,7 @@
 #include "matrices.h"
+#include "collision_shapes.h"
 #include "glm/gtx/string_cast.hpp"
+#include "glm/gtc/quaternion.hpp"
 struct ObjModel
 {
     tinyobj::attrib_t                 attrib;
@@ -57,6 +59,75 @@ struct ObjModel
 };
 
 
+// Transformao de um SceneObject, copiada da simulao para a renderizao.
+// Veja "frame_packet.h".
+struct ObjectTransform
+{
+    glm::mat4    model;
+    glm::mat4    render_model;
+    unsigned int version;
+};
+
+// Translao, rotao e escala de uma matriz "model" = T * R * S. A
+// interpolao entre dois ticks  feita nestes componentes (a rotao com
+// slerp): interpolar as matrizes elemento a elemento deformaria os objetos
+// que giram, como as gavetas e as peas da animao final.
+struct ObjectPose
+{
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    bool      valid; // false se a matriz tem cisalhamento ou projeo e no pode ser decomposta
+};
+
+inline ObjectPose ObjectPose_FromMatrix(const glm::mat4& m)
+{
+    ObjectPose pose;
+    pose.translation = glm::vec3(m[3]);
+    pose.valid = m[0][3] == 0.0f && m[1][3] == 0.0f && m[2][3] == 0.0f && m[3][3] == 1.0f;
+
+    glm::vec3 axes[3] = { glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]) };
+    for (int i = 0; i < 3; ++i)
+    {
+        pose.scale[i] = glm::length(axes[i]);
+        if (pose.scale[i] < 1e-6f)
+        {
+            pose.valid = false;
+            pose.scale[i] = 1.0f;
+        }
+    }
+    // Reflexo: a escala negativa fica no eixo X
+    if (glm::dot(glm::cross(axes[0], axes[1]), axes[2]) < 0.0f)
+        pose.scale.x = -pose.scale.x;
+
+    glm::mat3 rotation(axes[0] / pose.scale.x, axes[1] / pose.scale.y, axes[2] / pose.scale.z);
+    if (std::fabs(glm::dot(rotation[0], rotation[1])) > 1e-3f ||
+        std::fabs(glm::dot(rotation[0], rotation[2])) > 1e-3f ||
+        std::fabs(glm::dot(rotation[1], rotation[2])) > 1e-3f)
+        pose.valid = false;
+    pose.rotation = glm::normalize(glm::quat_cast(rotation));
+    return pose;
+}
+
+inline glm::mat4 ObjectPose_ToMatrix(const ObjectPose& pose)
+{
+    glm::mat4 rotation = glm::mat4_cast(pose.rotation);
+    glm::mat4 m(rotation[0] * pose.scale.x, rotation[1] * pose.scale.y, rotation[2] * pose.scale.z, glm::vec4(0.0f));
+    m[3] = glm::vec4(pose.translation, 1.0f);
+    return m;
+}
+
+// Translao e escala interpoladas linearmente, rotao pelo caminho mais
+// curto (glm::slerp)
+inline glm::mat4 ObjectPose_Interpolate(const ObjectPose& a, const ObjectPose& b, float alpha)
+{
+    ObjectPose pose;
+    pose.translation = a.translation + (b.translation - a.translation) * alpha;
+    pose.rotation = glm::slerp(a.rotation, b.rotation, alpha);
+    pose.scale = a.scale + (b.scale - a.scale) * alpha;
+    return ObjectPose_ToMatrix(pose);
+}
+
 // Definimos uma estrutura que armazenar dados necessrios para renderizar
 // cada objeto da cena virtual.
 struct SceneObject
@@ -75,6 +146,17 @@ struct SceneObject
     int          index;
     bool         inspectable = true;
     bool         collision = true;
+    bool         cast_shadow = true;
+    unsigned int transform_version = 0; // Incrementado sempre que "model" muda. Veja "shadows.h".
+    GLuint       lightmap_texture = 0; // Iluminao pr-calculada, 0 se no houver. Veja "lightmap.h".
+    glm::mat4    previous_model = Matrix_Identity(); // "model" no tick anterior da simulao. Veja "simulation.h".
+    glm::mat4    render_model = Matrix_Identity();   // Interpolao entre previous_model e model usada no desenho
+    unsigned int previous_version = 0;
+    ObjectPose   previous_pose;        // previous_model e model decompostas, uma vez por tick
+    ObjectPose   pose;
+    unsigned int pose_version = 0;     // transform_version de "pose"; 0 = ainda no decomposta
+    const MeshBVH* mesh_bvh = NULL; // Tringulos do modelo, para testes exatos. Veja "mesh_bvh.h".
+    CollisionShapeType collision_shape = COLLISION_MESH; // Forma usada nas colises (OBB se no houver malha). Veja "collision_shapes.h".
 
     public:
     SceneObject(){
@@ -143,9 +225,96 @@ struct SceneObject
     }
 
     void set_model(glm::mat4 new_model){
+        if (new_model != model)
+            ++transform_version;
         model = new_model;
     }
 
+    unsigned int get_transform_version(){
+        return transform_version;
+    }
+
+    void begin_tick(){
+        previous_model = model;
+        previous_version = transform_version;
+    }
+
+    void interpolate(float alpha){
+        if (transform_version == previous_version){
+            render_model = model;
+            return;
+        }
+        if (pose_version != transform_version){
+            previous_pose = ObjectPose_FromMatrix(previous_model);
+            pose = ObjectPose_FromMatrix(model);
+            pose_version = transform_version;
+        }
+        // Sem decomposio (cisalhamento), o objeto salta para o tick atual
+        if (previous_pose.valid && pose.valid)
+            render_model = ObjectPose_Interpolate(previous_pose, pose, alpha);
+        else
+            render_model = model;
+    }
+
+    glm::mat4 get_render_model(){
+        return render_model;
+    }
+
+    ObjectTransform get_transform(){
+        ObjectTransform transform;
+        transform.model = model;
+        transform.render_model = render_model;
+        transform.version = transform_version;
+        return transform;
+    }
+
+    void set_transform(const ObjectTransform& transform){
+        model = transform.model;
+        render_model = transform.render_model;
+        transform_version = transform.version;
+    }
+
+    void set_cast_shadow(bool cast_shadow){
+        this->cast_shadow = cast_shadow;
+    }
+
+    bool casts_shadow(){
+        return cast_shadow;
+    }
+
+    void set_lightmap(GLuint texture_id){
+        lightmap_texture = texture_id;
+    }
+
+    GLuint get_lightmap(){
+        return lightmap_texture;
+    }
+
+    void set_mesh_bvh(const MeshBVH* bvh){
+        mesh_bvh = bvh;
+    }
+
+    const MeshBVH* get_mesh_bvh(){
+        return mesh_bvh;
+    }
+
+    void set_collision_shape(CollisionShapeType shape){
+        collision_shape = shape;
+    }
+
+    CollisionShapeType get_collision_shape(){
+        return collision_shape;
+    }
+
+    // Bounding box nas coordenadas do modelo
+    glm::vec4 get_object_bbox_min(){
+        return bbox_min;
+    }
+
+    glm::vec4 get_object_bbox_max(){
+        return bbox_max;
+    }
+
     bool has_collision(){
         return collision;
     }
@@ -177,10 +346,12 @@ struct SceneObject
     }
 
     void set_position(float x, float y, float z){
-        model[3] = glm::vec4(x,y,z,1);
+        set_position(glm::vec4(x,y,z,1));
     }
 
     void set_position(glm::vec4 position){
+        if (position != model[3])
+            ++transform_version;
         model[3] = position;
     }
 
@@ -190,14 +361,17 @@ struct SceneObject
 
     void translate(float x, float y, float z){
         model =Matrix_Translate(x, y, z) * model ;
+        ++transform_version;
     }
     void scale(float x, float y, float z){
         model = model * Matrix_Scale(x, y, z);
+        ++transform_version;
     }
     void mRotate(float x, float y, float z){
         model = model * Matrix_Rotate_X(x)
                       * Matrix_Rotate_Y(y)
                       * Matrix_Rotate_Z(z);
+        ++transform_version;
     }
 
     bool is_sphere(){
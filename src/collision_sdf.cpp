@@ -0,0 +1,438 @@
+// Cálculo, gravação e leitura do campo de distância das formas de colisão
+// estáticas. Veja "include/collision_sdf.h".
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+
+#include "cpu_profiler.h"
+#include "collision_sdf.h"
+#include "parallel.h"
+
+#define COLLISION_SDF_MAGIC 0x46445343u // "CSDF"
+#define COLLISION_SDF_VERSION 1u
+
+CollisionSDF g_CollisionSDF;
+
+// ----------------------------------------------------------------------------
+// Distância até as formas
+
+// Formas do cálculo: as analíticas ficam em "shapes" e os triângulos de todas
+// as malhas, já em coordenadas globais, em uma única BVH
+struct SDFScene
+{
+    std::vector<CollisionShape> shapes;
+    MeshBVH                     mesh;
+    std::vector<glm::vec3>      normals; // Normal de cada triângulo de "mesh", na ordem da BVH
+};
+
+static float BoxDistance(const CollisionShape& box, glm::vec3 p)
+{
+    glm::vec3 d = p - box.center;
+    glm::vec3 q = glm::vec3(std::fabs(glm::dot(d, box.axes[0])),
+                            std::fabs(glm::dot(d, box.axes[1])),
+                            std::fabs(glm::dot(d, box.axes[2]))) - box.half_size;
+    float inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+    return glm::length(glm::max(q, glm::vec3(0.0f))) + inside;
+}
+
+static float ShapeDistance(const CollisionShape& shape, glm::vec3 p)
+{
+    switch (shape.type)
+    {
+        case COLLISION_AABB:
+        case COLLISION_OBB:
+            return BoxDistance(shape, p);
+        case COLLISION_SPHERE:
+            return glm::length(p - shape.center) - shape.radius;
+        case COLLISION_CAPSULE:
+            return glm::length(p - Collision_ClosestPointOnSegment(p, shape.center - shape.segment, shape.center + shape.segment)) - shape.radius;
+        default:
+            return 1e30f;
+    }
+}
+
+static float NodeDistance2(const MeshBVHNode& node, glm::vec3 p)
+{
+    glm::vec3 d = glm::max(glm::max(node.bbox_min - p, p - node.bbox_max), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+// Distância com sinal até o triângulo mais próximo de p, se ele estiver a
+// menos de "max_distance". O sinal vem da normal do triângulo; quando vários
+// triângulos estão à mesma distância (p mais perto de uma aresta ou vértice
+// compartilhado), vale o que está mais de frente para p.
+static float MeshDistance(const SDFScene& scene, glm::vec3 p, float max_distance)
+{
+    const MeshBVH& bvh = scene.mesh;
+    float best2 = max_distance * max_distance;
+    float best = max_distance;
+    float best_alignment = -1.0f;
+    bool found = false;
+
+    int num_nodes = (int)bvh.nodes.size();
+    int i = 0;
+    while (i < num_nodes)
+    {
+        const MeshBVHNode& node = bvh.nodes[i];
+        if (NodeDistance2(node, p) > best2 * 1.0001f)
+        {
+            i = node.skip;
+            continue;
+        }
+        if (node.num_triangles == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        for (int k = node.first_triangle; k < node.first_triangle + node.num_triangles; ++k)
+        {
+            const MeshBVHTriangle& tri = bvh.triangles[k];
+            glm::vec3 c = MeshBVH_ClosestPoint(p, tri.v0, tri.v0 + tri.e1, tri.v0 + tri.e2);
+            glm::vec3 to_p = p - c;
+            float d2 = glm::dot(to_p, to_p);
+            if (d2 > best2 * 1.0001f + 1e-12f)
+                continue;
+
+            float d = std::sqrt(d2);
+            float side = glm::dot(to_p, scene.normals[k]);
+            float alignment = d > 0.0f ? std::fabs(side) / d : 1.0f;
+            bool tie = found && d2 > best2 * 0.9999f - 1e-12f;
+            if (tie && alignment <= best_alignment)
+                continue;
+
+            best2 = std::min(best2, d2);
+            best = side < 0.0f ? -d : d;
+            best_alignment = alignment;
+            found = true;
+        }
+        i = node.skip;
+    }
+    return found ? best : max_distance;
+}
+
+static float SceneDistance(const SDFScene& scene, glm::vec3 p)
+{
+    float d = 1e30f;
+    for (size_t i = 0; i < scene.shapes.size(); ++i)
+        d = std::min(d, ShapeDistance(scene.shapes[i], p));
+    if (!scene.mesh.empty())
+    {
+        float mesh = MeshDistance(scene, p, std::fabs(d));
+        d = std::min(d, mesh);
+    }
+    return d;
+}
+
+static void BuildScene(SDFScene& scene, const std::vector<CollisionShape>& shapes)
+{
+    std::vector<glm::vec4> positions;
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        const CollisionShape& shape = shapes[i];
+        if (shape.type != COLLISION_MESH)
+        {
+            scene.shapes.push_back(shape);
+            continue;
+        }
+        if (shape.mesh == NULL)
+            continue;
+
+        const std::vector<MeshBVHTriangle>& triangles = shape.mesh->triangles;
+        for (size_t t = 0; t < triangles.size(); ++t)
+        {
+            const MeshBVHTriangle& tri = triangles[t];
+            positions.push_back(shape.model * glm::vec4(tri.v0, 1.0f));
+            positions.push_back(shape.model * glm::vec4(tri.v0 + tri.e1, 1.0f));
+            positions.push_back(shape.model * glm::vec4(tri.v0 + tri.e2, 1.0f));
+        }
+    }
+
+    MeshBVH_Build(scene.mesh, positions);
+    scene.normals.resize(scene.mesh.triangles.size());
+    for (size_t t = 0; t < scene.mesh.triangles.size(); ++t)
+    {
+        glm::vec3 n = glm::cross(scene.mesh.triangles[t].e1, scene.mesh.triangles[t].e2);
+        float length = glm::length(n);
+        scene.normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Hash das formas, para detectar arquivos desatualizados
+
+static void HashBytes(uint32_t& hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u; // FNV-1a
+    }
+}
+
+static void HashVec3(uint32_t& hash, glm::vec3 v)
+{
+    HashBytes(hash, &v.x, sizeof(float));
+    HashBytes(hash, &v.y, sizeof(float));
+    HashBytes(hash, &v.z, sizeof(float));
+}
+
+static uint32_t ShapesHash(const std::vector<CollisionShape>& shapes)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t version = COLLISION_SDF_VERSION;
+    float settings[4] = { COLLISION_SDF_VOXEL_SIZE, (float)COLLISION_SDF_BRICK, COLLISION_SDF_BAND, COLLISION_SDF_SCALE };
+    HashBytes(hash, &version, sizeof(version));
+    HashBytes(hash, settings, sizeof(settings));
+
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        const CollisionShape& shape = shapes[i];
+        int type = (int)shape.type;
+        HashBytes(hash, &type, sizeof(type));
+        if (shape.type != COLLISION_MESH)
+        {
+            HashVec3(hash, shape.center);
+            HashVec3(hash, shape.half_size);
+            HashVec3(hash, shape.axes[0]);
+            HashVec3(hash, shape.axes[1]);
+            HashVec3(hash, shape.axes[2]);
+            HashVec3(hash, shape.segment);
+            HashBytes(hash, &shape.radius, sizeof(float));
+            continue;
+        }
+
+        for (int c = 0; c < 4; ++c)
+            HashBytes(hash, &shape.model[c][0], 4 * sizeof(float));
+        if (shape.mesh == NULL)
+            continue;
+        const std::vector<MeshBVHTriangle>& triangles = shape.mesh->triangles;
+        for (size_t t = 0; t < triangles.size(); ++t)
+        {
+            HashVec3(hash, triangles[t].v0);
+            HashVec3(hash, triangles[t].e1);
+            HashVec3(hash, triangles[t].e2);
+        }
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// Cálculo
+
+void CollisionSDF_Bake(CollisionSDF& sdf, const std::vector<CollisionShape>& shapes)
+{
+    PROFILE_FUNCTION();
+
+    SDFScene scene;
+    BuildScene(scene, shapes);
+
+    // Grade com um brick de folga em volta de todas as formas
+    float brick_size = COLLISION_SDF_BRICK * COLLISION_SDF_VOXEL_SIZE;
+    glm::vec3 bbox_min = glm::vec3( 1e30f);
+    glm::vec3 bbox_max = glm::vec3(-1e30f);
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        glm::vec3 shape_min, shape_max;
+        CollisionShape_Bounds(shapes[i], shape_min, shape_max);
+        bbox_min = glm::min(bbox_min, shape_min);
+        bbox_max = glm::max(bbox_max, shape_max);
+    }
+    if (shapes.empty())
+        bbox_min = bbox_max = glm::vec3(0.0f);
+
+    sdf.voxel_size = COLLISION_SDF_VOXEL_SIZE;
+    sdf.origin = bbox_min - glm::vec3(brick_size);
+    for (int a = 0; a < 3; ++a)
+        sdf.bricks[a] = (int)std::ceil((bbox_max[a] - bbox_min[a]) / brick_size) + 2;
+    sdf.hash = ShapesHash(shapes);
+
+    int num_bricks = sdf.bricks[0] * sdf.bricks[1] * sdf.bricks[2];
+    sdf.brick_index.assign(num_bricks, -1);
+    sdf.brick_distance.assign(num_bricks, 0.0f);
+    sdf.samples.clear();
+
+    // Distância no centro de cada brick. Como a distância muda no máximo tanto
+    // quanto o ponto se move, o brick inteiro fica a menos de meia diagonal
+    // desse valor.
+    float half_diagonal = 0.5f * std::sqrt(3.0f) * brick_size;
+    std::vector<char> near_surface(num_bricks, 0);
+    ParallelFor(sdf.bricks[1] * sdf.bricks[2], [&](int row) {
+        PROFILE_ZONE("collision sdf: linha de bricks");
+        int y = row % sdf.bricks[1];
+        int z = row / sdf.bricks[1];
+        for (int x = 0; x < sdf.bricks[0]; ++x)
+        {
+            glm::vec3 center = sdf.origin + (glm::vec3(x, y, z) + 0.5f) * brick_size;
+            float d = SceneDistance(scene, center);
+            int b = (z * sdf.bricks[1] + y) * sdf.bricks[0] + x;
+            sdf.brick_distance[b] = d - half_diagonal;
+            near_surface[b] = d - half_diagonal < COLLISION_SDF_BAND && d + half_diagonal > -COLLISION_SDF_VOXEL_SIZE;
+        }
+    });
+
+    std::vector<int> stored;
+    for (int b = 0; b < num_bricks; ++b)
+    {
+        if (!near_surface[b])
+            continue;
+        sdf.brick_index[b] = (int)stored.size() * COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES;
+        sdf.brick_distance[b] = 0.0f;
+        stored.push_back(b);
+    }
+
+    const int n = COLLISION_SDF_BRICK_SAMPLES;
+    sdf.samples.resize(stored.size() * n * n * n);
+    ParallelFor((int)stored.size(), [&](int i) {
+        PROFILE_ZONE("collision sdf: brick");
+        int b = stored[i];
+        int x = b % sdf.bricks[0];
+        int y = (b / sdf.bricks[0]) % sdf.bricks[1];
+        int z = b / (sdf.bricks[0] * sdf.bricks[1]);
+        glm::vec3 corner = sdf.origin + glm::vec3(x, y, z) * brick_size;
+        int16_t* samples = &sdf.samples[sdf.brick_index[b]];
+        for (int k = 0; k < n; ++k)
+        for (int j = 0; j < n; ++j)
+        for (int l = 0; l < n; ++l)
+        {
+            glm::vec3 p = corner + glm::vec3(l, j, k) * sdf.voxel_size;
+            float q = SceneDistance(scene, p) * COLLISION_SDF_SCALE;
+            q = std::max(-32767.0f, std::min(32767.0f, q));
+            samples[(k * n + j) * n + l] = (int16_t)std::floor(q + 0.5f);
+        }
+    });
+}
+
+// ----------------------------------------------------------------------------
+// Arquivos
+
+std::string CollisionSDF_Path(const std::string& name)
+{
+    return std::string(COLLISION_SDF_DIR) + "/" + name + ".sdf";
+}
+
+struct SDFFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t hash;
+    int32_t  bricks[3];
+    float    origin[3];
+    float    voxel_size;
+    uint32_t num_samples;
+};
+
+bool CollisionSDF_Save(const CollisionSDF& sdf, const std::string& name)
+{
+#ifdef _WIN32
+    _mkdir(COLLISION_SDF_DIR);
+#else
+    mkdir(COLLISION_SDF_DIR, 0755);
+#endif
+
+    FILE* file = fopen(CollisionSDF_Path(name).c_str(), "wb");
+    if (!file)
+        return false;
+
+    SDFFileHeader header;
+    header.magic = COLLISION_SDF_MAGIC;
+    header.version = COLLISION_SDF_VERSION;
+    header.hash = sdf.hash;
+    for (int a = 0; a < 3; ++a)
+    {
+        header.bricks[a] = sdf.bricks[a];
+        header.origin[a] = sdf.origin[a];
+    }
+    header.voxel_size = sdf.voxel_size;
+    header.num_samples = (uint32_t)sdf.samples.size();
+
+    size_t num_bricks = sdf.brick_index.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(sdf.brick_index.data(), sizeof(int32_t), num_bricks, file) == num_bricks &&
+              fwrite(sdf.brick_distance.data(), sizeof(float), num_bricks, file) == num_bricks &&
+              fwrite(sdf.samples.data(), sizeof(int16_t), sdf.samples.size(), file) == sdf.samples.size();
+    fclose(file);
+    return ok;
+}
+
+bool CollisionSDF_Load(CollisionSDF& sdf, const std::string& name, const std::vector<CollisionShape>& shapes)
+{
+    PROFILE_FUNCTION();
+    FILE* file = fopen(CollisionSDF_Path(name).c_str(), "rb");
+    if (!file)
+        return false;
+
+    SDFFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == COLLISION_SDF_MAGIC &&
+              header.version == COLLISION_SDF_VERSION &&
+              header.hash == ShapesHash(shapes) &&
+              header.bricks[0] > 0 && header.bricks[1] > 0 && header.bricks[2] > 0;
+    if (ok)
+    {
+        size_t num_bricks = (size_t)header.bricks[0] * header.bricks[1] * header.bricks[2];
+        sdf.brick_index.resize(num_bricks);
+        sdf.brick_distance.resize(num_bricks);
+        sdf.samples.resize(header.num_samples);
+        ok = fread(sdf.brick_index.data(), sizeof(int32_t), num_bricks, file) == num_bricks &&
+             fread(sdf.brick_distance.data(), sizeof(float), num_bricks, file) == num_bricks &&
+             fread(sdf.samples.data(), sizeof(int16_t), sdf.samples.size(), file) == sdf.samples.size();
+
+        const int brick_samples = COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES;
+        for (size_t b = 0; ok && b < num_bricks; ++b)
+            ok = sdf.brick_index[b] < 0 || (size_t)sdf.brick_index[b] + brick_samples <= sdf.samples.size();
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        sdf = CollisionSDF();
+        return false;
+    }
+
+    sdf.hash = header.hash;
+    sdf.voxel_size = header.voxel_size;
+    for (int a = 0; a < 3; ++a)
+    {
+        sdf.bricks[a] = header.bricks[a];
+        sdf.origin[a] = header.origin[a];
+    }
+    return true;
+}
+
+void CollisionSDF_LoadOrBake(CollisionSDF& sdf, const std::string& name, const std::vector<CollisionShape>& shapes, bool bake)
+{
+    if (!bake && CollisionSDF_Load(sdf, name, shapes))
+    {
+        printf("Campo de distância \"%s\" carregado (%d bricks com amostras).\n", name.c_str(),
+               (int)(sdf.samples.size() / (COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES)));
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    CollisionSDF_Bake(sdf, shapes);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int num_stored = (int)(sdf.samples.size() / (COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES * COLLISION_SDF_BRICK_SAMPLES));
+    printf("Campo de distância \"%s\": %d de %d bricks com amostras (%.1f MB) em %.2f s, %d threads.\n",
+           name.c_str(), num_stored, (int)sdf.brick_index.size(),
+           sdf.samples.size() * sizeof(int16_t) / (1024.0 * 1024.0), seconds,
+           ParallelPool::instance().num_threads());
+
+    if (!CollisionSDF_Save(sdf, name))
+        fprintf(stderr, "Não foi possível salvar \"%s\".\n", CollisionSDF_Path(name).c_str());
+}
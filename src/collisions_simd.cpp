@@ -0,0 +1,356 @@
+// Testes de colisão em lote. Veja "include/collisions_simd.h".
+#include "collisions_simd.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLLISIONS_X86 1
+#include <immintrin.h>
+#endif
+
+// Mesmo resultado de _mm_min_ps/_mm_max_ps quando algum operando é NaN
+// (retorna o segundo), para que todas as versões concordem
+static inline float min_ps(float a, float b) { return a < b ? a : b; }
+static inline float max_ps(float a, float b) { return a > b ? a : b; }
+
+static inline void set_hit(uint64_t* hits, size_t i)
+{
+    hits[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+//------------------------------------------------------------------------------
+// Versão escalar, usada também para as caixas que sobram no fim dos arrays
+
+static void aabb_scalar(const AABBArrays& b, size_t begin, glm::vec3 lo, glm::vec3 hi, uint64_t* hits)
+{
+    for (size_t i = begin; i < b.count; ++i)
+    {
+        if (lo.x <= b.max_x[i] && hi.x >= b.min_x[i] &&
+            lo.y <= b.max_y[i] && hi.y >= b.min_y[i] &&
+            lo.z <= b.max_z[i] && hi.z >= b.min_z[i])
+            set_hit(hits, i);
+    }
+}
+
+static void sphere_scalar(const AABBArrays& b, size_t begin, glm::vec3 c, float radius, uint64_t* hits)
+{
+    float r2 = radius * radius;
+    for (size_t i = begin; i < b.count; ++i)
+    {
+        // Ponto da caixa mais próximo do centro (clamp_to_bbox())
+        float dx = min_ps(max_ps(c.x, b.min_x[i]), b.max_x[i]) - c.x;
+        float dy = min_ps(max_ps(c.y, b.min_y[i]), b.max_y[i]) - c.y;
+        float dz = min_ps(max_ps(c.z, b.min_z[i]), b.max_z[i]) - c.z;
+        if (dx*dx + dy*dy + dz*dz <= r2)
+            set_hit(hits, i);
+    }
+}
+
+static void ray_scalar(const AABBArrays& b, size_t begin, glm::vec3 o, glm::vec3 inv, uint64_t* hits, float* distances)
+{
+    for (size_t i = begin; i < b.count; ++i)
+    {
+        float t1x = (b.min_x[i] - o.x) * inv.x, t2x = (b.max_x[i] - o.x) * inv.x;
+        float t1y = (b.min_y[i] - o.y) * inv.y, t2y = (b.max_y[i] - o.y) * inv.y;
+        float t1z = (b.min_z[i] - o.z) * inv.z, t2z = (b.max_z[i] - o.z) * inv.z;
+        float tmin = max_ps(max_ps(min_ps(t1x, t2x), min_ps(t1y, t2y)), min_ps(t1z, t2z));
+        float tmax = min_ps(min_ps(max_ps(t1x, t2x), max_ps(t1y, t2y)), max_ps(t1z, t2z));
+        if (tmax >= tmin && tmax >= 0.0f)
+        {
+            set_hit(hits, i);
+            if (distances != NULL)
+                distances[i] = tmin;
+        }
+    }
+}
+
+#ifdef COLLISIONS_X86
+
+//------------------------------------------------------------------------------
+// SSE: 4 caixas por instrução
+
+__attribute__((target("sse2")))
+static void aabb_sse(const AABBArrays& b, glm::vec3 lo, glm::vec3 hi, uint64_t* hits)
+{
+    __m128 lx = _mm_set1_ps(lo.x), ly = _mm_set1_ps(lo.y), lz = _mm_set1_ps(lo.z);
+    __m128 hx = _mm_set1_ps(hi.x), hy = _mm_set1_ps(hi.y), hz = _mm_set1_ps(hi.z);
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4)
+    {
+        __m128 m = _mm_and_ps(_mm_cmple_ps(lx, _mm_loadu_ps(b.max_x + i)), _mm_cmpge_ps(hx, _mm_loadu_ps(b.min_x + i)));
+        m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(ly, _mm_loadu_ps(b.max_y + i)), _mm_cmpge_ps(hy, _mm_loadu_ps(b.min_y + i))));
+        m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(lz, _mm_loadu_ps(b.max_z + i)), _mm_cmpge_ps(hz, _mm_loadu_ps(b.min_z + i))));
+        hits[i / 64] |= (uint64_t)_mm_movemask_ps(m) << (i % 64);
+    }
+    aabb_scalar(b, i, lo, hi, hits);
+}
+
+__attribute__((target("sse2")))
+static void sphere_sse(const AABBArrays& b, glm::vec3 c, float radius, uint64_t* hits)
+{
+    __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    __m128 r2 = _mm_set1_ps(radius * radius);
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cx, _mm_loadu_ps(b.min_x + i)), _mm_loadu_ps(b.max_x + i)), cx);
+        __m128 dy = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cy, _mm_loadu_ps(b.min_y + i)), _mm_loadu_ps(b.max_y + i)), cy);
+        __m128 dz = _mm_sub_ps(_mm_min_ps(_mm_max_ps(cz, _mm_loadu_ps(b.min_z + i)), _mm_loadu_ps(b.max_z + i)), cz);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        hits[i / 64] |= (uint64_t)_mm_movemask_ps(_mm_cmple_ps(d2, r2)) << (i % 64);
+    }
+    sphere_scalar(b, i, c, radius, hits);
+}
+
+__attribute__((target("sse2")))
+static void ray_sse(const AABBArrays& b, glm::vec3 o, glm::vec3 inv, uint64_t* hits, float* distances)
+{
+    __m128 ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+    __m128 ix = _mm_set1_ps(inv.x), iy = _mm_set1_ps(inv.y), iz = _mm_set1_ps(inv.z);
+    __m128 zero = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= b.count; i += 4)
+    {
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.min_x + i), ox), ix);
+        __m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.max_x + i), ox), ix);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.min_y + i), oy), iy);
+        __m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.max_y + i), oy), iy);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.min_z + i), oz), iz);
+        __m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b.max_z + i), oz), iz);
+        __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_min_ps(t1z, t2z));
+        __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_max_ps(t1z, t2z));
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpge_ps(tmax, zero));
+        int mask = _mm_movemask_ps(hit);
+        hits[i / 64] |= (uint64_t)mask << (i % 64);
+
+        // Só as caixas atingidas recebem a distância. SSE2 não tem
+        // _mm_blendv_ps (SSE4.1): a mistura é feita com and/andnot/or.
+        if (distances != NULL && mask != 0)
+        {
+            __m128 old = _mm_loadu_ps(distances + i);
+            _mm_storeu_ps(distances + i, _mm_or_ps(_mm_and_ps(hit, tmin), _mm_andnot_ps(hit, old)));
+        }
+    }
+    ray_scalar(b, i, o, inv, hits, distances);
+}
+
+//------------------------------------------------------------------------------
+// AVX2: 8 caixas por instrução
+
+__attribute__((target("avx2")))
+static void aabb_avx2(const AABBArrays& b, glm::vec3 lo, glm::vec3 hi, uint64_t* hits)
+{
+    __m256 lx = _mm256_set1_ps(lo.x), ly = _mm256_set1_ps(lo.y), lz = _mm256_set1_ps(lo.z);
+    __m256 hx = _mm256_set1_ps(hi.x), hy = _mm256_set1_ps(hi.y), hz = _mm256_set1_ps(hi.z);
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8)
+    {
+        __m256 m = _mm256_and_ps(_mm256_cmp_ps(lx, _mm256_loadu_ps(b.max_x + i), _CMP_LE_OQ),
+                                 _mm256_cmp_ps(hx, _mm256_loadu_ps(b.min_x + i), _CMP_GE_OQ));
+        m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(ly, _mm256_loadu_ps(b.max_y + i), _CMP_LE_OQ),
+                                           _mm256_cmp_ps(hy, _mm256_loadu_ps(b.min_y + i), _CMP_GE_OQ)));
+        m = _mm256_and_ps(m, _mm256_and_ps(_mm256_cmp_ps(lz, _mm256_loadu_ps(b.max_z + i), _CMP_LE_OQ),
+                                           _mm256_cmp_ps(hz, _mm256_loadu_ps(b.min_z + i), _CMP_GE_OQ)));
+        hits[i / 64] |= (uint64_t)_mm256_movemask_ps(m) << (i % 64);
+    }
+    aabb_scalar(b, i, lo, hi, hits);
+}
+
+__attribute__((target("avx2,fma")))
+static void sphere_avx2(const AABBArrays& b, glm::vec3 c, float radius, uint64_t* hits)
+{
+    __m256 cx = _mm256_set1_ps(c.x), cy = _mm256_set1_ps(c.y), cz = _mm256_set1_ps(c.z);
+    __m256 r2 = _mm256_set1_ps(radius * radius);
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_min_ps(_mm256_max_ps(cx, _mm256_loadu_ps(b.min_x + i)), _mm256_loadu_ps(b.max_x + i)), cx);
+        __m256 dy = _mm256_sub_ps(_mm256_min_ps(_mm256_max_ps(cy, _mm256_loadu_ps(b.min_y + i)), _mm256_loadu_ps(b.max_y + i)), cy);
+        __m256 dz = _mm256_sub_ps(_mm256_min_ps(_mm256_max_ps(cz, _mm256_loadu_ps(b.min_z + i)), _mm256_loadu_ps(b.max_z + i)), cz);
+        __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        hits[i / 64] |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(d2, r2, _CMP_LE_OQ)) << (i % 64);
+    }
+    sphere_scalar(b, i, c, radius, hits);
+}
+
+__attribute__((target("avx2")))
+static void ray_avx2(const AABBArrays& b, glm::vec3 o, glm::vec3 inv, uint64_t* hits, float* distances)
+{
+    __m256 ox = _mm256_set1_ps(o.x), oy = _mm256_set1_ps(o.y), oz = _mm256_set1_ps(o.z);
+    __m256 ix = _mm256_set1_ps(inv.x), iy = _mm256_set1_ps(inv.y), iz = _mm256_set1_ps(inv.z);
+    __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= b.count; i += 8)
+    {
+        __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.min_x + i), ox), ix);
+        __m256 t2x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.max_x + i), ox), ix);
+        __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.min_y + i), oy), iy);
+        __m256 t2y = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.max_y + i), oy), iy);
+        __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.min_z + i), oz), iz);
+        __m256 t2z = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b.max_z + i), oz), iz);
+        __m256 tmin = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t1x, t2x), _mm256_min_ps(t1y, t2y)), _mm256_min_ps(t1z, t2z));
+        __m256 tmax = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t1x, t2x), _mm256_max_ps(t1y, t2y)), _mm256_max_ps(t1z, t2z));
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(tmax, tmin, _CMP_GE_OQ), _mm256_cmp_ps(tmax, zero, _CMP_GE_OQ));
+        int mask = _mm256_movemask_ps(hit);
+        hits[i / 64] |= (uint64_t)mask << (i % 64);
+
+        // Só as caixas atingidas recebem a distância
+        if (distances != NULL && mask != 0)
+            _mm256_storeu_ps(distances + i, _mm256_blendv_ps(_mm256_loadu_ps(distances + i), tmin, hit));
+    }
+    ray_scalar(b, i, o, inv, hits, distances);
+}
+
+//------------------------------------------------------------------------------
+// AVX-512: 16 caixas por instrução; as comparações já produzem máscaras
+
+// Os intrínsecos _mm512_min_ps/_mm512_max_ps do GCC 12 geram um aviso falso
+// de variável não inicializada (_mm512_undefined_ps())
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void aabb_avx512(const AABBArrays& b, glm::vec3 lo, glm::vec3 hi, uint64_t* hits)
+{
+    __m512 lx = _mm512_set1_ps(lo.x), ly = _mm512_set1_ps(lo.y), lz = _mm512_set1_ps(lo.z);
+    __m512 hx = _mm512_set1_ps(hi.x), hy = _mm512_set1_ps(hi.y), hz = _mm512_set1_ps(hi.z);
+    size_t i = 0;
+    for (; i + 16 <= b.count; i += 16)
+    {
+        __mmask16 m = _mm512_cmp_ps_mask(lx, _mm512_loadu_ps(b.max_x + i), _CMP_LE_OQ);
+        m = _mm512_mask_cmp_ps_mask(m, hx, _mm512_loadu_ps(b.min_x + i), _CMP_GE_OQ);
+        m = _mm512_mask_cmp_ps_mask(m, ly, _mm512_loadu_ps(b.max_y + i), _CMP_LE_OQ);
+        m = _mm512_mask_cmp_ps_mask(m, hy, _mm512_loadu_ps(b.min_y + i), _CMP_GE_OQ);
+        m = _mm512_mask_cmp_ps_mask(m, lz, _mm512_loadu_ps(b.max_z + i), _CMP_LE_OQ);
+        m = _mm512_mask_cmp_ps_mask(m, hz, _mm512_loadu_ps(b.min_z + i), _CMP_GE_OQ);
+        hits[i / 64] |= (uint64_t)m << (i % 64);
+    }
+    aabb_scalar(b, i, lo, hi, hits);
+}
+
+__attribute__((target("avx512f")))
+static void sphere_avx512(const AABBArrays& b, glm::vec3 c, float radius, uint64_t* hits)
+{
+    __m512 cx = _mm512_set1_ps(c.x), cy = _mm512_set1_ps(c.y), cz = _mm512_set1_ps(c.z);
+    __m512 r2 = _mm512_set1_ps(radius * radius);
+    size_t i = 0;
+    for (; i + 16 <= b.count; i += 16)
+    {
+        __m512 dx = _mm512_sub_ps(_mm512_min_ps(_mm512_max_ps(cx, _mm512_loadu_ps(b.min_x + i)), _mm512_loadu_ps(b.max_x + i)), cx);
+        __m512 dy = _mm512_sub_ps(_mm512_min_ps(_mm512_max_ps(cy, _mm512_loadu_ps(b.min_y + i)), _mm512_loadu_ps(b.max_y + i)), cy);
+        __m512 dz = _mm512_sub_ps(_mm512_min_ps(_mm512_max_ps(cz, _mm512_loadu_ps(b.min_z + i)), _mm512_loadu_ps(b.max_z + i)), cz);
+        __m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+        hits[i / 64] |= (uint64_t)_mm512_cmp_ps_mask(d2, r2, _CMP_LE_OQ) << (i % 64);
+    }
+    sphere_scalar(b, i, c, radius, hits);
+}
+
+__attribute__((target("avx512f")))
+static void ray_avx512(const AABBArrays& b, glm::vec3 o, glm::vec3 inv, uint64_t* hits, float* distances)
+{
+    __m512 ox = _mm512_set1_ps(o.x), oy = _mm512_set1_ps(o.y), oz = _mm512_set1_ps(o.z);
+    __m512 ix = _mm512_set1_ps(inv.x), iy = _mm512_set1_ps(inv.y), iz = _mm512_set1_ps(inv.z);
+    __m512 zero = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= b.count; i += 16)
+    {
+        __m512 t1x = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.min_x + i), ox), ix);
+        __m512 t2x = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.max_x + i), ox), ix);
+        __m512 t1y = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.min_y + i), oy), iy);
+        __m512 t2y = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.max_y + i), oy), iy);
+        __m512 t1z = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.min_z + i), oz), iz);
+        __m512 t2z = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(b.max_z + i), oz), iz);
+        __m512 tmin = _mm512_max_ps(_mm512_max_ps(_mm512_min_ps(t1x, t2x), _mm512_min_ps(t1y, t2y)), _mm512_min_ps(t1z, t2z));
+        __m512 tmax = _mm512_min_ps(_mm512_min_ps(_mm512_max_ps(t1x, t2x), _mm512_max_ps(t1y, t2y)), _mm512_max_ps(t1z, t2z));
+        __mmask16 mask = _mm512_cmp_ps_mask(tmax, tmin, _CMP_GE_OQ);
+        mask = _mm512_mask_cmp_ps_mask(mask, tmax, zero, _CMP_GE_OQ);
+        hits[i / 64] |= (uint64_t)mask << (i % 64);
+        if (distances != NULL)
+            _mm512_mask_storeu_ps(distances + i, mask, tmin);
+    }
+    ray_scalar(b, i, o, inv, hits, distances);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // COLLISIONS_X86
+
+//------------------------------------------------------------------------------
+// Escolha da versão em tempo de execução
+
+static CollisionsSimdLevel Collisions_DetectSimdLevel()
+{
+#ifdef COLLISIONS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return COLLISIONS_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return COLLISIONS_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return COLLISIONS_SSE;
+#endif
+    return COLLISIONS_SCALAR;
+}
+
+static const CollisionsSimdLevel g_CollisionsSupportedLevel = Collisions_DetectSimdLevel();
+static CollisionsSimdLevel g_CollisionsLevel = g_CollisionsSupportedLevel;
+
+CollisionsSimdLevel Collisions_SimdLevel()
+{
+    return g_CollisionsLevel;
+}
+
+CollisionsSimdLevel Collisions_SetSimdLevel(CollisionsSimdLevel level)
+{
+    g_CollisionsLevel = level < g_CollisionsSupportedLevel ? level : g_CollisionsSupportedLevel;
+    return g_CollisionsLevel;
+}
+
+const char* Collisions_SimdLevelName(CollisionsSimdLevel level)
+{
+    static const char* names[] = { "escalar", "SSE", "AVX2", "AVX-512" };
+    return names[level];
+}
+
+void Collisions_AABBBatch(const AABBArrays& boxes, glm::vec3 bbox_min, glm::vec3 bbox_max, uint64_t* hits)
+{
+    memset(hits, 0, Collisions_HitWords(boxes.count) * sizeof(uint64_t));
+    switch (g_CollisionsLevel)
+    {
+#ifdef COLLISIONS_X86
+        case COLLISIONS_AVX512: aabb_avx512(boxes, bbox_min, bbox_max, hits); return;
+        case COLLISIONS_AVX2:   aabb_avx2(boxes, bbox_min, bbox_max, hits); return;
+        case COLLISIONS_SSE:    aabb_sse(boxes, bbox_min, bbox_max, hits); return;
+#endif
+        default:                aabb_scalar(boxes, 0, bbox_min, bbox_max, hits); return;
+    }
+}
+
+void Collisions_SphereBatch(const AABBArrays& boxes, glm::vec3 sphere_center, float radius, uint64_t* hits)
+{
+    memset(hits, 0, Collisions_HitWords(boxes.count) * sizeof(uint64_t));
+    switch (g_CollisionsLevel)
+    {
+#ifdef COLLISIONS_X86
+        case COLLISIONS_AVX512: sphere_avx512(boxes, sphere_center, radius, hits); return;
+        case COLLISIONS_AVX2:   sphere_avx2(boxes, sphere_center, radius, hits); return;
+        case COLLISIONS_SSE:    sphere_sse(boxes, sphere_center, radius, hits); return;
+#endif
+        default:                sphere_scalar(boxes, 0, sphere_center, radius, hits); return;
+    }
+}
+
+void Collisions_RayBatch(const AABBArrays& boxes, glm::vec3 ray_origin, glm::vec3 ray, uint64_t* hits, float* distances)
+{
+    memset(hits, 0, Collisions_HitWords(boxes.count) * sizeof(uint64_t));
+    glm::vec3 inv = glm::vec3(1.0f / ray.x, 1.0f / ray.y, 1.0f / ray.z);
+    switch (g_CollisionsLevel)
+    {
+#ifdef COLLISIONS_X86
+        case COLLISIONS_AVX512: ray_avx512(boxes, ray_origin, inv, hits, distances); return;
+        case COLLISIONS_AVX2:   ray_avx2(boxes, ray_origin, inv, hits, distances); return;
+        case COLLISIONS_SSE:    ray_sse(boxes, ray_origin, inv, hits, distances); return;
+#endif
+        default:                ray_scalar(boxes, 0, ray_origin, inv, hits, distances); return;
+    }
+}
@@ -0,0 +1,193 @@
+// Profiler de CPU por zonas. Veja "include/cpu_profiler.h".
+#include "cpu_profiler.h"
+
+#ifdef CPU_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define CPU_PROFILER_RING_SIZE 65536 // Zonas guardadas por thread; as mais antigas são sobrescritas
+#define CPU_PROFILER_WRITE_MARGIN 4096 // Zonas mais antigas do anel que CpuProfiler_WriteTrace() nem copia
+
+// Os campos são atômicos (com acesso "relaxed", que no x86 são leituras e
+// escritas comuns) porque CpuProfiler_WriteTrace() os lê enquanto a thread
+// dona do anel pode estar sobrescrevendo-os
+struct CpuProfilerEvent
+{
+    std::atomic<const char*> name;
+    std::atomic<uint64_t>    start; // Nanossegundos desde o início do programa
+    std::atomic<uint64_t>    end;
+};
+
+// Cópia de uma zona, feita por CpuProfiler_WriteTrace()
+struct CpuProfilerEventCopy
+{
+    const char* name;
+    uint64_t    start;
+    uint64_t    end;
+};
+
+// Anel de zonas de uma thread. Somente a própria thread escreve nele; o
+// contador é atômico para que CpuProfiler_WriteTrace() possa ser chamada
+// enquanto as outras threads continuam registrando zonas. A leitura segue o
+// padrão de um "seqlock": as zonas são copiadas entre duas leituras do
+// contador, e as que podem ter sido sobrescritas durante a cópia são
+// descartadas.
+struct CpuProfilerThread
+{
+    int         id;
+    std::string name;
+    std::unique_ptr<CpuProfilerEvent[]> events;
+    std::atomic<uint64_t> count; // Zonas registradas desde o início (índice = count % tamanho)
+
+    CpuProfilerThread() : id(0), count(0) {}
+};
+
+// Todas as threads que já registraram zonas. Os anéis não são liberados
+// quando a thread termina, para que suas zonas apareçam no trace.
+static std::mutex g_CpuProfilerMutex;
+static std::vector<std::unique_ptr<CpuProfilerThread> > g_CpuProfilerThreads;
+static const std::chrono::steady_clock::time_point g_CpuProfilerEpoch = std::chrono::steady_clock::now();
+
+static thread_local CpuProfilerThread* t_CpuProfilerThread = NULL;
+
+static uint64_t CpuProfiler_Now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_CpuProfilerEpoch).count();
+}
+
+// Anel da thread atual, criado no primeiro uso
+static CpuProfilerThread* CpuProfiler_Thread()
+{
+    if (t_CpuProfilerThread != NULL)
+        return t_CpuProfilerThread;
+
+    std::unique_ptr<CpuProfilerThread> thread(new CpuProfilerThread());
+    thread->events.reset(new CpuProfilerEvent[CPU_PROFILER_RING_SIZE]);
+
+    std::lock_guard<std::mutex> lock(g_CpuProfilerMutex);
+    thread->id = (int)g_CpuProfilerThreads.size();
+    thread->name = "thread " + std::to_string(thread->id);
+    t_CpuProfilerThread = thread.get();
+    g_CpuProfilerThreads.push_back(std::move(thread));
+    return t_CpuProfilerThread;
+}
+
+CpuProfilerZone::CpuProfilerZone(const char* name)
+    : name(name), start(CpuProfiler_Now())
+{
+}
+
+CpuProfilerZone::~CpuProfilerZone()
+{
+    uint64_t end = CpuProfiler_Now();
+    CpuProfilerThread* thread = CpuProfiler_Thread();
+    uint64_t count = thread->count.load(std::memory_order_relaxed);
+
+    // Ordena as escritas abaixo depois do contador atual: quem ler estes
+    // valores e depois o contador vê pelo menos "count"
+    std::atomic_thread_fence(std::memory_order_release);
+
+    CpuProfilerEvent& event = thread->events[count % CPU_PROFILER_RING_SIZE];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    thread->count.store(count + 1, std::memory_order_release);
+}
+
+void CpuProfiler_SetThreadName(const char* name)
+{
+    CpuProfilerThread* thread = CpuProfiler_Thread();
+    std::lock_guard<std::mutex> lock(g_CpuProfilerMutex);
+    thread->name = name;
+}
+
+// Escreve "str" entre aspas, escapando os caracteres especiais do JSON
+static void CpuProfiler_WriteString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char)*c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+bool CpuProfiler_WriteTrace(const char* filename)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot write CPU trace \"%s\".\n", filename);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_CpuProfilerMutex);
+
+    // Zonas completas ("ph":"X"), com instantes em microssegundos
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    size_t num_events = 0;
+    for (size_t t = 0; t < g_CpuProfilerThreads.size(); ++t)
+    {
+        const CpuProfilerThread& thread = *g_CpuProfilerThreads[t];
+
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                first ? "" : ",\n", thread.id);
+        CpuProfiler_WriteString(file, thread.name.c_str());
+        fprintf(file, "}}");
+        first = false;
+
+        // Copia as zonas terminadas até agora, menos as mais antigas, que
+        // a thread provavelmente sobrescreveria durante a cópia
+        const uint64_t kept = CPU_PROFILER_RING_SIZE - CPU_PROFILER_WRITE_MARGIN;
+        uint64_t count = thread.count.load(std::memory_order_acquire);
+        uint64_t begin = count > kept ? count - kept : 0;
+        std::vector<CpuProfilerEventCopy> events((size_t)(count - begin));
+        for (uint64_t i = begin; i < count; ++i)
+        {
+            const CpuProfilerEvent& event = thread.events[i % CPU_PROFILER_RING_SIZE];
+            CpuProfilerEventCopy& copy = events[(size_t)(i - begin)];
+            copy.name = event.name.load(std::memory_order_relaxed);
+            copy.start = event.start.load(std::memory_order_relaxed);
+            copy.end = event.end.load(std::memory_order_relaxed);
+        }
+
+        // Com o contador em "after", a zona "after" pode estar sendo escrita
+        // por cima da zona "after - tamanho do anel"; essa e as anteriores
+        // podem ter sido copiadas pela metade
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = thread.count.load(std::memory_order_relaxed);
+        uint64_t valid = after >= CPU_PROFILER_RING_SIZE ? after - CPU_PROFILER_RING_SIZE + 1 : 0;
+        size_t skipped = valid > begin ? (size_t)std::min(valid - begin, count - begin) : 0;
+
+        for (size_t i = skipped; i < events.size(); ++i)
+        {
+            const CpuProfilerEventCopy& event = events[i];
+            fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"cpu\",\"name\":");
+            CpuProfiler_WriteString(file, event.name);
+            fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread.id, event.start / 1e3, (event.end - event.start) / 1e3);
+        }
+        num_events += events.size() - skipped;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Trace de CPU salvo em \"%s\" (%d zonas).\n", filename, (int)num_events);
+    return true;
+}
+
+#endif // CPU_PROFILER
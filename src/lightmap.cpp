@@ -0,0 +1,595 @@
+// "Baker" de lightmaps: traçado de raios em pacotes sobre a BVH de
+// "include/mesh_bvh.h" e geração dos atlas dos objetos estáticos. Veja
+// "include/lightmap.h".
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <glad/glad.h>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include "cpu_profiler.h"
+#include "lightmap.h"
+#include "mesh_bvh.h"
+#include "parallel.h"
+
+#define LIGHTMAP_MAGIC 0x50414d4cu // "LMAP"
+#define LIGHTMAP_RAY_EPSILON 2e-3f
+
+// ----------------------------------------------------------------------------
+// Disposição dos triângulos no atlas
+
+LightmapLayout Lightmap_Layout(int num_triangles)
+{
+    LightmapLayout layout;
+    layout.num_triangles = num_triangles;
+
+    int num_cells = std::max(1, (num_triangles + 1) / 2);
+    layout.grid = (int)std::ceil(std::sqrt((double)num_cells));
+
+    layout.size = LIGHTMAP_MIN_SIZE;
+    while (layout.size < layout.grid * LIGHTMAP_TEXELS_PER_CELL && layout.size < LIGHTMAP_MAX_SIZE)
+        layout.size *= 2;
+
+    // Margem de 1.5 texel, para que a filtragem bilinear não misture texels
+    // de triângulos vizinhos no atlas
+    layout.margin = std::min(0.2f, 1.5f * layout.grid / layout.size);
+    return layout;
+}
+
+// Posição de um vértice dentro da sua célula. O triângulo par ocupa o canto
+// inferior esquerdo da célula e o ímpar o canto superior direito.
+static glm::vec2 CellCorner(const LightmapLayout& layout, int triangle, int vertex)
+{
+    float m = layout.margin;
+    static const float even[3][2] = { {0,0}, {1,0}, {0,1} };
+    static const float odd[3][2]  = { {1,1}, {0,1}, {1,0} };
+    const float* corner = (triangle % 2 == 0) ? even[vertex] : odd[vertex];
+
+    // Cantos em 0 viram m e cantos em 1 viram 1-2m (triângulo par); o
+    // triângulo ímpar é o espelho do par em relação ao centro da célula
+    float x = corner[0] > 0.5f ? 1.0f - 2.0f*m : m;
+    float y = corner[1] > 0.5f ? 1.0f - 2.0f*m : m;
+    if (triangle % 2 != 0)
+    {
+        x = 1.0f - x;
+        y = 1.0f - y;
+    }
+    return glm::vec2(x, y);
+}
+
+glm::vec2 Lightmap_VertexUV(const LightmapLayout& layout, int triangle, int vertex)
+{
+    int cell = triangle / 2;
+    glm::vec2 cell_origin = glm::vec2((float)(cell % layout.grid), (float)(cell / layout.grid));
+    return (cell_origin + CellCorner(layout, triangle, vertex)) / (float)layout.grid;
+}
+
+// Encontra o triângulo que contém o centro do texel (x,y) e as coordenadas
+// baricêntricas (b1, b2) do ponto em relação aos vértices 1 e 2. Os texels
+// da margem recebem o ponto mais próximo do triângulo. Retorna -1 para
+// texels fora de todos os triângulos.
+static int TexelToTriangle(const LightmapLayout& layout, int x, int y, float* b1, float* b2)
+{
+    float u = (x + 0.5f) / layout.size * layout.grid;
+    float v = (y + 0.5f) / layout.size * layout.grid;
+    int cell_x = (int)u;
+    int cell_y = (int)v;
+    if (cell_x >= layout.grid || cell_y >= layout.grid)
+        return -1;
+
+    float lx = u - cell_x;
+    float ly = v - cell_y;
+    float m = layout.margin;
+    int triangle = 2 * (cell_y * layout.grid + cell_x);
+    if (lx + ly <= 1.0f)
+    {
+        *b1 = (lx - m) / (1.0f - 3.0f*m);
+        *b2 = (ly - m) / (1.0f - 3.0f*m);
+    }
+    else
+    {
+        triangle += 1;
+        *b1 = (1.0f - m - lx) / (1.0f - 3.0f*m);
+        *b2 = (1.0f - m - ly) / (1.0f - 3.0f*m);
+    }
+    if (triangle >= layout.num_triangles)
+        return -1;
+
+    *b1 = std::max(*b1, 0.0f);
+    *b2 = std::max(*b2, 0.0f);
+    float sum = *b1 + *b2;
+    if (sum > 1.0f)
+    {
+        *b1 /= sum;
+        *b2 /= sum;
+    }
+    return triangle;
+}
+
+// ----------------------------------------------------------------------------
+// Cena
+
+// Triângulos de todos os objetos, em coordenadas globais, na mesma BVH das
+// malhas ("mesh_bvh.h"). Os dados usados só pelo baker ficam em arrays
+// paralelos, na ordem de MeshBVH::triangles.
+struct BakeScene
+{
+    MeshBVH                    mesh;
+    std::vector<glm::vec3>     normals;     // Normal geométrica
+    std::vector<unsigned char> cast_shadow; // Bloqueia a luz principal
+};
+
+static void BuildScene(BakeScene& scene, const std::vector<LightmapObject>& objects)
+{
+    std::vector<glm::vec4> positions;
+    std::vector<unsigned char> cast_shadow;
+    for (size_t o = 0; o < objects.size(); ++o)
+    {
+        const LightmapObject& object = objects[o];
+        const std::vector<glm::vec4>& object_positions = object.mesh->positions;
+        for (size_t i = 0; i + 2 < object_positions.size(); i += 3)
+        {
+            glm::vec4 a = object.model * object_positions[i + 0];
+            glm::vec4 b = object.model * object_positions[i + 1];
+            glm::vec4 c = object.model * object_positions[i + 2];
+            if (glm::length(glm::cross(glm::vec3(b - a), glm::vec3(c - a))) < 1e-12f)
+                continue; // Triângulo degenerado
+
+            positions.push_back(a);
+            positions.push_back(b);
+            positions.push_back(c);
+            cast_shadow.push_back(object.cast_shadow ? 1 : 0);
+        }
+    }
+
+    std::vector<int> order;
+    MeshBVH_Build(scene.mesh, positions, &order);
+    scene.normals.resize(order.size());
+    scene.cast_shadow.resize(order.size());
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        const MeshBVHTriangle& tri = scene.mesh.triangles[k];
+        scene.normals[k] = glm::normalize(glm::cross(tri.e1, tri.e2));
+        scene.cast_shadow[k] = cast_shadow[order[k]];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Pacotes de 4 raios
+
+struct RayPacket
+{
+    float ox[4], oy[4], oz[4];
+    float dx[4], dy[4], dz[4];
+    float tmax[4];
+    int   triangle[4]; // Triângulo mais próximo, ou -1
+    int   active;      // Bits dos raios que ainda estão sendo traçados
+};
+
+// Máscara dos raios ativos que intersectam a caixa do nó antes de tmax
+static int IntersectBox4(const MeshBVHNode& node, const RayPacket& ray, const float* inv_x, const float* inv_y, const float* inv_z)
+{
+#if defined(__SSE2__)
+    __m128 ox = _mm_loadu_ps(ray.ox), oy = _mm_loadu_ps(ray.oy), oz = _mm_loadu_ps(ray.oz);
+    __m128 ix = _mm_loadu_ps(inv_x), iy = _mm_loadu_ps(inv_y), iz = _mm_loadu_ps(inv_z);
+
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_min.x), ox), ix);
+    __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_max.x), ox), ix);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_min.y), oy), iy);
+    __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_max.y), oy), iy);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_min.z), oz), iz);
+    __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbox_max.z), oz), iz);
+
+    __m128 tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)),
+                              _mm_max_ps(_mm_min_ps(tz1, tz2), _mm_setzero_ps()));
+    __m128 tfar  = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)),
+                              _mm_min_ps(_mm_max_ps(tz1, tz2), _mm_loadu_ps(ray.tmax)));
+    return _mm_movemask_ps(_mm_cmple_ps(tnear, tfar)) & ray.active;
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        float tx1 = (node.bbox_min.x - ray.ox[i]) * inv_x[i], tx2 = (node.bbox_max.x - ray.ox[i]) * inv_x[i];
+        float ty1 = (node.bbox_min.y - ray.oy[i]) * inv_y[i], ty2 = (node.bbox_max.y - ray.oy[i]) * inv_y[i];
+        float tz1 = (node.bbox_min.z - ray.oz[i]) * inv_z[i], tz2 = (node.bbox_max.z - ray.oz[i]) * inv_z[i];
+        float tnear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+        float tfar  = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), ray.tmax[i]));
+        if (tnear <= tfar)
+            mask |= 1 << i;
+    }
+    return mask & ray.active;
+#endif
+}
+
+// Máscara dos raios (dentre "mask") que intersectam o triângulo antes de
+// tmax, com as distâncias em "t". Algoritmo de Möller-Trumbore, sem descartar
+// faces de trás.
+static int IntersectTriangle4(const MeshBVHTriangle& tri, const RayPacket& ray, int mask, float* t)
+{
+#if defined(__SSE2__)
+    __m128 dx = _mm_loadu_ps(ray.dx), dy = _mm_loadu_ps(ray.dy), dz = _mm_loadu_ps(ray.dz);
+    __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+    __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // s = o - v0
+    __m128 sx = _mm_sub_ps(_mm_loadu_ps(ray.ox), _mm_set1_ps(tri.v0.x));
+    __m128 sy = _mm_sub_ps(_mm_loadu_ps(ray.oy), _mm_set1_ps(tri.v0.y));
+    __m128 sz = _mm_sub_ps(_mm_loadu_ps(ray.oz), _mm_set1_ps(tri.v0.z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 abs_det = _mm_max_ps(det, _mm_sub_ps(zero, det));
+    __m128 hit = _mm_cmpgt_ps(abs_det, _mm_set1_ps(1e-12f));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(tt, _mm_set1_ps(LIGHTMAP_RAY_EPSILON)));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(tt, _mm_loadu_ps(ray.tmax)));
+    _mm_storeu_ps(t, tt);
+    return _mm_movemask_ps(hit) & mask;
+#else
+    int result = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!(mask & (1 << i)))
+            continue;
+        glm::vec3 d = glm::vec3(ray.dx[i], ray.dy[i], ray.dz[i]);
+        glm::vec3 p = glm::cross(d, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if (std::fabs(det) <= 1e-12f)
+            continue;
+        float inv_det = 1.0f / det;
+        glm::vec3 s = glm::vec3(ray.ox[i], ray.oy[i], ray.oz[i]) - tri.v0;
+        float u = glm::dot(s, p) * inv_det;
+        glm::vec3 q = glm::cross(s, tri.e1);
+        float v = glm::dot(d, q) * inv_det;
+        t[i] = glm::dot(tri.e2, q) * inv_det;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t[i] > LIGHTMAP_RAY_EPSILON && t[i] < ray.tmax[i])
+            result |= 1 << i;
+    }
+    return result;
+#endif
+}
+
+// Traça os raios ativos do pacote. Raios de sombra ("shadow") ignoram os
+// triângulos que não projetam sombra e são desativados na primeira
+// interseção; os demais procuram a interseção mais próxima.
+static void TracePacket(const BakeScene& scene, RayPacket& ray, bool shadow)
+{
+    float inv_x[4], inv_y[4], inv_z[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        inv_x[i] = 1.0f / (std::fabs(ray.dx[i]) > 1e-20f ? ray.dx[i] : 1e-20f);
+        inv_y[i] = 1.0f / (std::fabs(ray.dy[i]) > 1e-20f ? ray.dy[i] : 1e-20f);
+        inv_z[i] = 1.0f / (std::fabs(ray.dz[i]) > 1e-20f ? ray.dz[i] : 1e-20f);
+        ray.triangle[i] = -1;
+    }
+
+    // Percurso sem pilha da BVH (veja "mesh_bvh.h"): um nó é descartado
+    // quando nenhum raio ativo do pacote atinge a sua caixa
+    const std::vector<MeshBVHNode>& nodes = scene.mesh.nodes;
+    int num_nodes = (int)nodes.size();
+    int n = 0;
+    while (n < num_nodes && ray.active)
+    {
+        const MeshBVHNode& node = nodes[n];
+        int mask = IntersectBox4(node, ray, inv_x, inv_y, inv_z);
+        if (mask == 0)
+        {
+            n = node.skip;
+            continue;
+        }
+
+        if (node.num_triangles == 0)
+        {
+            ++n;
+            continue;
+        }
+
+        for (int i = node.first_triangle; i < node.first_triangle + node.num_triangles; ++i)
+        {
+            const MeshBVHTriangle& tri = scene.mesh.triangles[i];
+            if (shadow && !scene.cast_shadow[i])
+                continue;
+
+            float t[4];
+            int hits = IntersectTriangle4(tri, ray, mask, t);
+            if (hits == 0)
+                continue;
+
+            if (shadow)
+            {
+                ray.active &= ~hits;
+                mask &= ~hits;
+                if (mask == 0)
+                    break;
+                continue;
+            }
+
+            for (int r = 0; r < 4; ++r)
+            {
+                if (hits & (1 << r))
+                {
+                    ray.tmax[r] = t[r];
+                    ray.triangle[r] = i;
+                }
+            }
+        }
+        n = node.skip;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Baking
+
+// Gerador xorshift, com uma semente por texel para que o resultado não
+// dependa da ordem de execução das threads
+static float NextRandom(unsigned int& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+static void SetRay(RayPacket& ray, int i, const glm::vec3& origin, const glm::vec3& direction, float tmax)
+{
+    ray.ox[i] = origin.x;    ray.oy[i] = origin.y;    ray.oz[i] = origin.z;
+    ray.dx[i] = direction.x; ray.dy[i] = direction.y; ray.dz[i] = direction.z;
+    ray.tmax[i] = tmax;
+    ray.active |= 1 << i;
+}
+
+static glm::vec4 BakeTexel(const BakeScene& scene, const LightmapSettings& settings,
+                           const glm::vec3& light, glm::vec3 p, glm::vec3 n, unsigned int seed)
+{
+    p += n * LIGHTMAP_RAY_EPSILON;
+
+    // Luz direta da luz principal
+    glm::vec3 direct = glm::vec3(0.0f);
+    float n_dot_l = glm::dot(n, light);
+    if (n_dot_l > 0.0f)
+    {
+        RayPacket shadow_ray;
+        shadow_ray.active = 0;
+        for (int i = 0; i < 4; ++i)
+            SetRay(shadow_ray, i, p, light, 1e30f);
+        shadow_ray.active = 1;
+        TracePacket(scene, shadow_ray, true);
+        if (shadow_ray.active)
+            direct = settings.light_color * n_dot_l;
+    }
+
+    // Base ortonormal em torno da normal para as amostras do hemisfério
+    glm::vec3 tangent = std::fabs(n.x) > 0.5f ? glm::vec3(0.0f,1.0f,0.0f) : glm::vec3(1.0f,0.0f,0.0f);
+    tangent = glm::normalize(glm::cross(tangent, n));
+    glm::vec3 bitangent = glm::cross(n, tangent);
+
+    unsigned int state = seed * 747796405u + 2891336453u;
+    if (state == 0)
+        state = 1;
+
+    glm::vec3 indirect = glm::vec3(0.0f);
+    float occlusion = 0.0f;
+    for (int s = 0; s < settings.samples; s += 4)
+    {
+        // Amostras com distribuição proporcional ao cosseno: a média da
+        // radiância que chega é a irradiância dividida por pi, o mesmo fator
+        // que a BRDF de Lambert aplica
+        RayPacket ray;
+        ray.active = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            float r1 = NextRandom(state);
+            float r2 = NextRandom(state);
+            float phi = 6.28318530718f * r1;
+            float r = std::sqrt(r2);
+            glm::vec3 direction = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(std::max(0.0f, 1.0f - r2));
+            SetRay(ray, i, p, direction, 1e30f);
+        }
+        TracePacket(scene, ray, false);
+
+        // Luz direta nos pontos atingidos, com novos raios de sombra
+        RayPacket bounce;
+        bounce.active = 0;
+        glm::vec3 bounce_light[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            bounce_light[i] = glm::vec3(0.0f);
+            if (ray.triangle[i] < 0)
+                continue;
+            if (ray.tmax[i] < settings.ao_distance)
+                occlusion += 1.0f - ray.tmax[i] / settings.ao_distance;
+
+            glm::vec3 direction = glm::vec3(ray.dx[i], ray.dy[i], ray.dz[i]);
+            glm::vec3 hit_normal = scene.normals[ray.triangle[i]];
+            if (glm::dot(hit_normal, direction) > 0.0f)
+                hit_normal = -hit_normal;
+            float hit_n_dot_l = glm::dot(hit_normal, light);
+            if (hit_n_dot_l <= 0.0f)
+                continue;
+
+            glm::vec3 hit = p + direction * ray.tmax[i] + hit_normal * LIGHTMAP_RAY_EPSILON;
+            SetRay(bounce, i, hit, light, 1e30f);
+            bounce_light[i] = settings.albedo * settings.light_color * hit_n_dot_l;
+        }
+        if (bounce.active)
+        {
+            int requested = bounce.active;
+            TracePacket(scene, bounce, true);
+            for (int i = 0; i < 4; ++i)
+                if ((requested & bounce.active) & (1 << i))
+                    indirect += bounce_light[i];
+        }
+    }
+
+    float num_samples = (float)std::max(settings.samples, 1);
+    return glm::vec4(direct + indirect / num_samples, 1.0f - occlusion / num_samples);
+}
+
+std::string Lightmap_Path(const std::string& name)
+{
+    return std::string(LIGHTMAP_DIR) + "/" + name + ".lm";
+}
+
+static bool SaveLightmap(const std::string& name, int size, const std::vector<glm::vec4>& texels)
+{
+    FILE* file = fopen(Lightmap_Path(name).c_str(), "wb");
+    if (!file)
+        return false;
+
+    unsigned int header[3] = { LIGHTMAP_MAGIC, (unsigned int)size, (unsigned int)size };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(texels.data(), sizeof(glm::vec4), texels.size(), file) == texels.size();
+    fclose(file);
+    return ok;
+}
+
+void Lightmap_Bake(const std::vector<LightmapObject>& objects, const LightmapSettings& settings)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
+
+    BakeScene scene;
+    BuildScene(scene, objects);
+
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Lightmaps: BVH com %d triângulos e %d nós em %.2f s, %d threads.\n",
+           (int)scene.mesh.triangles.size(), (int)scene.mesh.nodes.size(), build_seconds,
+           ParallelPool::instance().num_threads());
+
+#ifdef _WIN32
+    _mkdir(LIGHTMAP_DIR);
+#else
+    mkdir(LIGHTMAP_DIR, 0755);
+#endif
+
+    glm::vec3 light = glm::normalize(settings.light_direction);
+
+    for (size_t o = 0; o < objects.size(); ++o)
+    {
+        const LightmapObject& object = objects[o];
+        if (!object.bake)
+            continue;
+
+        auto object_start = std::chrono::steady_clock::now();
+
+        const MeshData& mesh = *object.mesh;
+        LightmapLayout layout = Lightmap_Layout(mesh.num_triangles());
+        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+        std::vector<glm::vec4> texels(layout.size * layout.size, glm::vec4(0.0f));
+
+        // Cada linha do atlas é uma tarefa independente
+        ParallelFor(layout.size, [&](int y) {
+            PROFILE_ZONE("lightmap: linha");
+            for (int x = 0; x < layout.size; ++x)
+            {
+                float b1, b2;
+                int triangle = TexelToTriangle(layout, x, y, &b1, &b2);
+                if (triangle < 0)
+                    continue;
+
+                float b0 = 1.0f - b1 - b2;
+                const glm::vec4* v = &mesh.positions[3*triangle];
+                glm::vec3 p = glm::vec3(object.model * (b0*v[0] + b1*v[1] + b2*v[2]));
+
+                glm::vec3 face_normal = glm::cross(glm::vec3(object.model * (v[1] - v[0])),
+                                                   glm::vec3(object.model * (v[2] - v[0])));
+                if (glm::length(face_normal) < 1e-12f)
+                    continue;
+
+                glm::vec3 n;
+                if (!mesh.normals.empty())
+                {
+                    const glm::vec4* vn = &mesh.normals[3*triangle];
+                    n = normal_matrix * glm::vec3(b0*vn[0] + b1*vn[1] + b2*vn[2]);
+                }
+                else
+                {
+                    n = face_normal;
+                }
+                if (glm::length(n) < 1e-12f)
+                    n = face_normal;
+                n = glm::normalize(n);
+
+                texels[y * layout.size + x] = BakeTexel(scene, settings, light, p, n,
+                                                        (unsigned int)((o + 1) * 2654435761u) ^ (unsigned int)(y * layout.size + x));
+            }
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - object_start).count();
+        bool saved = SaveLightmap(object.name, layout.size, texels);
+        printf("Lightmap \"%s\" (%dx%d, %d triângulos): %.2f s%s\n", object.name.c_str(),
+               layout.size, layout.size, layout.num_triangles, seconds,
+               saved ? "" : " -- ERRO ao salvar");
+    }
+}
+
+GLuint Lightmap_LoadTexture(const std::string& name)
+{
+    FILE* file = fopen(Lightmap_Path(name).c_str(), "rb");
+    if (!file)
+        return 0;
+
+    unsigned int header[3]; // magic, largura, altura
+    std::vector<glm::vec4> texels;
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == LIGHTMAP_MAGIC &&
+              header[1] > 0 && header[1] <= 8192 && header[2] > 0 && header[2] <= 8192;
+    if (ok)
+    {
+        texels.resize((size_t)header[1] * header[2]);
+        ok = fread(texels.data(), sizeof(glm::vec4), texels.size(), file) == texels.size();
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        fprintf(stderr, "ERROR: invalid lightmap \"%s\".\n", Lightmap_Path(name).c_str());
+        return 0;
+    }
+
+    // Sem mipmaps: os níveis menores misturariam triângulos vizinhos no atlas
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, header[1], header[2], 0, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture_id;
+}
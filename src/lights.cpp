@@ -0,0 +1,322 @@
+// Atribuição de luzes pontuais aos clusters do frustum ("clustered forward
+// shading"). Veja "include/lights.h".
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "cpu_profiler.h"
+#include "lights.h"
+#include "parallel.h"
+
+// Todas as luzes adicionadas por Lights_Add()
+static std::vector<PointLight> g_PointLights;
+
+// Texture buffers: um "buffer object" com os dados e uma textura que o
+// referencia, para cada um dos três.
+static GLuint g_LightDataBuffer, g_LightDataTexture;   // 2 texels RGBA32F por luz: (posição, raio), (cor * intensidade, 0)
+static GLuint g_LightGridBuffer, g_LightGridTexture;   // 1 texel RG32UI por cluster: (início em g_LightIndices, número de luzes)
+static GLuint g_LightIndexBuffer, g_LightIndexTexture; // 1 texel R16UI por entrada: índice da luz
+
+// AABB de cada cluster no sistema de coordenadas da câmera. Recalculadas
+// somente quando a projeção muda.
+static glm::vec4 g_ClusterMin[NUM_CLUSTERS];
+static glm::vec4 g_ClusterMax[NUM_CLUSTERS];
+static float g_ClusterFieldOfView = 0.0f, g_ClusterRatio = 0.0f;
+static float g_ClusterNear = 0.0f, g_ClusterFar = 0.0f;
+static ClusterUniforms g_ClusterUniforms;
+
+// Luzes candidatas de cada fatia em profundidade, em formato SoA
+// (structure of arrays) para os testes SIMD abaixo. O tamanho é sempre um
+// múltiplo de 4.
+struct SliceLights
+{
+    std::vector<float> x, y, z, radius2;
+    std::vector<unsigned short> index;
+};
+static SliceLights g_SliceLights[CLUSTER_Z];
+
+// Resultados de cada cluster antes da compactação
+static unsigned short g_ClusterLights[NUM_CLUSTERS][MAX_LIGHTS_PER_CLUSTER];
+static int g_ClusterLightCount[NUM_CLUSTERS];
+
+static std::vector<glm::vec4> g_LightData;
+static std::vector<GLuint> g_LightGrid;
+static std::vector<GLushort> g_LightIndices;
+
+static void CreateTextureBuffer(GLuint* buffer, GLuint* texture, GLenum format)
+{
+    glGenBuffers(1, buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_BUFFER, *texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Lights_Init()
+{
+    CreateTextureBuffer(&g_LightDataBuffer, &g_LightDataTexture, GL_RGBA32F);
+    CreateTextureBuffer(&g_LightGridBuffer, &g_LightGridTexture, GL_RG32UI);
+    CreateTextureBuffer(&g_LightIndexBuffer, &g_LightIndexTexture, GL_R16UI);
+}
+
+int Lights_Add(const glm::vec3& position, const glm::vec3& color, float radius, float intensity)
+{
+    if (g_PointLights.size() >= MAX_POINT_LIGHTS)
+        return -1;
+
+    PointLight light;
+    light.position = position;
+    light.radius = radius;
+    light.color = color;
+    light.intensity = intensity;
+    g_PointLights.push_back(light);
+    return (int)g_PointLights.size() - 1;
+}
+
+PointLight& Lights_Get(int light)
+{
+    return g_PointLights[light];
+}
+
+void Lights_Remove(int light)
+{
+    g_PointLights[light].radius = 0.0f;
+}
+
+void Lights_Clear()
+{
+    g_PointLights.clear();
+}
+
+int Lights_Count()
+{
+    return (int)g_PointLights.size();
+}
+
+ClusterUniforms Lights_GetClusterUniforms()
+{
+    return g_ClusterUniforms;
+}
+
+// Profundidade (positiva) do início da fatia "slice"
+static float SliceDepth(int slice, float n, float f)
+{
+    return n * powf(f / n, (float)slice / CLUSTER_Z);
+}
+
+// Calcula a AABB de cada cluster. Cada ladrilho da tela define uma pirâmide
+// a partir da câmera; a AABB do cluster envolve o trecho dessa pirâmide entre
+// as profundidades da sua fatia.
+static void ComputeClusterBounds(float field_of_view, float ratio, float n, float f)
+{
+    float t = tanf(field_of_view / 2.0f);
+    float r = t * ratio;
+
+    for (int k = 0; k < CLUSTER_Z; ++k)
+    {
+        float d0 = SliceDepth(k, n, f);
+        float d1 = SliceDepth(k + 1, n, f);
+        for (int j = 0; j < CLUSTER_Y; ++j)
+        {
+            float y0 = (-1.0f + 2.0f * j / CLUSTER_Y) * t;
+            float y1 = (-1.0f + 2.0f * (j + 1) / CLUSTER_Y) * t;
+            for (int i = 0; i < CLUSTER_X; ++i)
+            {
+                float x0 = (-1.0f + 2.0f * i / CLUSTER_X) * r;
+                float x1 = (-1.0f + 2.0f * (i + 1) / CLUSTER_X) * r;
+
+                // x0..x1 e y0..y1 estão na profundidade 1; a pirâmide é mais
+                // larga na profundidade d1.
+                int c = i + CLUSTER_X * (j + CLUSTER_Y * k);
+                g_ClusterMin[c] = glm::vec4(std::min(x0 * d0, x0 * d1), std::min(y0 * d0, y0 * d1), -d1, 0.0f);
+                g_ClusterMax[c] = glm::vec4(std::max(x1 * d0, x1 * d1), std::max(y1 * d0, y1 * d1), -d0, 0.0f);
+            }
+        }
+    }
+
+    g_ClusterUniforms.z_scale = CLUSTER_Z / logf(f / n);
+    g_ClusterUniforms.z_bias = -CLUSTER_Z * logf(n) / logf(f / n);
+}
+
+// Testa as luzes candidatas da fatia contra a AABB do cluster "c", quatro de
+// cada vez, e guarda os índices das que intersectam.
+static void AssignLightsToCluster(const SliceLights& lights, int c)
+{
+    const glm::vec4& bmin = g_ClusterMin[c];
+    const glm::vec4& bmax = g_ClusterMax[c];
+    int count = 0;
+    size_t n = lights.x.size();
+
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 min_x = _mm_set1_ps(bmin.x), max_x = _mm_set1_ps(bmax.x);
+    const __m128 min_y = _mm_set1_ps(bmin.y), max_y = _mm_set1_ps(bmax.y);
+    const __m128 min_z = _mm_set1_ps(bmin.z), max_z = _mm_set1_ps(bmax.z);
+
+    for (size_t i = 0; i < n && count < MAX_LIGHTS_PER_CLUSTER; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&lights.x[i]);
+        __m128 y = _mm_loadu_ps(&lights.y[i]);
+        __m128 z = _mm_loadu_ps(&lights.z[i]);
+
+        // Distância do centro da esfera até a AABB, por eixo
+        __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_x, x), zero), _mm_max_ps(_mm_sub_ps(x, max_x), zero));
+        __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_y, y), zero), _mm_max_ps(_mm_sub_ps(y, max_y), zero));
+        __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_z, z), zero), _mm_max_ps(_mm_sub_ps(z, max_z), zero));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&lights.radius2[i])));
+        for (int lane = 0; mask != 0 && count < MAX_LIGHTS_PER_CLUSTER; ++lane, mask >>= 1)
+            if (mask & 1)
+                g_ClusterLights[c][count++] = lights.index[i + lane];
+    }
+#else
+    for (size_t i = 0; i < n && count < MAX_LIGHTS_PER_CLUSTER; ++i)
+    {
+        float dx = std::max(bmin.x - lights.x[i], 0.0f) + std::max(lights.x[i] - bmax.x, 0.0f);
+        float dy = std::max(bmin.y - lights.y[i], 0.0f) + std::max(lights.y[i] - bmax.y, 0.0f);
+        float dz = std::max(bmin.z - lights.z[i], 0.0f) + std::max(lights.z[i] - bmax.z, 0.0f);
+        if (dx*dx + dy*dy + dz*dz <= lights.radius2[i])
+            g_ClusterLights[c][count++] = lights.index[i];
+    }
+#endif
+
+    g_ClusterLightCount[c] = count;
+}
+
+void Lights_Update(const glm::mat4& view, float field_of_view, float screen_ratio,
+                   float nearplane, float farplane, int framebuffer_width, int framebuffer_height)
+{
+    PROFILE_FUNCTION();
+
+    float n = fabsf(nearplane);
+    float f = fabsf(farplane);
+
+    if (field_of_view != g_ClusterFieldOfView || screen_ratio != g_ClusterRatio ||
+        n != g_ClusterNear || f != g_ClusterFar)
+    {
+        ComputeClusterBounds(field_of_view, screen_ratio, n, f);
+        g_ClusterFieldOfView = field_of_view;
+        g_ClusterRatio = screen_ratio;
+        g_ClusterNear = n;
+        g_ClusterFar = f;
+    }
+
+    g_ClusterUniforms.tile_scale_x = (float)CLUSTER_X / std::max(framebuffer_width, 1);
+    g_ClusterUniforms.tile_scale_y = (float)CLUSTER_Y / std::max(framebuffer_height, 1);
+
+    // Distribuímos as luzes entre as fatias em profundidade que elas
+    // alcançam, já no sistema de coordenadas da câmera.
+    for (int k = 0; k < CLUSTER_Z; ++k)
+    {
+        g_SliceLights[k].x.clear();
+        g_SliceLights[k].y.clear();
+        g_SliceLights[k].z.clear();
+        g_SliceLights[k].radius2.clear();
+        g_SliceLights[k].index.clear();
+    }
+
+    g_LightData.resize(2 * std::max(g_PointLights.size(), (size_t)1));
+    for (size_t l = 0; l < g_PointLights.size(); ++l)
+    {
+        const PointLight& light = g_PointLights[l];
+        g_LightData[2*l]     = glm::vec4(light.position, light.radius);
+        g_LightData[2*l + 1] = glm::vec4(light.color * light.intensity, 0.0f);
+
+        if (light.radius <= 0.0f)
+            continue;
+
+        glm::vec4 p = view * glm::vec4(light.position, 1.0f);
+        float depth_min = -p.z - light.radius;
+        float depth_max = -p.z + light.radius;
+        if (depth_max < n || depth_min > f)
+            continue;
+
+        int k0 = depth_min <= n ? 0 : (int)(logf(depth_min) * g_ClusterUniforms.z_scale + g_ClusterUniforms.z_bias);
+        int k1 = depth_max >= f ? CLUSTER_Z - 1 : (int)(logf(depth_max) * g_ClusterUniforms.z_scale + g_ClusterUniforms.z_bias);
+        k0 = std::max(0, std::min(k0, CLUSTER_Z - 1));
+        k1 = std::max(0, std::min(k1, CLUSTER_Z - 1));
+
+        for (int k = k0; k <= k1; ++k)
+        {
+            SliceLights& slice = g_SliceLights[k];
+            slice.x.push_back(p.x);
+            slice.y.push_back(p.y);
+            slice.z.push_back(p.z);
+            slice.radius2.push_back(light.radius * light.radius);
+            slice.index.push_back((unsigned short)l);
+        }
+    }
+
+    // Completamos cada fatia até um múltiplo de 4 com luzes que nunca
+    // intersectam um cluster (raio negativo).
+    for (int k = 0; k < CLUSTER_Z; ++k)
+    {
+        SliceLights& slice = g_SliceLights[k];
+        while (slice.x.size() % 4 != 0)
+        {
+            slice.x.push_back(0.0f);
+            slice.y.push_back(0.0f);
+            slice.z.push_back(0.0f);
+            slice.radius2.push_back(-1.0f);
+            slice.index.push_back(0);
+        }
+    }
+
+    // Cada fatia é processada por uma thread, escrevendo somente nos seus
+    // próprios clusters.
+    ParallelFor(CLUSTER_Z, [](int k)
+    {
+        int first = k * CLUSTER_X * CLUSTER_Y;
+        for (int c = first; c < first + CLUSTER_X * CLUSTER_Y; ++c)
+            AssignLightsToCluster(g_SliceLights[k], c);
+    });
+
+    // Compactamos as listas de todos os clusters em um único vetor
+    g_LightGrid.resize(2 * NUM_CLUSTERS);
+    g_LightIndices.clear();
+    for (int c = 0; c < NUM_CLUSTERS; ++c)
+    {
+        g_LightGrid[2*c]     = (GLuint)g_LightIndices.size();
+        g_LightGrid[2*c + 1] = (GLuint)g_ClusterLightCount[c];
+        g_LightIndices.insert(g_LightIndices.end(), g_ClusterLights[c], g_ClusterLights[c] + g_ClusterLightCount[c]);
+    }
+    if (g_LightIndices.empty())
+        g_LightIndices.push_back(0);
+
+    // Enviamos os dados para a GPU. Chamar glBufferData() a cada quadro
+    // permite que o driver use uma nova região de memória enquanto a GPU
+    // ainda lê a do quadro anterior.
+    glBindBuffer(GL_TEXTURE_BUFFER, g_LightDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, g_LightData.size() * sizeof(glm::vec4), g_LightData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, g_LightGridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, g_LightGrid.size() * sizeof(GLuint), g_LightGrid.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, g_LightIndexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, g_LightIndices.size() * sizeof(GLushort), g_LightIndices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Lights_BindTextures()
+{
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, g_LightDataTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_GRID_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, g_LightGridTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, g_LightIndexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
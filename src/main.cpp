@@ -15,6 +15,7 @@
 //  vira
 //    #include <cstdio> // Em C++
 //
+#include <cctype>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -30,6 +31,7 @@
 #include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <thread>
 
 // Headers das bibliotecas OpenGL
 #include <glad/glad.h>   // Criação de contexto OpenGL 3.3
@@ -47,7 +49,28 @@
 
 #include "types.h"
 #include "collisions.h"
+#include "broadphase.h"
+#include "aabb_tree.h"
 #include "mouse_picking.h"
+#include "materials.h"
+#include "program_cache.h"
+#include "lights.h"
+#include "shadows.h"
+#include "mesh_data.h"
+#include "lightmap.h"
+#include "mesh_builder.h"
+#include "collision_sdf.h"
+#include "depth_prepass.h"
+#include "dynamic_resolution.h"
+#include "shading_lod.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "simulation.h"
+#include "spline.h"
+#include "timeline.h"
+#include "frame_packet.h"
+#include "input_replay.h"
+#include "benchmark.h"
 
 
 // Headers locais, definidos na pasta "include/"
@@ -63,15 +86,49 @@
 #define PI2 1.57079632679
 #define PI4 0.78539816339
 
+// Identificadores das classes de material dos objetos (veja LoadMaterials())
+#define SPHERE      0
+#define BUNNY       1
+#define ROOM_FLOOR  2
+#define WALL_1      3
+#define SKYBOX      4
+#define WALL_1_SIDE 5
+#define TABLE       6
+#define CHESS       7
+#define BOWL        8
+#define WHITE_PIECE 9
+#define BLACK_PIECE 10
+#define CONSOLE_TABLE 11
+#define SOFA        12
+#define TV          13
+#define SHELF       14
+#define CHAIR       15
+#define BED         16
+#define BOOK_SHELF  17
+#define BOOKS       18
+#define ROOM_CEILING 19
+#define DRAWER      20
+#define NUM_MATERIALS 21
+
 // Declaração de várias funções utilizadas em main().  Essas estão definidas
 // logo após a definição de main() neste arquivo.
 void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constrói representação de um ObjModel como malha de triângulos para renderização
-void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso não existam.
-void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU
+void LoadMaterials(); // Define os parâmetros de cada classe de material
+void LoadLights(); // Adiciona as luzes pontuais da cena
+void LoadLightmaps(const std::vector<SceneObject*>& static_objects, const std::vector<SceneObject*>& baked_objects, bool bake); // Carrega (ou gera) os lightmaps dos objetos estáticos
+void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU por permutação
+void PollGpuPrograms(); // Ativa os programas de GPU cuja compilação em segundo plano terminou
+void ActivatePendingProgram(GpuProgram& program); // Substitui o programa ativo de uma permutação pelo recém-linkado
 void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
-GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
-GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
-void LoadShader(const char* filename, GLuint shader_id); // Função utilizada pelas duas acima
+bool BindMaterial(int object_id, bool lod = false); // Ativa o programa de GPU e os parâmetros de uma classe de material
+void DrawSceneObject(const glm::mat4& model, int object_id, const char* object_name, GLuint lightmap = 0, bool lod = false); // Desenha um objeto com o material indicado
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines = "");   // Carrega um vertex shader
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines = ""); // Carrega um fragment shader
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines); // Função utilizada pelas duas acima
+std::string LoadShaderSource(const char* filename, const std::string& defines); // Lê um arquivo GLSL, inserindo os #defines
+void InsertShaderDefines(std::string& source, const std::string& defines); // Insere #defines logo após a linha "#version"
+void PrintShaderLog(const char* filename, GLuint shader_id); // Imprime erros e "warnings" de compilação de um shader
+void PrintProgramLog(GLuint program_id); // Imprime erros de linkagem de um programa de GPU
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Cria um programa de GPU
 void PrintObjModelInfo(ObjModel*); // Função para debugging
 
@@ -80,7 +137,11 @@ void PrintObjModelInfo(ObjModel*); // Função para debugging
 void TextRendering_Init();
 float TextRendering_LineHeight(GLFWwindow* window);
 float TextRendering_CharWidth(GLFWwindow* window);
+void TextRendering_BeginFrame(GLFWwindow* window);
+void TextRendering_Flush();
 void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f);
+int  TextRendering_CacheString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f);
+void TextRendering_PrintCached(int text);
 void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale = 1.0f);
 void TextRendering_PrintVector(GLFWwindow* window, glm::vec4 v, float x, float y, float scale = 1.0f);
 void TextRendering_PrintMatrixVectorProduct(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
@@ -93,6 +154,10 @@ void TextRendering_Press_F_To_Open(GLFWwindow* window);
 void TextRendering_You_Lost(GLFWwindow* window);
 void TextRendering_Press_esc_to_close_game(GLFWwindow* window);
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window);
+void TextRendering_ShowSamplesPassed(GLFWwindow* window);
+void TextRendering_ShowResolutionScale(GLFWwindow* window);
+void TextRendering_ShowShadingLod(GLFWwindow* window);
+void TextRendering_ShowGpuProfile(GLFWwindow* window);
 
 // Funções callback para comunicação com o sistema operacional e interação do
 // usuário. Veja mais comentários nas definições das mesmas, abaixo.
@@ -103,9 +168,19 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
+// Tratamento da entrada na thread de simulação. Veja "frame_packet.h".
+void HandleKey(int key, int action);
+void HandleRenderKey(GLFWwindow* window, int key, int action);
+void HandleMouseButton(int button, int action, double xpos, double ypos);
+void HandleCursorPos(double xpos, double ypos);
+void HandleScroll(double yoffset);
+void HandleInputEvent(const InputEvent& event);
+
 void LoadTextureImage(const char* filename);
 void load_models();
-void draw_objects();
+void draw_objects(const std::vector<SceneObject*>& objects);
+bool compare_program(SceneObject* a, SceneObject* b);
+int GetMaterialIndex(int object_id);
 
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
@@ -114,6 +189,7 @@ void draw_objects();
 // objetos dentro da variável g_VirtualScene, e veja na função main() como
 // estes são acessados.
 std::map<std::string, SceneObject> g_VirtualScene;
+std::map<std::string, MeshData> g_MeshData; // Triângulos de cada objeto de g_VirtualScene, na CPU
 std::map<std::string, glm::mat4> pieces_initial_position;
 std::vector<SceneObject*> objects_to_draw;
 std::vector<SceneObject*> chess_pieces;
@@ -121,6 +197,11 @@ std::vector<SceneObject*> chess_pieces;
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Tamanho do framebuffer da janela em pixels. A cena é renderizada em uma
+// fração deste tamanho; veja FramebufferSizeCallback() e "dynamic_resolution.h".
+int g_FramebufferWidth = 800;
+int g_FramebufferHeight = 600;
+
 // Ângulos de Euler que controlam a rotação de um dos cubos da cena virtual
 float g_AngleX = 0.0f;
 float g_AngleY = 0.0f;
@@ -143,14 +224,22 @@ float g_CameraDistance = 3.5f; // Distância da câmera para a origem
 // Número de texturas carregadas pela função LoadTextureImage()
 GLuint g_NumLoadedTextures = 0;
 
-// Variáveis que definem um programa de GPU (shaders). Veja função LoadShadersFromFiles().
-GLuint g_GpuProgramID = 0;
-GLint g_model_uniform;
-GLint g_view_uniform;
-GLint g_projection_uniform;
-GLint g_object_id_uniform;
-GLint g_bbox_min_uniform;
-GLint g_bbox_max_uniform;
+// Classes de material, indexadas pelo identificador do objeto (SPHERE, BUNNY, ...),
+// e um programa de GPU especializado para cada permutação distinta dos
+// shaders. Veja funções LoadMaterials() e LoadShadersFromFiles().
+std::vector<Material> g_Materials;
+std::vector<GpuProgram> g_GpuPrograms;
+
+// Estado atual dos programas de GPU, para evitar trocas redundantes. Veja
+// função BindMaterial().
+// Desativado durante a inspeção de objetos, que são desenhados fora da sua
+// posição na sala. Veja "shadows.h".
+bool g_ShadowsEnabled = true;
+
+int g_CurrentProgram = -1;
+int g_CurrentMaterial = -1;
+glm::mat4 g_ViewMatrix;
+glm::mat4 g_ProjectionMatrix;
 
 
 SceneObject *interactable_object;
@@ -175,17 +264,17 @@ bool open_right_drawer = false;
 bool hidden_pieces[6] = {true, true, true, true, true, true};
 bool all_pieces_collected = false;
 bool game_ended = false;
+bool close_window_requested = false; // ESC com o jogo terminado
 bool y_axis_movement = false;
-float t_bezier = 0.0f;
-float t_bezier2 = 0.0f;
+float fst_anim_time = 0.0f; // Segundos desde o início da animação inicial
 
 glm::vec4 camera_view_vector;
 
-glm::vec3 calculateBezierPoint(const std::vector<glm::vec3>& controlPoints, float t);
-void move_with_collision(SceneObject player, std::vector<SceneObject*> objects_group, float delta_t, float speed, glm::vec4 w, glm::vec4 u);
-void drawer(float delta_t, SceneObject player, SceneObject& drawer_left, SceneObject& drawer_right, SceneObject& collectable1);
+#define COLLISION_MAX_SLIDES 3     // Contatos resolvidos por passo de movimento
+#define COLLISION_SKIN       0.001f // Folga mantida entre o jogador e o objeto tocado
+void move_with_collision(SceneObject& player, float delta_t, float speed, glm::vec4 w, glm::vec4 u);
+void drawer(float delta_t, SceneObject& player, SceneObject& drawer_left, SceneObject& drawer_right, SceneObject& collectable1);
 void play_game_anim(float delta_t);
-SceneObject* find_piece_by_name(std::string target_name);
 bool all_pieces_in_starting_pos();
 void capture_piece(SceneObject* piece);
 
@@ -197,16 +286,16 @@ white_queen -> drawer
 black_queen -> table
 g_black_pawn -> sofa
 */
-glm::vec4 h5_position = glm::vec4(-4.260000, 0.230000, -3.830000, 1.000000);
-glm::vec4 f6_position = glm::vec4(-4.000000, 0.230000, -3.690000, 1.000000);
-glm::vec4 c4_position = glm::vec4(-3.600000, 0.230000, -3.970000, 1.000000);
-glm::vec4 c6_position = glm::vec4(-3.600000, 0.230000, -3.690000, 1.000000);
-glm::vec4 e4_position = glm::vec4(-3.870000, 0.230000, -3.970000, 1.000000);
-glm::vec4 e5_position = glm::vec4(-3.870000, 0.230000, -3.840000, 1.000000);
-
 glm::vec4 captured_black_piece_next_position = glm::vec4(-4.450f,0.20f,-3.42f, 1.0f);
+
+// Animação final (veja "timeline.h" e data/animations/final_move.anim)
+Timeline final_move;
+void end_game(SceneObject* target);
 int main(int argc, char* argv[])
 {
+    // Veja "cpu_profiler.h" (somente com make PROFILE=1)
+    CpuProfiler_SetThreadName("principal");
+
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com OpenGL.
     int success = glfwInit();
@@ -231,6 +320,18 @@ int main(int argc, char* argv[])
     // funções modernas de OpenGL.
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // Modo de medição: "--benchmark [quadros]" e "--benchmark-output
+    // arquivo". A janela fica escondida. Veja "benchmark.h".
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--benchmark")
+            Benchmark_Start(i + 1 < argc && isdigit(argv[i + 1][0]) ? atoi(argv[i + 1]) : 0, NULL);
+        if (std::string(argv[i]) == "--benchmark-output" && i + 1 < argc)
+            g_Benchmark.output = argv[i + 1];
+    }
+    if (g_Benchmark.running)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
     // Criamos uma janela do sistema operacional, com 800 colunas e 600 linhas
     // de pixels, e com título "INF01047 ...".
     GLFWwindow* window;
@@ -259,6 +360,10 @@ int main(int argc, char* argv[])
     // biblioteca GLAD.
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
 
+    // Sem vsync nas medições
+    if (g_Benchmark.running)
+        glfwSwapInterval(0);
+
     // Definimos a função de callback que será chamada sempre que a janela for
     // redimensionada, por consequência alterando o tamanho do "framebuffer"
     // (região de memória onde são armazenados os pixels da imagem).
@@ -273,11 +378,38 @@ int main(int argc, char* argv[])
 
     printf("GPU: %s, %s, OpenGL %s, GLSL %s\n", vendor, renderer, glversion, glslversion);
 
+    // Verificamos o suporte a binários de programas e à compilação paralela
+    // de shaders. Veja o arquivo "program_cache.h".
+    ProgramCache_Init();
+
     // Carregamos os shaders de vértices e de fragmentos que serão utilizados
     // para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
+    // É criado um programa de GPU para cada permutação usada pelos materiais.
+    // Quando o driver suporta compilação paralela, os programas que não
+    // estão no cache em disco são compilados em segundo plano enquanto as
+    // texturas e modelos abaixo são carregados.
     //
+    LoadMaterials();
     LoadShadersFromFiles();
 
+    // Criamos os texture buffers das luzes pontuais e as luzes da cena
+    Lights_Init();
+    LoadLights();
+
+    // Mapas de sombra da luz principal (veja "shader_fragment.glsl"),
+    // cobrindo toda a sala
+    Shadows_Init(glm::vec4(1.0f, 1.0f, 0.5f, 0.0f), glm::vec4(-10.0f, -1.0f, -8.0f, 1.0f), glm::vec4(10.0f, 3.7f, 8.0f, 1.0f));
+
+    // Pré-passo de profundidade opcional (tecla P). Veja "depth_prepass.h".
+    DepthPrepass_Init();
+
+    // A cena 3D é renderizada fora da tela, com resolução ajustada ao tempo
+    // de GPU medido. Veja "dynamic_resolution.h".
+    DynamicResolution_Init();
+
+    // Tempo de GPU de cada passo, mostrado na tela. Veja "gpu_profiler.h".
+    GpuProfiler_Init();
+
     LoadTextureImage("../../data/tc-earth_daymap_surface.jpg");      // TextureImage0
     LoadTextureImage("../../data/tc-earth_nightmap_citylights.gif"); // TextureImage1
     LoadTextureImage("../../data/box/texture.jpg");                  // TextureImage2
@@ -306,33 +438,11 @@ int main(int argc, char* argv[])
 
     load_models();
 
-    #define SPHERE      0
-    #define BUNNY       1
-    #define ROOM_FLOOR  2
-    #define WALL_1      3
-    #define SKYBOX      4
-    #define WALL_1_SIDE 5
-    #define TABLE       6
-    #define CHESS       7
-    #define BOWL        8
-    #define WHITE_PIECE 9
-    #define BLACK_PIECE 10
-    #define CONSOLE_TABLE 11
-    #define SOFA        12
-    #define TV          13
-    #define SHELF       14
-    #define CHAIR       15
-    #define BED         16
-    #define BOOK_SHELF  17
-    #define BOOKS       18
-    #define ROOM_CEILING 19
-    #define DRAWER      20
-
-
     /* Criacao de objetos */
     SceneObject player = g_VirtualScene.at("the_sphere");
     player.set_name("player");
     player.set_inspectable(false);
+    player.set_collision_shape(COLLISION_CAPSULE);
     objects_to_draw.push_back(&player);
 
     // Chão principal
@@ -358,6 +468,7 @@ int main(int argc, char* argv[])
 
     SceneObject wall1 = g_VirtualScene.at("box.jpg");
     wall1.set_name("wall_1");
+    wall1.set_collision_shape(COLLISION_OBB);
     wall1.set_inspectable(false);
     wall1.scale(8.0f, 4.0f, 0.5f);
     wall1.set_position(0.0f,1.0f,-8.0f);
@@ -366,6 +477,7 @@ int main(int argc, char* argv[])
 
     SceneObject wall2 = g_VirtualScene.at("box.jpg");
     wall2.set_name("wall_2");
+    wall2.set_collision_shape(COLLISION_OBB);
     wall2.mRotate(0.0f,PI2,0.0f);
     wall2.scale(8.0f, 4.0f, 0.5f);
     wall2.set_position(-10.0f,1.0f,0.0f);
@@ -376,6 +488,7 @@ int main(int argc, char* argv[])
     // Parede 3
     SceneObject wall3 = g_VirtualScene.at("box.jpg");
     wall3.set_name("wall_3");
+    wall3.set_collision_shape(COLLISION_OBB);
     wall3.set_position(0.0f,1.0f,8.0f);
     wall3.scale(8.0f, 4.0f, 0.5f);
     wall3.set_inspectable(false);
@@ -385,6 +498,7 @@ int main(int argc, char* argv[])
     // Parede 4
     SceneObject wall4 = g_VirtualScene.at("box.jpg");
     wall4.set_name("wall_4");
+    wall4.set_collision_shape(COLLISION_OBB);
     wall4.mRotate(0.0f,PI2,0.0f);
     wall4.scale(8.0f, 4.0f, 0.5f);
     wall4.set_position(10.0f,1.0f,0.0f);
@@ -654,6 +768,7 @@ int main(int argc, char* argv[])
 
     SceneObject table2 = g_VirtualScene.at("console-table");
     table2.set_name("console_table");
+    table2.set_collision_shape(COLLISION_OBB);
     table2.scale(3.0f, 2.5f, 2.5f);
     table2.set_position(5.0f,-1.0f,-6.0f);
     table2.set_index(CONSOLE_TABLE);
@@ -662,6 +777,7 @@ int main(int argc, char* argv[])
 
     SceneObject sofa = g_VirtualScene.at("Rectangle001");
     sofa.set_name("sofa");
+    sofa.set_collision_shape(COLLISION_OBB);
     sofa.scale(0.002f, 0.002f, 0.0018f);
     sofa.set_position(1.0f,-1.0f,2.0f);
     sofa.mRotate(0,-PI2,0);
@@ -671,6 +787,7 @@ int main(int argc, char* argv[])
 
     SceneObject shelf = g_VirtualScene.at("shelf");
     shelf.set_name("shelf");
+    shelf.set_collision_shape(COLLISION_OBB);
     shelf.scale(7.0f,5.5f,5.5f);
     shelf.set_position(-9.0f,-1.0f,1.2f);
     shelf.mRotate(0,PI2,0);
@@ -680,6 +797,7 @@ int main(int argc, char* argv[])
 
     SceneObject tv = g_VirtualScene.at("smart-tv_Text");
     tv.set_name("tv");
+    tv.set_collision_shape(COLLISION_OBB);
     tv.scale(0.5f, 0.5f, 0.5f);
     tv.set_position(-9.0f,0.5f,1.2f);
     tv.mRotate(0,PI2,0);
@@ -719,12 +837,14 @@ int main(int argc, char* argv[])
     bed.scale(0.013f, 0.013f, 0.013f);
     bed.mRotate(0,-PI2,0);
     bed.set_name("bed");
+    bed.set_collision_shape(COLLISION_OBB);
     bed.set_position(8.0f, -1.0f, -5.0f);
     bed.set_index(BED);
     objects_to_draw.push_back(&bed);
 
     SceneObject book_shelf = g_VirtualScene.at("bookshelf-031");
     book_shelf.set_name("bookshelf");
+    book_shelf.set_collision_shape(COLLISION_OBB);
     book_shelf.scale(2.0f, 2.0f, 2.0f);
     book_shelf.mRotate(0,PI,0);
     book_shelf.set_position(-6.5f, -1.0f, 7.0f);
@@ -734,6 +854,7 @@ int main(int argc, char* argv[])
 
     SceneObject pack_book1 = g_VirtualScene.at("box.jpg");
     pack_book1.set_name("books");
+    pack_book1.set_collision_shape(COLLISION_OBB);
     pack_book1.scale(0.6f, 0.35f, 0.4f);
     pack_book1.set_position(-7.2f, 0.38f, 7.0f);
     pack_book1.set_index(BOOKS);
@@ -741,6 +862,7 @@ int main(int argc, char* argv[])
 
     SceneObject pack_book2 = g_VirtualScene.at("box.jpg");
     pack_book2.set_name("books");
+    pack_book2.set_collision_shape(COLLISION_OBB);
     pack_book2.scale(0.6f, 0.35f, 0.4f);
     pack_book2.set_position(-7.0f, 1.32f, 7.0f);
     pack_book2.set_index(BOOKS);
@@ -748,6 +870,7 @@ int main(int argc, char* argv[])
 
     SceneObject pack_book3 = g_VirtualScene.at("box.jpg");
     pack_book3.set_name("books");
+    pack_book3.set_collision_shape(COLLISION_OBB);
     pack_book3.scale(0.6f, 0.35f, 0.4f);
     pack_book3.set_position(-7.2f, 2.22f, 7.0f);
     pack_book3.set_index(BOOKS);
@@ -782,6 +905,12 @@ int main(int argc, char* argv[])
         }
     }
 
+    // As peças da animação final são resolvidas aqui, uma única vez
+    std::map<std::string, TimelineCallback> final_move_callbacks;
+    final_move_callbacks["capture_piece"] = capture_piece;
+    final_move_callbacks["end_game"] = end_game;
+    Timeline_Load(final_move, "../../data/animations/final_move.anim", chess_pieces, final_move_callbacks);
+
     std::vector<SceneObject*> objects_group = {&room_floor, &wall1, &wall2,
                                                 &wall3, &wall4, &table, &coelho,
                                                 &chess_board, &bowl, &black_king, &black_queen,
@@ -803,9 +932,112 @@ int main(int argc, char* argv[])
     left_white_bishop.set_position(-3.8f,-0.12f,-6.0f);
     left_white_bishop.mRotate(PI2, PI2, 0);
 
+    bool bake = false;
+    for (int i = 1; i < argc; ++i)
+        bake = bake || std::string(argv[i]) == "--bake";
+
+    // Colisões do jogador. As formas que nunca se movem entram no campo de
+    // distância pré-calculado (veja "collision_sdf.h"), recalculado somente
+    // se elas mudarem ou com --bake; a grade da fase ampla (veja
+    // "broadphase.h") fica só com as gavetas e as peças de xadrez. A árvore
+    // usada para achar o objeto para onde a câmera aponta (veja
+    // "aabb_tree.h") continua com todos os objetos.
+    std::vector<SceneObject*> moving_colliders;
+    std::vector<CollisionShape> static_shapes;
+    for(SceneObject* obj : objects_group){
+        if(!obj->has_collision()){
+            continue;
+        }
+        if(obj == &drawer_left || obj == &drawer_right ||
+           obj->get_index() == WHITE_PIECE || obj->get_index() == BLACK_PIECE){
+            moving_colliders.push_back(obj);
+        } else {
+            static_shapes.push_back(Collision_ObjectShape(*obj));
+        }
+    }
+    CollisionSDF_LoadOrBake(g_CollisionSDF, "room", static_shapes, bake);
+    Broadphase_Build(moving_colliders);
+    AABBTree_Build(objects_group);
+
+    // Objetos que projetam sombra. O chão, o teto e as paredes só recebem
+    // sombras (caso contrário a sala inteira ficaria na sombra do teto), e o
+    // jogador fica na posição da câmera. As gavetas e as peças de xadrez se
+    // movem durante o jogo e ficam na camada dinâmica.
+    room_floor.set_cast_shadow(false);
+    room_ceiling.set_cast_shadow(false);
+    wall1.set_cast_shadow(false);
+    wall2.set_cast_shadow(false);
+    wall3.set_cast_shadow(false);
+    wall4.set_cast_shadow(false);
+    player.set_cast_shadow(false);
+
+    std::vector<SceneObject*> static_casters;
+    std::vector<SceneObject*> dynamic_casters;
+    for(SceneObject* obj : objects_to_draw){
+        if(!obj->casts_shadow())
+            continue;
+        if(obj == &drawer_left || obj == &drawer_right ||
+           obj->get_index() == WHITE_PIECE || obj->get_index() == BLACK_PIECE){
+            dynamic_casters.push_back(obj);
+        } else {
+            static_casters.push_back(obj);
+        }
+    }
+    // Iluminação pré-calculada das superfícies estáticas da sala. Os objetos
+    // que se movem (e o jogador) não participam do cálculo.
+    std::vector<SceneObject*> lightmap_static_objects;
+    for(SceneObject* obj : objects_to_draw){
+        if(obj != &player && std::find(dynamic_casters.begin(), dynamic_casters.end(), obj) == dynamic_casters.end())
+            lightmap_static_objects.push_back(obj);
+    }
+    std::vector<SceneObject*> lightmap_baked_objects = {&room_floor, &room_ceiling, &wall1, &wall2,
+                                                        &wall3, &wall4, &shelf, &book_shelf, &bed};
+    LoadLightmaps(lightmap_static_objects, lightmap_baked_objects, bake);
+
+    // Agrupamos os objetos por programa de GPU, para que draw_objects() troque
+    // de programa o mínimo possível.
+    std::stable_sort(objects_to_draw.begin(), objects_to_draw.end(), compare_program);
+
+    // Cópias dos objetos usadas somente pela renderização, na mesma ordem de
+    // objects_to_draw. A cada quadro recebem as transformações calculadas
+    // pela simulação (veja "frame_packet.h"), que altera os originais em
+    // outra thread.
+    std::vector<SceneObject> render_objects;
+    for(SceneObject* obj : objects_to_draw){
+        render_objects.push_back(*obj);
+    }
+    std::vector<SceneObject*> render_objects_to_draw;
+    for(SceneObject& obj : render_objects){
+        render_objects_to_draw.push_back(&obj);
+    }
+    auto to_render_objects = [&](const std::vector<SceneObject*>& objects){
+        std::vector<SceneObject*> result;
+        for(SceneObject* obj : objects){
+            size_t i = std::find(objects_to_draw.begin(), objects_to_draw.end(), obj) - objects_to_draw.begin();
+            result.push_back(render_objects_to_draw[i]);
+        }
+        return result;
+    };
+    Shadows_SetCasters(to_render_objects(static_casters), to_render_objects(dynamic_casters));
+
+    // Tamanho na tela abaixo do qual os objetos usam o sombreamento
+    // simplificado. Veja "shading_lod.h".
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--lod-threshold")
+            g_ShadingLod.threshold = (float)atof(argv[i + 1]);
+    }
 
+    // Gravação ou reprodução da entrada (veja "input_replay.h")
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--record" && !InputReplay_StartRecording(argv[i + 1], glfwGetTime()))
+            std::exit(EXIT_FAILURE);
+        if (std::string(argv[i]) == "--replay" && !InputReplay_StartReplay(argv[i + 1]))
+            std::exit(EXIT_FAILURE);
+    }
 
-    if ( argc > 1 )
+    if ( argc > 1 && argv[1][0] != '-' )
     {
         ObjModel model(argv[1]);
         BuildTrianglesAndAddToVirtualScene(&model);
@@ -823,365 +1055,538 @@ int main(int argc, char* argv[])
     glFrontFace(GL_CCW);
 
     float speed = 5.0f; // Velocidade da câmera
-    float prev_time = (float)glfwGetTime();
 
-    float anim_speed = 2000;
-
-    float t_bezier3 = 0.0f;
+    float collect_anim_time = 0.0f;
     float total_t = 0;
-    float initial_t = 0;
+
+    // Caminhos de câmera das animações (veja "spline.h"), percorridos com
+    // velocidade constante. A animação inicial sobrevoa a sala olhando para
+    // pontos de uma segunda curva; a de coleta desce até o tabuleiro.
+    const glm::vec3 intro_position_points[] = {
+        glm::vec3( 7.5f, 1.0f, -1.0f), glm::vec3( 5.5f, 1.0f,  2.0f), glm::vec3( 2.5f, 3.0f, -1.0f),
+        glm::vec3(-3.5f, 4.0f, -1.5f), glm::vec3(-3.5f, 2.0f,  3.0f), glm::vec3(-3.5f, 1.0f, -1.5f) };
+    const glm::vec3 intro_look_at_points[] = {
+        glm::vec3( 5.5f, 1.0f, -1.0f), glm::vec3( 5.5f, 0.0f,  2.0f), glm::vec3( 2.5f, 0.0f, -1.0f),
+        glm::vec3(-3.5f, 0.0f, -1.5f), glm::vec3(-3.5f, 0.0f,  3.0f), glm::vec3(-4.5f, 0.0f, -6.5f) };
+    CameraPath intro_path;
+    CameraPath_Build(intro_path, intro_position_points, 6, 8.0f, intro_look_at_points, 6, 6.0f);
+
+    const glm::vec3 collect_position_points[] = { glm::vec3(-3.8f, 3.0f, -2.0f), glm::vec3(-3.8f, 2.0f, -3.0f) };
+    const glm::vec3 collect_look_at_point = glm::vec3(-3.8f, 0.1f, -3.9f);
+    CameraPath collect_path;
+    CameraPath_Build(collect_path, collect_position_points, 2, 0.5f, &collect_look_at_point, 1, 0.0f);
+
+    // Caminho do modo de medição (veja "benchmark.h"): abre a gaveta da
+    // esquerda e a inspeciona, passa pela cama, inspeciona o bowl, olha o
+    // tabuleiro e volta ao início
+    if(g_Benchmark.running){
+        const BenchmarkStop benchmark_stops[] = {
+            { glm::vec4( 7.5f, 1.0f, -1.0f, 1.0f), glm::vec4( 0.0f, 0.5f,  0.0f, 1.0f), 0.0f, 1.0f, NULL, NULL },
+            { glm::vec4( 2.5f, 1.0f, -3.5f, 1.0f), glm::vec4( 5.0f,-0.5f, -6.0f, 1.0f), 3.0f, 0.5f, NULL, &open_left_drawer },
+            { glm::vec4( 2.5f, 1.0f, -3.5f, 1.0f), glm::vec4( 5.0f,-0.5f, -6.0f, 1.0f), 0.0f, 3.0f, &drawer_left, NULL },
+            { glm::vec4(-1.0f, 1.0f,  1.5f, 1.0f), glm::vec4(-6.0f, 1.0f,  5.0f, 1.0f), 3.0f, 0.5f, NULL, NULL },
+            { glm::vec4(-4.5f, 1.0f, -2.5f, 1.0f), glm::vec4(-6.0f, 0.2f, -4.0f, 1.0f), 3.0f, 0.5f, NULL, NULL },
+            { glm::vec4(-4.5f, 1.0f, -2.5f, 1.0f), glm::vec4(-6.0f, 0.2f, -4.0f, 1.0f), 0.0f, 3.0f, &bowl, NULL },
+            { glm::vec4(-3.8f, 1.5f, -2.0f, 1.0f), glm::vec4(-3.8f, 0.2f, -3.9f, 1.0f), 2.0f, 1.0f, NULL, NULL },
+            { glm::vec4( 7.5f, 1.0f, -1.0f, 1.0f), glm::vec4( 0.0f, 0.5f,  0.0f, 1.0f), 4.0f, 0.0f, NULL, NULL },
+        };
+        Benchmark_SetPath(benchmark_stops, sizeof(benchmark_stops) / sizeof(benchmark_stops[0]));
+        fst_anim = false;
+    }
 
 
     glm::mat4 model = Matrix_Identity();
 
+    // Os objetos começam parados no estado inicial da simulação
+    Simulation_BeginTick(objects_to_draw);
+    Simulation_Interpolate(objects_to_draw, 0.0f);
+    FixedTimestep_Reset(glfwGetTime());
+
+    // Câmera no penúltimo tick, interpolada com a do último tick no desenho
+    glm::vec4 previous_camera_position = glm::vec4(cameraX,cameraY,cameraZ,1.0f);
+    glm::vec4 previous_camera_view_vector = camera_view_vector;
+
+    for (int i = 0; i < 2; ++i)
+        g_FramePipeline.packets[i].transforms.resize(objects_to_draw.size());
+
+    // Objeto de objects_to_draw desenhado durante a inspeção
+    auto add_inspection_draw = [&](FramePacket& packet, SceneObject* obj, const glm::mat4& model, bool lightmap){
+        InspectionDraw draw;
+        draw.object = (int)(std::find(objects_to_draw.begin(), objects_to_draw.end(), obj) - objects_to_draw.begin());
+        draw.model = model;
+        draw.lightmap = lightmap;
+        packet.inspection.push_back(draw);
+    };
+
+    // Thread de simulação: processa a entrada, executa os ticks e descreve o
+    // quadro seguinte em um FramePacket. Não faz chamadas OpenGL. Veja
+    // "frame_packet.h".
+    auto simulate = [&](){
+        CpuProfiler_SetThreadName("simulacao");
+
+        while (true)
+        {
+            FramePacket& packet = FramePipeline_BeginWrite();
+            if (FramePipeline_ShouldQuit())
+                break;
+
+            PROFILE_ZONE("simulacao");
+
+            // Eventos de teclado e mouse recebidos desde o último pacote, ou
+            // os do log na reprodução. As teclas da renderização reproduzidas
+            // são repassadas para a thread principal.
+            InputEvent event;
+            packet.replayed_keys.clear();
+            if (InputReplay_IsReplaying())
+            {
+                while (InputReplay_Next(event))
+                {
+                    HandleInputEvent(event);
+                    if (event.type == INPUT_KEY)
+                        packet.replayed_keys.push_back(event);
+                }
+            }
+            else
+            {
+                while (g_InputQueue.pop(event))
+                {
+                    InputReplay_Record(event);
+                    HandleInputEvent(event);
+                }
+            }
 
-    // Ficamos em um loop infinito, renderizando, até que o usuário feche a janela
-    while (!glfwWindowShouldClose(window))
-    {
-        // Aqui executamos as operações de renderização
-
-        // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
-        // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
-        // Vermelho, Verde, Azul, Alpha (valor de transparência).
-        // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
-        //
-        //           R     G     B     A
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            // Computamos a posição da câmera utilizando coordenadas esféricas.  As
+            // variáveis g_CameraDistance, g_CameraPhi, e g_CameraTheta são
+            // controladas pelo mouse do usuário. Veja as funções HandleCursorPos()
+            // e HandleScroll().
+            float r = g_CameraDistance;
+            float y = r*sin(g_CameraPhi);
+            float z = r*cos(g_CameraPhi)*cos(g_CameraTheta);
+            float x = r*cos(g_CameraPhi)*sin(g_CameraTheta);
+
+            // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
+            // Veja slides 195-227 e 229-234 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
+            glm::vec4 camera_position_c  = glm::vec4(cameraX,cameraY,cameraZ,1.0f); // Ponto "c", centro da câmera
+            glm::vec4 camera_up_vector   = glm::vec4(0.0f,1.0f,0.0f,0.0f); // Vetor "up" fixado para apontar para o "céu" (eito Y global)
+            //glm::vec4 camera_view_vector = camera_lookat_l - camera_position_c; // Vetor "view", sentido para onde a câmera está virada
+
+            glm::vec4 camera_view_vector_mov = -glm::vec4(x, 0.0f, z, 0.0f);
+
+            // Executamos os ticks da simulação que couberem no tempo decorrido
+            // desde o último quadro. Veja "simulation.h".
+            int steps = g_Benchmark.running ? Benchmark_Advance() : InputReplay_Advance(glfwGetTime());
+            for (int step = 0; step < steps; ++step)
+            {
+                PROFILE_ZONE("tick");
+                const float delta_t = SIMULATION_DT;
+
+                Simulation_BeginTick(objects_to_draw);
+                camera_position_c = glm::vec4(cameraX,cameraY,cameraZ,1.0f);
+                previous_camera_position = camera_position_c;
+                previous_camera_view_vector = camera_view_vector;
+
+                glm::vec3 direction_anim = glm::vec3(0,0,0);
+
+                if(g_Benchmark.running){
+                    /* Caminho do modo de medição */
+                    BenchmarkPose pose;
+                    Benchmark_Update(pose);
+                    cameraX = pose.position.x;
+                    cameraY = pose.position.y;
+                    cameraZ = pose.position.z;
+
+                    is_inspecting = pose.inspect != NULL;
+                    if(is_inspecting){
+                        interactable_object = pose.inspect;
+                        g_AngleX = 0.0f;
+                        g_AngleY = pose.spin;
+                        g_AngleZ = 0.0f;
+                        camera_view_vector = interactable_object->get_center() - pose.position;
+                    } else {
+                        camera_view_vector = pose.look_at - pose.position;
+                    }
+                } else if(is_inspecting && interactable_object != NULL){
+                    glm::vec4 bbox_center = interactable_object->get_center();
+                    camera_view_vector = bbox_center - camera_position_c;
+                } else if(collect_anim){
+                    /* Animação de coleta */
+                    glm::vec3 med_pos, look_at;
+                    CameraPath_Sample(collect_path, collect_anim_time, med_pos, look_at);
 
-        // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
-        // e também resetamos todos os pixels do Z-buffer (depth buffer).
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    cameraX = med_pos.x;
+                    cameraY = med_pos.y;
+                    cameraZ = med_pos.z;
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vértice e fragmentos).
-        glUseProgram(g_GpuProgramID);
 
-        // Computamos a posição da câmera utilizando coordenadas esféricas.  As
-        // variáveis g_CameraDistance, g_CameraPhi, e g_CameraTheta são
-        // controladas pelo mouse do usuário. Veja as funções CursorPosCallback()
-        // e ScrollCallback().
-        float r = g_CameraDistance;
-        float y = r*sin(g_CameraPhi);
-        float z = r*cos(g_CameraPhi)*cos(g_CameraTheta);
-        float x = r*cos(g_CameraPhi)*sin(g_CameraTheta);
+                    camera_view_vector = glm::vec4(look_at.x, look_at.y, look_at.z, 0) -
+                                            glm::vec4(med_pos.x, med_pos.y, med_pos.z, 0);
 
-        // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
-        // Veja slides 195-227 e 229-234 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
-        glm::vec4 camera_position_c  = glm::vec4(cameraX,cameraY,cameraZ,1.0f); // Ponto "c", centro da câmera
-        glm::vec4 camera_up_vector   = glm::vec4(0.0f,1.0f,0.0f,0.0f); // Vetor "up" fixado para apontar para o "céu" (eito Y global)
-        //glm::vec4 camera_view_vector = camera_lookat_l - camera_position_c; // Vetor "view", sentido para onde a câmera está virada
+                    if(collect_anim_time < CameraPath_Duration(collect_path)){
+                        collect_anim_time += delta_t;
+                    } else {
+                        total_t += delta_t;
+                        if(total_t >= 0.5f){
+                            /* coloca a peca no tabuleiro */
+                            glm::mat4 piece_model = pieces_initial_position.at(piece_to_reposition->get_name());
+                            piece_to_reposition->set_model(piece_model);
+                            piece_to_reposition->set_inspectable(false);
+                        }
+                        if(total_t >= 1.5f){
+                            /* Sai da animação*/
+                            all_pieces_collected = all_pieces_in_starting_pos();
+                            if(!all_pieces_collected){
+                                cameraX = old_camera_x;
+                                cameraY = old_camera_y;
+                                cameraZ = old_camera_z;
+                            }
+
+                            total_t = 0;
+                            collect_anim_time = 0;
+                            collect_anim = false;
+                        }
+                    }
 
-        glm::vec4 camera_view_vector_mov = -glm::vec4(x, 0.0f, z, 0.0f);
+                } else if(fst_anim){
+                    /* Animação inicial */
+                    glm::vec3 p_saida;
+                    CameraPath_Sample(intro_path, fst_anim_time, p_saida, direction_anim);
+
+                    cameraX = p_saida.x;
+                    cameraY = p_saida.y;
+                    cameraZ = p_saida.z;
+
+                    camera_view_vector = glm::vec4(direction_anim.x, direction_anim.y, direction_anim.z, 1.0f)
+                                       - player.get_center();
+
+                    fst_anim_time += delta_t;
+                    if(fst_anim_time >= CameraPath_Duration(intro_path)){
+                        total_t += delta_t;
+                        if(total_t > 2.0f){
+                            fst_anim = false;
+                            cameraX = 7.5f;;
+                            cameraY = 1.0f;
+                            cameraZ = -1.0f;
+                            camera_view_vector = -glm::vec4(x, y, z, 0.0f);
+                            total_t = 0;
+                        }
+                    }
+                } else {
+                    camera_view_vector = -glm::vec4(x, y, z, 0.0f);
+                }
 
-        float current_time = (float)glfwGetTime();
-        float delta_t = current_time - prev_time;
-        prev_time = current_time;
+                if(running){
+                    speed = 10.0f;
+                } else {
+                    speed = 5.0f;
+                }
 
-        glm::vec3 direction_anim = glm::vec3(0,0,0);
 
-        if(is_inspecting && interactable_object != NULL){
-            glm::vec4 bbox_center = interactable_object->get_center();
-            camera_view_vector = bbox_center - camera_position_c;
-        } else if(collect_anim){
-            /* Animação de coleta */
-            glm::vec3 start_pos = glm::vec3(-3.8f,3.0f,-2.0f);
-            glm::vec3 final_pos = glm::vec3(-3.8f,2.0f,-3.0f);
-            glm::vec3 look_at = glm::vec3(-3.8f, 0.1f, -3.9f);
-            glm::vec3 med_pos = calculateBezierPoint({start_pos, final_pos}, t_bezier3);
+                if(all_pieces_collected){
+                    total_t += delta_t;
+                    play_game_anim(total_t);
+                }
 
-            cameraX = med_pos.x;
-            cameraY = med_pos.y;
-            cameraZ = med_pos.z;
+                drawer(delta_t, player, drawer_left, drawer_right, black_king);
 
+                /* Att posicao de camera */
+                glm::vec4 w = -camera_view_vector_mov/norm(camera_view_vector_mov);
+                glm::vec4 u = crossproduct(camera_up_vector, w)/norm(crossproduct(camera_up_vector, w)); /*camera_up_vector * w;*/
 
-            camera_view_vector = glm::vec4(look_at.x, look_at.y, look_at.z, 0) -
-                                    glm::vec4(med_pos.x, med_pos.y, med_pos.z, 0);
 
-            if(t_bezier3 <= 1.0f){
-                t_bezier3 += 1.0f * delta_t * 2;
-            } else {
-                if(total_t == 0){
-                    initial_t = (float)glfwGetTime();
-                }
-                float t = (float)glfwGetTime();
-                float past_t = t - initial_t;
-                total_t += past_t;
-                initial_t = t;
-                if(total_t >= 0.5f){
-                    /* coloca a peca no tabuleiro */
-                    glm::mat4 piece_model = pieces_initial_position.at(piece_to_reposition->get_name());
-                    piece_to_reposition->set_model(piece_model);
-                    piece_to_reposition->set_inspectable(false);
+                if(!fst_anim && !collect_anim && !g_Benchmark.running && !all_pieces_in_starting_pos()){
+                    move_with_collision(player, delta_t, speed, w, u);
                 }
-                if(total_t >= 1.5f){
-                    /* Sai da animação*/
-                    all_pieces_collected = all_pieces_in_starting_pos();
-                    if(!all_pieces_collected){
-                        cameraX = old_camera_x;
-                        cameraY = old_camera_y;
-                        cameraZ = old_camera_z;
-                    }
 
-                    total_t = 0;
-                    t_bezier3 = 0;
-                    collect_anim = false;
-                }
+                player.set_position(cameraX, cameraY, cameraZ);
             }
 
-        } else if(fst_anim){
-            /* Animação inicial */
-            glm::vec3 ponto1 = glm::vec3( 7.5f, 1.0f, -1.0f);
-            glm::vec3 ponto2 = glm::vec3( 5.5f, 1.0f,  2.0f);
-            glm::vec3 ponto3 = glm::vec3( 2.5f, 3.0f, -1.0f);
-            glm::vec3 ponto4 = glm::vec3(-3.5f, 4.0f, -1.5f);
-            glm::vec3 ponto5 = glm::vec3(-3.5f, 2.0f,  3.0f);
-            glm::vec3 ponto6 = glm::vec3(-3.5f, 1.0f, -1.5f);
-            glm::vec3 p_saida = calculateBezierPoint({ponto1, ponto2, ponto3, ponto4, ponto5, ponto6}, t_bezier);
-
-            glm::vec3 vponto1 = glm::vec3( 5.5f, 1.0f, -1.0f);
-            glm::vec3 vponto2 = glm::vec3( 5.5f, 0.0f,  2.0f);
-            glm::vec3 vponto3 = glm::vec3( 2.5f, 0.0f, -1.0f);
-            glm::vec3 vponto4 = glm::vec3(-3.5f, 0.0f, -1.5f);
-            glm::vec3 vponto5 = glm::vec3(-3.5f, 0.0f,  3.0f);
-            glm::vec3 vponto6 = glm::vec3(-4.5f, 0.0f, -6.5f);
-            direction_anim = calculateBezierPoint({vponto1, vponto2, vponto3, vponto4, vponto5, vponto6}, t_bezier2);
-
-            cameraX = p_saida.x;
-            cameraY = p_saida.y;
-            cameraZ = p_saida.z;
-
-            camera_view_vector = glm::vec4(direction_anim.x, direction_anim.y, direction_anim.z, 1.0f)
-                               - player.get_center();
-
-            if(t_bezier <= 1.0f){
-                if(t_bezier < 0.2f){
-                    t_bezier += 0.0001f * delta_t * anim_speed;
-                }else if(t_bezier > 0.7f){
-                    t_bezier += 0.00002f * delta_t * anim_speed;
-                } else if(t_bezier > 0.9f){
-                    t_bezier += 0.00001f * delta_t * anim_speed;
-                } else {
-                    t_bezier += 0.0001f * delta_t * anim_speed;
-                }
-            }
-            if(t_bezier2 <= 1.0f){
-                    if(t_bezier2 > 0.8f){
-                        t_bezier2 += 0.00003f * delta_t * anim_speed;
-                    } else {
-                        t_bezier2 += 0.00015f * delta_t * anim_speed;
-                    }
-            }
+            // A câmera e os objetos são desenhados entre os dois últimos ticks.
+            // Com a câmera livre, a direção vem do mouse e não é interpolada.
+            float alpha = g_FixedTimestep.alpha;
+            Simulation_Interpolate(objects_to_draw, alpha);
+            camera_position_c = Simulation_Lerp(previous_camera_position, glm::vec4(cameraX,cameraY,cameraZ,1.0f), alpha);
+            glm::vec4 render_view_vector = camera_view_vector;
+            if (!is_inspecting && !collect_anim && !fst_anim && !g_Benchmark.running)
+                render_view_vector = -glm::vec4(x, y, z, 0.0f);
+            else if (norm(previous_camera_view_vector) > 0.0f)
+                render_view_vector = Simulation_Lerp(previous_camera_view_vector, camera_view_vector, alpha);
+
+            //---------------------------- INSPEÇÃO ----------------------------
+            packet.inspecting = is_inspecting && interactable_object != NULL;
+            packet.inspection.clear();
+            packet.show_collect_prompt = false;
+
+            if(packet.inspecting){
+                glm::mat4 rotation_matrix = Matrix_Rotate_Z(g_AngleZ)
+                                              * Matrix_Rotate_Y(g_AngleY)
+                                              * Matrix_Rotate_X(g_AngleX);
+                glm::mat4 model;
 
-            if(t_bezier >= 1.0f){
-                if(total_t == 0){
-                    initial_t = (float)glfwGetTime();
-                }
-                float t = (float)glfwGetTime();
-                float past_t = t - initial_t;
-                total_t += past_t;
-                initial_t = t;
-                if(total_t > 2.0f){
-                    fst_anim = false;
-                    cameraX = 7.5f;;
-                    cameraY = 1.0f;
-                    cameraZ = -1.0f;
-                    camera_view_vector = -glm::vec4(x, y, z, 0.0f);
-                    total_t = 0;
-                }
-            }
-        } else {
-            camera_view_vector = -glm::vec4(x, y, z, 0.0f);
-        }
 
-        if(running){
-            speed = 10.0f;
-        } else {
-            speed = 5.0f;
-        }
+                model = Matrix_Translate(interactable_object->get_center())
+                          * rotation_matrix
+                          * Matrix_Translate(-interactable_object->get_center())
+                          * interactable_object->get_model();
 
+                add_inspection_draw(packet, interactable_object, model, true);
 
-        if(all_pieces_collected){
-            total_t += delta_t;
-            play_game_anim(total_t);
-        }
+                if(interactable_object->get_index() == WHITE_PIECE || interactable_object->get_index() == BLACK_PIECE) {
+                    packet.show_collect_prompt = true;
+                    piece_to_reposition = interactable_object;
+                } else if(interactable_object->get_name() == "bowl" && hidden_pieces[0]){
+                //---------------------------- OBJETOS SECUNDARIOS ----------------------------
 
-        drawer(delta_t, player, drawer_left, drawer_right, black_king);
 
-        // Computamos a matriz "View" utilizando os parâmetros da câmera para
-        // definir o sistema de coordenadas da câmera.  Veja slides 2-14, 184-190 e 236-242 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
-        glm::mat4 view = Matrix_Camera_View(camera_position_c, camera_view_vector, camera_up_vector);
-        // Agora computamos a matriz de Projeção.
-        glm::mat4 projection;
+                    model = Matrix_Translate(interactable_object->get_center())
+                          * rotation_matrix
+                          * Matrix_Translate(-interactable_object->get_center())
+                          * white_king.get_model();
 
-        // Note que, no sistema de coordenadas da câmera, os planos near e far
-        // estão no sentido negativo! Veja slides 176-204 do documento Aula_09_Projecoes.pdf.
-        float nearplane = -0.1f;  // Posição do "near plane"
-        float farplane  = -50.0f; // Posição do "far plane"
+                    add_inspection_draw(packet, &white_king, model, false);
 
-        /* Att posicao de camera */
+                    piece_to_reposition = &white_king;
 
+                    glm::vec4 bowl_up = glm::vec4(0,1,0,0);
+                    glm::vec4 visible_v = ( rotation_matrix * bowl_up );
+                    visible_v.w = 0.0f;
 
+                    float inner_prod = dot(visible_v, -camera_view_vector);
+                    if(inner_prod > 1.0 ){
+                        packet.show_collect_prompt = true;
+                    }
 
-        glm::vec4 w = -camera_view_vector_mov/norm(camera_view_vector_mov);
-        glm::vec4 u = crossproduct(camera_up_vector, w)/norm(crossproduct(camera_up_vector, w)); /*camera_up_vector * w;*/
 
+                } else if(interactable_object->get_name() == "drawer_left" && hidden_pieces[1]){
 
-        if(!fst_anim && !collect_anim && !all_pieces_in_starting_pos()){
-            move_with_collision(player, objects_group, delta_t, speed, w, u);
-        }
+                    model = Matrix_Translate(interactable_object->get_center())
+                          * rotation_matrix
+                          * Matrix_Translate(-interactable_object->get_center())
+                          * black_king.get_model();
 
+                    add_inspection_draw(packet, &black_king, model, false);
 
+                    piece_to_reposition = &black_king;
 
-        float field_of_view = 3.141592 / 3.0f;
-        projection = Matrix_Perspective(field_of_view, g_ScreenRatio, nearplane, farplane);
+                    glm::vec4 bowl_up = glm::vec4(0,1,0,0);
+                    glm::vec4 visible_v = ( rotation_matrix * bowl_up );
+                    visible_v.w = 0.0f;
 
-        // Enviamos as matrizes "view" e "projection" para a placa de vídeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas são
-        // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
+                    float inner_prod = dot(visible_v, -camera_view_vector);
+                    if(inner_prod > 1.2 ){
+                        packet.show_collect_prompt = true;
+                    }
 
+                } else if(interactable_object->get_name() == "chair" && hidden_pieces[2]){
+                    model = Matrix_Translate(interactable_object->get_center())
+                          * rotation_matrix
+                          * Matrix_Translate(-interactable_object->get_center())
+                          * left_white_bishop.get_model();
 
-        if(!is_inspecting){
-            // PLAYER
-            player.set_position(cameraX, cameraY, cameraZ);
+                    add_inspection_draw(packet, &left_white_bishop, model, false);
 
-            /* Desenha os objetos */
-            draw_objects();
+                    piece_to_reposition = &left_white_bishop;
+
+                    glm::vec4 bowl_up = glm::vec4(0,-1,0,0);
+                    glm::vec4 visible_v = ( rotation_matrix * bowl_up );
+                    visible_v.w = 0.0f;
+
+                    float inner_prod = dot(visible_v, -camera_view_vector);
+                    if(inner_prod > 0 ){
+                        packet.show_collect_prompt = true;
+                    }
+                }
+            }
+
+            // O objeto apontado faz parte do estado da simulação: é calculado
+            // com a câmera do último tick, e só quando algum tick foi
+            // executado, para que a reprodução da entrada o encontre igual
+            if(!is_inspecting && steps > 0){
+                glm::vec4 tick_camera_position = glm::vec4(cameraX,cameraY,cameraZ,1.0f);
+                interactable_object = GetInteractableObject(tick_camera_position,camera_view_vector);
+            }
+
+            packet.show_open_prompt = false;
+            packet.show_inspect_prompt = false;
+            if(interactable_object != NULL && !is_inspecting && !fst_anim && !collect_anim && !all_pieces_collected){
+                if(interactable_object->get_name() == "drawer_left"){
+                    packet.show_open_prompt = true;
+                    packet.show_inspect_prompt = open_left_drawer;
+                } else if(interactable_object->get_name() == "drawer_right"){
+                    packet.show_open_prompt = true;
+                    packet.show_inspect_prompt = open_right_drawer;
+                } else {
+                    packet.show_inspect_prompt = true;
+                }
+            }
 
+            packet.game_ended = game_ended;
+            packet.close_window = close_window_requested || InputReplay_Finished();
+
+            packet.camera_position = camera_position_c;
+            packet.camera_view_vector = render_view_vector;
+            for (size_t i = 0; i < objects_to_draw.size(); ++i)
+                packet.transforms[i] = objects_to_draw[i]->get_transform();
+
+            InputReplay_EndFrame(steps);
+            FramePipeline_Publish();
         }
+    };
+    std::thread simulation_thread(simulate);
 
+    // Ficamos em um loop infinito, renderizando, até que o usuário feche a janela
+    while (!glfwWindowShouldClose(window))
+    {
+        PROFILE_ZONE("quadro");
 
+        // Quadro mais recente descrito pela simulação. As transformações são
+        // copiadas para os objetos da renderização, que são os usados por
+        // draw_objects(), pelo pré-passo de profundidade e pelas sombras.
+        const FramePacket* packet = FramePipeline_BeginRead();
+        for (size_t i = 0; i < render_objects.size(); ++i)
+            render_objects[i].set_transform(packet->transforms[i]);
+        for (const InputEvent& key : packet->replayed_keys)
+            HandleRenderKey(window, key.key, key.action);
 
-        if(is_inspecting && interactable_object != NULL){
-            //---------------------------- SKYBOX ----------------------------
-            model = Matrix_Translate(camera_position_c.x,camera_position_c.y,camera_position_c.z);
+        // Aqui executamos as operações de renderização
 
-            glDisable(GL_DEPTH_TEST);
-            glDisable(GL_CULL_FACE);
+        // A cena é desenhada no framebuffer da resolução dinâmica, com o
+        // viewport reduzido; o texto é desenhado depois, na resolução da
+        // janela. Veja DynamicResolution_EndScene().
+        GpuProfiler_BeginFrame();
+        GpuProfiler_Begin(GPU_SCOPE_FRAME);
+        if (g_Benchmark.running)
+            Benchmark_BeginFrame();
+        DynamicResolution_BeginScene(g_FramebufferWidth, g_FramebufferHeight);
+
+        // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
+        // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
+        // Vermelho, Verde, Azul, Alpha (valor de transparência).
+        // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
+        //
+        //           R     G     B     A
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKYBOX);
-            DrawVirtualObject("skybox");
+        // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
+        // e também resetamos todos os pixels do Z-buffer (depth buffer).
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
+        // Ativamos os programas de GPU que terminaram de compilar desde o
+        // último quadro. Veja LoadShadersFromFiles().
+        PollGpuPrograms();
 
-            //---------------------------- OBJETO INTERAGIDO ----------------------------
-            glm::mat4 rotation_matrix = Matrix_Rotate_Z(g_AngleZ)
-                                          * Matrix_Rotate_Y(g_AngleY)
-                                          * Matrix_Rotate_X(g_AngleX);
+        // Abaixo definimos as varáveis que efetivamente definem a câmera virtual.
+        // Veja slides 195-227 e 229-234 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
+        glm::vec4 camera_position_c  = packet->camera_position; // Ponto "c", centro da câmera
+        glm::vec4 camera_up_vector   = glm::vec4(0.0f,1.0f,0.0f,0.0f); // Vetor "up" fixado para apontar para o "céu" (eito Y global)
+
+        // Computamos a matriz "View" utilizando os parâmetros da câmera para
+        // definir o sistema de coordenadas da câmera.  Veja slides 2-14, 184-190 e 236-242 do documento Aula_08_Sistemas_de_Coordenadas.pdf.
+        glm::mat4 view = Matrix_Camera_View(camera_position_c, packet->camera_view_vector, camera_up_vector);
+        // Agora computamos a matriz de Projeção.
+        glm::mat4 projection;
 
+        // Note que, no sistema de coordenadas da câmera, os planos near e far
+        // estão no sentido negativo! Veja slides 176-204 do documento Aula_09_Projecoes.pdf.
+        float nearplane = -0.1f;  // Posição do "near plane"
+        float farplane  = -50.0f; // Posição do "far plane"
 
-            model = Matrix_Translate(interactable_object->get_center())
-                      * rotation_matrix
-                      * Matrix_Translate(-interactable_object->get_center())
-                      * interactable_object->get_model();
 
 
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, interactable_object->get_index());
-            DrawVirtualObject(interactable_object->get_model_name().c_str());
+        float field_of_view = 3.141592 / 3.0f;
+        projection = Matrix_Perspective(field_of_view, g_ScreenRatio, nearplane, farplane);
 
-            if(interactable_object->get_index() == WHITE_PIECE || interactable_object->get_index() == BLACK_PIECE) {
-                TextRendering_Press_F_To_Collect(window);
-                piece_to_reposition = interactable_object;
-            } else if(interactable_object->get_name() == "bowl" && hidden_pieces[0]){
-            //---------------------------- OBJETOS SECUNDARIOS ----------------------------
+        // Atribuímos as luzes pontuais aos clusters do frustum deste quadro
+        Lights_Update(view, field_of_view, g_ScreenRatio, nearplane, farplane,
+                      g_DynamicResolution.render_width, g_DynamicResolution.render_height);
+        Lights_BindTextures();
 
+        // Guardamos as matrizes "view" e "projection", que são enviadas para a
+        // placa de vídeo (GPU) sempre que um programa de GPU é ativado por
+        // BindMaterial(). Veja o arquivo "shader_vertex.glsl", onde estas são
+        // efetivamente aplicadas em todos os pontos.
+        g_ViewMatrix = view;
+        g_ProjectionMatrix = projection;
 
-                model = Matrix_Translate(interactable_object->get_center())
-                      * rotation_matrix
-                      * Matrix_Translate(-interactable_object->get_center())
-                      * white_king.get_model();
+        // Atualizamos somente as camadas de sombra cujos objetos se moveram
+        GpuProfiler_Begin(GPU_SCOPE_SHADOWS);
+        Shadows_Update();
+        GpuProfiler_End(GPU_SCOPE_SHADOWS);
+        Shadows_BindTextures();
+        g_ShadowsEnabled = true;
 
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, white_king.get_index());
-                DrawVirtualObject(white_king.get_model_name().c_str());
+        g_CurrentProgram = -1;
+        g_CurrentMaterial = -1;
 
-                piece_to_reposition = &white_king;
 
-                glm::vec4 bowl_up = glm::vec4(0,1,0,0);
-                glm::vec4 visible_v = ( rotation_matrix * bowl_up );
-                visible_v.w = 0.0f;
+        if(!packet->inspecting){
+            GpuProfiler_Begin(GPU_SCOPE_SCENE);
 
-                float inner_prod = dot(visible_v, -camera_view_vector);
-                if(inner_prod > 1.0 ){
-                    TextRendering_Press_F_To_Collect(window);
-                }
+            // Pré-passo de profundidade, se ativo: o passo de cor abaixo só
+            // executa o fragment shader para os fragmentos visíveis
+            DepthPrepass_Draw(render_objects_to_draw, g_ViewMatrix, g_ProjectionMatrix);
+            g_CurrentProgram = -1;
 
+            /* Desenha os objetos */
+            DepthPrepass_BeginColorPass();
+            draw_objects(render_objects_to_draw);
+            DepthPrepass_EndColorPass();
 
-            } else if(interactable_object->get_name() == "drawer_left" && hidden_pieces[1]){
+            GpuProfiler_End(GPU_SCOPE_SCENE);
 
-                model = Matrix_Translate(interactable_object->get_center())
-                      * rotation_matrix
-                      * Matrix_Translate(-interactable_object->get_center())
-                      * black_king.get_model();
+        }
 
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, black_king.get_index());
-                DrawVirtualObject(black_king.get_model_name().c_str());
 
-                piece_to_reposition = &black_king;
 
-                glm::vec4 bowl_up = glm::vec4(0,1,0,0);
-                glm::vec4 visible_v = ( rotation_matrix * bowl_up );
-                visible_v.w = 0.0f;
+        if(packet->inspecting){
+            GpuProfiler_Begin(GPU_SCOPE_INSPECTION);
 
-                float inner_prod = dot(visible_v, -camera_view_vector);
-                if(inner_prod > 1.2 ){
-                    TextRendering_Press_F_To_Collect(window);
-                }
+            //---------------------------- SKYBOX ----------------------------
+            GpuProfiler_Begin(GPU_SCOPE_SKYBOX);
+            model = Matrix_Translate(camera_position_c.x,camera_position_c.y,camera_position_c.z);
 
-            } else if(interactable_object->get_name() == "chair" && hidden_pieces[2]){
-                model = Matrix_Translate(interactable_object->get_center())
-                      * rotation_matrix
-                      * Matrix_Translate(-interactable_object->get_center())
-                      * left_white_bishop.get_model();
+            // O objeto inspecionado é girado fora da sua posição na sala
+            g_ShadowsEnabled = false;
+            g_CurrentProgram = -1;
 
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, left_white_bishop.get_index());
-                DrawVirtualObject(left_white_bishop.get_model_name().c_str());
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
 
-                piece_to_reposition = &left_white_bishop;
+            DrawSceneObject(model, SKYBOX, "skybox");
 
-                glm::vec4 bowl_up = glm::vec4(0,-1,0,0);
-                glm::vec4 visible_v = ( rotation_matrix * bowl_up );
-                visible_v.w = 0.0f;
+            glEnable(GL_CULL_FACE);
+            glEnable(GL_DEPTH_TEST);
+            GpuProfiler_End(GPU_SCOPE_SKYBOX);
 
-                float inner_prod = dot(visible_v, -camera_view_vector);
-                if(inner_prod > 0 ){
-                    TextRendering_Press_F_To_Collect(window);
-                }
+            //---------------------------- OBJETO INTERAGIDO ----------------------------
+            for(const InspectionDraw& draw: packet->inspection){
+                SceneObject* obj = render_objects_to_draw[draw.object];
+                DrawSceneObject(draw.model, obj->get_index(), obj->get_model_name().c_str(), draw.lightmap ? obj->get_lightmap() : 0);
             }
 
-
+            GpuProfiler_End(GPU_SCOPE_INSPECTION);
         }
 
-        if(!is_inspecting){
-            interactable_object = GetInteractableObject(objects_group,camera_position_c,camera_view_vector);
-        }
+        // Ampliamos a cena para a janela; daqui em diante, somente texto
+        GpuProfiler_Begin(GPU_SCOPE_UPSCALE);
+        DynamicResolution_EndScene();
+        GpuProfiler_End(GPU_SCOPE_UPSCALE);
 
-        // Imprimimos na tela os ângulos de Euler que controlam a rotação do
-        // terceiro cubo.
+        // Os textos abaixo são acumulados e desenhados juntos por
+        // TextRendering_Flush(), antes da troca de buffers
+        TextRendering_BeginFrame(window);
 
-        if(interactable_object != NULL && !is_inspecting && !fst_anim && !collect_anim && !all_pieces_collected){
-            if(interactable_object->get_name() == "drawer_left"){
-                TextRendering_Press_F_To_Open(window);
-                if(open_left_drawer){
-                    TextRendering_Press_E_To_Inspect(window);
-                }
-            } else if(interactable_object->get_name() == "drawer_right"){
-                TextRendering_Press_F_To_Open(window);
-                if(open_right_drawer){
-                    TextRendering_Press_E_To_Inspect(window);
-                }
-            } else {
-                TextRendering_Press_E_To_Inspect(window);
-            }
+        if(packet->show_collect_prompt){
+            TextRendering_Press_F_To_Collect(window);
         }
 
-        if(game_ended){
+        if(packet->show_open_prompt){
+            TextRendering_Press_F_To_Open(window);
+        }
+        if(packet->show_inspect_prompt){
+            TextRendering_Press_E_To_Inspect(window);
+        }
+
+        if(packet->game_ended){
             TextRendering_You_Lost(window);
             TextRendering_Press_esc_to_close_game(window);
         }
@@ -1190,13 +1595,46 @@ int main(int argc, char* argv[])
         // por segundo (frames per second).
         TextRendering_ShowFramesPerSecond(window);
 
+        // ... e o número de amostras que passaram no teste de profundidade
+        // no passo de cor, com e sem o pré-passo de profundidade.
+        TextRendering_ShowSamplesPassed(window);
+
+        // ... e a escala atual da resolução dinâmica
+        TextRendering_ShowResolutionScale(window);
+
+        // ... e quantos objetos usaram o sombreamento simplificado
+        TextRendering_ShowShadingLod(window);
+
+        // ... e o tempo de GPU de cada passo de renderização
+        TextRendering_ShowGpuProfile(window);
+
+        GpuProfiler_Begin(GPU_SCOPE_HUD);
+        TextRendering_Flush();
+        GpuProfiler_End(GPU_SCOPE_HUD);
+        GpuProfiler_End(GPU_SCOPE_FRAME);
+
+        if (g_Benchmark.running && Benchmark_EndFrame()){
+            Benchmark_WriteReport((const char*)renderer);
+            glfwSetWindowShouldClose(window, GL_TRUE);
+        }
+
+        if(packet->close_window){
+            glfwSetWindowShouldClose(window, GL_TRUE);
+        }
+
+        // A simulação pode escrever neste pacote a partir de agora
+        FramePipeline_EndRead();
+
         // O framebuffer onde OpenGL executa as operações de renderização não
         // é o mesmo que está sendo mostrado para o usuário, caso contrário
         // seria possível ver artefatos conhecidos como "screen tearing". A
         // chamada abaixo faz a troca dos buffers, mostrando para o usuário
         // tudo que foi renderizado pelas funções acima.
         // Veja o link: https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
         // Verificamos com o sistema operacional se houve alguma interação do
         // usuário (teclado, mouse, ...). Caso positivo, as funções de callback
@@ -1205,6 +1643,14 @@ int main(int argc, char* argv[])
         glfwPollEvents();
     }
 
+    // Esperamos a simulação terminar antes de liberar os recursos
+    FramePipeline_Quit();
+    simulation_thread.join();
+    InputReplay_Stop();
+
+    // Salvamos as zonas medidas pelo profiler de CPU, se ativo
+    CpuProfiler_WriteTrace("cpu_trace.json");
+
     // Finalizamos o uso dos recursos do sistema operacional
     glfwTerminate();
 
@@ -1212,17 +1658,59 @@ int main(int argc, char* argv[])
     return 0;
 }
 
-void draw_objects(){
-    for(SceneObject *obj: objects_to_draw){
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(obj->get_model()));
-        glUniform1i(g_object_id_uniform, obj->get_index());
-        DrawVirtualObject(const_cast<char*>(obj->get_model_name().c_str()));
+// Um objeto de objects_to_draw com o programa de GPU escolhido para o quadro
+struct DrawItem
+{
+    int          program;
+    bool         lod;
+    SceneObject* object;
+};
+
+bool compare_draw_item(const DrawItem& a, const DrawItem& b){
+    return a.program < b.program;
+}
+
+void draw_objects(const std::vector<SceneObject*>& objects){
+    PROFILE_FUNCTION();
+    // Objetos pequenos na tela usam o programa simplificado do seu material
+    // (veja "shading_lod.h"). A lista é reordenada por programa de GPU, para
+    // que cada programa seja ativado uma única vez por quadro; como "objects"
+    // já está ordenado pelo programa completo (veja main()), a ordenação
+    // estável quase não move os elementos.
+    static std::vector<DrawItem> items;
+    items.clear();
+    g_ShadingLod.num_full = 0;
+    g_ShadingLod.num_lod = 0;
+    for(SceneObject *obj: objects){
+        const Material& material = g_Materials[GetMaterialIndex(obj->get_index())];
+        DrawItem item;
+        item.object = obj;
+        item.lod = material.lod_program != material.program &&
+                   ShadingLod_Select(obj->get_bbox_min(), obj->get_bbox_max(), g_ViewMatrix, g_ProjectionMatrix);
+        item.program = item.lod ? material.lod_program : material.program;
+        items.push_back(item);
+        if (item.lod)
+            ++g_ShadingLod.num_lod;
+        else
+            ++g_ShadingLod.num_full;
+    }
+    std::stable_sort(items.begin(), items.end(), compare_draw_item);
+
+    for(const DrawItem& item: items){
+        SceneObject* obj = item.object;
+        DrawSceneObject(obj->get_render_model(), obj->get_index(), obj->get_model_name().c_str(), obj->get_lightmap(), item.lod);
     }
 }
 
+bool compare_program(SceneObject* a, SceneObject* b){
+    return g_Materials[GetMaterialIndex(a->get_index())].program <
+           g_Materials[GetMaterialIndex(b->get_index())].program;
+}
+
 
 
 void load_models(){
+    PROFILE_FUNCTION();
     ObjModel plane_model("../../data/plane.obj");
     ComputeNormals(&plane_model);
     BuildTrianglesAndAddToVirtualScene(&plane_model);
@@ -1327,6 +1815,8 @@ void DrawVirtualObject(const char* object_name)
     // g_VirtualScene[""] dentro da função BuildTrianglesAndAddToVirtualScene(), e veja
     // a documentação da função glDrawElements() em
     // http://docs.gl/gl3/glDrawElements.
+    Benchmark_CountDraw(g_VirtualScene[object_name].get_rendering_mode(),
+                        g_VirtualScene[object_name].get_num_indices());
     glDrawElements(
         g_VirtualScene[object_name].get_rendering_mode(),
         g_VirtualScene[object_name].get_num_indices(),
@@ -1344,6 +1834,7 @@ void DrawVirtualObject(const char* object_name)
 //
 void LoadShadersFromFiles()
 {
+    PROFILE_FUNCTION();
     // Note que o caminho para os arquivos "shader_vertex.glsl" e
     // "shader_fragment.glsl" estão fixados, sendo que assumimos a existência
     // da seguinte estrutura no sistema de arquivos:
@@ -1362,232 +1853,584 @@ void LoadShadersFromFiles()
     //       |
     //       o-- shader_fragment.glsl
     //
-    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_vertex.glsl");
-    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl");
-
-    // Deletamos o programa de GPU anterior, caso ele exista.
-    if ( g_GpuProgramID != 0 )
-        glDeleteProgram(g_GpuProgramID);
-
-    // Criamos um programa de GPU utilizando os shaders carregados acima.
-    g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
-
-    // Buscamos o endereço das variáveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform      = glGetUniformLocation(g_GpuProgramID, "model"); // Variável da matriz "model"
-    g_view_uniform       = glGetUniformLocation(g_GpuProgramID, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform = glGetUniformLocation(g_GpuProgramID, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform  = glGetUniformLocation(g_GpuProgramID, "object_id"); // Variável "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_min");
-    g_bbox_max_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_max");
-
-    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage2"), 2);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage3"), 3);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage4"), 4);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage5"), 5);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage6"), 6);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage7"), 7);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage8"), 8);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage9"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage10"), 10);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage11"), 11);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage12"), 12);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage13"), 13);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage14"), 14);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage15"), 15);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage16"), 16);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage17"), 17);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage18"), 18);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage19"), 19);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage20"), 20);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage21"), 21);
-    glUseProgram(0);
-}
-
-
-// Função que computa as normais de um ObjModel, caso elas não tenham sido
-// especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
-{
-    if ( !model->attrib.normals.empty() )
-        return;
-
-    // Primeiro computamos as normais para todos os TRIÂNGULOS.
-    // Segundo, computamos as normais dos VÉRTICES através do método proposto
-    // por Gouraud, onde a normal de cada vértice vai ser a média das normais de
-    // todas as faces que compartilham este vértice.
-
-    size_t num_vertices = model->attrib.vertices.size() / 3;
+    //
+    // Cada permutação distinta usada pelos materiais (veja LoadMaterials())
+    // gera um programa de GPU especializado, compilado com os #defines da
+    // permutação. Assim os shaders não precisam testar qual objeto está sendo
+    // desenhado.
+    //
+    // Programas já linkados anteriormente são restaurados do cache em disco
+    // (veja "program_cache.h"). Os demais são compilados e linkados sem
+    // consultar o resultado: com GL_KHR_parallel_shader_compile o driver faz
+    // isso em segundo plano e PollGpuPrograms() ativa cada programa quando ele
+    // fica pronto. Até lá (por exemplo, ao recarregar os shaders com a tecla
+    // R), o programa anterior da permutação continua sendo usado.
+
+    std::string vertex_source = LoadShaderSource("../../src/shader_vertex.glsl", "");
+    std::string fragment_source = LoadShaderSource("../../src/shader_fragment.glsl", "");
+
+    // Cada material usa duas permutações: a completa e a simplificada para
+    // objetos distantes (veja "shading_lod.h"), que podem coincidir.
+    std::vector<bool> used(g_GpuPrograms.size(), false);
+    auto find_program = [&used](const ShaderPermutation& permutation) -> int
+    {
+        // Procuramos um programa já criado para esta permutação
+        size_t p = 0;
+        while (p < g_GpuPrograms.size() && !(g_GpuPrograms[p].permutation == permutation))
+            ++p;
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+        if (p == g_GpuPrograms.size())
+        {
+            GpuProgram program;
+            program.permutation = permutation;
+            g_GpuPrograms.push_back(program);
+            used.push_back(false);
+        }
+        used[p] = true;
+        return (int)p;
+    };
+    for (size_t m = 0; m < g_Materials.size(); ++m)
+    {
+        Material& material = g_Materials[m];
+        material.program = find_program(material.permutation);
+        material.lod_program = find_program(material.permutation.Lod());
+    }
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    int num_cached = 0;
+    int num_compiling = 0;
+    int num_used = 0;
+    for (size_t p = 0; p < g_GpuPrograms.size(); ++p)
     {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+        GpuProgram& program = g_GpuPrograms[p];
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        // Descartamos uma compilação anterior que ainda não terminou
+        if (program.pending_id != 0)
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            glDeleteShader(program.pending_vertex_shader);
+            glDeleteShader(program.pending_fragment_shader);
+            glDeleteProgram(program.pending_id);
+            program.pending_id = 0;
+        }
 
-            glm::vec4  vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
-            }
+        // Permutações que nenhum material usa mais (por exemplo, após a
+        // troca para BAKED_LIGHTING em LoadLightmaps()) não são recompiladas
+        if (!used[p])
+        {
+            if (program.id != 0)
+                glDeleteProgram(program.id);
+            program.id = 0;
+            continue;
+        }
+        ++num_used;
 
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
+        std::string defines = program.permutation.defines();
+        std::string vertex_permutation = vertex_source;
+        std::string fragment_permutation = fragment_source;
+        InsertShaderDefines(vertex_permutation, defines);
+        InsertShaderDefines(fragment_permutation, defines);
 
-            // PREENCHA AQUI o cálculo da normal de um triângulo cujos vértices
-            // estão nos pontos "a", "b", e "c", definidos no sentido anti-horário.
-            const glm::vec4  n = crossproduct(b-a,c-a);
+        program.cache_key = ProgramCache_Key(vertex_permutation, fragment_permutation);
+        program.pending_id = glCreateProgram();
+        program.pending_vertex_shader = 0;
+        program.pending_fragment_shader = 0;
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
-            }
+        if (ProgramCache_Load(program.cache_key, program.pending_id))
+        {
+            ActivatePendingProgram(program);
+            ++num_cached;
+            continue;
         }
+
+        // O binário não existe ou foi rejeitado pelo driver; recriamos o
+        // programa para compilá-lo a partir do código fonte.
+        glDeleteProgram(program.pending_id);
+        program.pending_id = glCreateProgram();
+
+        const GLchar* vertex_string = vertex_permutation.c_str();
+        const GLchar* fragment_string = fragment_permutation.c_str();
+        program.pending_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        program.pending_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(program.pending_vertex_shader, 1, &vertex_string, NULL);
+        glShaderSource(program.pending_fragment_shader, 1, &fragment_string, NULL);
+        glCompileShader(program.pending_vertex_shader);
+        glCompileShader(program.pending_fragment_shader);
+
+        glAttachShader(program.pending_id, program.pending_vertex_shader);
+        glAttachShader(program.pending_id, program.pending_fragment_shader);
+        ProgramCache_MarkRetrievable(program.pending_id);
+        glLinkProgram(program.pending_id);
+        ++num_compiling;
     }
 
-    model->attrib.normals.resize( 3*num_vertices );
+    printf("%d programas de GPU para %d materiais: %d do cache, %d em compilação.\n",
+           num_used, (int)g_Materials.size(), num_cached, num_compiling);
+
+    // Sem compilação paralela, esperamos todos os programas aqui mesmo.
+    if (!g_ProgramCache.parallel_supported)
+        PollGpuPrograms();
+}
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+// Verifica os programas de GPU em compilação (veja LoadShadersFromFiles()).
+// Os que terminaram com sucesso são salvos no cache em disco e passam a ser
+// usados; em caso de erro, o log é impresso e o programa anterior é mantido.
+void PollGpuPrograms()
+{
+    for (size_t p = 0; p < g_GpuPrograms.size(); ++p)
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        GpuProgram& program = g_GpuPrograms[p];
+        if (program.pending_id == 0 || !ProgramCache_IsLinkComplete(program.pending_id))
+            continue;
+
+        PrintShaderLog("../../src/shader_vertex.glsl", program.pending_vertex_shader);
+        PrintShaderLog("../../src/shader_fragment.glsl", program.pending_fragment_shader);
+        glDeleteShader(program.pending_vertex_shader);
+        glDeleteShader(program.pending_fragment_shader);
+        program.pending_vertex_shader = 0;
+        program.pending_fragment_shader = 0;
+
+        GLint linked_ok = GL_FALSE;
+        glGetProgramiv(program.pending_id, GL_LINK_STATUS, &linked_ok);
+        if ( linked_ok == GL_FALSE )
+        {
+            PrintProgramLog(program.pending_id);
+            glDeleteProgram(program.pending_id);
+            program.pending_id = 0;
+            continue;
+        }
+
+        ProgramCache_Store(program.cache_key, program.pending_id);
+        ActivatePendingProgram(program);
     }
 }
 
-// Constrói triângulos para futura renderização a partir de um ObjModel.
-void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+// Substitui o programa de GPU de uma permutação por program.pending_id, já
+// linkado com sucesso.
+void ActivatePendingProgram(GpuProgram& program)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+    if (program.id != 0)
+        glDeleteProgram(program.id);
+    program.id = program.pending_id;
+    program.pending_id = 0;
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+    // Forçamos BindMaterial() a reenviar matrizes e parâmetros
+    g_CurrentProgram = -1;
+    g_CurrentMaterial = -1;
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
-    {
-        size_t first_index = indices.size();
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+    // Buscamos o endereço das variáveis definidas dentro dos shaders.
+    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
+    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
+    program.model_uniform       = glGetUniformLocation(program.id, "model"); // Variável da matriz "model"
+    program.view_uniform        = glGetUniformLocation(program.id, "view"); // Variável da matriz "view" em shader_vertex.glsl
+    program.projection_uniform  = glGetUniformLocation(program.id, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
+    program.bbox_min_uniform    = glGetUniformLocation(program.id, "bbox_min");
+    program.bbox_max_uniform    = glGetUniformLocation(program.id, "bbox_max");
+    program.kd_texture_uniform  = glGetUniformLocation(program.id, "KdTexture");
+    program.kd2_texture_uniform = glGetUniformLocation(program.id, "Kd2Texture");
+    program.ks_texture_uniform  = glGetUniformLocation(program.id, "KsTexture");
+    program.kd_uniform          = glGetUniformLocation(program.id, "material_kd");
+    program.ks_uniform          = glGetUniformLocation(program.id, "material_ks");
+    program.ka_factor_uniform   = glGetUniformLocation(program.id, "material_ka");
+    program.q_uniform           = glGetUniformLocation(program.id, "material_q");
+    program.uv_scale_uniform    = glGetUniformLocation(program.id, "uv_scale");
+    program.uv_offset_uniform   = glGetUniformLocation(program.id, "uv_offset");
+    program.uv_wrap_uniform     = glGetUniformLocation(program.id, "uv_wrap");
+    program.light_data_uniform  = glGetUniformLocation(program.id, "light_data");
+    program.light_grid_uniform  = glGetUniformLocation(program.id, "light_grid");
+    program.light_index_uniform = glGetUniformLocation(program.id, "light_index");
+    program.cluster_params_uniform = glGetUniformLocation(program.id, "cluster_params");
+    program.cluster_count_uniform  = glGetUniformLocation(program.id, "cluster_count");
+    program.shadow_static_uniform  = glGetUniformLocation(program.id, "shadow_static");
+    program.shadow_dynamic_uniform = glGetUniformLocation(program.id, "shadow_dynamic");
+    program.shadow_matrix_uniform  = glGetUniformLocation(program.id, "shadow_matrix");
+    program.shadow_enabled_uniform = glGetUniformLocation(program.id, "shadow_enabled");
+    program.lightmap_uniform       = glGetUniformLocation(program.id, "lightmap");
+}
 
-        const float minval = std::numeric_limits<float>::min();
-        const float maxval = std::numeric_limits<float>::max();
+// Adiciona as luzes pontuais da cena, além da luz principal fixa em
+// "shader_fragment.glsl". A sala ocupa aproximadamente x em [-10,10], z em
+// [-8,8] e y em [-1,3.7].
+void LoadLights()
+{
+    Lights_Clear();
+
+    // Luminárias do teto
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            Lights_Add(glm::vec3(-7.5f + 5.0f*i, 3.3f, -5.0f + 5.0f*j), glm::vec3(1.0f, 0.85f, 0.6f), 6.0f, 1.5f);
+
+    // Luz sobre o tabuleiro e brilho da TV
+    Lights_Add(glm::vec3(-3.8f, 1.5f, -3.9f), glm::vec3(1.0f, 0.9f, 0.75f), 3.0f, 1.0f);
+    Lights_Add(glm::vec3(-8.6f, 0.9f, 1.2f), glm::vec3(0.4f, 0.6f, 1.0f), 3.0f, 1.5f);
+
+    // Cordão de luzes coloridas contornando as paredes, perto do teto
+    const glm::vec3 colors[] = {
+        glm::vec3(1.0f, 0.3f, 0.3f), glm::vec3(0.3f, 1.0f, 0.4f),
+        glm::vec3(0.3f, 0.5f, 1.0f), glm::vec3(1.0f, 0.8f, 0.3f)
+    };
+    const float x = 9.3f, z = 7.3f, spacing = 0.5f;
+    int n = 0;
+    for (float t = -x; t < x; t += spacing, ++n)
+    {
+        Lights_Add(glm::vec3(t, 3.4f, -z), colors[n % 4], 1.5f, 0.8f);
+        Lights_Add(glm::vec3(-t, 3.4f, z), colors[n % 4], 1.5f, 0.8f);
+    }
+    for (float t = -z; t < z; t += spacing, ++n)
+    {
+        Lights_Add(glm::vec3(x, 3.4f, t), colors[n % 4], 1.5f, 0.8f);
+        Lights_Add(glm::vec3(-x, 3.4f, -t), colors[n % 4], 1.5f, 0.8f);
+    }
 
-        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
-        glm::vec3 bbox_max = glm::vec3(minval,minval,minval);
+    printf("%d luzes pontuais.\n", Lights_Count());
+}
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+// Carrega os lightmaps dos objetos em "baked_objects", gerando-os antes com
+// Lightmap_Bake() se "bake" for verdadeiro (opção --bake na linha de
+// comando). Todos os objetos de "static_objects" participam do cálculo como
+// oclusores. As classes de material cujas instâncias têm todas um lightmap
+// passam a usar a permutação BAKED_LIGHTING.
+void LoadLightmaps(const std::vector<SceneObject*>& static_objects, const std::vector<SceneObject*>& baked_objects, bool bake)
+{
+    PROFILE_FUNCTION();
+    if (bake)
+    {
+        std::vector<LightmapObject> objects;
+        for (SceneObject* obj : static_objects)
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            LightmapObject object;
+            object.name = obj->get_name();
+            object.mesh = &g_MeshData.at(obj->get_model_name());
+            object.model = obj->get_model();
+            object.bake = std::find(baked_objects.begin(), baked_objects.end(), obj) != baked_objects.end();
+            object.cast_shadow = obj->casts_shadow();
+            objects.push_back(object);
+        }
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-
-                indices.push_back(first_index + 3*triangle + vertex);
-
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                //printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
-                model_coefficients.push_back( vx ); // X
-                model_coefficients.push_back( vy ); // Y
-                model_coefficients.push_back( vz ); // Z
-                model_coefficients.push_back( 1.0f ); // W
-
-                bbox_min.x = std::min(bbox_min.x, vx);
-                bbox_min.y = std::min(bbox_min.y, vy);
-                bbox_min.z = std::min(bbox_min.z, vz);
-                bbox_max.x = std::max(bbox_max.x, vx);
-                bbox_max.y = std::max(bbox_max.y, vy);
-                bbox_max.z = std::max(bbox_max.z, vz);
-
-                // Inspecionando o código da tinyobjloader, o aluno Bernardo
-                // Sulzbach (2017/1) apontou que a maneira correta de testar se
-                // existem normais e coordenadas de textura no ObjModel é
-                // comparando se o índice retornado é -1. Fazemos isso abaixo.
-
-                if ( idx.normal_index != -1 )
-                {
-                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
-                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
-                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
-                    normal_coefficients.push_back( nx ); // X
-                    normal_coefficients.push_back( ny ); // Y
-                    normal_coefficients.push_back( nz ); // Z
-                    normal_coefficients.push_back( 0.0f ); // W
-                }
+        // Mesma luz principal de "shader_fragment.glsl" e de Shadows_Init()
+        LightmapSettings settings;
+        settings.light_direction = glm::vec3(1.0f, 1.0f, 0.5f);
+        Lightmap_Bake(objects, settings);
+    }
 
-                if ( idx.texcoord_index != -1 )
-                {
-                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
-                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
-                    texture_coefficients.push_back( u );
-                    texture_coefficients.push_back( v );
-                }
-            }
+    int num_loaded = 0;
+    for (SceneObject* obj : baked_objects)
+    {
+        obj->set_lightmap(Lightmap_LoadTexture(obj->get_name()));
+        if (obj->get_lightmap() != 0)
+            ++num_loaded;
+    }
+
+    bool changed = false;
+    for (int m = 0; m < NUM_MATERIALS; ++m)
+    {
+        int num_objects = 0;
+        bool all_baked = true;
+        for (SceneObject* obj : objects_to_draw)
+        {
+            if (obj->get_index() != m)
+                continue;
+            ++num_objects;
+            all_baked = all_baked && obj->get_lightmap() != 0;
+        }
+
+        bool lightmap = num_objects > 0 && all_baked;
+        if (g_Materials[m].permutation.lightmap != lightmap)
+        {
+            g_Materials[m].permutation.lightmap = lightmap;
+            changed = true;
         }
+    }
+
+    printf("%d de %d lightmaps carregados%s\n", num_loaded, (int)baked_objects.size(),
+           num_loaded == 0 ? " (execute com --bake para gerá-los)." : ".");
+
+    if (changed)
+        LoadShadersFromFiles();
+}
+
+// Função que define os parâmetros de cada classe de material, indexadas pelo
+// identificador do objeto (SPHERE, BUNNY, ...). As texturas são as "texture
+// units" atribuídas na ordem das chamadas a LoadTextureImage() em main().
+void LoadMaterials()
+{
+    PROFILE_FUNCTION();
+    g_Materials.assign(NUM_MATERIALS, Material());
+
+    // Objetos sem classe definida são desenhados em preto
+    Material black;
+    black.permutation.mapping  = MAPPING_NONE;
+    black.permutation.lighting = LIGHTING_UNLIT;
+
+    Material& sphere = g_Materials[SPHERE];
+    sphere.permutation.mapping = MAPPING_SPHERICAL;
+    sphere.kd_texture = 0;
+    sphere.ks = glm::vec3(0.01f,0.01f,0.01f);
+    sphere.ka_factor = 1.0f/2;
+    sphere.q = 1.0f;
+
+    Material& bunny = g_Materials[BUNNY];
+    bunny.kd_texture = 10;
+    bunny.ks = glm::vec3(0.6f,0.6f,0.6f);
+    bunny.ka_factor = 1.0f/4;
+    bunny.q = 32.0f;
+
+    Material& room_floor = g_Materials[ROOM_FLOOR];
+    room_floor.permutation.mapping = MAPPING_PLANAR_XZ;
+    room_floor.permutation.kd2_texture = true;
+    room_floor.kd_texture = 3;
+    room_floor.kd2_texture = 4;
+    room_floor.uv_scale = glm::vec2(3.0f,2.0f);
+    room_floor.ks = glm::vec3(0.1f,0.1f,0.1f);
+    room_floor.ka_factor = 1.0f/2;
+    room_floor.q = 32.0f;
+
+    Material& wall = g_Materials[WALL_1];
+    wall.permutation.mapping = MAPPING_PLANAR_XY;
+    wall.permutation.lighting = LIGHTING_LAMBERT;
+    wall.permutation.kd2_texture = true;
+    wall.kd_texture = 5;
+    wall.kd2_texture = 6;
+    wall.uv_scale = glm::vec2(1.9f,1.0f);
+    wall.ka_factor = 1.0f/2;
+
+    Material& skybox = g_Materials[SKYBOX];
+    skybox.permutation.mapping = MAPPING_NONE;
+    skybox.permutation.lighting = LIGHTING_UNLIT;
+    skybox.kd = glm::vec3(0.1f,0.1f,0.1f);
+
+    g_Materials[WALL_1_SIDE] = black;
+
+    Material& table = g_Materials[TABLE];
+    table.kd_texture = 7;
+    table.ks = glm::vec3(0.04f,0.04f,0.04f);
+    table.ka_factor = 1.0f/6;
+    table.q = 32.0f;
+
+    Material& chess = g_Materials[CHESS];
+    chess.permutation.mapping = MAPPING_PLANAR_XZ;
+    chess.kd_texture = 8;
+    chess.uv_scale = glm::vec2(0.11f,0.11f);
+    chess.ks = glm::vec3(0.1f,0.1f,0.1f);
+    chess.ka_factor = 1.0f/8;
+    chess.q = 16.0f;
+
+    // Interpolação de Gouraud com o modelo de Phong
+    Material& bowl = g_Materials[BOWL];
+    bowl.permutation.lighting = LIGHTING_PHONG;
+    bowl.permutation.gouraud = true;
+    bowl.kd_texture = 9;
+    bowl.ks = glm::vec3(0.04f,0.04f,0.04f);
+    bowl.ka_factor = 1.0f/8;
+    bowl.q = 16.0f;
+
+    Material& white_piece = g_Materials[WHITE_PIECE];
+    white_piece.kd_texture = 10;
+    white_piece.ks = glm::vec3(0.05f,0.05f,0.05f);
+    white_piece.ka_factor = 1.0f/4;
+    white_piece.q = 16.0f;
+
+    Material& black_piece = g_Materials[BLACK_PIECE];
+    black_piece = white_piece;
+    black_piece.kd_texture = 11;
+
+    Material& console_table = g_Materials[CONSOLE_TABLE];
+    console_table.kd_texture = 12;
+    console_table.ks = glm::vec3(0.01f,0.01f,0.01f);
+    console_table.ka_factor = 1.0f/4;
+    console_table.q = 16.0f;
+
+    g_Materials[DRAWER] = console_table;
+
+    Material& sofa = g_Materials[SOFA];
+    sofa.permutation.lighting = LIGHTING_LAMBERT;
+    sofa.permutation.kd2_texture = true;
+    sofa.kd_texture = 13;
+    sofa.kd2_texture = 14;
+    sofa.ka_factor = 1.0f/2;
+
+    Material& tv = g_Materials[TV];
+    tv.permutation.mapping = MAPPING_NONE;
+    tv.kd = glm::vec3(0.01f,0.01f,0.01f);
+    tv.ks = glm::vec3(0.2f,0.2f,0.2f);
+    tv.ka_factor = 1.0f/8;
+    tv.q = 32.0f;
+
+    Material& shelf = g_Materials[SHELF];
+    shelf.kd_texture = 15;
+    shelf.ks = glm::vec3(0.03f,0.03f,0.03f);
+    shelf.ka_factor = 1.0f/6;
+    shelf.q = 16.0f;
+
+    Material& chair = g_Materials[CHAIR];
+    chair.permutation.ks_texture = true;
+    chair.kd_texture = 17;
+    chair.ks_texture = 18;
+    chair.ka_factor = 1.0f/8;
+    chair.q = 64.0f;
+
+    Material& bed = g_Materials[BED];
+    bed.permutation.lighting = LIGHTING_LAMBERT;
+    bed.kd_texture = 16;
+    bed.ka_factor = 1.0f/4;
+
+    Material& book_shelf = g_Materials[BOOK_SHELF];
+    book_shelf.kd_texture = 19;
+    book_shelf.ka_factor = 1.0f/2;
+
+    Material& books = g_Materials[BOOKS];
+    books.permutation.mapping = MAPPING_PLANAR_XY;
+    books.permutation.lighting = LIGHTING_LAMBERT;
+    books.kd_texture = 20;
+    books.uv_scale = glm::vec2(0.4f,0.7f);
+    books.uv_offset = glm::vec2(0.0f,0.5f);
+    books.uv_wrap = glm::vec2(1.0f,0.0f);
+    books.ka_factor = 1.0f/4;
+
+    Material& ceiling = g_Materials[ROOM_CEILING];
+    ceiling.permutation.mapping = MAPPING_PLANAR_XZ;
+    ceiling.permutation.lighting = LIGHTING_LAMBERT;
+    ceiling.kd_texture = 21;
+    ceiling.uv_scale = glm::vec2(2.0f,2.0f);
+    ceiling.ks = glm::vec3(0.01f,0.01f,0.01f);
+    ceiling.ka_factor = 1.0f/4;
+    ceiling.q = 32.0f;
+
+    // Material usado por objetos com índice fora da tabela
+    g_Materials.push_back(black);
+}
+
+// Retorna o índice em g_Materials da classe de material de um objeto, a
+// partir do seu identificador
+int GetMaterialIndex(int object_id)
+{
+    if (object_id < 0 || object_id >= NUM_MATERIALS)
+        return NUM_MATERIALS;
+    return object_id;
+}
 
-        size_t last_index = indices.size() - 1;
+// Ativa o programa de GPU da classe de material indicada e envia seus
+// parâmetros. O programa só é trocado quando necessário; quando ele é ativado,
+// enviamos também as matrizes "view" e "projection" do quadro atual.
+// Com "lod", usa o programa simplificado do material (veja "shading_lod.h"),
+// ou o completo enquanto o simplificado não estiver pronto.
+// Retorna false se o programa ainda está sendo compilado pela primeira vez.
+bool BindMaterial(int object_id, bool lod)
+{
+    int material_index = GetMaterialIndex(object_id);
+    const Material& material = g_Materials[material_index];
+    int program_index = material.program;
+    if (lod && g_GpuPrograms[material.lod_program].id != 0)
+        program_index = material.lod_program;
+    const GpuProgram& program = g_GpuPrograms[program_index];
 
+    if (program.id == 0)
+        return false;
 
+    if (g_CurrentProgram != program_index)
+    {
+        glUseProgram(program.id);
+        glUniformMatrix4fv(program.view_uniform       , 1 , GL_FALSE , glm::value_ptr(g_ViewMatrix));
+        glUniformMatrix4fv(program.projection_uniform , 1 , GL_FALSE , glm::value_ptr(g_ProjectionMatrix));
+
+        // Luzes pontuais. Veja Lights_Update().
+        ClusterUniforms clusters = Lights_GetClusterUniforms();
+        glUniform1i(program.light_data_uniform, LIGHT_DATA_TEXTURE_UNIT);
+        glUniform1i(program.light_grid_uniform, LIGHT_GRID_TEXTURE_UNIT);
+        glUniform1i(program.light_index_uniform, LIGHT_INDEX_TEXTURE_UNIT);
+        glUniform4f(program.cluster_params_uniform, clusters.tile_scale_x, clusters.tile_scale_y, clusters.z_scale, clusters.z_bias);
+        glUniform3i(program.cluster_count_uniform, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+
+        // Sombras da luz principal. Veja Shadows_Update().
+        glUniform1i(program.shadow_static_uniform, SHADOW_STATIC_TEXTURE_UNIT);
+        glUniform1i(program.shadow_dynamic_uniform, SHADOW_DYNAMIC_TEXTURE_UNIT);
+        glUniformMatrix4fv(program.shadow_matrix_uniform, 1, GL_FALSE, glm::value_ptr(Shadows_Matrix()));
+        glUniform1f(program.shadow_enabled_uniform, g_ShadowsEnabled ? 1.0f : 0.0f);
+        glUniform1i(program.lightmap_uniform, LIGHTMAP_TEXTURE_UNIT);
+        g_CurrentProgram = program_index;
+        g_CurrentMaterial = -1;
+    }
 
+    if (g_CurrentMaterial == material_index)
+        return true;
+
+    glUniform1i(program.kd_texture_uniform, material.kd_texture);
+    glUniform1i(program.kd2_texture_uniform, material.kd2_texture);
+    glUniform1i(program.ks_texture_uniform, material.ks_texture);
+    glUniform3fv(program.kd_uniform, 1, glm::value_ptr(material.kd));
+    glUniform3fv(program.ks_uniform, 1, glm::value_ptr(material.ks));
+    glUniform1f(program.ka_factor_uniform, material.ka_factor);
+    glUniform1f(program.q_uniform, material.q);
+    glUniform2fv(program.uv_scale_uniform, 1, glm::value_ptr(material.uv_scale));
+    glUniform2fv(program.uv_offset_uniform, 1, glm::value_ptr(material.uv_offset));
+    glUniform2fv(program.uv_wrap_uniform, 1, glm::value_ptr(material.uv_wrap));
+    g_CurrentMaterial = material_index;
+    return true;
+}
 
-        SceneObject *theobject = new SceneObject (first_index,
-                                                         last_index - first_index + 1,
+// Desenha um objeto de g_VirtualScene com a matriz "model" e a classe de
+// material indicadas. "lightmap" é a textura de iluminação pré-calculada do
+// objeto, usada pelos materiais com BAKED_LIGHTING. "lod" seleciona o
+// programa simplificado do material (veja draw_objects()).
+void DrawSceneObject(const glm::mat4& model, int object_id, const char* object_name, GLuint lightmap, bool lod)
+{
+    if (!BindMaterial(object_id, lod))
+        return;
+    if (lightmap != 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, lightmap);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glUniformMatrix4fv(g_GpuPrograms[g_CurrentProgram].model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
+    DrawVirtualObject(object_name);
+}
+
+
+// Constrói triângulos para futura renderização a partir de um ObjModel.
+void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+{
+    PROFILE_FUNCTION();
+    GLuint vertex_array_object_id;
+    glGenVertexArrays(1, &vertex_array_object_id);
+    glBindVertexArray(vertex_array_object_id);
+
+    MeshBuffers buffers;
+    std::vector<MeshShape> shapes;
+    MeshBuilder_Build(model, g_MeshData, buffers, shapes);
+
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        SceneObject *theobject = new SceneObject (shapes[shape].first_index,
+                                                         shapes[shape].num_indices,
                                                          GL_TRIANGLES,
                                                          vertex_array_object_id,
                                                          obj_index++,
-                                                         bbox_min,
-                                                         bbox_max);
-
+                                                         shapes[shape].bbox_min,
+                                                         shapes[shape].bbox_max);
 
-
-        theobject->set_name(model->shapes[shape].name);
-        theobject->set_model_name(model->shapes[shape].name);
-        g_VirtualScene[model->shapes[shape].name] = *theobject;
+        theobject->set_name(shapes[shape].name);
+        theobject->set_model_name(shapes[shape].name);
+        theobject->set_mesh_bvh(&shapes[shape].mesh->bvh);
+        g_VirtualScene[shapes[shape].name] = *theobject;
     }
 
     GLuint VBO_model_coefficients_id;
     glGenBuffers(1, &VBO_model_coefficients_id);
     glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
+    glBufferData(GL_ARRAY_BUFFER, buffers.model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, buffers.model_coefficients.size() * sizeof(float), buffers.model_coefficients.data());
     GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
     GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
     glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(location);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    if ( !normal_coefficients.empty() )
+    if ( !buffers.normal_coefficients.empty() )
     {
         GLuint VBO_normal_coefficients_id;
         glGenBuffers(1, &VBO_normal_coefficients_id);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
+        glBufferData(GL_ARRAY_BUFFER, buffers.normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, buffers.normal_coefficients.size() * sizeof(float), buffers.normal_coefficients.data());
         location = 1; // "(location = 1)" em "shader_vertex.glsl"
         number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
         glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
@@ -1595,13 +2438,13 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    if ( !texture_coefficients.empty() )
+    if ( !buffers.texture_coefficients.empty() )
     {
         GLuint VBO_texture_coefficients_id;
         glGenBuffers(1, &VBO_texture_coefficients_id);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
+        glBufferData(GL_ARRAY_BUFFER, buffers.texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, buffers.texture_coefficients.size() * sizeof(float), buffers.texture_coefficients.data());
         location = 2; // "(location = 1)" em "shader_vertex.glsl"
         number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
         glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
@@ -1609,13 +2452,24 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    GLuint VBO_lightmap_coefficients_id;
+    glGenBuffers(1, &VBO_lightmap_coefficients_id);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_lightmap_coefficients_id);
+    glBufferData(GL_ARRAY_BUFFER, buffers.lightmap_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, buffers.lightmap_coefficients.size() * sizeof(float), buffers.lightmap_coefficients.data());
+    location = 3; // "(location = 3)" em "shader_vertex.glsl"
+    number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
+    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
     GLuint indices_id;
     glGenBuffers(1, &indices_id);
 
     // "Ligamos" o buffer. Note que o tipo agora é GL_ELEMENT_ARRAY_BUFFER.
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, buffers.indices.size() * sizeof(GLuint), buffers.indices.data());
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
     //
 
@@ -1625,40 +2479,56 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
 }
 
 // Carrega um Vertex Shader de um arquivo GLSL. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Vertex(const char* filename)
+GLuint LoadShader_Vertex(const char* filename, const std::string& defines)
 {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos vértices.
     GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    LoadShader(filename, vertex_shader_id, defines);
 
     // Retorna o ID gerado acima
     return vertex_shader_id;
 }
 
 // Carrega um Fragment Shader de um arquivo GLSL . Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Fragment(const char* filename)
+GLuint LoadShader_Fragment(const char* filename, const std::string& defines)
 {
     // Criamos um identificador (ID) para este shader, informando que o mesmo
     // será aplicado nos fragmentos.
     GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
 
     // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+    LoadShader(filename, fragment_shader_id, defines);
 
     // Retorna o ID gerado acima
     return fragment_shader_id;
 }
 
 // Função auxilar, utilizada pelas duas funções acima. Carrega código de GPU de
-// um arquivo GLSL e faz sua compilação.
-void LoadShader(const char* filename, GLuint shader_id)
+// um arquivo GLSL e faz sua compilação. Os #defines em "defines" são inseridos
+// logo após a linha "#version" do arquivo.
+void LoadShader(const char* filename, GLuint shader_id, const std::string& defines)
+{
+    std::string str = LoadShaderSource(filename, defines);
+    const GLchar* shader_string = str.c_str();
+    const GLint   shader_string_length = static_cast<GLint>( str.length() );
+
+    // Define o código do shader GLSL, contido na string "shader_string"
+    glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
+
+    // Compila o código do shader GLSL (em tempo de execução)
+    glCompileShader(shader_id);
+
+    // Verificamos se ocorreu algum erro ou "warning" durante a compilação
+    PrintShaderLog(filename, shader_id);
+}
+
+// Lê o arquivo de texto indicado pela variável "filename" e retorna seu
+// conteúdo, com os #defines em "defines" inseridos após a linha "#version".
+std::string LoadShaderSource(const char* filename, const std::string& defines)
 {
-    // Lemos o arquivo de texto indicado pela variável "filename"
-    // e colocamos seu conteúdo em memória, apontado pela variável
-    // "shader_string".
     std::ifstream file;
     try {
         file.exceptions(std::ifstream::failbit);
@@ -1670,16 +2540,23 @@ void LoadShader(const char* filename, GLuint shader_id)
     std::stringstream shader;
     shader << file.rdbuf();
     std::string str = shader.str();
-    const GLchar* shader_string = str.c_str();
-    const GLint   shader_string_length = static_cast<GLint>( str.length() );
+    InsertShaderDefines(str, defines);
+    return str;
+}
 
-    // Define o código do shader GLSL, contido na string "shader_string"
-    glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
+void InsertShaderDefines(std::string& source, const std::string& defines)
+{
+    if ( defines.empty() )
+        return;
 
-    // Compila o código do shader GLSL (em tempo de execução)
-    glCompileShader(shader_id);
+    size_t version_end = source.find('\n', source.find("#version"));
+    source.insert(version_end == std::string::npos ? source.size() : version_end + 1, defines);
+}
 
-    // Verificamos se ocorreu algum erro ou "warning" durante a compilação
+// Imprime no terminal qualquer erro ou "warning" da compilação do shader
+// "shader_id", carregado do arquivo "filename".
+void PrintShaderLog(const char* filename, GLuint shader_id)
+{
     GLint compiled_ok;
     glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
 
@@ -1742,35 +2619,39 @@ GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id)
 
     // Imprime no terminal qualquer erro de linkagem
     if ( linked_ok == GL_FALSE )
-    {
-        GLint log_length = 0;
-        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
+        PrintProgramLog(program_id);
 
-        // Alocamos memória para guardar o log de compilação.
-        // A chamada "new" em C++ é equivalente ao "malloc()" do C.
-        GLchar* log = new GLchar[log_length];
+    // Os "Shader Objects" podem ser marcados para deleção após serem linkados
+    glDeleteShader(vertex_shader_id);
+    glDeleteShader(fragment_shader_id);
 
-        glGetProgramInfoLog(program_id, log_length, &log_length, log);
+    // Retornamos o ID gerado acima
+    return program_id;
+}
 
-        std::string output;
+// Imprime no terminal o log de linkagem do programa "program_id".
+void PrintProgramLog(GLuint program_id)
+{
+    GLint log_length = 0;
+    glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
 
-        output += "ERROR: OpenGL linking of program failed.\n";
-        output += "== Start of link log\n";
-        output += log;
-        output += "\n== End of link log\n";
+    // Alocamos memória para guardar o log de compilação.
+    // A chamada "new" em C++ é equivalente ao "malloc()" do C.
+    GLchar* log = new GLchar[log_length];
 
-        // A chamada "delete" em C++ é equivalente ao "free()" do C
-        delete [] log;
+    glGetProgramInfoLog(program_id, log_length, &log_length, log);
 
-        fprintf(stderr, "%s", output.c_str());
-    }
+    std::string output;
 
-    // Os "Shader Objects" podem ser marcados para deleção após serem linkados
-    glDeleteShader(vertex_shader_id);
-    glDeleteShader(fragment_shader_id);
+    output += "ERROR: OpenGL linking of program failed.\n";
+    output += "== Start of link log\n";
+    output += log;
+    output += "\n== End of link log\n";
 
-    // Retornamos o ID gerado acima
-    return program_id;
+    // A chamada "delete" em C++ é equivalente ao "free()" do C
+    delete [] log;
+
+    fprintf(stderr, "%s", output.c_str());
 }
 
 // Definição da função que será chamada sempre que a janela do sistema
@@ -1792,6 +2673,9 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     // O cast para float é necessário pois números inteiros são arredondados ao
     // serem divididos!
     g_ScreenRatio = (float)width / height;
+
+    g_FramebufferWidth = width;
+    g_FramebufferHeight = height;
 }
 
 // Variáveis globais que armazenam a última posição do cursor do mouse, para
@@ -1799,8 +2683,20 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 // de tempo. Utilizadas no callback CursorPosCallback() abaixo.
 double g_LastCursorPosX, g_LastCursorPosY;
 
-// Função callback chamada sempre que o usuário aperta algum dos botões do mouse
+// Função callback chamada sempre que o usuário aperta algum dos botões do
+// mouse. Assim como os demais callbacks de entrada, somente repassa o evento
+// para a thread de simulação (veja "frame_packet.h" e HandleInputEvent()).
 void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (InputReplay_IsReplaying() || g_Benchmark.running)
+        return;
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    InputQueue_Push(INPUT_MOUSE_BUTTON, button, action, xpos, ypos);
+}
+
+// Trata um botão do mouse pressionado ou solto, na thread de simulação
+void HandleMouseButton(int button, int action, double xpos, double ypos)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
     {
@@ -1809,7 +2705,8 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         // g_LastCursorPosY.  Também, setamos a variável
         // g_LeftMouseButtonPressed como true, para saber que o usuário está
         // com o botão esquerdo pressionado.
-        glfwGetCursorPos(window, &g_LastCursorPosX, &g_LastCursorPosY);
+        g_LastCursorPosX = xpos;
+        g_LastCursorPosY = ypos;
         g_LeftMouseButtonPressed = true;
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE)
@@ -1825,7 +2722,8 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         // g_LastCursorPosY.  Também, setamos a variável
         // g_RightMouseButtonPressed como true, para saber que o usuário está
         // com o botão esquerdo pressionado.
-        glfwGetCursorPos(window, &g_LastCursorPosX, &g_LastCursorPosY);
+        g_LastCursorPosX = xpos;
+        g_LastCursorPosY = ypos;
         g_RightMouseButtonPressed = true;
     }
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE)
@@ -1841,7 +2739,8 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         // g_LastCursorPosY.  Também, setamos a variável
         // g_MiddleMouseButtonPressed como true, para saber que o usuário está
         // com o botão esquerdo pressionado.
-        glfwGetCursorPos(window, &g_LastCursorPosX, &g_LastCursorPosY);
+        g_LastCursorPosX = xpos;
+        g_LastCursorPosY = ypos;
         g_MiddleMouseButtonPressed = true;
     }
     if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_RELEASE)
@@ -1855,6 +2754,14 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 // Função callback chamada sempre que o usuário movimentar o cursor do mouse em
 // cima da janela OpenGL.
 void CursorPosCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    if (InputReplay_IsReplaying() || g_Benchmark.running)
+        return;
+    InputQueue_Push(INPUT_CURSOR, 0, 0, xpos, ypos);
+}
+
+// Trata o movimento do cursor, na thread de simulação
+void HandleCursorPos(double xpos, double ypos)
 {
     // Abaixo executamos o seguinte: caso o botão esquerdo do mouse esteja
     // pressionado, computamos quanto que o mouse se movimento desde o último
@@ -1898,6 +2805,14 @@ void CursorPosCallback(GLFWwindow* window, double xpos, double ypos)
 
 // Função callback chamada sempre que o usuário movimenta a "rodinha" do mouse.
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    if (InputReplay_IsReplaying() || g_Benchmark.running)
+        return;
+    InputQueue_Push(INPUT_SCROLL, 0, 0, xoffset, yoffset);
+}
+
+// Trata o movimento da "rodinha", na thread de simulação
+void HandleScroll(double yoffset)
 {
     // Atualizamos a distância da câmera para a origem utilizando a
     // movimentação da "rodinha", simulando um ZOOM.
@@ -1918,13 +2833,73 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
             std::exit(100 + i);
     // ==================
 
+    // Na reprodução e no modo de medição a entrada ao vivo é ignorada; ESC
+    // fecha a janela
+    if (InputReplay_IsReplaying() || g_Benchmark.running)
+    {
+        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+            glfwSetWindowShouldClose(window, GL_TRUE);
+        return;
+    }
+
+    HandleRenderKey(window, key, action);
+
+    // As demais teclas controlam o jogo e são tratadas pela thread de
+    // simulação, em HandleKey()
+    InputQueue_Push(INPUT_KEY, key, action, 0.0, 0.0);
+}
+
+// Teclas da renderização, na thread principal. Na reprodução da entrada são
+// chamadas com as teclas do log (veja FramePacket::replayed_keys).
+void HandleRenderKey(GLFWwindow* window, int key, int action)
+{
+    if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    {
+        LoadShadersFromFiles();
+        fprintf(stdout,"Shaders recarregados!\n");
+        fflush(stdout);
+    }
+
+    // Liga/desliga o pré-passo de profundidade
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        DepthPrepass_Toggle();
+    }
+
+    if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    {
+        DynamicResolution_ToggleSharpen();
+    }
+
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        ShadingLod_Toggle();
+    }
+
+    // Salva as zonas do profiler de CPU até agora (veja "cpu_profiler.h")
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    {
+        CpuProfiler_WriteTrace("cpu_trace.json");
+    }
+
+    if(action == GLFW_PRESS && key == GLFW_KEY_C){
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+    if(action == GLFW_PRESS && key == GLFW_KEY_V){
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    }
+}
+
+// Trata uma tecla do jogo, na thread de simulação
+void HandleKey(int key, int action)
+{
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS){
         is_inspecting = false;
         g_CameraDistance = 3.5;
 
 
         if(game_ended){
-            glfwSetWindowShouldClose(window, GL_TRUE);
+            close_window_requested = true;
         }
 
     }
@@ -1936,13 +2911,6 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         all_pieces_collected = true;
     }
 
-    if (key == GLFW_KEY_R && action == GLFW_PRESS)
-    {
-        LoadShadersFromFiles();
-        fprintf(stdout,"Shaders recarregados!\n");
-        fflush(stdout);
-    }
-
     if(key == GLFW_KEY_E && action == GLFW_PRESS && !fst_anim && !collect_anim && !all_pieces_collected){
         if(interactable_object != NULL && !is_inspecting){
             if((interactable_object->get_name() == "drawer_left" && !open_left_drawer) ||
@@ -2031,18 +2999,10 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
 
 
     if(action == GLFW_PRESS && key == GLFW_KEY_ENTER && !fst_anim){
-        t_bezier = 0.0f;
-        t_bezier2 = 0.0f;
+        fst_anim_time = 0.0f;
         fst_anim = true;
     }
 
-    if(action == GLFW_PRESS && key == GLFW_KEY_C){
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    }
-    if(action == GLFW_PRESS && key == GLFW_KEY_V){
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    }
-
     /* coordenadas da camera: x, y, z*/
     /* W -> move para frente */
 
@@ -2119,6 +3079,18 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
 
 }
 
+// Repassa um evento de entrada para a função que o trata
+void HandleInputEvent(const InputEvent& event)
+{
+    switch (event.type)
+    {
+        case INPUT_KEY:          HandleKey(event.key, event.action); break;
+        case INPUT_MOUSE_BUTTON: HandleMouseButton(event.key, event.action, event.x, event.y); break;
+        case INPUT_CURSOR:       HandleCursorPos(event.x, event.y); break;
+        case INPUT_SCROLL:       HandleScroll(event.y); break;
+    }
+}
+
 // Definimos o callback para impressão de erros da GLFW no terminal
 void ErrorCallback(int error, const char* description)
 {
@@ -2132,50 +3104,36 @@ void ErrorCallback(int error, const char* description)
 
 // Escrevemos na tela os ângulos de Euler definidos nas variáveis globais
 // g_AngleX, g_AngleY, e g_AngleZ.
+// Os avisos abaixo nunca mudam: são montados uma única vez e desenhados a
+// partir do VBO de texto. Veja TextRendering_CacheString().
 void TextRendering_Press_E_To_Inspect(GLFWwindow* window)
 {
-
-    char buffer[20];
-    snprintf(buffer, 20, "Press E to inspect\n");
-
-    TextRendering_PrintString(window, buffer, -0.15, -0.5f, 2.0f);
+    static int text = TextRendering_CacheString(window, "Press E to inspect", -0.15, -0.5f, 2.0f);
+    TextRendering_PrintCached(text);
 }
 
 void TextRendering_Press_F_To_Collect(GLFWwindow* window)
 {
-
-    char buffer[20];
-    snprintf(buffer, 20, "Press F to collect\n");
-
-    TextRendering_PrintString(window, buffer, -0.15, -0.5f, 2.0f);
+    static int text = TextRendering_CacheString(window, "Press F to collect", -0.15, -0.5f, 2.0f);
+    TextRendering_PrintCached(text);
 }
 
 void TextRendering_You_Lost(GLFWwindow* window)
 {
-
-    char buffer[20];
-    snprintf(buffer, 20, "You Lost!\n");
-
-    TextRendering_PrintString(window, buffer, -0.19, +0.6f, 5.0f);
-
+    static int text = TextRendering_CacheString(window, "You Lost!", -0.19, +0.6f, 5.0f);
+    TextRendering_PrintCached(text);
 }
+
 void TextRendering_Press_esc_to_close_game(GLFWwindow* window)
 {
-
-    char buffer[20];
-    snprintf(buffer, 20, "Press Esc to close the game.\n");
-
-    TextRendering_PrintString(window, buffer, -0.15, +0.5f, 2.0f);
-
+    static int text = TextRendering_CacheString(window, "Press Esc to close the game.", -0.15, +0.5f, 2.0f);
+    TextRendering_PrintCached(text);
 }
 
-
 void TextRendering_Press_F_To_Open(GLFWwindow* window)
 {
-    char buffer[22];
-    snprintf(buffer, 22, "Press F to open/close\n");
-
-    TextRendering_PrintString(window, buffer, -0.15, -0.6f, 2.0f);
+    static int text = TextRendering_CacheString(window, "Press F to open/close", -0.15, -0.6f, 2.0f);
+    TextRendering_PrintCached(text);
 }
 
 
@@ -2212,8 +3170,81 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
 }
 
+// Escrevemos na tela o número de amostras (fragmentos, sem multisampling)
+// que passaram no teste de profundidade durante o passo de cor, no último
+// quadro medido em cada modo. Veja "depth_prepass.h".
+void TextRendering_ShowSamplesPassed(GLFWwindow* window)
+{
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "pre-pass %s: %.2fM / sem: %.2fM",
+                            g_DepthPrepass.enabled ? "on " : "off",
+                            g_DepthPrepass.samples_with_prepass / 1e6f,
+                            g_DepthPrepass.samples_without_prepass / 1e6f);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-2*lineheight, 1.0f);
+}
+
+// Escrevemos na tela a escala da resolução da cena e o último tempo de GPU
+// medido. Veja "dynamic_resolution.h".
+void TextRendering_ShowResolutionScale(GLFWwindow* window)
+{
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "escala %.2f (%dx%d): %.1f ms",
+                            g_DynamicResolution.scale,
+                            g_DynamicResolution.render_width,
+                            g_DynamicResolution.render_height,
+                            g_DynamicResolution.gpu_ms);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-3*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos objetos foram desenhados com o programa de GPU
+// completo e com o simplificado. Veja "shading_lod.h".
+void TextRendering_ShowShadingLod(GLFWwindow* window)
+{
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "LOD %s: %d completos / %d simples",
+                            g_ShadingLod.enabled ? "on " : "off",
+                            g_ShadingLod.num_full, g_ShadingLod.num_lod);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-4*lineheight, 1.0f);
+}
+
+// Escrevemos no canto superior esquerdo da tela o mínimo, a média e o
+// percentil 99 do tempo de GPU de cada passo. Veja "gpu_profiler.h".
+void TextRendering_ShowGpuProfile(GLFWwindow* window)
+{
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, "GPU (ms)   min   med   p99", -1.0f+charwidth, 1.0f-lineheight, 1.0f);
+    for (int s = 0; s < NUM_GPU_SCOPES; ++s)
+    {
+        GpuProfilerStats stats = GpuProfiler_Stats((GpuProfilerScopeId)s);
+
+        char buffer[80];
+        if (stats.samples == 0)
+            snprintf(buffer, 80, "%-8s      -     -     -", g_GpuProfiler.scopes[s].name);
+        else
+            snprintf(buffer, 80, "%-8s %5.2f %5.2f %5.2f", g_GpuProfiler.scopes[s].name,
+                     stats.min_ms, stats.avg_ms, stats.p99_ms);
+
+        TextRendering_PrintString(window, buffer, -1.0f+charwidth, 1.0f-(s + 2)*lineheight, 1.0f);
+    }
+}
+
 void LoadTextureImage(const char* filename)
 {
+    PROFILE_FUNCTION();
     printf("Carregando imagem \"%s\"... ", filename);
 
     // Primeiro fazemos a leitura da imagem do disco
@@ -2432,195 +3463,107 @@ void PrintObjModelInfo(ObjModel* model)
   }
 }
 
-glm::vec3 calculateBezierPoint(const std::vector<glm::vec3>& controlPoints, float t){
-    int n = controlPoints.size() - 1;
-    std::vector<glm::vec3> tempPoints = controlPoints;
-
-    while (n > 0){
-        for (int i = 0; i < n; i++){
-            tempPoints[i] = tempPoints[i] + t*(tempPoints[i + 1] - tempPoints[i]);
-        }
-        n--;
-    }
-
-    return tempPoints[0];
-}
-
-void move_with_collision(SceneObject player,
-                         std::vector<SceneObject*> objects_group,
+void move_with_collision(SceneObject& player,
                          float delta_t,
                          float speed,
                          glm::vec4 w,
                          glm::vec4 u){
-    bool colFX = false;
-    bool colFZ = false;
-    bool movF = false;
-
-    bool colBX = false;
-    bool colBZ = false;
-    bool movB = false;
-
-    bool colRX = false;
-    bool colRZ = false;
-    bool movR = false;
-
-    bool colLX = false;
-    bool colLZ = false;
-    bool movL = false;
-
-    for(SceneObject *i : objects_group){
-        SceneObject obj = *i;
-
-        if(obj.has_collision()){
-            float nextX = cameraX;
-            float nextZ = cameraZ;
-            SceneObject player_dislocated_in_X = player;
-            SceneObject player_dislocated_in_Z = player;
-            if (moving_forward){
-                movF = true;
-                nextX += -w.x * delta_t * speed;
-                nextZ += -w.z * delta_t * speed;
-                player_dislocated_in_X.set_position(nextX,cameraY,cameraZ);
-                player_dislocated_in_Z.set_position(cameraX,cameraY,nextZ);
-
-                if(obj.is_sphere()){
-                    if(isCubeIntersectingSphere(player_dislocated_in_X.get_bbox_min(),
-                                                player_dislocated_in_X.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colFX = true;
-                    }
-                    if(isCubeIntersectingSphere(player_dislocated_in_Z.get_bbox_min(),
-                                                player_dislocated_in_Z.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colFZ = true;
-                    }
-                }else{
-                    if(isBoundingBoxIntersection(player_dislocated_in_X, obj)){
-                    colFX = true;
-                    }
-                    if(isBoundingBoxIntersection(player_dislocated_in_Z, obj)){
-                        colFZ = true;
-                    }
-                }
-
+    PROFILE_FUNCTION();
 
-            }
-             if(moving_backwards){
-                movB = true;
-                nextX += w.x * delta_t * speed;
-                nextZ += w.z * delta_t * speed;
-                player_dislocated_in_X.set_position(nextX,cameraY,cameraZ);
-                player_dislocated_in_Z.set_position(cameraX,cameraY,nextZ);
-
-                if(obj.is_sphere()){
-                    if(isCubeIntersectingSphere(player_dislocated_in_X.get_bbox_min(),
-                                                player_dislocated_in_X.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colBX = true;
-                    }
-                    if(isCubeIntersectingSphere(player_dislocated_in_Z.get_bbox_min(),
-                                                player_dislocated_in_Z.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colBZ = true;
-                    }
-                }else{
-                    if(isBoundingBoxIntersection(player_dislocated_in_X, obj)){
-                        colBX = true;
-                    }
-                    if(isBoundingBoxIntersection(player_dislocated_in_Z, obj)){
-                        colBZ = true;
-                    }
-                }
-            }
-            if(moving_right){
-                movR = true;
-                nextX += u.x * delta_t * speed;
-                nextZ += u.z * delta_t * speed;
-                player_dislocated_in_X.set_position(nextX,cameraY,cameraZ);
-                player_dislocated_in_Z.set_position(cameraX,cameraY,nextZ);
-                if(obj.is_sphere()){
-                    if(isCubeIntersectingSphere(player_dislocated_in_X.get_bbox_min(),
-                                                player_dislocated_in_X.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colRX = true;
-                    }
-                    if(isCubeIntersectingSphere(player_dislocated_in_Z.get_bbox_min(),
-                                                player_dislocated_in_Z.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colRZ = true;
-                    }
-                }else{
-                    if(isBoundingBoxIntersection(player_dislocated_in_X, obj)){
-                        colRX = true;
-                    }
-                    if(isBoundingBoxIntersection(player_dislocated_in_Z, obj)){
-                        colRZ = true;
-                    }
-                }
-            }
-            if(moving_left){
-                movL = true;
-                nextX += -u.x * delta_t * speed;
-                nextZ += -u.z * delta_t * speed;
-                player_dislocated_in_X.set_position(nextX,cameraY,cameraZ);
-                player_dislocated_in_Z.set_position(cameraX,cameraY,nextZ);
-
-                if(obj.is_sphere()){
-                    if(isCubeIntersectingSphere(player_dislocated_in_X.get_bbox_min(),
-                                                player_dislocated_in_X.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colLX = true;
-                    }
-                    if(isCubeIntersectingSphere(player_dislocated_in_Z.get_bbox_min(),
-                                                player_dislocated_in_Z.get_bbox_max(),
-                                                obj.get_center(),
-                                                obj.get_radius())){
-                        colLZ = true;
-                    }
-                }else{
-                    if(isBoundingBoxIntersection(player_dislocated_in_X, obj)){
-                        colLX = true;
-                    }
-                    if(isBoundingBoxIntersection(player_dislocated_in_Z, obj)){
-                        colLZ = true;
-                    }
-                }
-            }
-        }
+    // Deslocamento de cada direção pressionada
+    glm::vec3 moves[4];
+    int num_moves = 0;
+    if(moving_forward){
+        moves[num_moves++] = glm::vec3(-w.x, 0.0f, -w.z) * delta_t * speed;
     }
-    // Atualizar posicao depois de fazer todos os testes
-    if(!colFX && movF){
-        cameraX += -w.x * delta_t * speed;
+    if(moving_backwards){
+        moves[num_moves++] = glm::vec3(w.x, 0.0f, w.z) * delta_t * speed;
     }
-    if(!colFZ && movF){
-        cameraZ += -w.z * delta_t * speed;
+    if(moving_right){
+        moves[num_moves++] = glm::vec3(u.x, 0.0f, u.z) * delta_t * speed;
     }
-    if(!colBX && movB){
-        cameraX += w.x * delta_t * speed;
+    if(moving_left){
+        moves[num_moves++] = glm::vec3(-u.x, 0.0f, -u.z) * delta_t * speed;
     }
-    if(!colBZ && movB){
-        cameraZ += w.z * delta_t * speed;
-    }
-    if(!colRX && movR){
-        cameraX += u.x * delta_t * speed;
-    }
-    if(!colRZ && movR){
-        cameraZ += u.z * delta_t * speed;
-    }
-    if(!colLX && movL){
-        cameraX += -u.x * delta_t * speed;
+
+    // As direções pressionadas são somadas e resolvidas em uma única
+    // varredura
+    glm::vec3 motion = glm::vec3(0.0f);
+    for(int m = 0; m < num_moves; ++m){
+        motion += moves[m];
     }
-    if(!colLZ && movL){
-        cameraZ += -u.z * delta_t * speed;
+
+    // Cápsula do jogador (veja "collision_shapes.h") na posição da câmera
+    glm::vec3 position = glm::vec3(cameraX, cameraY, cameraZ);
+    CollisionShape player_shape = Collision_ObjectShape(player);
+    CollisionShape_Translate(player_shape, position - glm::vec3(player.get_position()));
+
+    // Fase ampla: somente os objetos móveis perto da região que o jogador
+    // pode alcançar neste passo (veja "broadphase.h"). O deslizamento nunca
+    // percorre mais que o comprimento do movimento original.
+    Broadphase_Update();
+    glm::vec3 reach = glm::vec3(glm::length(motion));
+    glm::vec3 player_min, player_max;
+    CollisionShape_Bounds(player_shape, player_min, player_max);
+    static std::vector<int> candidates;
+    Broadphase_Query(player_min - reach, player_max + reach, candidates);
+
+    // Movimento contínuo: o jogador avança até o primeiro contato (sem
+    // atravessar objetos finos, mesmo com um passo longo) e o que sobra do
+    // movimento desliza ao longo da superfície tocada. O mundo estático é
+    // consultado no campo de distância; o teste usado para cada objeto móvel
+    // vem de g_CollisionSweeps.
+    glm::vec3 previous_normal;
+    for(int iteration = 0; iteration < COLLISION_MAX_SLIDES && glm::length(motion) > 0.0f; ++iteration){
+        float first_t = 1.0f;
+        glm::vec3 first_normal;
+        bool hit = CollisionSDF_Sweep(g_CollisionSDF, player_shape, motion, 2.0f * COLLISION_SKIN, first_t, first_normal);
+
+        for(int c : candidates){
+            const Collider& obj = g_Broadphase.colliders[c];
+            if(!obj.object->has_collision()){
+                continue;
+            }
+
+            float t;
+            glm::vec3 normal;
+            if(Collision_Sweep(player_shape, motion, obj.shape, t, normal) && t < first_t){
+                first_t = t;
+                first_normal = normal;
+                hit = true;
+            }
+        }
+
+        if(!hit){
+            position += motion;
+            break;
+        }
+
+        // O jogador anda no plano XZ
+        first_normal.y = 0.0f;
+        if(glm::length(first_normal) == 0.0f){
+            break;
+        }
+        first_normal = glm::normalize(first_normal);
+
+        glm::vec3 step = motion * first_t + first_normal * COLLISION_SKIN;
+        position += step;
+        CollisionShape_Translate(player_shape, step);
+        motion *= 1.0f - first_t;
+        motion -= glm::dot(motion, first_normal) * first_normal;
+
+        // Um segundo contato com outra normal no mesmo passo indica um canto
+        // (arredondado pelo campo de distância): deslizar de novo faria o
+        // jogador oscilar entre as duas superfícies
+        if(iteration > 0 && glm::dot(first_normal, previous_normal) < 0.99f){
+            break;
+        }
+        previous_normal = first_normal;
     }
 
+    cameraX = position.x;
+    cameraZ = position.z;
+
     /* Movimentacao no Y *Testes* */
 
     if(y_axis_movement){
@@ -2633,15 +3576,18 @@ void move_with_collision(SceneObject player,
     }
 }
 
-void drawer(float delta_t, SceneObject player, SceneObject& drawer_left, SceneObject& drawer_right,
+void drawer(float delta_t, SceneObject& player, SceneObject& drawer_left, SceneObject& drawer_right,
             SceneObject& collectable1){
+    PROFILE_FUNCTION();
+    // A gaveta só se move se a sua forma na nova posição não tocar o jogador
+    CollisionShape player_shape = Collision_ObjectShape(player);
     if(open_left_drawer){
         // abertura
         float new_z = delta_t * 2;
-        SceneObject new_pos = drawer_left;
-        new_pos.translate(0,0,new_z);
+        CollisionShape new_pos = Collision_ObjectShape(drawer_left);
+        CollisionShape_Translate(new_pos, glm::vec3(0,0,new_z));
         if(drawer_left.get_position().z <= -5.6f &&
-           !isBoundingBoxIntersection(player, new_pos) ){
+           !Collision_Overlap(player_shape, new_pos) ){
             drawer_left.translate(0,0,new_z);
             if(collectable1.get_position() != pieces_initial_position.at("black_king")[3]){
                 collectable1.translate(0,0,new_z);
@@ -2649,10 +3595,10 @@ void drawer(float delta_t, SceneObject player, SceneObject& drawer_left, SceneOb
         }
     } else {
         float new_z = delta_t * 2;
-        SceneObject new_pos = drawer_left;
-        new_pos.translate(0,0,new_z);
+        CollisionShape new_pos = Collision_ObjectShape(drawer_left);
+        CollisionShape_Translate(new_pos, glm::vec3(0,0,new_z));
         if(drawer_left.get_position().z >= -6.0f &&
-           !isBoundingBoxIntersection(player, new_pos) ){
+           !Collision_Overlap(player_shape, new_pos) ){
             drawer_left.translate(0,0,-new_z);
             if(collectable1.get_position() != pieces_initial_position.at("black_king")[3]){
                 collectable1.translate(0,0,-new_z);
@@ -2663,18 +3609,18 @@ void drawer(float delta_t, SceneObject player, SceneObject& drawer_left, SceneOb
     if(open_right_drawer){
         // abertura
         float new_z = delta_t * 2;
-        SceneObject new_pos = drawer_right;
-        new_pos.translate(0,0,new_z);
+        CollisionShape new_pos = Collision_ObjectShape(drawer_right);
+        CollisionShape_Translate(new_pos, glm::vec3(0,0,new_z));
         if(drawer_right.get_position().z <= -5.6f &&
-           !isBoundingBoxIntersection(player, new_pos) ){
+           !Collision_Overlap(player_shape, new_pos) ){
             drawer_right.translate(0,0,new_z);
         }
     } else {
         float new_z = delta_t * 2;
-        SceneObject new_pos = drawer_right;
-        new_pos.translate(0,0,new_z);
+        CollisionShape new_pos = Collision_ObjectShape(drawer_right);
+        CollisionShape_Translate(new_pos, glm::vec3(0,0,new_z));
         if(drawer_right.get_position().z >= -6.0f &&
-           !isBoundingBoxIntersection(player, new_pos) ){
+           !Collision_Overlap(player_shape, new_pos) ){
             drawer_right.translate(0,0,-new_z);
         }
     }
@@ -2682,81 +3628,16 @@ void drawer(float delta_t, SceneObject player, SceneObject& drawer_left, SceneOb
 }
 
 void play_game_anim(float t){
-    SceneObject* e_white_pawn = find_piece_by_name("e_white_pawn");
-    SceneObject* e_black_pawn = find_piece_by_name("e_black_pawn");
-    SceneObject* left_white_bishop = find_piece_by_name("left_white_bishop");
-    SceneObject* left_black_knight = find_piece_by_name("left_black_knight");
-    SceneObject* white_queen = find_piece_by_name("white_queen");
-    SceneObject* right_black_knight = find_piece_by_name("right_black_knight");
-    SceneObject* f_black_pawn = find_piece_by_name("f_black_pawn");
-
+    PROFILE_FUNCTION();
     glm::vec3 look_at = glm::vec3(-3.8f, 0.1f, -3.9f);
     camera_view_vector = glm::vec4(look_at, 0) -
                                     glm::vec4(cameraX, cameraY, cameraZ, 0);
 
-    if (t > 3 && t < 5){
-        e_white_pawn->set_position(e_white_pawn->get_position() +
-                                   ((3-t)/2) *
-                                   (e_white_pawn->get_position()-
-                                   e4_position)
-                                   );
-    }else if(t > 5 && t < 7){
-        e_black_pawn->set_position(e_black_pawn->get_position() +
-                                   ((5-t)/2) *
-                                   (e_black_pawn->get_position()-
-                                   e5_position)
-                                   );
-    }else if(t > 7 && t < 9){
-        left_white_bishop->set_position(left_white_bishop->get_position() +
-                                       ((7-t)/2) *
-                                       (left_white_bishop->get_position()-
-                                       c4_position)
-                                        );
-    }else if(t > 9 && t < 11){
-        left_black_knight->set_position(left_black_knight->get_position() +
-                                       ((9-t)/2) *
-                                       (left_black_knight->get_position()-
-                                        f6_position)
-                                        );
-    }else if(t > 11 && t < 13){
-        white_queen->set_position(white_queen->get_position() +
-                                   ((11-t)/2) *
-                                   (white_queen->get_position()-
-                                    h5_position)
-                                  );
-    }else if(t > 13 && t < 15){
-        right_black_knight->set_position(right_black_knight->get_position() +
-                                           ((13-t)/2) *
-                                           (right_black_knight->get_position()-
-                                            c6_position)
-                                            );
-    }else if(t > 15 && t < 17){
-        //if(glm::all(glm::equal(white_queen->get_position(),h5_position))){
-        if(f_black_pawn->get_position().x > captured_black_piece_next_position.x){
-                white_queen->set_position(white_queen->get_position() +
-                                       ((15-t)/2) *
-                                       (white_queen->get_position()-
-                                        f_black_pawn->get_position())
-                                          );
-        }
-
-        if(glm::all(glm::equal(f_black_pawn->get_position(), white_queen->get_position()))){
-            capture_piece(f_black_pawn);
-            game_ended = true;
-        }
-
-    }
+    Timeline_Evaluate(final_move, t);
 }
 
-
-SceneObject* find_piece_by_name(std::string target_name){
-
-    std::vector<SceneObject*>::iterator it = chess_pieces.begin();
-    while (it++ != chess_pieces.end()){
-      if((*it)->get_name() == target_name){
-        return *it;
-      }
-    }
+void end_game(SceneObject* target){
+    game_ended = true;
 }
 
 bool all_pieces_in_starting_pos(){
@@ -0,0 +1,8 @@
+#version 330 core
+
+// Fragment shader vazio: somente o Z-buffer é escrito. Veja
+// "shader_depth_vertex.glsl".
+
+void main()
+{
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// Vertex shader mínimo, usado quando somente a profundidade dos objetos é
+// necessária (mapas de sombra e pré-passo de profundidade). Veja "shadows.h"
+// e "depth_prepass.h".
+
+// Somente a posição dos vértices é lida. Veja a função
+// BuildTrianglesAndAddToVirtualScene() em "main.cpp".
+layout (location = 0) in vec4 model_coefficients;
+
+// A posição é calculada exatamente da mesma forma em "shader_vertex.glsl" e
+// "shader_depth_vertex.glsl", para que o pré-passo de profundidade (veja
+// "depth_prepass.h") e o passo de cor gerem o mesmo Z.
+invariant gl_Position;
+
+// Matrizes computadas no código C++ e enviadas para a GPU
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * model * model_coefficients;
+}
@@ -1,5 +1,9 @@
 #version 330 core
 
+// Os #defines da permutação (MAPPING_*, LIGHTING_*, GOURAUD, KD2_TEXTURE,
+// KS_TEXTURE, BAKED_LIGHTING, SHADING_LOD) são inseridos logo após a linha acima por LoadShadersFromFiles()
+// em "main.cpp". Veja "materials.h".
+
 // Atributos de fragmentos recebidos como entrada ("in") pelo Fragment Shader.
 // Neste exemplo, este atributo foi gerado pelo rasterizador como a
 // interpolação da posição global e a normal de cada vértice, definidas em
@@ -13,64 +17,63 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
-in vec4 color_v;
+// Coordenadas no atlas do lightmap. Veja "lightmap.h".
+in vec2 lightmap_texcoords;
+
+#ifdef GOURAUD
+// Termos de iluminação calculados por vértice em "shader_vertex.glsl"
+in vec3 gouraud_diffuse;
+in vec3 gouraud_specular;
+#endif
+
+#ifdef SHADING_LOD
+// Luzes pontuais calculadas por vértice. Veja "shading_lod.h".
+in vec3 point_diffuse;
+in vec3 point_specular;
+#endif
+
 // Matrizes computadas no código C++ e enviadas para a GPU
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-// Identificador que define qual objeto está sendo desenhado no momento
-#define SPHERE      0
-#define BUNNY       1
-#define ROOM_FLOOR  2
-#define WALL_1      3
-#define SKYBOX      4
-#define WALL_1_SIDE 5
-#define TABLE       6
-#define CHESS       7
-#define BOWL        8
-#define WHITE_PIECE 9
-#define BLACK_PIECE 10
-#define CONSOLE_TABLE 11
-#define SOFA        12
-#define TV          13
-#define SHELF       14
-#define CHAIR       15
-#define BED         16
-#define BOOK_SHELF  17
-#define BOOKS       18
-#define ROOM_CEILING 19
-#define DRAWER      20
-
-uniform int object_id;
-
 // Parâmetros da axis-aligned bounding box (AABB) do modelo
 uniform vec4 bbox_min;
 uniform vec4 bbox_max;
 
-// Variáveis para acesso das imagens de textura
-uniform sampler2D TextureImage0;
-uniform sampler2D TextureImage1;
-uniform sampler2D TextureImage2;
-uniform sampler2D TextureImage3;
-uniform sampler2D TextureImage4;
-uniform sampler2D TextureImage5;
-uniform sampler2D TextureImage6;
-uniform sampler2D TextureImage7;
-uniform sampler2D TextureImage8;
-uniform sampler2D TextureImage9;
-uniform sampler2D TextureImage10;
-uniform sampler2D TextureImage11;
-uniform sampler2D TextureImage12;
-uniform sampler2D TextureImage13;
-uniform sampler2D TextureImage14;
-uniform sampler2D TextureImage15;
-uniform sampler2D TextureImage16;
-uniform sampler2D TextureImage17;
-uniform sampler2D TextureImage18;
-uniform sampler2D TextureImage19;
-uniform sampler2D TextureImage20;
-uniform sampler2D TextureImage21;
+// Texturas da classe de material. Cada uma recebe a "texture unit" da imagem
+// correspondente carregada por LoadTextureImage().
+uniform sampler2D KdTexture;
+uniform sampler2D Kd2Texture;
+uniform sampler2D KsTexture;
+
+// Parâmetros da classe de material. Veja a struct Material em "materials.h".
+uniform vec3  material_kd;
+uniform vec3  material_ks;
+uniform float material_ka;
+uniform float material_q;
+uniform vec2  uv_scale;
+uniform vec2  uv_offset;
+uniform vec2  uv_wrap;
+
+// Luzes pontuais, agrupadas por cluster do frustum. Veja "lights.h" e
+// Lights_Update() em "lights.cpp".
+uniform samplerBuffer  light_data;  // 2 texels por luz: (posição, raio), (cor, 0)
+uniform usamplerBuffer light_grid;  // 1 texel por cluster: (início, número de luzes)
+uniform usamplerBuffer light_index; // Índices das luzes de todos os clusters
+uniform vec4  cluster_params;       // (CLUSTER_X/largura, CLUSTER_Y/altura, escala z, bias z)
+uniform ivec3 cluster_count;        // (CLUSTER_X, CLUSTER_Y, CLUSTER_Z)
+
+// Mapas de sombra da luz principal: camada estática e camada dinâmica. Veja
+// "shadows.h".
+uniform sampler2DShadow shadow_static;
+uniform sampler2DShadow shadow_dynamic;
+uniform mat4  shadow_matrix;
+uniform float shadow_enabled; // 0 durante a inspeção de objetos
+
+// Iluminação pré-calculada por Lightmap_Bake(): RGB = luz principal (já com
+// sombras) + luz indireta, A = oclusão ambiente
+uniform sampler2D lightmap;
 
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec4 color;
@@ -79,6 +82,98 @@ out vec4 color;
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
 
+// Coordenadas de textura do fragmento atual, conforme o modo de mapeamento
+vec2 ComputeTexcoords()
+{
+#if defined(MAPPING_SPHERICAL)
+    float raio = 1;
+    vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
+    vec4 pl = bbox_center + raio*(position_model - bbox_center)/length(position_model - bbox_center);
+
+    vec4 p2  = pl - bbox_center;
+    float theta = atan( p2.x, p2.z );
+    float phi   = asin( p2.y/raio );
+
+    return vec2((theta + M_PI) / (2 * M_PI), (phi + M_PI_2) / M_PI);
+#elif defined(MAPPING_PLANAR_XZ)
+    vec2 uv = position_model.xz * uv_scale + uv_offset;
+    return mix(uv, fract(uv), uv_wrap);
+#elif defined(MAPPING_PLANAR_XY)
+    vec2 uv = position_model.xy * uv_scale + uv_offset;
+    return mix(uv, fract(uv), uv_wrap);
+#else
+    return texcoords;
+#endif
+}
+
+#if !defined(LIGHTING_UNLIT)
+// Fração da luz principal que chega ao ponto p (1 = iluminado). Combina as
+// duas camadas do mapa de sombra com PCF 3x3.
+float KeyLightVisibility(vec4 p, vec4 n, vec4 l)
+{
+    vec3 coords = (shadow_matrix * p).xyz * 0.5 + 0.5;
+    if (shadow_enabled == 0.0 || coords.z > 1.0)
+        return 1.0;
+
+    // Bias maior para superfícies quase paralelas à luz
+    float cos_theta = clamp(dot(n, l), 0.0, 1.0);
+    coords.z -= clamp(0.0005 * sqrt(1.0 - cos_theta*cos_theta) / max(cos_theta, 0.05), 0.0002, 0.005);
+
+    vec2 static_texel = 1.0 / vec2(textureSize(shadow_static, 0));
+    vec2 dynamic_texel = 1.0 / vec2(textureSize(shadow_dynamic, 0));
+    float visibility = 0.0;
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            float lit_static = texture(shadow_static, vec3(coords.xy + vec2(x,y) * static_texel, coords.z));
+            float lit_dynamic = texture(shadow_dynamic, vec3(coords.xy + vec2(x,y) * dynamic_texel, coords.z));
+            visibility += lit_static * lit_dynamic;
+        }
+    }
+    return mix(1.0, visibility / 9.0, shadow_enabled);
+}
+
+// Soma a contribuição das luzes pontuais do cluster que contém o fragmento,
+// usando o mesmo modelo de iluminação da luz principal.
+vec3 PointLights(vec4 p, vec4 n, vec4 v, vec3 Kd, vec3 Ks, float q)
+{
+    // O cluster é definido pelo ladrilho da tela e pela fatia da profundidade
+    float depth = max(-(view * p).z, 1e-4);
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * cluster_params.xy),
+                          int(log(depth) * cluster_params.z + cluster_params.w));
+    cluster = clamp(cluster, ivec3(0), cluster_count - ivec3(1));
+    uvec2 grid = texelFetch(light_grid, cluster.x + cluster_count.x * (cluster.y + cluster_count.y * cluster.z)).rg;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < grid.y; ++i)
+    {
+        int light = int(texelFetch(light_index, int(grid.x + i)).r);
+        vec4 position_radius = texelFetch(light_data, 2*light);
+        vec3 light_color = texelFetch(light_data, 2*light + 1).rgb;
+
+        vec3 to_light = position_radius.xyz - p.xyz;
+        float dist2 = max(dot(to_light, to_light), 1e-6);
+
+        // Atenuação com o inverso do quadrado da distância, levada a zero
+        // suavemente no raio da luz
+        float falloff = clamp(1.0 - pow(dist2 / (position_radius.w * position_radius.w), 2.0), 0.0, 1.0);
+        float attenuation = falloff * falloff / (dist2 + 1.0);
+
+        vec4 lp = vec4(to_light * inversesqrt(dist2), 0.0);
+        vec3 term = Kd * max(0, dot(n, lp));
+#if defined(LIGHTING_PHONG)
+        vec4 rp = -lp + 2 * n * dot(n, lp);
+        term += Ks * pow(max(0, dot(rp, v)), q);
+#elif !defined(LIGHTING_LAMBERT)
+        vec4 hp = normalize(v + lp);
+        term += Ks * pow(max(0, dot(n, hp)), q);
+#endif
+        result += light_color * attenuation * term;
+    }
+    return result;
+}
+#endif
 
 void main()
 {
@@ -105,231 +200,79 @@ void main()
     vec4 v = normalize(camera_position - p);
 
     // Vetor que define o sentido da reflexão especular ideal.
-    vec4 r = -l + 2 * n * dot(n, l); // PREENCHA AQUI o vetor de reflexão especular ideal
+    vec4 r = -l + 2 * n * dot(n, l);
 
     vec4 h = normalize(v + l);
 
-    float U = 0.0;
-    float V = 0.0;
-
-
     // Parâmetros que definem as propriedades espectrais da superfície
     vec3 Kd; // Refletância difusa
     vec3 Ks; // Refletância especular
     vec3 Ka; // Refletância ambiente
-    float q; // Expoente especular para o modelo de iluminação de Phong
-
-    if ( object_id == SPHERE ){
-
-        float raio = 1;
-        vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
-        vec4 pl = bbox_center + raio*(position_model - bbox_center)/length(position_model - bbox_center);
-
-        vec4 p2  = pl - bbox_center;
-        float theta = atan( p2.x, p2.z );
-        float phi   = asin( p2.y/raio );
-
-        U = (theta + M_PI) / (2 * M_PI);
-        V = (phi + M_PI_2) / M_PI;
-
-        Kd = texture(TextureImage0, vec2(U,V)).rgb;
-        Ks = vec3(0.01,0.01,0.01);
-        Ka = Kd/2;
-        q = 1.0;
-
-    } else if ( object_id == BUNNY ){
-        float minx = bbox_min.x;
-        float maxx = bbox_max.x;
-
-        float miny = bbox_min.y;
-        float maxy = bbox_max.y;
-
-        float minz = bbox_min.z;
-        float maxz = bbox_max.z;
-
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage10, vec2(U,V)).rgb;
-        Ks = vec3(0.6,0.6,0.6);
-        Ka = Kd/4;
-        q = 32.0;
-    } else if ( object_id == ROOM_FLOOR ){
-        float uR = 3;
-        float vR = 2;
-
-        U = position_model.x * uR - floor(position_model.x * uR);
-        V = position_model.z * vR - floor(position_model.z * vR);
-
-        Kd = texture(TextureImage3, vec2(U,V)).rgb * texture(TextureImage4, vec2(U,V)).rgb;
-        Ks = vec3(0.1 ,0.1 ,0.1);
-        Ka = Kd/2;
-        q = 32.0;
-    } else if (object_id == WALL_1){
-        float uR = 1.9;
-        float vR = 1;
-
-        U = position_model.x * uR - floor(position_model.x * uR);
-        V = position_model.y * vR - floor(position_model.y * vR);
-
-        Kd= texture(TextureImage5, vec2(U,V)).rgb * texture(TextureImage6, vec2(U,V)).rgb;
-        Ks= vec3(0.0,0.0,0.0);
-        Ka= Kd/2;
-        q = 1.0;
-    } else if (object_id == TABLE){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd= texture(TextureImage7, vec2(U,V)).rgb;
-        Ks= vec3(0.04,0.04,0.04);
-        Ka= Kd/6;
-        q = 32.0;
-    } else if(object_id == CHESS){
-        float uR = 0.11;
-        float vR = 0.11;
-
-        U = position_model.x * uR - floor(position_model.x * uR);
-        V = position_model.z * vR - floor(position_model.z * vR);
-
-        Kd= texture(TextureImage8, vec2(U,V)).rgb;
-        Ks= vec3(0.1,0.1,0.1);
-        Ka= Kd/8;
-        q = 16.0;
-    } else if (object_id == WHITE_PIECE){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage10, vec2(U,V)).rgb;
-        Ks = vec3(0.05,0.05,0.05);
-        Ka = Kd/4;
-        q = 16.0;
-
-    } else if (object_id == BLACK_PIECE){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage11, vec2(U,V)).rgb;
-        Ks = vec3(0.05,0.05,0.05);
-        Ka = Kd/4;
-        q = 16.0;
-    }else if(object_id == CONSOLE_TABLE || object_id == DRAWER){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage12, vec2(U,V)).rgb;
-        Ks = vec3(0.01,0.01,0.01);
-        Ka = Kd/4;
-        q = 16.0;
-    } else if(object_id == SOFA){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage13, vec2(U,V)).rgb * texture(TextureImage14, vec2(U,V)).rgb;
-        Ks = vec3(0,0,0);
-        Ka = Kd/2;
-        q = 1.0f;
-    } else if(object_id == TV){
-        Kd = vec3(0.01f,0.01f,0.01f);
-        Ks = vec3(0.2f,0.2f,0.2f);
-        Ka = Kd/8;
-        q = 32.0;
-    } else if(object_id == SHELF){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage15, vec2(U,V)).rgb;
-        Ks = vec3(0.03f,0.03f,0.03f);
-        Ka = Kd/6;
-        q = 16.0f;
-    } else if(object_id == CHAIR){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage17, vec2(U,V)).rgb;
-        Ks = texture(TextureImage18, vec2(U,V)).rgb;
-        Ka = Kd/8;
-        q = 64.0f;
-    } else if(object_id == BED){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage16, vec2(U,V)).rgb;
-        Ks = vec3(0.0f,0.0f,0.0f);
-        Ka = Kd/4;
-        q = 1.0f;
-    } else if(object_id == BOOK_SHELF){
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage19, vec2(U,V)).rgb;
-        Ks = vec3(0.0f,0.0f,0.0f);
-        Ka = Kd/2;
-        q = 1.0f;
-    } else if(object_id == BOOKS){
-        float uR = 0.4;
-        float vR = 0.7;
-
-        U = position_model.x * uR - floor(position_model.x * uR);
-        V = position_model.y * vR + 0.5;
-
-        Kd = texture(TextureImage20, vec2(U,V)).rgb;
-        Ks = vec3(0.0f,0.0f,0.0f);
-        Ka = Kd/4;
-        q = 1.0f;
-    }else if(object_id == ROOM_CEILING){
-        float uR = 2;
-        float vR = 2;
-
-        U = position_model.x * uR - floor(position_model.x * uR);
-        V = position_model.z * vR - floor(position_model.z * vR);
-
-        Kd = texture(TextureImage21, vec2(U,V)).rgb;
-        Ks = vec3(0.01f, 0.01f, 0.01f);
-        Ka = Kd/4;
-        q = 32.0f;
-    } else {
-        Kd = vec3(0.0,0.0,0.0);
-        Ks = vec3(0.0,0.0,0.0);
-        Ka = vec3(0.0,0.0,0.0);
-        q = 1.0;
-    }
-
+    float q = material_q; // Expoente especular
+
+#if defined(MAPPING_NONE)
+    Kd = material_kd;
+#else
+    vec2 uv = ComputeTexcoords();
+    Kd = texture(KdTexture, uv).rgb;
+#ifdef KD2_TEXTURE
+    Kd *= texture(Kd2Texture, uv).rgb;
+#endif
+#endif
+
+#if defined(KS_TEXTURE) && !defined(MAPPING_NONE)
+    Ks = texture(KsTexture, uv).rgb;
+#else
+    Ks = material_ks;
+#endif
+
+    Ka = Kd * material_ka;
 
     vec3 I = vec3(1.0,1.0,1.0);
+#if !defined(LIGHTING_UNLIT) && !defined(BAKED_LIGHTING) && !defined(SHADING_LOD)
+    // (com SHADING_LOD, a sombra já foi aplicada por vértice)
+    I *= KeyLightVisibility(p, n, l);
+#endif
     vec3 Ia = vec3(0.2,0.2,0.2);
-    vec3 lambert_diffuse_term = Kd * I * max(0, dot(n, l));
     vec3 ambient_term = Ka * Ia;
-    vec3 phong_specular_term  = Ks * I * pow(max(0, dot(r, v)), q);
-    vec3 bling_phong_specular_term  = Ks * I * pow(max(0, dot(n, h)), q);
-
 
     color.a = 1;
-    //color.rgb = lambert_diffuse_term + ambient_term + bling_phong_specular_term;
-
-    if(object_id == SKYBOX){
-        color.rgb = vec3(0.1,0.1,0.1);
-    } else if(object_id == BOWL){
-        // Gouraud
-        color = color_v;
-    } else if(object_id == ROOM_CEILING || object_id == WALL_1 || object_id == BOOKS ||
-              object_id == BED || object_id == SOFA){
-        // Difusa
-        color.rgb = lambert_diffuse_term + ambient_term;
-    } else if(object_id == ROOM_FLOOR || object_id == TV || object_id == SHELF ||
-              object_id == CHAIR || object_id == CHESS || object_id == TABLE ||
-              object_id == WHITE_PIECE || object_id == BLACK_PIECE || object_id == DRAWER ||
-              object_id == CONSOLE_TABLE || object_id == BOOK_SHELF || object_id == SPHERE ||
-              object_id == BUNNY){
-        // Blinn-Phong
-        color.rgb = lambert_diffuse_term + ambient_term + bling_phong_specular_term;
-    }
 
+#if defined(LIGHTING_UNLIT)
+    color.rgb = Kd;
+#elif defined(BAKED_LIGHTING)
+    // Superfícies estáticas: a luz principal, suas sombras e a luz indireta
+    // foram pré-calculadas, e o termo ambiente é atenuado pela oclusão
+    vec4 baked = texture(lightmap, lightmap_texcoords);
+    color.rgb = Kd * baked.rgb + ambient_term * baked.a;
+#elif defined(GOURAUD)
+    // Gouraud: somente a textura é amostrada por fragmento
+    color.rgb = I * (Kd * gouraud_diffuse + Ks * gouraud_specular) + ambient_term;
+#elif defined(LIGHTING_LAMBERT)
+    // Difusa
+    vec3 lambert_diffuse_term = Kd * I * max(0, dot(n, l));
+    color.rgb = lambert_diffuse_term + ambient_term;
+#elif defined(LIGHTING_PHONG)
+    vec3 lambert_diffuse_term = Kd * I * max(0, dot(n, l));
+    vec3 phong_specular_term  = Ks * I * pow(max(0, dot(r, v)), q);
+    color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
+#else
+    // Blinn-Phong
+    vec3 lambert_diffuse_term = Kd * I * max(0, dot(n, l));
+    vec3 bling_phong_specular_term  = Ks * I * pow(max(0, dot(n, h)), q);
+    color.rgb = lambert_diffuse_term + ambient_term + bling_phong_specular_term;
+#endif
+
+#if defined(SHADING_LOD)
+    // Luzes pontuais interpoladas a partir dos vértices
+    color.rgb += Kd * point_diffuse + Ks * point_specular;
+#elif !defined(LIGHTING_UNLIT)
+    // Luzes pontuais (calculadas por fragmento também nos materiais Gouraud)
+    color.rgb += PointLights(p, n, v, Kd, Ks, q);
+#endif
 
     // Cor final com correção gamma, considerando monitor sRGB.
     // Veja https://en.wikipedia.org/w/index.php?title=Gamma_correction&oldid=751281772#Windows.2C_Mac.2C_sRGB_and_TV.2Fvideo_standard_gammas
     color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
-
-
-
 }
 
@@ -0,0 +1,44 @@
+#version 330 core
+
+// Passo de upscale da resolução dinâmica. Veja "dynamic_resolution.h".
+
+in vec2 screen_texcoords;
+
+// Imagem da cena. Somente a região [0, uv_scale] foi renderizada neste
+// quadro.
+uniform sampler2D scene;
+uniform vec2 uv_scale;
+uniform vec2 uv_max;     // Centro do último texel renderizado
+uniform vec2 texel_size; // Tamanho de um texel em coordenadas de textura
+
+// Intensidade do filtro de nitidez (0 = somente bilinear)
+uniform float sharpness;
+
+out vec4 color;
+
+vec3 Sample(vec2 uv)
+{
+    return texture(scene, min(uv, uv_max)).rgb;
+}
+
+void main()
+{
+    vec2 uv = screen_texcoords * uv_scale;
+
+    // Filtragem bilinear feita pelo hardware
+    vec3 center = Sample(uv);
+
+    if (sharpness > 0.0)
+    {
+        // "Unsharp mask": subtraímos a média dos 4 vizinhos (um texel da
+        // imagem renderizada de distância), realçando os detalhes que a
+        // ampliação suaviza
+        vec3 neighbours = Sample(uv + vec2(texel_size.x, 0.0))
+                        + Sample(uv - vec2(texel_size.x, 0.0))
+                        + Sample(uv + vec2(0.0, texel_size.y))
+                        + Sample(uv - vec2(0.0, texel_size.y));
+        center = center + sharpness * (center - 0.25 * neighbours);
+    }
+
+    color = vec4(clamp(center, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Passo de upscale da resolução dinâmica. Veja "dynamic_resolution.h".
+//
+// Não há atributos de vértice: os 3 vértices de um triângulo que cobre a
+// tela inteira são gerados a partir de gl_VertexID (0, 1, 2), nas posições
+// (-1,-1), (3,-1) e (-1,3) em NDC.
+out vec2 screen_texcoords;
+
+void main()
+{
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    screen_texcoords = p; // [0,1] na região visível da tela
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
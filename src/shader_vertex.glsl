@@ -1,21 +1,25 @@
 #version 330 core
 
+// Os #defines da permutação (veja "materials.h") são inseridos logo após a
+// linha acima por LoadShadersFromFiles() em "main.cpp".
+
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
 // Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
 layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
+layout (location = 3) in vec2 lightmap_coefficients; // Coordenadas no atlas do lightmap
+
+// A posição é calculada exatamente da mesma forma em "shader_vertex.glsl" e
+// "shader_depth_vertex.glsl", para que o pré-passo de profundidade (veja
+// "depth_prepass.h") e o passo de cor gerem o mesmo Z.
+invariant gl_Position;
 
 // Matrizes computadas no código C++ e enviadas para a GPU
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
-uniform int object_id;
-uniform sampler2D TextureImage9;
-
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
 // para cada fragmento, os quais serão recebidos como entrada pelo Fragment
@@ -24,29 +28,82 @@ out vec4 position_world;
 out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
-out vec4 color_v;
-
-#define SPHERE      0
-#define BUNNY       1
-#define ROOM_FLOOR  2
-#define WALL_1      3
-#define SKYBOX      4
-#define WALL_1_SIDE 5
-#define TABLE       6
-#define CHESS       7
-#define BOWL        8
-#define WHITE_PIECE 9
-#define BLACK_PIECE 10
-#define CONSOLE_TABLE 11
-#define SOFA        12
-#define TV          13
-#define SHELF       14
-#define CHAIR       15
-#define BED         16
-#define BOOK_SHELF  17
-#define BOOKS       18
-#define ROOM_CEILING 19
-#define DRAWER      20
+out vec2 lightmap_texcoords;
+
+#ifdef GOURAUD
+// Termos de iluminação por vértice (interpolação de Gouraud). A textura é
+// amostrada no fragment shader.
+out vec3 gouraud_diffuse;
+out vec3 gouraud_specular;
+
+uniform float material_q;
+#endif
+
+#ifdef SHADING_LOD
+// Versão simplificada para objetos pequenos na tela (veja "shading_lod.h"):
+// a sombra da luz principal e as luzes pontuais também são calculadas por
+// vértice. Os mesmos uniforms de "shader_fragment.glsl".
+out vec3 point_diffuse;
+out vec3 point_specular;
+
+uniform samplerBuffer  light_data;
+uniform usamplerBuffer light_grid;
+uniform usamplerBuffer light_index;
+uniform ivec3 cluster_count;
+uniform vec4  cluster_params;
+
+uniform sampler2DShadow shadow_static;
+uniform sampler2DShadow shadow_dynamic;
+uniform mat4  shadow_matrix;
+uniform float shadow_enabled;
+
+// Fração da luz principal que chega ao ponto p, com uma única amostra de
+// cada camada do mapa de sombra
+float KeyLightVisibility(vec4 p)
+{
+    vec3 coords = (shadow_matrix * p).xyz * 0.5 + 0.5;
+    if (shadow_enabled == 0.0 || coords.z > 1.0)
+        return 1.0;
+    coords.z -= 0.002;
+    return texture(shadow_static, coords) * texture(shadow_dynamic, coords);
+}
+
+// Luzes pontuais do cluster que contém o vértice. Como em PointLights() de
+// "shader_fragment.glsl", mas o ladrilho da tela vem da posição em NDC.
+void PointLights(vec4 p, vec4 n, vec4 v, float q, out vec3 diffuse, out vec3 specular)
+{
+    vec2 ndc = clamp(gl_Position.xy / max(gl_Position.w, 1e-4), -1.0, 1.0);
+    float depth = max(-(view * p).z, 1e-4);
+    ivec3 cluster = ivec3(ivec2((ndc * 0.5 + 0.5) * vec2(cluster_count.xy)),
+                          int(log(depth) * cluster_params.z + cluster_params.w));
+    cluster = clamp(cluster, ivec3(0), cluster_count - ivec3(1));
+    uvec2 grid = texelFetch(light_grid, cluster.x + cluster_count.x * (cluster.y + cluster_count.y * cluster.z)).rg;
+
+    diffuse = vec3(0.0);
+    specular = vec3(0.0);
+    for (uint i = 0u; i < grid.y; ++i)
+    {
+        int light = int(texelFetch(light_index, int(grid.x + i)).r);
+        vec4 position_radius = texelFetch(light_data, 2*light);
+        vec3 light_color = texelFetch(light_data, 2*light + 1).rgb;
+
+        vec3 to_light = position_radius.xyz - p.xyz;
+        float dist2 = max(dot(to_light, to_light), 1e-6);
+        float falloff = clamp(1.0 - pow(dist2 / (position_radius.w * position_radius.w), 2.0), 0.0, 1.0);
+        vec3 intensity = light_color * falloff * falloff / (dist2 + 1.0);
+
+        vec4 lp = vec4(to_light * inversesqrt(dist2), 0.0);
+        diffuse += intensity * max(0, dot(n, lp));
+#if defined(LIGHTING_PHONG)
+        vec4 rp = -lp + 2 * n * dot(n, lp);
+        specular += intensity * pow(max(0, dot(rp, v)), q);
+#elif !defined(LIGHTING_LAMBERT)
+        vec4 hp = normalize(v + lp);
+        specular += intensity * pow(max(0, dot(n, hp)), q);
+#endif
+    }
+}
+#endif
 
 void main()
 {
@@ -89,55 +146,40 @@ void main()
     normal.w = 0.0;
 
     texcoords = texture_coefficients;
-
-    if(object_id == BOWL){
-        vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-        vec4 camera_position = inverse(view) * origin;
-
-        float U = 0.0;
-        float V = 0.0;
-
-        // Parâmetros que definem as propriedades espectrais da superfície
-        vec3 Kd; // Refletância difusa
-        vec3 Ks; // Refletância especular
-        vec3 Ka; // Refletância ambiente
-        float q; // Expoente especular para o modelo de iluminação de Phong
-
-        vec4 p = position_world;
-        vec4 v = normalize(camera_position - p);
-        vec4 l = normalize(vec4(0.0f,5.0f,0.0f, 0.0f) - vec4(-1.0f,4.0f,0.0f, 0.0f));
-        vec4 n = normalize(normal);
-        vec3 I = vec3(1.0,1.0,1.0);
-
-        // Vetor que define o sentido da reflexão especular ideal.
-        vec4 r = -l + 2 * n * dot(n, l); // PREENCHA AQUI o vetor de reflexão especular ideal
-
-        vec4 h = normalize(v + l);
-
-        U = texcoords.x;
-        V = texcoords.y;
-
-        Kd = texture(TextureImage9, vec2(U,V)).rgb;
-        Ks= vec3(0.04,0.04,0.04);
-        Ka= Kd/8;
-
-        q = 16.0;
-
-        // Espectro da luz ambiente
-        vec3 Ia = vec3(0.2,0.2,0.2); // PREENCHA AQUI o espectro da luz ambiente
-
-        // Termo difuso utilizando a lei dos cossenos de Lambert
-        vec3 lambert_diffuse_term = Kd * I * max(0, dot(n, l));
-
-        // Termo ambiente
-        vec3 ambient_term = Ka * Ia;
-
-        // Termo especular utilizando o modelo de iluminação de Phong
-        vec3 phong_specular_term  = Ks * I * pow(max(0, dot(r, v)), q);
-        vec3 bling_phong_specular_term  = Ks * I * pow(max(0, dot(n, h)), q);
-
-        color_v.a = 1;
-        color_v.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
-    }
+    lightmap_texcoords = lightmap_coefficients;
+
+#ifdef GOURAUD
+    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
+    vec4 camera_position = inverse(view) * origin;
+
+    vec4 p = position_world;
+    vec4 v = normalize(camera_position - p);
+    vec4 l = normalize(vec4(5.0f, 3.0f, 5.0f, 0.0f) - vec4(4.0f, 2.0f, 4.5f, 0.0f));
+    vec4 n = normalize(normal);
+    vec3 I = vec3(1.0,1.0,1.0);
+
+    // Vetor que define o sentido da reflexão especular ideal.
+    vec4 r = -l + 2 * n * dot(n, l);
+
+    vec4 h = normalize(v + l);
+
+    // Termo difuso utilizando a lei dos cossenos de Lambert
+    gouraud_diffuse = I * max(0, dot(n, l));
+
+#if defined(LIGHTING_PHONG)
+    // Termo especular utilizando o modelo de iluminação de Phong
+    gouraud_specular = I * pow(max(0, dot(r, v)), material_q);
+#elif defined(LIGHTING_BLINN_PHONG)
+    gouraud_specular = I * pow(max(0, dot(n, h)), material_q);
+#else
+    gouraud_specular = vec3(0.0,0.0,0.0);
+#endif
+
+#ifdef SHADING_LOD
+    float visibility = KeyLightVisibility(p);
+    gouraud_diffuse *= visibility;
+    gouraud_specular *= visibility;
+    PointLights(p, n, v, material_q, point_diffuse, point_specular);
+#endif
+#endif
 }
-
@@ -1,6 +1,8 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,6 +12,7 @@
 
 #include "utils.h"
 #include "dejavufont.h"
+#include "cpu_profiler.h"
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
 
@@ -82,11 +85,60 @@ void TextRendering_LoadShader(const GLchar* const shader_string, GLuint shader_i
     delete [] log;
 }
 
+// Texto em lote: TextRendering_PrintString() somente acrescenta os vértices
+// de cada caractere em "textvertices"; TextRendering_Flush() envia todos de
+// uma vez para a GPU e desenha o quadro inteiro com uma única chamada.
+// Textos que nunca mudam (por exemplo, "Press E to inspect") são montados
+// uma só vez por TextRendering_CacheString() e ficam no início do mesmo VBO.
+
+struct TextVertex
+{
+    float x, y, s, t;
+};
+
+// Texto guardado no VBO, com a posição usada para montá-lo
+struct CachedText
+{
+    std::string str;
+    float x, y, scale;
+    GLint first;   // Primeiro vértice no VBO
+    GLsizei count; // Número de vértices
+};
+
 GLuint textVAO;
 GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+// Glifo de cada caractere de 8 bits, ou NULL se a fonte não o possui
+const texture_glyph_t* textglyphs[256];
+
+std::vector<TextVertex> textvertices;       // Vértices dos textos do quadro atual
+std::vector<TextVertex> textcachedvertices; // Vértices de todos os textos de textcached
+std::vector<CachedText> textcached;
+std::vector<GLint>      textdrawfirst;      // Faixas do VBO desenhadas no quadro atual
+std::vector<GLsizei>    textdrawcount;
+size_t textvbo_capacity = 0;  // Em vértices
+bool   textcached_dirty = false; // textcachedvertices precisa ser enviado para a GPU
+
+// Tamanho da janela no quadro atual. Veja TextRendering_BeginFrame().
+int textwindow_width = 0;
+int textwindow_height = 0;
+
+// Tabela de glifos indexada pelo caractere, para não procurarmos na lista da
+// fonte a cada caractere desenhado. Não usa OpenGL.
+void TextRendering_BuildGlyphTable()
+{
+    for (size_t c = 0; c < 256; ++c)
+        textglyphs[c] = NULL;
+    for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
+    {
+        uint32_t codepoint = dejavufont.glyphs[j].codepoint;
+        if (codepoint < 256 && textglyphs[codepoint] == NULL)
+            textglyphs[codepoint] = &dejavufont.glyphs[j];
+    }
+}
+
 void TextRendering_Init()
 {
     GLuint sampler;
@@ -127,7 +179,8 @@ void TextRendering_Init()
     glBindVertexArray(textVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    textvbo_capacity = 1024;
+    glBufferData(GL_ARRAY_BUFFER, textvbo_capacity * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
@@ -140,30 +193,33 @@ void TextRendering_Init()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     glCheckError();
+
+    TextRendering_BuildGlyphTable();
 }
 
 float textscale = 1.5f;
 
-void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+// Lê o tamanho da janela, caso TextRendering_BeginFrame() ainda não tenha
+// sido chamada
+void TextRendering_WindowSize(GLFWwindow* window, int* width, int* height)
+{
+    if (textwindow_width == 0 || textwindow_height == 0)
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+    *width = std::max(textwindow_width, 1);
+    *height = std::max(textwindow_height, 1);
+}
+
+// Acrescenta em "vertices" os triângulos dos caracteres de "str"
+void TextRendering_Layout(const std::string &str, float x, float y, float scale, int width, int height,
+                          std::vector<TextVertex>& vertices)
 {
     scale *= textscale;
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
     float sx = scale / width;
     float sy = scale / height;
 
     for (size_t i = 0; i < str.size(); i++)
     {
-        // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = 0;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
-        {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)str[i])
-            {
-                glyph = &dejavufont.glyphs[j];
-                break;
-            }
-        }
+        const texture_glyph_t *glyph = textglyphs[(unsigned char)str[i]];
         if (!glyph) {
             continue;
         }
@@ -178,7 +234,7 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
         float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
 
-        struct {float x, y, s, t;} data[6] = {
+        TextVertex quad[6] = {
             { x0, y0, s0, t0 },
             { x0, y1, s0, t1 },
             { x1, y1, s1, t1 },
@@ -186,42 +242,145 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
             { x1, y1, s1, t1 },
             { x1, y0, s1, t0 }
         };
+        vertices.insert(vertices.end(), quad, quad + 6);
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        x += (glyph->advance_x * sx);
+    }
+}
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+// Remonta os textos guardados, necessário quando o tamanho da janela muda
+void TextRendering_RebuildCache()
+{
+    textcachedvertices.clear();
+    for (size_t i = 0; i < textcached.size(); ++i)
+    {
+        CachedText& text = textcached[i];
+        text.first = (GLint)textcachedvertices.size();
+        TextRendering_Layout(text.str, text.x, text.y, text.scale,
+                             std::max(textwindow_width, 1), std::max(textwindow_height, 1), textcachedvertices);
+        text.count = (GLsizei)(textcachedvertices.size() - text.first);
+    }
+    textcached_dirty = true;
+}
 
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
+// Deve ser chamada antes dos textos de cada quadro
+void TextRendering_BeginFrame(GLFWwindow* window)
+{
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    // Com a janela minimizada (0x0) mantemos o tamanho anterior: a
+    // montagem dos textos dividiria por zero
+    if (width > 0 && height > 0 && (width != textwindow_width || height != textwindow_height))
+    {
+        textwindow_width = width;
+        textwindow_height = height;
+        TextRendering_RebuildCache();
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    textvertices.clear();
+    textdrawfirst.clear();
+    textdrawcount.clear();
+}
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+{
+    int width, height;
+    TextRendering_WindowSize(window, &width, &height);
+    TextRendering_Layout(str, x, y, scale, width, height, textvertices);
+}
 
-        glDisable(GL_BLEND);
+// Guarda um texto que não muda e retorna o identificador usado por
+// TextRendering_PrintCached()
+int TextRendering_CacheString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+{
+    int width, height;
+    TextRendering_WindowSize(window, &width, &height);
+
+    CachedText text;
+    text.str = str;
+    text.x = x;
+    text.y = y;
+    text.scale = scale;
+    text.first = (GLint)textcachedvertices.size();
+    TextRendering_Layout(str, x, y, scale, width, height, textcachedvertices);
+    text.count = (GLsizei)(textcachedvertices.size() - text.first);
+    textcached.push_back(text);
+    textcached_dirty = true;
+    return (int)textcached.size() - 1;
+}
 
-        x += (glyph->advance_x * sx);
+void TextRendering_PrintCached(int text)
+{
+    if (text < 0 || text >= (int)textcached.size() || textcached[text].count == 0)
+        return;
+    textdrawfirst.push_back(textcached[text].first);
+    textdrawcount.push_back(textcached[text].count);
+}
+
+// Desenha todos os textos do quadro com uma única chamada
+void TextRendering_Flush()
+{
+    PROFILE_FUNCTION();
+
+    size_t num_cached = textcachedvertices.size();
+    size_t num_vertices = num_cached + textvertices.size();
+    if (!textvertices.empty())
+    {
+        textdrawfirst.push_back((GLint)num_cached);
+        textdrawcount.push_back((GLsizei)textvertices.size());
     }
+    if (textdrawfirst.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    if (num_vertices > textvbo_capacity)
+    {
+        while (textvbo_capacity < num_vertices)
+            textvbo_capacity *= 2;
+        glBufferData(GL_ARRAY_BUFFER, textvbo_capacity * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
+        textcached_dirty = true;
+    }
+    if (textcached_dirty && num_cached > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, num_cached * sizeof(TextVertex), textcachedvertices.data());
+    textcached_dirty = false;
+    if (!textvertices.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, num_cached * sizeof(TextVertex),
+                        textvertices.size() * sizeof(TextVertex), textvertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
+
+    glUseProgram(textprogram_id);
+    glBindVertexArray(textVAO);
+
+    glMultiDrawArrays(GL_TRIANGLES, textdrawfirst.data(), textdrawcount.data(), (GLsizei)textdrawfirst.size());
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+
+    glDisable(GL_BLEND);
+
+    textvertices.clear();
+    textdrawfirst.clear();
+    textdrawcount.clear();
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)
 {
     int width, height;
-    glfwGetWindowSize(window, &width, &height);
+    TextRendering_WindowSize(window, &width, &height);
     return dejavufont.height / height * textscale;
 }
 
 float TextRendering_CharWidth(GLFWwindow* window)
 {
     int width, height;
-    glfwGetWindowSize(window, &width, &height);
+    TextRendering_WindowSize(window, &width, &height);
     return dejavufont.glyphs[32].advance_x / width * textscale;
 }
 